@@ -238,6 +238,15 @@ void cell_drift_part(struct cell *c, const struct engine *e, int force,
       dt_therm = (ti_current - ti_old_part) * e->time_base;
     }
 
+    /* Find the replications in which the particles of this cell can cross a
+     * lightcone during this drift (NULL if there are none) */
+    struct replication_list *drift_replication_list = NULL;
+#ifdef WITH_LIGHTCONE
+    drift_replication_list = lightcone_array_refine_replications_for_drift(
+        e->lightcone_array_properties, e->cosmology, c, replication_list,
+        ti_old_part, ti_current);
+#endif
+
     /* Loop over all the gas particles in the cell */
     const size_t nr_parts = c->hydro.count;
     for (size_t k = 0; k < nr_parts; k++) {
@@ -255,7 +264,8 @@ void cell_drift_part(struct cell *c, const struct engine *e, int force,
 
       /* Drift... */
       drift_part(p, xp, dt_drift, dt_kick_hydro, dt_kick_grav, dt_therm,
-                 ti_old_part, ti_current, e, replication_list, c->loc);
+                 ti_old_part, ti_current, e, drift_replication_list,
+                 c->loc);
 
       /* Update the tracers properties */
       tracers_after_drift(p, xp, e->internal_units, e->physical_constants,
@@ -360,6 +370,12 @@ void cell_drift_part(struct cell *c, const struct engine *e, int force,
 #endif
     }
 
+#ifdef WITH_LIGHTCONE
+    if (drift_replication_list != NULL)
+      lightcone_array_free_replications(e->lightcone_array_properties,
+                                        drift_replication_list);
+#endif
+
     /* Now, get the maximal particle motion from its square */
     dx_max = sqrtf(dx2_max);
     dx_max_sort = sqrtf(dx2_max_sort);
@@ -465,6 +481,15 @@ void cell_drift_gpart(struct cell *c, const struct engine *e, int force,
       dt_drift = (ti_current - ti_old_gpart) * e->time_base;
     }
 
+    /* Find the replications in which the particles of this cell can cross a
+     * lightcone during this drift (NULL if there are none) */
+    struct replication_list *drift_replication_list = NULL;
+#ifdef WITH_LIGHTCONE
+    drift_replication_list = lightcone_array_refine_replications_for_drift(
+        e->lightcone_array_properties, e->cosmology, c, replication_list,
+        ti_old_gpart, ti_current);
+#endif
+
     /* Loop over all the g-particles in the cell */
     const size_t nr_gparts = c->grav.count;
     for (size_t k = 0; k < nr_gparts; k++) {
@@ -482,7 +507,7 @@ void cell_drift_gpart(struct cell *c, const struct engine *e, int force,
 
       /* Drift... */
       drift_gpart(gp, dt_drift_k, ti_old_gpart, ti_current, grav_props, e,
-                  replication_list, c->loc);
+                  drift_replication_list, c->loc);
 
 #ifdef SWIFT_DEBUG_CHECKS
       /* Make sure the particle does not drift by more than a box length. */
@@ -539,6 +564,12 @@ void cell_drift_gpart(struct cell *c, const struct engine *e, int force,
       }
     }
 
+#ifdef WITH_LIGHTCONE
+    if (drift_replication_list != NULL)
+      lightcone_array_free_replications(e->lightcone_array_properties,
+                                        drift_replication_list);
+#endif
+
     /* Update the time of the last drift */
     c->grav.ti_old_part = ti_current;
   }
@@ -648,6 +679,15 @@ void cell_drift_spart(struct cell *c, const struct engine *e, int force,
       dt_drift = (ti_current - ti_old_spart) * e->time_base;
     }
 
+    /* Find the replications in which the particles of this cell can cross a
+     * lightcone during this drift (NULL if there are none) */
+    struct replication_list *drift_replication_list = NULL;
+#ifdef WITH_LIGHTCONE
+    drift_replication_list = lightcone_array_refine_replications_for_drift(
+        e->lightcone_array_properties, e->cosmology, c, replication_list,
+        ti_old_spart, ti_current);
+#endif
+
     /* Loop over all the star particles in the cell */
     const size_t nr_sparts = c->stars.count;
     for (size_t k = 0; k < nr_sparts; k++) {
@@ -658,8 +698,8 @@ void cell_drift_spart(struct cell *c, const struct engine *e, int force,
       if (spart_is_inhibited(sp, e)) continue;
 
       /* Drift... */
-      drift_spart(sp, dt_drift, ti_old_spart, ti_current, e, replication_list,
-                  c->loc);
+      drift_spart(sp, dt_drift, ti_old_spart, ti_current, e,
+                  drift_replication_list, c->loc);
 
 #ifdef SWIFT_DEBUG_CHECKS
       /* Make sure the particle does not drift by more than a box length. */
@@ -733,6 +773,12 @@ void cell_drift_spart(struct cell *c, const struct engine *e, int force,
       }
     }
 
+#ifdef WITH_LIGHTCONE
+    if (drift_replication_list != NULL)
+      lightcone_array_free_replications(e->lightcone_array_properties,
+                                        drift_replication_list);
+#endif
+
     /* Now, get the maximal particle motion from its square */
     dx_max = sqrtf(dx2_max);
     dx_max_sort = sqrtf(dx2_max_sort);
@@ -853,6 +899,15 @@ void cell_drift_bpart(struct cell *c, const struct engine *e, int force,
       dt_drift = (ti_current - ti_old_bpart) * e->time_base;
     }
 
+    /* Find the replications in which the particles of this cell can cross a
+     * lightcone during this drift (NULL if there are none) */
+    struct replication_list *drift_replication_list = NULL;
+#ifdef WITH_LIGHTCONE
+    drift_replication_list = lightcone_array_refine_replications_for_drift(
+        e->lightcone_array_properties, e->cosmology, c, replication_list,
+        ti_old_bpart, ti_current);
+#endif
+
     /* Loop over all the black hole particles in the cell */
     const size_t nr_bparts = c->black_holes.count;
     for (size_t k = 0; k < nr_bparts; k++) {
@@ -864,8 +919,8 @@ void cell_drift_bpart(struct cell *c, const struct engine *e, int force,
       if (bpart_is_inhibited(bp, e)) continue;
 
       /* Drift... */
-      drift_bpart(bp, dt_drift, ti_old_bpart, ti_current, e, replication_list,
-                  c->loc);
+      drift_bpart(bp, dt_drift, ti_old_bpart, ti_current, e,
+                  drift_replication_list, c->loc);
 
 #ifdef SWIFT_DEBUG_CHECKS
       /* Make sure the particle does not drift by more than a box length. */
@@ -932,6 +987,12 @@ void cell_drift_bpart(struct cell *c, const struct engine *e, int force,
       }
     }
 
+#ifdef WITH_LIGHTCONE
+    if (drift_replication_list != NULL)
+      lightcone_array_free_replications(e->lightcone_array_properties,
+                                        drift_replication_list);
+#endif
+
     /* Now, get the maximal particle motion from its square */
     dx_max = sqrtf(dx2_max);
 
@@ -329,6 +329,98 @@ int cell_unpack_tags(const int *tags, struct cell *restrict c) {
 #endif
 }
 
+/**
+ * @brief Pack the offsets of the particles of a foreign cell and all its
+ * sub-cells in the node-shared foreign buffers.
+ *
+ * Two values are packed per cell: the offset of its #part in
+ * s->parts_foreign and that of its #gpart in s->gparts_foreign (-1 if the
+ * cell's particles are not linked to the buffers).
+ *
+ * @param c The foreign #cell.
+ * @param s The #space holding the foreign buffers.
+ * @param offsets Pointer to an array of packed offsets.
+ *
+ * @return The number of packed cells.
+ */
+int cell_pack_node_offsets(const struct cell *c, const struct space *s,
+                           long long *offsets) {
+#ifdef WITH_MPI
+
+  /* Start by packing the data of the current cell. */
+  offsets[0] = -1;
+  offsets[1] = -1;
+  if (c->hydro.parts != NULL && c->hydro.parts >= s->parts_foreign &&
+      c->hydro.parts < s->parts_foreign + s->nr_parts_foreign)
+    offsets[0] = c->hydro.parts - s->parts_foreign;
+  if (c->grav.parts != NULL && c->grav.parts >= s->gparts_foreign &&
+      c->grav.parts < s->gparts_foreign + s->nr_gparts_foreign)
+    offsets[1] = c->grav.parts - s->gparts_foreign;
+
+  /* Fill in the progeny, depth-first recursion. */
+  int count = 1;
+  for (int k = 0; k < 8; k++)
+    if (c->progeny[k] != NULL)
+      count += cell_pack_node_offsets(c->progeny[k], s, &offsets[2 * count]);
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (c->mpi.pcell_size != count) error("Inconsistent offset and pcell count!");
+#endif  // SWIFT_DEBUG_CHECKS
+
+  /* Return the number of packed cells used. */
+  return count;
+
+#else
+  error("SWIFT was not compiled with MPI support.");
+  return 0;
+#endif
+}
+
+/**
+ * @brief Unpack the offsets in a node-mate's shared foreign buffers into
+ * the send tasks of a local cell and all its sub-cells.
+ *
+ * @param c The local #cell.
+ * @param nodeID The rank that owns the foreign copy of the cell.
+ * @param offsets An array of offsets packed with #cell_pack_node_offsets.
+ *
+ * @return The number of unpacked cells.
+ */
+int cell_unpack_node_offsets(struct cell *c, const int nodeID,
+                             const long long *offsets) {
+#ifdef WITH_MPI
+
+  /* Attach the offsets to the send tasks going to that node. */
+  for (struct link *l = c->mpi.send; l != NULL; l = l->next) {
+    struct task *t = l->t;
+    if (t->cj->nodeID != nodeID) continue;
+
+    if (t->subtype == task_subtype_gpart)
+      t->node_offset = offsets[1];
+    else
+      t->node_offset = offsets[0];
+  }
+
+  /* Fill the progeny recursively, depth-first. */
+  int count = 1;
+  for (int k = 0; k < 8; k++)
+    if (c->progeny[k] != NULL)
+      count += cell_unpack_node_offsets(c->progeny[k], nodeID,
+                                        &offsets[2 * count]);
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (c->mpi.pcell_size != count) error("Inconsistent offset and pcell count!");
+#endif  // SWIFT_DEBUG_CHECKS
+
+  /* Return the number of unpacked cells. */
+  return count;
+
+#else
+  error("SWIFT was not compiled with MPI support.");
+  return 0;
+#endif
+}
+
 /**
  * @brief Pack the cell information about time-step sizes and displacements
  * of a cell hierarchy.
@@ -77,6 +77,12 @@ static MPI_Datatype mpicollectgroup1_type;
  */
 static MPI_Op mpicollectgroup1_reduce_op;
 
+/**
+ * @brief Buffers and request of the reduction in flight.
+ */
+static struct mpicollectgroup1 mpicollectgroup1_send, mpicollectgroup1_recv;
+static MPI_Request mpicollectgroup1_request = MPI_REQUEST_NULL;
+
 #endif
 
 /**
@@ -263,83 +269,122 @@ void collectgroup1_init(
  */
 void collectgroup1_reduce(struct collectgroup1 *grp1) {
 
+  collectgroup1_reduce_start(grp1);
+  collectgroup1_reduce_finish(grp1);
+}
+
+/**
+ * @brief Start the reduction of the group across all nodes.
+ *
+ * With MPI this posts a non-blocking reduction, so that work that does not
+ * depend on the global values can be done before calling
+ * collectgroup1_reduce_finish(). Only one reduction can be in flight at any
+ * time.
+ *
+ * @param grp1 the #collectgroup1 struct already initialised by a call
+ *             to collectgroup1_init.
+ */
+void collectgroup1_reduce_start(const struct collectgroup1 *grp1) {
+
 #ifdef WITH_MPI
 
+  if (mpicollectgroup1_request != MPI_REQUEST_NULL)
+    error("A reduction of mpicollection1 is already in flight.");
+
   /* Populate an MPI group struct and reduce this across all nodes. */
-  struct mpicollectgroup1 mpigrp11;
-  mpigrp11.updated = grp1->updated;
-  mpigrp11.g_updated = grp1->g_updated;
-  mpigrp11.s_updated = grp1->s_updated;
-  mpigrp11.sink_updated = grp1->sink_updated;
-  mpigrp11.b_updated = grp1->b_updated;
-  mpigrp11.inhibited = grp1->inhibited;
-  mpigrp11.g_inhibited = grp1->g_inhibited;
-  mpigrp11.s_inhibited = grp1->s_inhibited;
-  mpigrp11.sink_inhibited = grp1->sink_inhibited;
-  mpigrp11.b_inhibited = grp1->b_inhibited;
-  mpigrp11.ti_hydro_end_min = grp1->ti_hydro_end_min;
-  mpigrp11.ti_rt_end_min = grp1->ti_rt_end_min;
-  mpigrp11.ti_gravity_end_min = grp1->ti_gravity_end_min;
-  mpigrp11.ti_stars_end_min = grp1->ti_stars_end_min;
-  mpigrp11.ti_sinks_end_min = grp1->ti_sinks_end_min;
-  mpigrp11.ti_black_holes_end_min = grp1->ti_black_holes_end_min;
-  mpigrp11.ti_hydro_beg_max = grp1->ti_hydro_beg_max;
-  mpigrp11.ti_rt_beg_max = grp1->ti_rt_beg_max;
-  mpigrp11.ti_gravity_beg_max = grp1->ti_gravity_beg_max;
-  mpigrp11.ti_stars_beg_max = grp1->ti_stars_beg_max;
-  mpigrp11.ti_sinks_beg_max = grp1->ti_sinks_beg_max;
-  mpigrp11.ti_black_holes_beg_max = grp1->ti_black_holes_beg_max;
-  mpigrp11.forcerebuild = grp1->forcerebuild;
-  mpigrp11.total_nr_cells = grp1->total_nr_cells;
-  mpigrp11.total_nr_tasks = grp1->total_nr_tasks;
-  mpigrp11.tasks_per_cell_max = grp1->tasks_per_cell_max;
-  mpigrp11.sfh = grp1->sfh;
-  mpigrp11.runtime = grp1->runtime;
-  mpigrp11.flush_lightcone_maps = grp1->flush_lightcone_maps;
-  mpigrp11.deadtime = grp1->deadtime;
+  struct mpicollectgroup1 *mpigrp11 = &mpicollectgroup1_send;
+  mpigrp11->updated = grp1->updated;
+  mpigrp11->g_updated = grp1->g_updated;
+  mpigrp11->s_updated = grp1->s_updated;
+  mpigrp11->sink_updated = grp1->sink_updated;
+  mpigrp11->b_updated = grp1->b_updated;
+  mpigrp11->inhibited = grp1->inhibited;
+  mpigrp11->g_inhibited = grp1->g_inhibited;
+  mpigrp11->s_inhibited = grp1->s_inhibited;
+  mpigrp11->sink_inhibited = grp1->sink_inhibited;
+  mpigrp11->b_inhibited = grp1->b_inhibited;
+  mpigrp11->ti_hydro_end_min = grp1->ti_hydro_end_min;
+  mpigrp11->ti_rt_end_min = grp1->ti_rt_end_min;
+  mpigrp11->ti_gravity_end_min = grp1->ti_gravity_end_min;
+  mpigrp11->ti_stars_end_min = grp1->ti_stars_end_min;
+  mpigrp11->ti_sinks_end_min = grp1->ti_sinks_end_min;
+  mpigrp11->ti_black_holes_end_min = grp1->ti_black_holes_end_min;
+  mpigrp11->ti_hydro_beg_max = grp1->ti_hydro_beg_max;
+  mpigrp11->ti_rt_beg_max = grp1->ti_rt_beg_max;
+  mpigrp11->ti_gravity_beg_max = grp1->ti_gravity_beg_max;
+  mpigrp11->ti_stars_beg_max = grp1->ti_stars_beg_max;
+  mpigrp11->ti_sinks_beg_max = grp1->ti_sinks_beg_max;
+  mpigrp11->ti_black_holes_beg_max = grp1->ti_black_holes_beg_max;
+  mpigrp11->forcerebuild = grp1->forcerebuild;
+  mpigrp11->total_nr_cells = grp1->total_nr_cells;
+  mpigrp11->total_nr_tasks = grp1->total_nr_tasks;
+  mpigrp11->tasks_per_cell_max = grp1->tasks_per_cell_max;
+  mpigrp11->sfh = grp1->sfh;
+  mpigrp11->runtime = grp1->runtime;
+  mpigrp11->flush_lightcone_maps = grp1->flush_lightcone_maps;
+  mpigrp11->deadtime = grp1->deadtime;
 #ifdef WITH_CSDS
-  mpigrp11.csds_file_size_gb = grp1->csds_file_size_gb;
+  mpigrp11->csds_file_size_gb = grp1->csds_file_size_gb;
+#endif
+
+  if (MPI_Iallreduce(mpigrp11, &mpicollectgroup1_recv, 1,
+                     mpicollectgroup1_type, mpicollectgroup1_reduce_op,
+                     MPI_COMM_WORLD, &mpicollectgroup1_request) != MPI_SUCCESS)
+    error("Failed to start the reduction of mpicollection1.");
+
 #endif
+}
+
+/**
+ * @brief Wait for the reduction started by collectgroup1_reduce_start() to
+ * complete and copy the global values back into the group.
+ *
+ * @param grp1 the #collectgroup1 struct passed to
+ *             collectgroup1_reduce_start().
+ */
+void collectgroup1_reduce_finish(struct collectgroup1 *grp1) {
 
-  struct mpicollectgroup1 mpigrp12;
-  if (MPI_Allreduce(&mpigrp11, &mpigrp12, 1, mpicollectgroup1_type,
-                    mpicollectgroup1_reduce_op, MPI_COMM_WORLD) != MPI_SUCCESS)
+#ifdef WITH_MPI
+
+  if (MPI_Wait(&mpicollectgroup1_request, MPI_STATUS_IGNORE) != MPI_SUCCESS)
     error("Failed to reduce mpicollection1.");
 
+  const struct mpicollectgroup1 *mpigrp12 = &mpicollectgroup1_recv;
+
   /* And update. */
-  grp1->updated = mpigrp12.updated;
-  grp1->g_updated = mpigrp12.g_updated;
-  grp1->sink_updated = mpigrp12.sink_updated;
-  grp1->s_updated = mpigrp12.s_updated;
-  grp1->b_updated = mpigrp12.b_updated;
-  grp1->inhibited = mpigrp12.inhibited;
-  grp1->g_inhibited = mpigrp12.g_inhibited;
-  grp1->s_inhibited = mpigrp12.s_inhibited;
-  grp1->sink_inhibited = mpigrp12.sink_inhibited;
-  grp1->b_inhibited = mpigrp12.b_inhibited;
-  grp1->ti_hydro_end_min = mpigrp12.ti_hydro_end_min;
-  grp1->ti_rt_end_min = mpigrp12.ti_rt_end_min;
-  grp1->ti_gravity_end_min = mpigrp12.ti_gravity_end_min;
-  grp1->ti_stars_end_min = mpigrp12.ti_stars_end_min;
-  grp1->ti_sinks_end_min = mpigrp12.ti_sinks_end_min;
-  grp1->ti_black_holes_end_min = mpigrp12.ti_black_holes_end_min;
-  grp1->ti_hydro_beg_max = mpigrp12.ti_hydro_beg_max;
-  grp1->ti_rt_beg_max = mpigrp12.ti_rt_beg_max;
-  grp1->ti_gravity_beg_max = mpigrp12.ti_gravity_beg_max;
-  grp1->ti_stars_beg_max = mpigrp12.ti_stars_beg_max;
-  grp1->ti_sinks_beg_max = mpigrp12.ti_sinks_beg_max;
-  grp1->ti_black_holes_beg_max = mpigrp12.ti_black_holes_beg_max;
-  grp1->forcerebuild = mpigrp12.forcerebuild;
-  grp1->total_nr_cells = mpigrp12.total_nr_cells;
-  grp1->total_nr_tasks = mpigrp12.total_nr_tasks;
-  grp1->tasks_per_cell_max = mpigrp12.tasks_per_cell_max;
-  grp1->sfh = mpigrp12.sfh;
-  grp1->runtime = mpigrp12.runtime;
-  grp1->flush_lightcone_maps = mpigrp12.flush_lightcone_maps;
-
-  grp1->deadtime = mpigrp12.deadtime;
+  grp1->updated = mpigrp12->updated;
+  grp1->g_updated = mpigrp12->g_updated;
+  grp1->sink_updated = mpigrp12->sink_updated;
+  grp1->s_updated = mpigrp12->s_updated;
+  grp1->b_updated = mpigrp12->b_updated;
+  grp1->inhibited = mpigrp12->inhibited;
+  grp1->g_inhibited = mpigrp12->g_inhibited;
+  grp1->s_inhibited = mpigrp12->s_inhibited;
+  grp1->sink_inhibited = mpigrp12->sink_inhibited;
+  grp1->b_inhibited = mpigrp12->b_inhibited;
+  grp1->ti_hydro_end_min = mpigrp12->ti_hydro_end_min;
+  grp1->ti_rt_end_min = mpigrp12->ti_rt_end_min;
+  grp1->ti_gravity_end_min = mpigrp12->ti_gravity_end_min;
+  grp1->ti_stars_end_min = mpigrp12->ti_stars_end_min;
+  grp1->ti_sinks_end_min = mpigrp12->ti_sinks_end_min;
+  grp1->ti_black_holes_end_min = mpigrp12->ti_black_holes_end_min;
+  grp1->ti_hydro_beg_max = mpigrp12->ti_hydro_beg_max;
+  grp1->ti_rt_beg_max = mpigrp12->ti_rt_beg_max;
+  grp1->ti_gravity_beg_max = mpigrp12->ti_gravity_beg_max;
+  grp1->ti_stars_beg_max = mpigrp12->ti_stars_beg_max;
+  grp1->ti_sinks_beg_max = mpigrp12->ti_sinks_beg_max;
+  grp1->ti_black_holes_beg_max = mpigrp12->ti_black_holes_beg_max;
+  grp1->forcerebuild = mpigrp12->forcerebuild;
+  grp1->total_nr_cells = mpigrp12->total_nr_cells;
+  grp1->total_nr_tasks = mpigrp12->total_nr_tasks;
+  grp1->tasks_per_cell_max = mpigrp12->tasks_per_cell_max;
+  grp1->sfh = mpigrp12->sfh;
+  grp1->runtime = mpigrp12->runtime;
+  grp1->flush_lightcone_maps = mpigrp12->flush_lightcone_maps;
+
+  grp1->deadtime = mpigrp12->deadtime;
 #ifdef WITH_CSDS
-  grp1->csds_file_size_gb = mpigrp12.csds_file_size_gb;
+  grp1->csds_file_size_gb = mpigrp12->csds_file_size_gb;
 #endif
 
 #endif
@@ -23,6 +23,9 @@
 /* Config parameters. */
 #include <config.h>
 
+/* Standard headers. */
+#include <pthread.h>
+
 /* Local includes. */
 #include "part_type.h"
 
@@ -110,7 +113,7 @@ void io_write_part_type_names(hid_t h_grp);
 void io_write_cell_offsets(hid_t h_grp, const int cdim[3], const double dim[3],
                            const struct cell* cells_top, const int nr_cells,
                            const double width[3], const int nodeID,
-                           const int distributed,
+                           const int distributed, const int* rank_files,
                            const int subsample[swift_type_count],
                            const float subsample_fraction[swift_type_count],
                            const int snap_num,
@@ -120,6 +123,13 @@ void io_write_cell_offsets(hid_t h_grp, const int cdim[3], const double dim[3],
                            const int num_fields[swift_type_count],
                            const struct unit_system* internal_units,
                            const struct unit_system* snapshot_units);
+#ifdef WITH_MPI
+int io_read_cell_regions(const char* fileName,
+                         const long long N_total[swift_type_count],
+                         const int mpi_rank, const int mpi_size, int cdim[3],
+                         int** cell_ranks, long long offset[swift_type_count],
+                         size_t N[swift_type_count]);
+#endif
 
 void io_read_unit_system(hid_t h_file, struct unit_system* ic_units,
                          const struct unit_system* internal_units,
@@ -134,6 +144,30 @@ void io_copy_temp_buffer(void* temp, const struct engine* e,
 
 #endif /* HAVE_HDF5 */
 
+/**
+ * @brief Writes the converted fields to a file one after the other, each in
+ * the background while the next one is being converted.
+ *
+ * At most one field is being written at any time, so that at most two field
+ * buffers (the one being written and the one being filled) exist at once.
+ * No HDF5 call can be made by the caller while a write is in flight, i.e.
+ * between io_write_pipeline_submit() and the next
+ * io_write_pipeline_submit() or io_write_pipeline_wait().
+ */
+struct io_write_pipeline {
+
+  /*! The thread doing the last write submitted */
+  pthread_t thread;
+
+  /*! Is a write in flight? */
+  int running;
+};
+
+void io_write_pipeline_submit(struct io_write_pipeline* p,
+                              void (*write)(void*), void* data,
+                              const int background);
+void io_write_pipeline_wait(struct io_write_pipeline* p);
+
 size_t io_sizeof_type(enum IO_DATA_TYPE type);
 int io_is_double_precision(enum IO_DATA_TYPE type);
 
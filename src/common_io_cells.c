@@ -260,6 +260,8 @@ void io_write_array(hid_t h_grp, const int n, const int dim, const void* array,
  * @param cells_top The top-level cells.
  * @param nr_cells The number of top-level cells.
  * @param distributed Is this a distributed snapshot?
+ * @param rank_files For a distributed snapshot, the file each rank writes
+ * its particles to, NULL for one file per rank.
  * @param subsample Are we subsampling the different particle types?
  * @param subsample_fraction The fraction of particles to keep when subsampling.
  * @param snap_num The snapshot number used as subsampling random seed.
@@ -275,7 +277,7 @@ void io_write_array(hid_t h_grp, const int n, const int dim, const void* array,
 void io_write_cell_offsets(hid_t h_grp, const int cdim[3], const double dim[3],
                            const struct cell* cells_top, const int nr_cells,
                            const double width[3], const int nodeID,
-                           const int distributed,
+                           const int distributed, const int* rank_files,
                            const int subsample[swift_type_count],
                            const float subsample_fraction[swift_type_count],
                            const int snap_num,
@@ -287,7 +289,7 @@ void io_write_cell_offsets(hid_t h_grp, const int cdim[3], const double dim[3],
                            const struct unit_system* snapshot_units) {
 
 #ifdef SWIFT_DEBUG_CHECKS
-  if (distributed) {
+  if (distributed && rank_files == NULL) {
     if (global_offsets[0] != 0 || global_offsets[1] != 0 ||
         global_offsets[2] != 0 || global_offsets[3] != 0 ||
         global_offsets[4] != 0 || global_offsets[5] != 0 ||
@@ -378,7 +380,9 @@ void io_write_cell_offsets(hid_t h_grp, const int cdim[3], const double dim[3],
   for (int i = 0; i < nr_cells; ++i) {
 
     /* Store in which file this cell will be found */
-    if (distributed) {
+    if (distributed && rank_files != NULL) {
+      files[i] = rank_files[cells_top[i].nodeID];
+    } else if (distributed) {
       files[i] = cells_top[i].nodeID;
     } else {
       files[i] = 0;
@@ -437,8 +441,9 @@ void io_write_cell_offsets(hid_t h_grp, const int cdim[3], const double dim[3],
           &min_nupart_pos[i * 3], &max_nupart_pos[i * 3]);
 
       /* Offsets including the global offset of all particles on this MPI rank
-       * Note that in the distributed case, the global offsets are 0 such that
-       * we actually compute the offset in the file written by this rank. */
+       * Note that in the distributed case, the global offsets are those of
+       * this rank in its file (0 if it has a file of its own) such that we
+       * actually compute the offset in the file written by this rank. */
       offset_part[i] = local_offset_part + global_offsets[swift_type_gas];
       offset_gpart[i] =
           local_offset_gpart + global_offsets[swift_type_dark_matter];
@@ -759,4 +764,282 @@ void io_write_cell_offsets(hid_t h_grp, const int cdim[3], const double dim[3],
   free(max_nupart_pos);
 }
 
+#ifdef WITH_MPI
+
+/**
+ * @brief Sort key of a top-level cell of an IC file.
+ */
+struct io_cell_key {
+
+  /*! Sum of the offsets in the file of all the particle types. */
+  long long offset;
+
+  /*! Index of the cell. */
+  int cid;
+};
+
+/**
+ * @brief Sort #io_cell_key by offset, then by cell index.
+ */
+static int io_cell_key_compare(const void* a, const void* b) {
+
+  const struct io_cell_key* ka = (const struct io_cell_key*)a;
+  const struct io_cell_key* kb = (const struct io_cell_key*)b;
+  if (ka->offset != kb->offset) return (ka->offset < kb->offset) ? -1 : 1;
+  return ka->cid - kb->cid;
+}
+
+/**
+ * @brief Split the particles of a single-file IC among ranks following the
+ * top-level cell meta-data stored in the file (rank 0 only).
+ *
+ * The cells are ordered by their position in the file and cut into
+ * consecutive runs holding similar numbers of particles. Each rank then reads
+ * one contiguous slice of every particle type and owns the cells it contains,
+ * which for a snapshot written by SWIFT are the spatially compact domains of
+ * the run that wrote it.
+ *
+ * Returns 0 if the file has no usable cell meta-data: no "Cells" group, a
+ * particle type without cell information, a distributed or sub-sampled
+ * snapshot, or particles not sorted by cell.
+ *
+ * @param h_file The (opened) IC file.
+ * @param N_total The total number of particles of each type in the file.
+ * @param nr_ranks The number of ranks to split the particles over.
+ * @param cdim (return) The number of top-level cells along each axis.
+ * @param cell_ranks (return) The rank reading each top-level cell, allocated
+ * here and to be freed by the caller.
+ * @param offsets (return) Offset in the file of the first particle of each
+ * type read by each rank (array of size nr_ranks * swift_type_count).
+ * @param counts (return) Number of particles of each type read by each rank
+ * (array of size nr_ranks * swift_type_count).
+ * @return 1 if the split succeeded, 0 otherwise.
+ */
+static int io_read_cell_regions_file(
+    hid_t h_file, const long long N_total[swift_type_count],
+    const int nr_ranks, int cdim[3], int** cell_ranks, long long* offsets,
+    long long* counts) {
+
+  *cell_ranks = NULL;
+
+  /* The parent group has to be checked first. */
+  htri_t exist = H5Lexists(h_file, "/Cells", H5P_DEFAULT);
+  if (exist > 0) exist = H5Lexists(h_file, "/Cells/Meta-data", H5P_DEFAULT);
+  if (exist < 0)
+    error("Error while checking the existence of cell meta-data.");
+  if (exist == 0) {
+    message("No cell meta-data found in the ICs.");
+    return 0;
+  }
+
+  hid_t h_grp = H5Gopen(h_file, "/Cells/Meta-data", H5P_DEFAULT);
+  if (h_grp < 0) error("Error while opening cell meta-data.");
+  io_read_attribute(h_grp, "dimension", INT, cdim);
+  H5Gclose(h_grp);
+  const int nr_cells = cdim[0] * cdim[1] * cdim[2];
+  if (nr_cells < nr_ranks) {
+    message("Fewer cells in the ICs (%d) than ranks.", nr_cells);
+    return 0;
+  }
+
+  long long* cell_counts =
+      (long long*)malloc(swift_type_count * nr_cells * sizeof(long long));
+  long long* cell_offsets =
+      (long long*)malloc(swift_type_count * nr_cells * sizeof(long long));
+  int* cell_files = (int*)malloc(nr_cells * sizeof(int));
+  struct io_cell_key* keys =
+      (struct io_cell_key*)malloc(nr_cells * sizeof(struct io_cell_key));
+  if (cell_counts == NULL || cell_offsets == NULL || cell_files == NULL ||
+      keys == NULL)
+    error("Unable to allocate memory for the cell meta-data.");
+  bzero(cell_counts, swift_type_count * nr_cells * sizeof(long long));
+  bzero(cell_offsets, swift_type_count * nr_cells * sizeof(long long));
+
+  /* Read the counts and offsets of all the types present in the file. */
+  int usable = 1;
+  for (int ptype = 0; ptype < swift_type_count && usable; ptype++) {
+
+    if (N_total[ptype] == 0) continue;
+
+    char name[PARTICLE_GROUP_BUFFER_SIZE];
+    snprintf(name, PARTICLE_GROUP_BUFFER_SIZE, "/Cells/Counts/PartType%d",
+             ptype);
+    if (H5Lexists(h_file, "/Cells/Counts", H5P_DEFAULT) <= 0 ||
+        H5Lexists(h_file, name, H5P_DEFAULT) <= 0) {
+      message("No cell meta-data for particle type %d in the ICs.", ptype);
+      usable = 0;
+      break;
+    }
+    io_read_array_dataset(h_file, name, LONGLONG,
+                          &cell_counts[ptype * nr_cells], nr_cells);
+    snprintf(name, PARTICLE_GROUP_BUFFER_SIZE,
+             "/Cells/OffsetsInFile/PartType%d", ptype);
+    io_read_array_dataset(h_file, name, LONGLONG,
+                          &cell_offsets[ptype * nr_cells], nr_cells);
+    snprintf(name, PARTICLE_GROUP_BUFFER_SIZE, "/Cells/Files/PartType%d",
+             ptype);
+    io_read_array_dataset(h_file, name, INT, cell_files, nr_cells);
+
+    long long total = 0;
+    for (int cid = 0; cid < nr_cells; cid++) {
+      total += cell_counts[ptype * nr_cells + cid];
+      if (cell_files[cid] != 0) usable = 0;
+    }
+    if (!usable) message("The ICs are a distributed snapshot.");
+    if (usable && total != N_total[ptype]) {
+      message("The cells of the ICs do not hold all the particles of type %d.",
+              ptype);
+      usable = 0;
+    }
+  }
+
+  /* Order the cells as they appear in the file. A non-empty cell is always
+   * strictly before the next one, so only empty cells can tie. */
+  for (int cid = 0; cid < nr_cells && usable; cid++) {
+    keys[cid].cid = cid;
+    keys[cid].offset = 0;
+    for (int ptype = 0; ptype < swift_type_count; ptype++)
+      keys[cid].offset += cell_offsets[ptype * nr_cells + cid];
+  }
+  if (usable)
+    qsort(keys, nr_cells, sizeof(struct io_cell_key), io_cell_key_compare);
+
+  /* Check that, in this order, the cells tile every particle array. */
+  for (int ptype = 0; ptype < swift_type_count && usable; ptype++) {
+    long long next = 0;
+    for (int k = 0; k < nr_cells; k++) {
+      const int cid = keys[k].cid;
+      const long long count = cell_counts[ptype * nr_cells + cid];
+      if (count == 0) continue;
+      if (cell_offsets[ptype * nr_cells + cid] != next) {
+        message("The particles of type %d in the ICs are not sorted by cell.",
+                ptype);
+        usable = 0;
+        break;
+      }
+      next += count;
+    }
+  }
+
+  if (usable) {
+
+    long long weight = 0;
+    for (int ptype = 0; ptype < swift_type_count; ptype++)
+      weight += N_total[ptype];
+
+    if ((*cell_ranks = (int*)malloc(nr_cells * sizeof(int))) == NULL)
+      error("Unable to allocate memory for the cell ranks.");
+    bzero(offsets, nr_ranks * swift_type_count * sizeof(long long));
+    bzero(counts, nr_ranks * swift_type_count * sizeof(long long));
+
+    /* Cut the ordered cells into runs of similar weight, keeping at least
+     * one cell per rank. */
+    long long sum = 0;
+    int rank = 0;
+    for (int k = 0; k < nr_cells; k++) {
+      const int cid = keys[k].cid;
+
+      /* Move on to the next rank once this one has had its share, or if we
+       * must leave one cell for each of the remaining ranks. */
+      if (rank < nr_ranks - 1 && k > 0 &&
+          (sum * nr_ranks >= (rank + 1) * weight ||
+           nr_cells - k == nr_ranks - rank - 1)) {
+        rank++;
+        for (int ptype = 0; ptype < swift_type_count; ptype++)
+          offsets[rank * swift_type_count + ptype] =
+              offsets[(rank - 1) * swift_type_count + ptype] +
+              counts[(rank - 1) * swift_type_count + ptype];
+      }
+
+      (*cell_ranks)[cid] = rank;
+      for (int ptype = 0; ptype < swift_type_count; ptype++) {
+        const long long count = cell_counts[ptype * nr_cells + cid];
+        counts[rank * swift_type_count + ptype] += count;
+        sum += count;
+      }
+    }
+    if (rank != nr_ranks - 1) error("Failed to give cells to all the ranks.");
+  }
+
+  free(keys);
+  free(cell_files);
+  free(cell_offsets);
+  free(cell_counts);
+  return usable;
+}
+
+/**
+ * @brief Split the particles of an IC file among all the ranks following the
+ * top-level cell meta-data stored in the file.
+ *
+ * Collective over MPI_COMM_WORLD. Only rank 0 reads the meta-data. See
+ * #io_read_cell_regions_file for the split itself.
+ *
+ * @param fileName The name of the IC file.
+ * @param N_total The total number of particles of each type in the file.
+ * @param mpi_rank The rank of this node.
+ * @param mpi_size The number of ranks.
+ * @param cdim (return) The number of top-level cells of the ICs along each
+ * axis.
+ * @param cell_ranks (return) The rank reading each top-level cell of the ICs,
+ * allocated here and to be freed by the caller.
+ * @param offset (return) Offset in the file of the first particle of each type
+ * to read on this rank.
+ * @param N (return) The number of particles of each type to read on this rank.
+ * @return 1 if the split succeeded, 0 if the file has no usable cell
+ * meta-data, in which case the outputs are left untouched.
+ */
+int io_read_cell_regions(const char* fileName,
+                         const long long N_total[swift_type_count],
+                         const int mpi_rank, const int mpi_size, int cdim[3],
+                         int** cell_ranks, long long offset[swift_type_count],
+                         size_t N[swift_type_count]) {
+
+  int usable = 0;
+  long long* offsets = NULL;
+  long long* counts = NULL;
+  if (mpi_rank == 0) {
+    offsets =
+        (long long*)malloc(mpi_size * swift_type_count * sizeof(long long));
+    counts =
+        (long long*)malloc(mpi_size * swift_type_count * sizeof(long long));
+    if (offsets == NULL || counts == NULL)
+      error("Unable to allocate memory for the rank offsets.");
+
+    const hid_t h_file = H5Fopen(fileName, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (h_file < 0)
+      error("Error while opening file '%s' to read the cells.", fileName);
+    usable = io_read_cell_regions_file(h_file, N_total, mpi_size, cdim,
+                                       cell_ranks, offsets, counts);
+    H5Fclose(h_file);
+  }
+
+  MPI_Bcast(&usable, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  if (usable) {
+
+    /* Everyone needs the owner of every cell for the initial partition. */
+    MPI_Bcast(cdim, 3, MPI_INT, 0, MPI_COMM_WORLD);
+    const int nr_cells = cdim[0] * cdim[1] * cdim[2];
+    if (mpi_rank != 0 &&
+        (*cell_ranks = (int*)malloc(nr_cells * sizeof(int))) == NULL)
+      error("Unable to allocate memory for the cell ranks.");
+    MPI_Bcast(*cell_ranks, nr_cells, MPI_INT, 0, MPI_COMM_WORLD);
+
+    /* But only its own slice of the file. */
+    long long my_counts[swift_type_count];
+    MPI_Scatter(offsets, swift_type_count, MPI_LONG_LONG_INT, offset,
+                swift_type_count, MPI_LONG_LONG_INT, 0, MPI_COMM_WORLD);
+    MPI_Scatter(counts, swift_type_count, MPI_LONG_LONG_INT, my_counts,
+                swift_type_count, MPI_LONG_LONG_INT, 0, MPI_COMM_WORLD);
+    for (int ptype = 0; ptype < swift_type_count; ptype++)
+      N[ptype] = my_counts[ptype];
+  }
+
+  free(offsets);
+  free(counts);
+  return usable;
+}
+
+#endif /* WITH_MPI */
+
 #endif /* HAVE_HDF5 */
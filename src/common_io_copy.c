@@ -455,6 +455,28 @@ void io_convert_sink_l_mapper(void* restrict temp, int N,
     props.convert_sink_l(e, sinks + delta + i, &temp_l[i * dim]);
 }
 
+/**
+ * @brief Mapper function applying a unit conversion factor to a buffer of
+ * doubles.
+ */
+void io_scale_d_mapper(void* restrict temp, int N, void* restrict extra_data) {
+
+  const double factor = *((const double*)extra_data);
+  double* restrict temp_d = (double*)temp;
+  for (int i = 0; i < N; i++) temp_d[i] *= factor;
+}
+
+/**
+ * @brief Mapper function applying a unit conversion factor to a buffer of
+ * floats.
+ */
+void io_scale_f_mapper(void* restrict temp, int N, void* restrict extra_data) {
+
+  const double factor = *((const double*)extra_data);
+  float* restrict temp_f = (float*)temp;
+  for (int i = 0; i < N; i++) temp_f[i] *= factor;
+}
+
 /**
  * @brief Copy the particle data into a temporary buffer ready for i/o.
  *
@@ -740,14 +762,78 @@ void io_copy_temp_buffer(void* temp, const struct engine* e,
 
     /* message("Converting ! factor=%e", factor); */
 
-    if (io_is_double_precision(props.type)) {
-      swift_declare_aligned_ptr(double, temp_d, (double*)temp,
-                                IO_BUFFER_ALIGNMENT);
-      for (size_t i = 0; i < num_elements; ++i) temp_d[i] *= factor;
-    } else {
-      swift_declare_aligned_ptr(float, temp_f, (float*)temp,
-                                IO_BUFFER_ALIGNMENT);
-      for (size_t i = 0; i < num_elements; ++i) temp_f[i] *= factor;
-    }
+    if (io_is_double_precision(props.type))
+      threadpool_map((struct threadpool*)&e->threadpool, io_scale_d_mapper,
+                     temp, num_elements, sizeof(double),
+                     threadpool_auto_chunk_size, (void*)&factor);
+    else
+      threadpool_map((struct threadpool*)&e->threadpool, io_scale_f_mapper,
+                     temp, num_elements, sizeof(float),
+                     threadpool_auto_chunk_size, (void*)&factor);
+  }
+}
+
+/**
+ * @brief A write handed over to the #io_write_pipeline thread.
+ */
+struct io_write_pipeline_job {
+  void (*write)(void*);
+  void* data;
+};
+
+/**
+ * @brief Body of the #io_write_pipeline thread.
+ */
+static void* io_write_pipeline_runner(void* arg) {
+
+  struct io_write_pipeline_job job = *((struct io_write_pipeline_job*)arg);
+  free(arg);
+  job.write(job.data);
+  return NULL;
+}
+
+/**
+ * @brief Hand a converted field over to the #io_write_pipeline.
+ *
+ * Waits for the previous write to complete and starts this one.
+ *
+ * @param p The #io_write_pipeline.
+ * @param write The function writing the field (and freeing its buffer).
+ * @param data The argument of the function.
+ * @param background Can the write be done in the background? This must be
+ * 0 if the writing function uses the threadpool, which the caller needs to
+ * convert the next field.
+ */
+void io_write_pipeline_submit(struct io_write_pipeline* p,
+                              void (*write)(void*), void* data,
+                              const int background) {
+
+  io_write_pipeline_wait(p);
+
+  if (!background) {
+    write(data);
+    return;
   }
+
+  struct io_write_pipeline_job* job =
+      (struct io_write_pipeline_job*)malloc(sizeof(*job));
+  if (job == NULL) error("Unable to allocate i/o pipeline job");
+  job->write = write;
+  job->data = data;
+  if (pthread_create(&p->thread, NULL, io_write_pipeline_runner, job) != 0)
+    error("Failed to create i/o pipeline thread.");
+  p->running = 1;
+}
+
+/**
+ * @brief Wait for the field being written by the #io_write_pipeline, if any.
+ *
+ * @param p The #io_write_pipeline.
+ */
+void io_write_pipeline_wait(struct io_write_pipeline* p) {
+
+  if (!p->running) return;
+  if (pthread_join(p->thread, NULL) != 0)
+    error("Failed to join i/o pipeline thread.");
+  p->running = 0;
 }
@@ -43,6 +43,7 @@
 #include "hydro.h"
 #include "interpolate.h"
 #include "io_properties.h"
+#include "mpi_node.h"
 #include "parser.h"
 #include "part.h"
 #include "physical_constants.h"
@@ -160,8 +161,19 @@ void cooling_update(const struct cosmology *cosmo,
   /* Do we already have the correct tables loaded? */
   if (cooling->z_index == z_index) return;
 
+  /* When the tables are shared by the node, only one rank reads them */
+  int read_tables = 1;
+#ifdef WITH_MPI
+  if (cooling->tables_node_shared)
+    read_tables = mpi_node_shared_begin_write(&cooling->tables_window);
+#endif
+
   /* Which table should we load ? */
-  if (z_index >= eagle_cooling_N_redshifts) {
+  if (!read_tables) {
+
+    /* Nothing to do, a node-mate reads them for us */
+
+  } else if (z_index >= eagle_cooling_N_redshifts) {
 
     if (z_index == eagle_cooling_N_redshifts + 1) {
 
@@ -183,6 +195,11 @@ void cooling_update(const struct cosmology *cosmo,
     get_cooling_table(cooling, low_z_index, high_z_index);
   }
 
+#ifdef WITH_MPI
+  if (cooling->tables_node_shared)
+    mpi_node_shared_end_write(&cooling->tables_window);
+#endif
+
   /* Store the currently loaded index */
   cooling->z_index = z_index;
 }
@@ -192,25 +209,18 @@ void cooling_update(const struct cosmology *cosmo,
  *
  * @param u_ini_cgs Internal energy at beginning of hydro step in CGS.
  * @param n_H_cgs Hydrogen number density in CGS.
- * @param redshift Current redshift.
- * @param n_H_index Particle hydrogen number density index.
- * @param d_n_H Particle hydrogen number density offset.
- * @param He_index Particle helium fraction index.
- * @param d_He Particle helium fraction offset.
+ * @param slice The #eagle_cooling_slice of the particle.
  * @param Lambda_He_reion_cgs Cooling rate coming from He reionization.
  * @param ratefact_cgs Multiplication factor to get a cooling rate.
  * @param cooling #cooling_function_data structure.
- * @param abundance_ratio Array of ratios of metal abundance to solar.
  * @param dt_cgs timestep in CGS.
  * @param ID ID of the particle (for debugging).
  */
 INLINE static double bisection_iter(
-    const double u_ini_cgs, const double n_H_cgs, const double redshift,
-    const int n_H_index, const float d_n_H, const int He_index,
-    const float d_He, const double Lambda_He_reion_cgs,
+    const double u_ini_cgs, const double n_H_cgs,
+    struct eagle_cooling_slice *slice, const double Lambda_He_reion_cgs,
     const double ratefact_cgs,
     const struct cooling_function_data *restrict cooling,
-    const float abundance_ratio[eagle_cooling_N_abundances],
     const double dt_cgs, const long long ID) {
 
   /* Bracketing */
@@ -223,8 +233,7 @@ INLINE static double bisection_iter(
 
   double LambdaNet_cgs =
       Lambda_He_reion_cgs +
-      eagle_cooling_rate(log10(u_ini_cgs), redshift, n_H_cgs, abundance_ratio,
-                         n_H_index, d_n_H, He_index, d_He, cooling);
+      eagle_cooling_rate_slice(log10(u_ini_cgs), slice, cooling);
 
   /*************************************/
   /* Let's try to bracket the solution */
@@ -237,10 +246,9 @@ INLINE static double bisection_iter(
     u_upper_cgs *= bracket_factor;
 
     /* Compute a new rate */
-    LambdaNet_cgs = Lambda_He_reion_cgs +
-                    eagle_cooling_rate(log10(u_lower_cgs), redshift, n_H_cgs,
-                                       abundance_ratio, n_H_index, d_n_H,
-                                       He_index, d_He, cooling);
+    LambdaNet_cgs =
+        Lambda_He_reion_cgs +
+        eagle_cooling_rate_slice(log10(u_lower_cgs), slice, cooling);
 
     int i = 0;
     while (u_lower_cgs - u_ini_cgs - LambdaNet_cgs * ratefact_cgs * dt_cgs >
@@ -251,10 +259,9 @@ INLINE static double bisection_iter(
       u_upper_cgs /= bracket_factor;
 
       /* Compute a new rate */
-      LambdaNet_cgs = Lambda_He_reion_cgs +
-                      eagle_cooling_rate(log10(u_lower_cgs), redshift, n_H_cgs,
-                                         abundance_ratio, n_H_index, d_n_H,
-                                         He_index, d_He, cooling);
+      LambdaNet_cgs =
+          Lambda_He_reion_cgs +
+          eagle_cooling_rate_slice(log10(u_lower_cgs), slice, cooling);
       i++;
     }
 
@@ -271,10 +278,9 @@ INLINE static double bisection_iter(
     u_upper_cgs *= bracket_factor;
 
     /* Compute a new rate */
-    LambdaNet_cgs = Lambda_He_reion_cgs +
-                    eagle_cooling_rate(log10(u_upper_cgs), redshift, n_H_cgs,
-                                       abundance_ratio, n_H_index, d_n_H,
-                                       He_index, d_He, cooling);
+    LambdaNet_cgs =
+        Lambda_He_reion_cgs +
+        eagle_cooling_rate_slice(log10(u_upper_cgs), slice, cooling);
 
     int i = 0;
     while (u_upper_cgs - u_ini_cgs - LambdaNet_cgs * ratefact_cgs * dt_cgs <
@@ -285,10 +291,9 @@ INLINE static double bisection_iter(
       u_upper_cgs *= bracket_factor;
 
       /* Compute a new rate */
-      LambdaNet_cgs = Lambda_He_reion_cgs +
-                      eagle_cooling_rate(log10(u_upper_cgs), redshift, n_H_cgs,
-                                         abundance_ratio, n_H_index, d_n_H,
-                                         He_index, d_He, cooling);
+      LambdaNet_cgs =
+          Lambda_He_reion_cgs +
+          eagle_cooling_rate_slice(log10(u_upper_cgs), slice, cooling);
       i++;
     }
 
@@ -315,10 +320,9 @@ INLINE static double bisection_iter(
     u_next_cgs = 0.5 * (u_lower_cgs + u_upper_cgs);
 
     /* New rate */
-    LambdaNet_cgs = Lambda_He_reion_cgs +
-                    eagle_cooling_rate(log10(u_next_cgs), redshift, n_H_cgs,
-                                       abundance_ratio, n_H_index, d_n_H,
-                                       He_index, d_He, cooling);
+    LambdaNet_cgs =
+        Lambda_He_reion_cgs +
+        eagle_cooling_rate_slice(log10(u_next_cgs), slice, cooling);
 #ifdef SWIFT_DEBUG_CHECKS
     if (u_next_cgs <= 0)
       error(
@@ -475,11 +479,15 @@ void cooling_cool_part(const struct phys_const *phys_const,
      be overwritten. */
   double u_final_cgs = u_0_cgs;
 
+  /* Reduce the tables to the temperature axis for this particle */
+  struct eagle_cooling_slice slice;
+  eagle_cooling_slice_init(&slice, cosmo->z, n_H_cgs, abundance_ratio,
+                           n_H_index, d_n_H, He_index, d_He, cooling);
+
   /* First try an explicit integration (note we ignore the derivative) */
   const double LambdaNet_cgs =
       Lambda_He_reion_cgs +
-      eagle_cooling_rate(log10(u_0_cgs), cosmo->z, n_H_cgs, abundance_ratio,
-                         n_H_index, d_n_H, He_index, d_He, cooling);
+      eagle_cooling_rate_slice(log10(u_0_cgs), &slice, cooling);
 
   /* if cooling rate is small, take the explicit solution */
   if (fabs(ratefact_cgs * LambdaNet_cgs * dt_cgs) <
@@ -490,10 +498,8 @@ void cooling_cool_part(const struct phys_const *phys_const,
   } else {
 
     /* Otherwise, go the bisection route. */
-    u_final_cgs =
-        bisection_iter(u_0_cgs, n_H_cgs, cosmo->z, n_H_index, d_n_H, He_index,
-                       d_He, Lambda_He_reion_cgs, ratefact_cgs, cooling,
-                       abundance_ratio, dt_cgs, p->id);
+    u_final_cgs = bisection_iter(u_0_cgs, n_H_cgs, &slice, Lambda_He_reion_cgs,
+                                 ratefact_cgs, cooling, dt_cgs, p->id);
   }
 
   /* Convert back to internal units */
@@ -961,6 +967,14 @@ void cooling_init_backend(struct swift_params *parameter_file,
   cooling->S_over_Si_ratio_in_solar = parser_get_opt_param_float(
       parameter_file, "EAGLECooling:S_over_Si_in_solar", 1.f);
 
+  /* Read the tables once per node and share them between the ranks? */
+#ifdef WITH_MPI
+  cooling->tables_node_shared = parser_get_opt_param_int(
+      parameter_file, "EAGLECooling:node_shared_tables", 1);
+#else
+  cooling->tables_node_shared = 0;
+#endif
+
   /* Convert H_reion_heat_cgs and He_reion_heat_cgs to cgs
    * (units used internally by the cooling routines). This is done by
    * multiplying by 'eV/m_H' in internal units, then converting to cgs units.
@@ -1091,6 +1105,12 @@ void cooling_clean(struct cooling_function_data *cooling) {
   swift_free("cooling", cooling->SolarAbundances_inv);
 
   /* Free the tables */
+#ifdef WITH_MPI
+  if (cooling->tables_node_shared) {
+    mpi_node_window_free("cooling-tables", &cooling->tables_window);
+    return;
+  }
+#endif
   swift_free("cooling-tables", cooling->table.metal_heating);
   swift_free("cooling-tables", cooling->table.electron_abundance);
   swift_free("cooling-tables", cooling->table.temperature);
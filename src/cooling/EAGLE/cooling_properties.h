@@ -19,6 +19,9 @@
 #ifndef SWIFT_COOLING_PROPERTIES_EAGLE_H
 #define SWIFT_COOLING_PROPERTIES_EAGLE_H
 
+/* Local includes. */
+#include "mpi_node.h"
+
 #define eagle_table_path_name_length 500
 
 /**
@@ -127,6 +130,14 @@ struct cooling_function_data {
   /*! Index of the previous tables along the redshift index of the tables */
   int previous_z_index;
 
+  /*! Are the tables read once and shared by all the ranks of a node? */
+  int tables_node_shared;
+
+#ifdef WITH_MPI
+  /*! Node-shared memory holding the tables (if tables_node_shared) */
+  struct mpi_node_window tables_window;
+#endif
+
   /*! Dummy temporary value to compile the new temporary (?) BH model */
   float dlogT_EOS;
 };
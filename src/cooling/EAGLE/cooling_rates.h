@@ -539,4 +539,294 @@ INLINE static double eagle_cooling_rate(
                                   d_He, cooling, /* element_lambda=*/NULL);
 }
 
+/*! Number of nodes of the temperature axes kept by a #eagle_cooling_slice */
+#define eagle_cooling_slice_nodes 8
+
+/**
+ * @brief The cooling tables of one particle reduced to their temperature
+ * axis.
+ *
+ * The redshift, density, Helium fraction and abundances of a particle are
+ * constant while its implicit energy equation is solved. The tables are hence
+ * interpolated along these dimensions only once per node of the temperature
+ * (or internal energy) axis. The iterations of the solver then only
+ * interpolate linearly between two nodes. Since the tables are stored with
+ * the temperature as their fastest varying dimension, interpolating at a node
+ * is a weighted sum over the rows of the surrounding corners, whose offsets
+ * and weights are computed once by eagle_cooling_slice_init().
+ *
+ * The nodes are computed on demand and kept in a small direct-mapped cache as
+ * the solver converges within a few table cells.
+ */
+struct eagle_cooling_slice {
+
+  /*! Offsets and weights of the rows of the H+He tables */
+  int HHe_offset[8];
+  float HHe_weight[8];
+  int HHe_count;
+
+  /*! Offsets and weights of the rows of the solar and metal tables */
+  int solar_offset[4];
+  float solar_weight[4];
+  int solar_count;
+
+  /*! Distance between the metals in the metal table */
+  int metal_stride;
+
+  /*! Metals with a non-zero abundance and their ratio to solar */
+  int metal[eagle_cooling_N_metal];
+  float metal_ratio[eagle_cooling_N_metal];
+  int metal_count;
+
+  /*! Redshift and Hydrogen number density in CGS */
+  double redshift;
+  double n_H_cgs;
+
+  /*! Do we need to add the Compton cooling? */
+  int with_Compton;
+
+  /*! Cache of temperatures along the internal energy axis */
+  int u_node[eagle_cooling_slice_nodes];
+  float u_node_log_10_T[eagle_cooling_slice_nodes];
+
+  /*! Cache of rates and abundances along the temperature axis */
+  int T_node[eagle_cooling_slice_nodes];
+  float T_node_Lambda_free[eagle_cooling_slice_nodes];
+  float T_node_H_plus_He_electron_abundance[eagle_cooling_slice_nodes];
+  float T_node_solar_electron_abundance[eagle_cooling_slice_nodes];
+  double T_node_Lambda_metal[eagle_cooling_slice_nodes];
+};
+
+/**
+ * @brief Prepare the #eagle_cooling_slice of a particle.
+ *
+ * @param slice The #eagle_cooling_slice to initialise.
+ * @param redshift The current redshift.
+ * @param n_H_cgs The Hydrogen number density in CGS units.
+ * @param solar_ratio Array of ratios of particle metal abundances
+ * to solar metal abundances.
+ * @param n_H_index Particle hydrogen number density index.
+ * @param d_n_H Particle hydrogen number density offset.
+ * @param He_index Particle helium fraction index.
+ * @param d_He Particle helium fraction offset.
+ * @param cooling #cooling_function_data structure.
+ */
+INLINE static void eagle_cooling_slice_init(
+    struct eagle_cooling_slice *slice, const double redshift,
+    const double n_H_cgs, const float solar_ratio[eagle_cooling_N_abundances],
+    const int n_H_index, const float d_n_H, const int He_index,
+    const float d_He, const struct cooling_function_data *cooling) {
+
+  const int high_z =
+      redshift > cooling->Redshifts[eagle_cooling_N_redshifts - 1];
+
+  /* The high redshift tables have no redshift dimension */
+  const int N_z = high_z ? 1 : eagle_cooling_N_loaded_redshifts;
+  const float d_z = high_z ? 0.f : cooling->dz;
+
+  slice->HHe_count = 0;
+  slice->solar_count = 0;
+  for (int i = 0; i < N_z; ++i) {
+    const float w_z = i ? d_z : 1.f - d_z;
+    for (int j = 0; j < 2; ++j) {
+      const float w_n_H = j ? d_n_H : 1.f - d_n_H;
+
+      const int solar = slice->solar_count++;
+      slice->solar_offset[solar] =
+          row_major_index_3d(i, n_H_index + j, /*T_index=*/0, N_z,
+                             eagle_cooling_N_density,
+                             eagle_cooling_N_temperature);
+      slice->solar_weight[solar] = w_z * w_n_H;
+
+      for (int k = 0; k < 2; ++k) {
+        const float w_He = k ? d_He : 1.f - d_He;
+
+        const int HHe = slice->HHe_count++;
+        slice->HHe_offset[HHe] = row_major_index_4d(
+            i, n_H_index + j, He_index + k, /*T_index=*/0, N_z,
+            eagle_cooling_N_density, eagle_cooling_N_He_frac,
+            eagle_cooling_N_temperature);
+        slice->HHe_weight[HHe] = w_z * w_n_H * w_He;
+      }
+    }
+  }
+  slice->metal_stride =
+      N_z * eagle_cooling_N_density * eagle_cooling_N_temperature;
+
+  /* Only keep the metals that are present (ignore H and He) */
+  slice->metal_count = 0;
+  for (int elem = 2; elem < eagle_cooling_N_metal + 2; elem++) {
+    if (solar_ratio[elem] > 0.) {
+      slice->metal[slice->metal_count] = elem - 2;
+      slice->metal_ratio[slice->metal_count] = solar_ratio[elem];
+      slice->metal_count++;
+    }
+  }
+
+  slice->redshift = redshift;
+  slice->n_H_cgs = n_H_cgs;
+
+  /* Inverse Compton cooling is *not* stored in the tables before
+   * re-ionisation */
+  slice->with_Compton = high_z || (redshift > cooling->H_reion_z);
+
+  /* Empty the caches */
+  for (int i = 0; i < eagle_cooling_slice_nodes; ++i) {
+    slice->u_node[i] = -1;
+    slice->T_node[i] = -1;
+  }
+}
+
+/**
+ * @brief Returns the cache slot of a node of the internal energy axis of an
+ * #eagle_cooling_slice, computing it if needed.
+ *
+ * @param slice The #eagle_cooling_slice.
+ * @param u_index The index of the node along the internal energy axis.
+ * @param cooling #cooling_function_data structure.
+ */
+INLINE static int eagle_cooling_slice_u_node(
+    struct eagle_cooling_slice *slice, const int u_index,
+    const struct cooling_function_data *cooling) {
+
+  const int slot = u_index % eagle_cooling_slice_nodes;
+  if (slice->u_node[slot] == u_index) return slot;
+
+  float log_10_T = 0.f;
+  for (int c = 0; c < slice->HHe_count; ++c)
+    log_10_T += slice->HHe_weight[c] *
+                cooling->table.temperature[slice->HHe_offset[c] + u_index];
+
+  slice->u_node[slot] = u_index;
+  slice->u_node_log_10_T[slot] = log_10_T;
+  return slot;
+}
+
+/**
+ * @brief Returns the cache slot of a node of the temperature axis of an
+ * #eagle_cooling_slice, computing it if needed.
+ *
+ * @param slice The #eagle_cooling_slice.
+ * @param T_index The index of the node along the temperature axis.
+ * @param cooling #cooling_function_data structure.
+ */
+INLINE static int eagle_cooling_slice_T_node(
+    struct eagle_cooling_slice *slice, const int T_index,
+    const struct cooling_function_data *cooling) {
+
+  const int slot = T_index % eagle_cooling_slice_nodes;
+  if (slice->T_node[slot] == T_index) return slot;
+
+  /* Metal-free cooling and electron abundance */
+  float Lambda_free = 0.f;
+  float H_plus_He_electron_abundance = 0.f;
+  for (int c = 0; c < slice->HHe_count; ++c) {
+    const int index = slice->HHe_offset[c] + T_index;
+    Lambda_free +=
+        slice->HHe_weight[c] * cooling->table.H_plus_He_heating[index];
+    H_plus_He_electron_abundance +=
+        slice->HHe_weight[c] *
+        cooling->table.H_plus_He_electron_abundance[index];
+  }
+
+  /* Solar electron abundance and metal-line cooling */
+  float solar_electron_abundance = 0.f;
+  double Lambda_metal = 0.;
+  for (int c = 0; c < slice->solar_count; ++c) {
+    const int index = slice->solar_offset[c] + T_index;
+    solar_electron_abundance +=
+        slice->solar_weight[c] * cooling->table.electron_abundance[index];
+
+    float lambda = 0.f;
+    for (int m = 0; m < slice->metal_count; ++m)
+      lambda +=
+          slice->metal_ratio[m] *
+          cooling->table
+              .metal_heating[slice->metal[m] * slice->metal_stride + index];
+    Lambda_metal += slice->solar_weight[c] * lambda;
+  }
+
+  slice->T_node[slot] = T_index;
+  slice->T_node_Lambda_free[slot] = Lambda_free;
+  slice->T_node_H_plus_He_electron_abundance[slot] =
+      H_plus_He_electron_abundance;
+  slice->T_node_solar_electron_abundance[slot] = solar_electron_abundance;
+  slice->T_node_Lambda_metal[slot] = Lambda_metal;
+  return slot;
+}
+
+/**
+ * @brief Computes the cooling rate of a particle from its
+ * #eagle_cooling_slice.
+ *
+ * This is equivalent to eagle_cooling_rate() with the arguments used to
+ * construct the slice, up to round-off.
+ *
+ * @param log10_u_cgs Log base 10 of internal energy per unit mass in CGS units.
+ * @param slice The #eagle_cooling_slice of the particle.
+ * @param cooling #cooling_function_data structure.
+ *
+ * @return The cooling rate
+ */
+INLINE static double eagle_cooling_rate_slice(
+    const double log10_u_cgs, struct eagle_cooling_slice *slice,
+    const struct cooling_function_data *cooling) {
+
+  /* Temperature */
+  int u_index;
+  float d_u;
+  get_index_1d(cooling->Therm, eagle_cooling_N_temperature, log10_u_cgs,
+               &u_index, &d_u);
+
+  const int u_0 = eagle_cooling_slice_u_node(slice, u_index, cooling);
+  const int u_1 = eagle_cooling_slice_u_node(slice, u_index + 1, cooling);
+  double log_10_T = (1.f - d_u) * slice->u_node_log_10_T[u_0] +
+                    d_u * slice->u_node_log_10_T[u_1];
+
+  /* Special case for temperatures below the start of the table */
+  if (u_index == 0 && d_u == 0.f) log_10_T += log10_u_cgs - cooling->Temp[0];
+
+  /* Get index along temperature dimension of the tables */
+  int T_index;
+  float d_T;
+  get_index_1d(cooling->Temp, eagle_cooling_N_temperature, log_10_T, &T_index,
+               &d_T);
+
+  const int T_0 = eagle_cooling_slice_T_node(slice, T_index, cooling);
+  const int T_1 = eagle_cooling_slice_T_node(slice, T_index + 1, cooling);
+  const float t_T = 1.f - d_T;
+
+  /* Metal-free cooling */
+  const double Lambda_free = t_T * slice->T_node_Lambda_free[T_0] +
+                             d_T * slice->T_node_Lambda_free[T_1];
+
+  /* Electron abundance */
+  const double H_plus_He_electron_abundance =
+      t_T * slice->T_node_H_plus_He_electron_abundance[T_0] +
+      d_T * slice->T_node_H_plus_He_electron_abundance[T_1];
+
+  /* Compton cooling (note the minus sign) */
+  double Lambda_Compton = 0.;
+  if (slice->with_Compton) {
+    const double T = exp10(log_10_T);
+    Lambda_Compton -=
+        eagle_Compton_cooling_rate(cooling, slice->redshift, slice->n_H_cgs,
+                                   T, H_plus_He_electron_abundance);
+  }
+
+  /* Solar electron abundance */
+  const double solar_electron_abundance =
+      t_T * slice->T_node_solar_electron_abundance[T_0] +
+      d_T * slice->T_node_solar_electron_abundance[T_1];
+
+  /* Metal-line cooling, scaled by the ratio of H, He electron abundance to
+   * solar electron abundance */
+  const double Lambda_metal = t_T * slice->T_node_Lambda_metal[T_0] +
+                              d_T * slice->T_node_Lambda_metal[T_1];
+
+  return Lambda_free + Lambda_Compton +
+         Lambda_metal * H_plus_He_electron_abundance /
+             solar_electron_abundance;
+}
+
 #endif /* SWIFT_EAGLE_COOLING_RATES_H */
@@ -314,6 +314,38 @@ void read_cooling_header(const char *fname,
  */
 void allocate_cooling_tables(struct cooling_function_data *restrict cooling) {
 
+#ifdef WITH_MPI
+  if (cooling->tables_node_shared) {
+
+    /* Place all the tables in a single block shared by the node. Each table
+     * starts on an aligned boundary. */
+    const size_t sizes[5] = {
+        num_elements_metal_heating, num_elements_electron_abundance,
+        num_elements_temperature, num_elements_HpHe_heating,
+        num_elements_HpHe_electron_abundance};
+    float **tables[5] = {&cooling->table.metal_heating,
+                         &cooling->table.electron_abundance,
+                         &cooling->table.temperature,
+                         &cooling->table.H_plus_He_heating,
+                         &cooling->table.H_plus_He_electron_abundance};
+    size_t offsets[5];
+    size_t total = 0;
+    for (int k = 0; k < 5; k++) {
+      offsets[k] = total;
+      const size_t bytes =
+          eagle_cooling_N_loaded_redshifts * sizes[k] * sizeof(float);
+      total += (bytes + SWIFT_STRUCT_ALIGNMENT - 1) / SWIFT_STRUCT_ALIGNMENT *
+               SWIFT_STRUCT_ALIGNMENT;
+    }
+
+    mpi_node_init();
+    char *base = (char *)mpi_node_shared_allocate(
+        "cooling-tables", &cooling->tables_window, total);
+    for (int k = 0; k < 5; k++) *tables[k] = (float *)(base + offsets[k]);
+    return;
+  }
+#endif
+
   /* Allocate arrays to store cooling tables. Arrays contain two tables of
    * cooling rates with one table being for the redshift above current redshift
    * and one below. */
@@ -45,6 +45,7 @@
 #include "hydro.h"
 #include "interpolate.h"
 #include "io_properties.h"
+#include "mpi_node.h"
 #include "parser.h"
 #include "part.h"
 #include "physical_constants.h"
@@ -525,6 +526,7 @@ double cooling_get_ycompton(const struct phys_const *phys_const,
  * @param ratefact_cgs Multiplication factor to get a cooling rate.
  * @param cooling #cooling_function_data structure.
  * @param abundance_ratio Array of ratios of metal abundance to solar.
+ * @param slice The #colibre_cooling_slice of the particle.
  * @param dt_cgs timestep in CGS.
  * @param ID ID of the particle (for debugging).
  */
@@ -533,8 +535,8 @@ static INLINE double bisection_iter(
     int n_H_index, float d_n_H, int met_index, float d_met, int red_index,
     float d_red, double Lambda_He_reion_cgs, double ratefact_cgs,
     const struct cooling_function_data *cooling,
-    const float abundance_ratio[colibre_cooling_N_elementtypes], double dt_cgs,
-    long long ID) {
+    const float abundance_ratio[colibre_cooling_N_elementtypes],
+    struct colibre_cooling_slice *slice, double dt_cgs, long long ID) {
 
   /* Bracketing */
   double u_lower_cgs = max(u_ini_cgs, cooling->umin_cgs);
@@ -546,9 +548,7 @@ static INLINE double bisection_iter(
 
   double LambdaNet_cgs =
       Lambda_He_reion_cgs +
-      colibre_cooling_rate(log10(u_ini_cgs), redshift, n_H_cgs, abundance_ratio,
-                           n_H_index, d_n_H, met_index, d_met, red_index, d_red,
-                           cooling, 0, 0, 0, 0);
+      colibre_cooling_rate_slice(log10(u_ini_cgs), slice, cooling);
 
   /*************************************/
   /* Let's try to bracket the solution */
@@ -563,9 +563,7 @@ static INLINE double bisection_iter(
     /* Compute a new rate */
     LambdaNet_cgs =
         Lambda_He_reion_cgs +
-        colibre_cooling_rate(log10(u_lower_cgs), redshift, n_H_cgs,
-                             abundance_ratio, n_H_index, d_n_H, met_index,
-                             d_met, red_index, d_red, cooling, 0, 0, 0, 0);
+        colibre_cooling_rate_slice(log10(u_lower_cgs), slice, cooling);
 
     int i = 0;
     while (u_lower_cgs - u_ini_cgs - LambdaNet_cgs * ratefact_cgs * dt_cgs >
@@ -578,9 +576,7 @@ static INLINE double bisection_iter(
       /* Compute a new rate */
       LambdaNet_cgs =
           Lambda_He_reion_cgs +
-          colibre_cooling_rate(log10(u_lower_cgs), redshift, n_H_cgs,
-                               abundance_ratio, n_H_index, d_n_H, met_index,
-                               d_met, red_index, d_red, cooling, 0, 0, 0, 0);
+          colibre_cooling_rate_slice(log10(u_lower_cgs), slice, cooling);
 
       /* If the energy is below or equal the minimum energy and we are still
        * cooling, return the minimum energy */
@@ -613,9 +609,7 @@ static INLINE double bisection_iter(
     /* Compute a new rate */
     LambdaNet_cgs =
         Lambda_He_reion_cgs +
-        colibre_cooling_rate(log10(u_upper_cgs), redshift, n_H_cgs,
-                             abundance_ratio, n_H_index, d_n_H, met_index,
-                             d_met, red_index, d_red, cooling, 0, 0, 0, 0);
+        colibre_cooling_rate_slice(log10(u_upper_cgs), slice, cooling);
 
     int i = 0;
     while (u_upper_cgs - u_ini_cgs - LambdaNet_cgs * ratefact_cgs * dt_cgs <
@@ -628,9 +622,7 @@ static INLINE double bisection_iter(
       /* Compute a new rate */
       LambdaNet_cgs =
           Lambda_He_reion_cgs +
-          colibre_cooling_rate(log10(u_upper_cgs), redshift, n_H_cgs,
-                               abundance_ratio, n_H_index, d_n_H, met_index,
-                               d_met, red_index, d_red, cooling, 0, 0, 0, 0);
+          colibre_cooling_rate_slice(log10(u_upper_cgs), slice, cooling);
       i++;
     }
 
@@ -674,9 +666,7 @@ static INLINE double bisection_iter(
     /* New rate */
     LambdaNet_cgs =
         Lambda_He_reion_cgs +
-        colibre_cooling_rate(log10(u_next_cgs), redshift, n_H_cgs,
-                             abundance_ratio, n_H_index, d_n_H, met_index,
-                             d_met, red_index, d_red, cooling, 0, 0, 0, 0);
+        colibre_cooling_rate_slice(log10(u_next_cgs), slice, cooling);
 
     /* Where do we go next? */
     if (u_next_cgs - u_ini_cgs - LambdaNet_cgs * ratefact_cgs * dt_cgs > 0.0) {
@@ -826,12 +816,16 @@ void cooling_cool_part(const struct phys_const *phys_const,
   /* Let's compute the internal energy at the end of the step */
   double u_final_cgs;
 
+  /* Reduce the tables to the internal energy axis for this particle */
+  struct colibre_cooling_slice slice;
+  colibre_cooling_slice_init(&slice, cosmo->z, n_H_cgs, abundance_ratio,
+                             n_H_index, d_n_H, met_index, d_met, red_index,
+                             d_red);
+
   /* First try an explicit integration (note we ignore the derivative) */
   const double LambdaNet_cgs =
       Lambda_He_reion_cgs +
-      colibre_cooling_rate(log10(u_0_cgs), cosmo->z, n_H_cgs, abundance_ratio,
-                           n_H_index, d_n_H, met_index, d_met, red_index, d_red,
-                           cooling, 0, 0, 0, 0);
+      colibre_cooling_rate_slice(log10(u_0_cgs), &slice, cooling);
 
   /* if cooling rate is small, take the explicit solution */
   if (fabs(ratefact_cgs * LambdaNet_cgs * dt_cgs) <
@@ -841,10 +835,10 @@ void cooling_cool_part(const struct phys_const *phys_const,
 
   } else {
 
-    u_final_cgs =
-        bisection_iter(u_0_cgs, n_H_cgs, cosmo->z, n_H_index, d_n_H, met_index,
-                       d_met, red_index, d_red, Lambda_He_reion_cgs,
-                       ratefact_cgs, cooling, abundance_ratio, dt_cgs, p->id);
+    u_final_cgs = bisection_iter(
+        u_0_cgs, n_H_cgs, cosmo->z, n_H_index, d_n_H, met_index, d_met,
+        red_index, d_red, Lambda_He_reion_cgs, ratefact_cgs, cooling,
+        abundance_ratio, &slice, dt_cgs, p->id);
   }
 
   /* Convert back to internal units */
@@ -1468,6 +1462,14 @@ void cooling_init_backend(struct swift_params *parameter_file,
   cooling->S_over_Si_ratio_in_solar = parser_get_opt_param_float(
       parameter_file, "PS2020Cooling:S_over_Si_in_solar", 1.f);
 
+  /* Read the tables once per node and share them between the ranks? */
+#ifdef WITH_MPI
+  cooling->tables_node_shared = parser_get_opt_param_int(
+      parameter_file, "PS2020Cooling:node_shared_tables", 1);
+#else
+  cooling->tables_node_shared = 0;
+#endif
+
   /* Convert H_reion_heat_cgs and He_reion_heat_cgs to cgs
    * (units used internally by the cooling routines). This is done by
    * multiplying by 'eV/m_H' in internal units, then converting to cgs units.
@@ -1624,6 +1626,12 @@ void cooling_clean(struct cooling_function_data *cooling) {
   free(cooling->MassFractions);
 
   /* Free the tables */
+#ifdef WITH_MPI
+  if (cooling->tables_node_shared) {
+    mpi_node_window_free("cooling_tables", &cooling->tables_window);
+    return;
+  }
+#endif
   swift_free("cooling_table.Tcooling", cooling->table.Tcooling);
   swift_free("cooling_table.Ucooling", cooling->table.Ucooling);
   swift_free("cooling_table.Theating", cooling->table.Theating);
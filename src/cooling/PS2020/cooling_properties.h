@@ -19,6 +19,9 @@
 #ifndef SWIFT_COOLING_PROPERTIES_PS2020_H
 #define SWIFT_COOLING_PROPERTIES_PS2020_H
 
+/* Local includes. */
+#include "mpi_node.h"
+
 #define colibre_table_path_name_length 500
 
 /**
@@ -197,6 +200,14 @@ struct cooling_function_data {
 
   /*! Threshold to switch between rapid and slow cooling regimes. */
   double rapid_cooling_threshold;
+
+  /*! Are the tables read once and shared by all the ranks of a node? */
+  int tables_node_shared;
+
+#ifdef WITH_MPI
+  /*! Node-shared memory holding the tables (if tables_node_shared) */
+  struct mpi_node_window tables_window;
+#endif
 };
 
 /**
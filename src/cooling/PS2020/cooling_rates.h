@@ -789,4 +789,277 @@ INLINE static double colibre_cooling_rate_temperature(
   return heating_rate - cooling_rate - Compton_cooling_rate;
 }
 
+/*! Number of nodes of the internal energy axis kept by a
+ * #colibre_cooling_slice */
+#define colibre_cooling_slice_nodes 8
+
+/*! Number of channels interpolated in the electron fraction table */
+#define colibre_cooling_slice_N_electron (colibre_cooling_N_electrontypes - 3)
+
+/*! Number of channels interpolated in the cooling table */
+#define colibre_cooling_slice_N_cool (colibre_cooling_N_cooltypes - 2)
+
+/*! Number of channels interpolated in the heating table */
+#define colibre_cooling_slice_N_heat (colibre_cooling_N_heattypes - 2)
+
+/**
+ * @brief The cooling tables of one particle reduced to their internal energy
+ * axis.
+ *
+ * The redshift, density and metallicity of a particle are constant while its
+ * implicit energy equation is solved. The tables are hence interpolated
+ * along these dimensions only once per node of the internal energy axis, for
+ * each of the channels with a non-zero weight. The iterations of the solver
+ * then only interpolate linearly between two nodes before summing the
+ * channels.
+ *
+ * The nodes are computed on demand and kept in a small direct-mapped cache as
+ * the solver converges within a few table cells.
+ */
+struct colibre_cooling_slice {
+
+  /*! Offsets and weights of the corners of the tables */
+  int offset[8];
+  float weight[8];
+
+  /*! Channels with a non-zero weight and their weight */
+  int electron_channel[colibre_cooling_slice_N_electron];
+  float electron_weight[colibre_cooling_slice_N_electron];
+  int electron_count;
+  int cool_channel[colibre_cooling_slice_N_cool];
+  float cool_weight[colibre_cooling_slice_N_cool];
+  int cool_count;
+  int heat_channel[colibre_cooling_slice_N_heat];
+  float heat_weight[colibre_cooling_slice_N_heat];
+  int heat_count;
+
+  /*! Redshift and Hydrogen number density in CGS */
+  double redshift;
+  double n_H_cgs;
+
+  /*! Cache of the interpolated (log) tables along the internal energy axis */
+  int node[colibre_cooling_slice_nodes];
+  float node_log_T[colibre_cooling_slice_nodes];
+  float node_electron[colibre_cooling_slice_nodes]
+                     [colibre_cooling_slice_N_electron];
+  float node_cool[colibre_cooling_slice_nodes][colibre_cooling_slice_N_cool];
+  float node_heat[colibre_cooling_slice_nodes][colibre_cooling_slice_N_heat];
+};
+
+/**
+ * @brief Prepare the #colibre_cooling_slice of a particle.
+ *
+ * The weights of the channels are the ones used by colibre_cooling_rate()
+ * when all the channels are active.
+ *
+ * @param slice The #colibre_cooling_slice to initialise.
+ * @param redshift Current redshift
+ * @param n_H_cgs Hydrogen number density in cgs
+ * @param abundance_ratio Abundance ratio for each element x relative to solar
+ * @param n_H_index Index along the Hydrogen number density dimension
+ * @param d_n_H Offset between Hydrogen density and table[n_H_index]
+ * @param met_index Index along the metallicity dimension
+ * @param d_met Offset between metallicity and table[met_index]
+ * @param red_index Index along redshift dimension
+ * @param d_red Offset between redshift and table[red_index]
+ */
+INLINE static void colibre_cooling_slice_init(
+    struct colibre_cooling_slice *slice, const double redshift,
+    const double n_H_cgs,
+    const float abundance_ratio[colibre_cooling_N_elementtypes],
+    const int n_H_index, const float d_n_H, const int met_index,
+    const float d_met, const int red_index, const float d_red) {
+
+  /* Corners along the redshift, metallicity and density dimensions. The
+   * offsets are the ones of the channel 0 of the first internal energy node
+   * in the tables with a channel dimension. */
+  int c = 0;
+  for (int i = 0; i < 2; ++i) {
+    const float w_red = i ? d_red : 1.f - d_red;
+    for (int j = 0; j < 2; ++j) {
+      const float w_met = j ? d_met : 1.f - d_met;
+      for (int k = 0; k < 2; ++k) {
+        const float w_n_H = k ? d_n_H : 1.f - d_n_H;
+
+        slice->offset[c] = row_major_index_4d(
+            red_index + i, /*U_index=*/0, met_index + j, n_H_index + k,
+            colibre_cooling_N_redshifts, colibre_cooling_N_internalenergy,
+            colibre_cooling_N_metallicity, colibre_cooling_N_density);
+        slice->weight[c] = w_red * w_met * w_n_H;
+        c++;
+      }
+    }
+  }
+
+  /* Electron fractions use the abundance ratios */
+  slice->electron_count = 0;
+  for (int i = element_H; i < colibre_cooling_slice_N_electron; i++) {
+    if (abundance_ratio[i] != 0.f) {
+      slice->electron_channel[slice->electron_count] = i;
+      slice->electron_weight[slice->electron_count] = abundance_ratio[i];
+      slice->electron_count++;
+    }
+  }
+
+  /* Cooling rates use the abundance ratios for the elements. Compton
+   * cooling is added analytically, the other channels use the same
+   * abundances as the tables */
+  slice->cool_count = 0;
+  for (int i = element_H; i < colibre_cooling_slice_N_cool; i++) {
+    float w;
+    if (i < colibre_cooling_N_elementtypes)
+      w = abundance_ratio[i];
+    else if (i == cooltype_Compton)
+      w = 0.f;
+    else
+      w = 1.f;
+
+    if (w != 0.f) {
+      slice->cool_channel[slice->cool_count] = i;
+      slice->cool_weight[slice->cool_count] = w;
+      slice->cool_count++;
+    }
+  }
+
+  /* Heating rates use the abundance ratios for the elements */
+  slice->heat_count = 0;
+  for (int i = element_H; i < colibre_cooling_slice_N_heat; i++) {
+    const float w =
+        i < colibre_cooling_N_elementtypes ? abundance_ratio[i] : 1.f;
+
+    if (w != 0.f) {
+      slice->heat_channel[slice->heat_count] = i;
+      slice->heat_weight[slice->heat_count] = w;
+      slice->heat_count++;
+    }
+  }
+
+  slice->redshift = redshift;
+  slice->n_H_cgs = n_H_cgs;
+
+  /* Empty the cache */
+  for (int i = 0; i < colibre_cooling_slice_nodes; ++i) slice->node[i] = -1;
+}
+
+/**
+ * @brief Returns the cache slot of a node of the internal energy axis of a
+ * #colibre_cooling_slice, computing it if needed.
+ *
+ * @param slice The #colibre_cooling_slice.
+ * @param U_index The index of the node along the internal energy axis.
+ * @param cooling #cooling_function_data structure.
+ */
+INLINE static int colibre_cooling_slice_node(
+    struct colibre_cooling_slice *slice, const int U_index,
+    const struct cooling_function_data *cooling) {
+
+  const int slot = U_index % colibre_cooling_slice_nodes;
+  if (slice->node[slot] == U_index) return slot;
+
+  /* Distance between two nodes along the internal energy axis */
+  const int U_stride =
+      colibre_cooling_N_metallicity * colibre_cooling_N_density;
+
+  float log_T = 0.f;
+  float *restrict electron = slice->node_electron[slot];
+  float *restrict cool = slice->node_cool[slot];
+  float *restrict heat = slice->node_heat[slot];
+  for (int i = 0; i < slice->electron_count; ++i) electron[i] = 0.f;
+  for (int i = 0; i < slice->cool_count; ++i) cool[i] = 0.f;
+  for (int i = 0; i < slice->heat_count; ++i) heat[i] = 0.f;
+
+  for (int c = 0; c < 8; ++c) {
+    const float w = slice->weight[c];
+    const int index = slice->offset[c] + U_index * U_stride;
+
+    log_T += w * cooling->table.T_from_U[index];
+
+    const float *row = cooling->table.Uelectron_fraction +
+                       index * colibre_cooling_N_electrontypes;
+    for (int i = 0; i < slice->electron_count; ++i)
+      electron[i] += w * row[slice->electron_channel[i]];
+
+    row = cooling->table.Ucooling + index * colibre_cooling_N_cooltypes;
+    for (int i = 0; i < slice->cool_count; ++i)
+      cool[i] += w * row[slice->cool_channel[i]];
+
+    row = cooling->table.Uheating + index * colibre_cooling_N_heattypes;
+    for (int i = 0; i < slice->heat_count; ++i)
+      heat[i] += w * row[slice->heat_channel[i]];
+  }
+
+  slice->node[slot] = U_index;
+  slice->node_log_T[slot] = log_T;
+  return slot;
+}
+
+/**
+ * @brief Computes the net cooling rate of a particle from its
+ * #colibre_cooling_slice.
+ *
+ * This is equivalent to colibre_cooling_rate() with all the channels active
+ * and the arguments used to construct the slice, up to round-off.
+ *
+ * @param log_u_cgs Log base 10 of internal energy in cgs [erg g-1]
+ * @param slice The #colibre_cooling_slice of the particle.
+ * @param cooling #cooling_function_data structure
+ */
+INLINE static double colibre_cooling_rate_slice(
+    const double log_u_cgs, struct colibre_cooling_slice *slice,
+    const struct cooling_function_data *cooling) {
+
+  /* Get index of u along the internal energy axis */
+  int U_index;
+  float d_U;
+  get_index_1d(cooling->Therm, colibre_cooling_N_internalenergy, log_u_cgs,
+               &U_index, &d_U);
+
+  const int n0 = colibre_cooling_slice_node(slice, U_index, cooling);
+  const int n1 = colibre_cooling_slice_node(slice, U_index + 1, cooling);
+  const float t_U = 1.f - d_U;
+
+  /* n_e / n_H */
+  double electron_fraction = 0.;
+  for (int i = 0; i < slice->electron_count; ++i)
+    electron_fraction +=
+        slice->electron_weight[i] *
+        exp10f(t_U * slice->node_electron[n0][i] +
+               d_U * slice->node_electron[n1][i]);
+
+  /* Lambda / n_H**2 */
+  double cooling_rate = 0.;
+  for (int i = 0; i < slice->cool_count; ++i)
+    cooling_rate +=
+        slice->cool_weight[i] *
+        exp10f(t_U * slice->node_cool[n0][i] + d_U * slice->node_cool[n1][i]);
+
+  /* Gamma / n_H**2 */
+  double heating_rate = 0.;
+  for (int i = 0; i < slice->heat_count; ++i)
+    heating_rate +=
+        slice->heat_weight[i] *
+        exp10f(t_U * slice->node_heat[n0][i] + d_U * slice->node_heat[n1][i]);
+
+  /* Temperature from internal energy */
+  const double logtemp =
+      t_U * slice->node_log_T[n0] + d_U * slice->node_log_T[n1];
+  const double temp = exp10(logtemp);
+
+  /* Compton cooling/heating */
+  const double zp1 = 1. + slice->redshift;
+  const double zp1p2 = zp1 * zp1;
+  const double zp1p4 = zp1p2 * zp1p2;
+
+  /* CMB temperature at this redshift */
+  const double T_CMB = cooling->T_CMB_0 * zp1;
+
+  /* Analytic Compton cooling rate: Lambda_Compton / n_H**2 */
+  const double Compton_cooling_rate = cooling->compton_rate_cgs *
+                                      (temp - T_CMB) * zp1p4 *
+                                      electron_fraction / slice->n_H_cgs;
+
+  /* Return the net heating rate (Lambda_heat - Lambda_cool) */
+  return heating_rate - cooling_rate - Compton_cooling_rate;
+}
+
 #endif /* SWIFT_PS2020_COOLING_RATES_H */
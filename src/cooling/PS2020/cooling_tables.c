@@ -40,6 +40,7 @@
 #include "error.h"
 #include "exp10.h"
 #include "interpolate.h"
+#include "mpi_node.h"
 
 /**
  * @brief Reads in PS2020 cooling table header. Consists of tables
@@ -232,9 +233,96 @@ void read_cooling_header(struct cooling_function_data *cooling) {
 #endif
 }
 
+/**
+ * @brief Allocate space for cooling tables.
+ *
+ * When the tables are shared by the ranks of a node, they are all placed in
+ * a single block of node-shared memory.
+ *
+ * @param cooling #cooling_function_data structure
+ */
+static void allocate_cooling_tables(
+    struct cooling_function_data *restrict cooling) {
+
+  /* Size of the 4D tables (without and with the temperature or internal
+   * energy dimension) */
+  const size_t N_3d = colibre_cooling_N_redshifts *
+                      colibre_cooling_N_metallicity * colibre_cooling_N_density;
+  const size_t N_T = N_3d * colibre_cooling_N_temperature;
+  const size_t N_U = N_3d * colibre_cooling_N_internalenergy;
+
+  const char *labels[15] = {
+      "cooling_table.Tmu",      "cooling_table.Umu",
+      "cooling_table.Tcooling", "cooling_table.Ucooling",
+      "cooling_table.Theating", "cooling_table.Uheating",
+      "cooling_table.Tefrac",   "cooling_table.Uefrac",
+      "cooling_table.UfromT",   "cooling_table.TfromU",
+      "cooling_table.Teq",      "cooling_table.mueq",
+      "cooling_table.Hfracs",   "cooling_table.Hfracs",
+      "cooling_table.Peq"};
+  float **tables[15] = {&cooling->table.Tmu,
+                        &cooling->table.Umu,
+                        &cooling->table.Tcooling,
+                        &cooling->table.Ucooling,
+                        &cooling->table.Theating,
+                        &cooling->table.Uheating,
+                        &cooling->table.Telectron_fraction,
+                        &cooling->table.Uelectron_fraction,
+                        &cooling->table.U_from_T,
+                        &cooling->table.T_from_U,
+                        &cooling->table.logTeq,
+                        &cooling->table.meanpartmass_Teq,
+                        &cooling->table.logHfracs_Teq,
+                        &cooling->table.logHfracs_all,
+                        &cooling->table.logPeq};
+  const size_t counts[15] = {N_T,
+                             N_U,
+                             N_T * colibre_cooling_N_cooltypes,
+                             N_U * colibre_cooling_N_cooltypes,
+                             N_T * colibre_cooling_N_heattypes,
+                             N_U * colibre_cooling_N_heattypes,
+                             N_T * colibre_cooling_N_electrontypes,
+                             N_U * colibre_cooling_N_electrontypes,
+                             N_T,
+                             N_U,
+                             N_3d,
+                             N_3d,
+                             N_3d * 3,
+                             N_T * 3,
+                             N_3d};
+
+#ifdef WITH_MPI
+  if (cooling->tables_node_shared) {
+
+    /* Each table starts on an aligned boundary of the shared block */
+    size_t offsets[15];
+    size_t total = 0;
+    for (int k = 0; k < 15; k++) {
+      offsets[k] = total;
+      total += (counts[k] * sizeof(float) + SWIFT_STRUCT_ALIGNMENT - 1) /
+               SWIFT_STRUCT_ALIGNMENT * SWIFT_STRUCT_ALIGNMENT;
+    }
+
+    mpi_node_init();
+    char *base = (char *)mpi_node_shared_allocate(
+        "cooling_tables", &cooling->tables_window, total);
+    for (int k = 0; k < 15; k++) *tables[k] = (float *)(base + offsets[k]);
+    return;
+  }
+#endif
+
+  for (int k = 0; k < 15; k++)
+    if (swift_memalign(labels[k], (void **)tables[k], SWIFT_STRUCT_ALIGNMENT,
+                       counts[k] * sizeof(float)) != 0)
+      error("Failed to allocate %s array\n", labels[k]);
+}
+
 /**
  * @brief Allocate space for cooling tables and read them
  *
+ * When the tables are shared by the ranks of a node, only the first rank of
+ * the node reads them.
+ *
  * @param cooling #cooling_function_data structure
  */
 void read_cooling_tables(struct cooling_function_data *restrict cooling) {
@@ -242,6 +330,18 @@ void read_cooling_tables(struct cooling_function_data *restrict cooling) {
   /* Abort early if we were not using the cooling module */
   if (strcmp(cooling->cooling_table_path, "") == 0) return;
 
+  allocate_cooling_tables(cooling);
+
+#ifdef WITH_MPI
+  if (cooling->tables_node_shared &&
+      !mpi_node_shared_begin_write(&cooling->tables_window)) {
+
+    /* Wait for a node-mate to read them for us */
+    mpi_node_shared_end_write(&cooling->tables_window);
+    return;
+  }
+#endif
+
 #ifdef HAVE_HDF5
   hid_t dataset;
   herr_t status;
@@ -252,17 +352,9 @@ void read_cooling_tables(struct cooling_function_data *restrict cooling) {
   if (tempfile_id < 0)
     error("unable to open file %s\n", cooling->cooling_table_path);
 
-  /* Allocate and read arrays to store cooling tables. */
+  /* Read arrays to store cooling tables. */
 
   /* Mean particle mass (temperature) */
-  if (swift_memalign("cooling_table.Tmu", (void **)&cooling->table.Tmu,
-                     SWIFT_STRUCT_ALIGNMENT,
-                     colibre_cooling_N_redshifts *
-                         colibre_cooling_N_temperature *
-                         colibre_cooling_N_metallicity *
-                         colibre_cooling_N_density * sizeof(float)) != 0)
-    error("Failed to allocate Tmu array\n");
-
   dataset = H5Dopen(tempfile_id, "/Tdep/MeanParticleMass", H5P_DEFAULT);
   status = H5Dread(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
                    cooling->table.Tmu);
@@ -271,14 +363,6 @@ void read_cooling_tables(struct cooling_function_data *restrict cooling) {
   if (status < 0) error("error closing mean particle mass dataset");
 
   /* Mean particle mass (internal energy) */
-  if (swift_memalign("cooling_table.Umu", (void **)&cooling->table.Umu,
-                     SWIFT_STRUCT_ALIGNMENT,
-                     colibre_cooling_N_redshifts *
-                         colibre_cooling_N_internalenergy *
-                         colibre_cooling_N_metallicity *
-                         colibre_cooling_N_density * sizeof(float)) != 0)
-    error("Failed to allocate Umu array\n");
-
   dataset = H5Dopen(tempfile_id, "/Udep/MeanParticleMass", H5P_DEFAULT);
   status = H5Dread(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
                    cooling->table.Umu);
@@ -287,14 +371,6 @@ void read_cooling_tables(struct cooling_function_data *restrict cooling) {
   if (status < 0) error("error closing mean particle mass dataset");
 
   /* Cooling (temperature) */
-  if (swift_memalign(
-          "cooling_table.Tcooling", (void **)&cooling->table.Tcooling,
-          SWIFT_STRUCT_ALIGNMENT,
-          colibre_cooling_N_redshifts * colibre_cooling_N_temperature *
-              colibre_cooling_N_metallicity * colibre_cooling_N_density *
-              colibre_cooling_N_cooltypes * sizeof(float)) != 0)
-    error("Failed to allocate Tcooling array\n");
-
   dataset = H5Dopen(tempfile_id, "/Tdep/Cooling", H5P_DEFAULT);
   status = H5Dread(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
                    cooling->table.Tcooling);
@@ -303,14 +379,6 @@ void read_cooling_tables(struct cooling_function_data *restrict cooling) {
   if (status < 0) error("error closing cooling dataset");
 
   /* Cooling (internal energy) */
-  if (swift_memalign(
-          "cooling_table.Ucooling", (void **)&cooling->table.Ucooling,
-          SWIFT_STRUCT_ALIGNMENT,
-          colibre_cooling_N_redshifts * colibre_cooling_N_internalenergy *
-              colibre_cooling_N_metallicity * colibre_cooling_N_density *
-              colibre_cooling_N_cooltypes * sizeof(float)) != 0)
-    error("Failed to allocate Ucooling array\n");
-
   dataset = H5Dopen(tempfile_id, "/Udep/Cooling", H5P_DEFAULT);
   status = H5Dread(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
                    cooling->table.Ucooling);
@@ -319,14 +387,6 @@ void read_cooling_tables(struct cooling_function_data *restrict cooling) {
   if (status < 0) error("error closing cooling dataset");
 
   /* Heating (temperature) */
-  if (swift_memalign(
-          "cooling_table.Theating", (void **)&cooling->table.Theating,
-          SWIFT_STRUCT_ALIGNMENT,
-          colibre_cooling_N_redshifts * colibre_cooling_N_temperature *
-              colibre_cooling_N_metallicity * colibre_cooling_N_density *
-              colibre_cooling_N_heattypes * sizeof(float)) != 0)
-    error("Failed to allocate Theating array\n");
-
   dataset = H5Dopen(tempfile_id, "/Tdep/Heating", H5P_DEFAULT);
   status = H5Dread(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
                    cooling->table.Theating);
@@ -335,14 +395,6 @@ void read_cooling_tables(struct cooling_function_data *restrict cooling) {
   if (status < 0) error("error closing cooling dataset");
 
   /* Heating (internal energy) */
-  if (swift_memalign(
-          "cooling_table.Uheating", (void **)&cooling->table.Uheating,
-          SWIFT_STRUCT_ALIGNMENT,
-          colibre_cooling_N_redshifts * colibre_cooling_N_internalenergy *
-              colibre_cooling_N_metallicity * colibre_cooling_N_density *
-              colibre_cooling_N_heattypes * sizeof(float)) != 0)
-    error("Failed to allocate Uheating array\n");
-
   dataset = H5Dopen(tempfile_id, "/Udep/Heating", H5P_DEFAULT);
   status = H5Dread(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
                    cooling->table.Uheating);
@@ -351,14 +403,6 @@ void read_cooling_tables(struct cooling_function_data *restrict cooling) {
   if (status < 0) error("error closing cooling dataset");
 
   /* Electron fraction (temperature) */
-  if (swift_memalign(
-          "cooling_table.Tefrac", (void **)&cooling->table.Telectron_fraction,
-          SWIFT_STRUCT_ALIGNMENT,
-          colibre_cooling_N_redshifts * colibre_cooling_N_temperature *
-              colibre_cooling_N_metallicity * colibre_cooling_N_density *
-              colibre_cooling_N_electrontypes * sizeof(float)) != 0)
-    error("Failed to allocate Telectron_fraction array\n");
-
   /* Dataset is named /Tdep/ElectronFractions in the published version of the
    * tables and for historical reasons /Tdep/ElectronFractionsVol in the version
    * used in the PS2020 repository. Content is identical but we deal
@@ -379,14 +423,6 @@ void read_cooling_tables(struct cooling_function_data *restrict cooling) {
   if (status < 0) error("error closing cooling dataset");
 
   /* Electron fraction (internal energy) */
-  if (swift_memalign(
-          "cooling_table.Uefrac", (void **)&cooling->table.Uelectron_fraction,
-          SWIFT_STRUCT_ALIGNMENT,
-          colibre_cooling_N_redshifts * colibre_cooling_N_internalenergy *
-              colibre_cooling_N_metallicity * colibre_cooling_N_density *
-              colibre_cooling_N_electrontypes * sizeof(float)) != 0)
-    error("Failed to allocate Uelectron_fraction array\n");
-
   /* Dataset is named /Udep/ElectronFractions in the published version of the
    * tables and for historical reasons /Udep/ElectronFractionsVol in the version
    * used in the PS2020 repository. Content is identical but we deal
@@ -407,14 +443,6 @@ void read_cooling_tables(struct cooling_function_data *restrict cooling) {
   if (status < 0) error("error closing cooling dataset");
 
   /* Internal energy from temperature */
-  if (swift_memalign("cooling_table.UfromT", (void **)&cooling->table.U_from_T,
-                     SWIFT_STRUCT_ALIGNMENT,
-                     colibre_cooling_N_redshifts *
-                         colibre_cooling_N_temperature *
-                         colibre_cooling_N_metallicity *
-                         colibre_cooling_N_density * sizeof(float)) != 0)
-    error("Failed to allocate U_from_T array\n");
-
   dataset = H5Dopen(tempfile_id, "/Tdep/U_from_T", H5P_DEFAULT);
   status = H5Dread(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
                    cooling->table.U_from_T);
@@ -423,14 +451,6 @@ void read_cooling_tables(struct cooling_function_data *restrict cooling) {
   if (status < 0) error("error closing cooling dataset");
 
   /* Temperature from interal energy */
-  if (swift_memalign("cooling_table.TfromU", (void **)&cooling->table.T_from_U,
-                     SWIFT_STRUCT_ALIGNMENT,
-                     colibre_cooling_N_redshifts *
-                         colibre_cooling_N_internalenergy *
-                         colibre_cooling_N_metallicity *
-                         colibre_cooling_N_density * sizeof(float)) != 0)
-    error("Failed to allocate T_from_U array\n");
-
   dataset = H5Dopen(tempfile_id, "/Udep/T_from_U", H5P_DEFAULT);
   status = H5Dread(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
                    cooling->table.T_from_U);
@@ -439,13 +459,6 @@ void read_cooling_tables(struct cooling_function_data *restrict cooling) {
   if (status < 0) error("error closing cooling dataset");
 
   /* Thermal equilibrium temperature */
-  if (swift_memalign("cooling_table.Teq", (void **)&cooling->table.logTeq,
-                     SWIFT_STRUCT_ALIGNMENT,
-                     colibre_cooling_N_redshifts *
-                         colibre_cooling_N_metallicity *
-                         colibre_cooling_N_density * sizeof(float)) != 0)
-    error("Failed to allocate logTeq array\n");
-
   dataset = H5Dopen(tempfile_id, "/ThermEq/Temperature", H5P_DEFAULT);
   status = H5Dread(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
                    cooling->table.logTeq);
@@ -454,14 +467,6 @@ void read_cooling_tables(struct cooling_function_data *restrict cooling) {
   if (status < 0) error("error closing logTeq dataset");
 
   /* Mean particle mass at thermal equilibrium temperature */
-  if (swift_memalign(
-          "cooling_table.mueq", (void **)&cooling->table.meanpartmass_Teq,
-          SWIFT_STRUCT_ALIGNMENT,
-
-          colibre_cooling_N_redshifts * colibre_cooling_N_metallicity *
-              colibre_cooling_N_density * sizeof(float)) != 0)
-    error("Failed to allocate mu array\n");
-
   dataset = H5Dopen(tempfile_id, "/ThermEq/MeanParticleMass", H5P_DEFAULT);
   status = H5Dread(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
                    cooling->table.meanpartmass_Teq);
@@ -470,13 +475,6 @@ void read_cooling_tables(struct cooling_function_data *restrict cooling) {
   if (status < 0) error("error closing mu dataset");
 
   /* Hydrogen fractions at thermal equilibirum temperature */
-  if (swift_memalign(
-          "cooling_table.Hfracs", (void **)&cooling->table.logHfracs_Teq,
-          SWIFT_STRUCT_ALIGNMENT,
-          colibre_cooling_N_redshifts * colibre_cooling_N_metallicity *
-              colibre_cooling_N_density * 3 * sizeof(float)) != 0)
-    error("Failed to allocate hydrogen fractions array\n");
-
   dataset = H5Dopen(tempfile_id, "/ThermEq/HydrogenFractionsVol", H5P_DEFAULT);
   status = H5Dread(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
                    cooling->table.logHfracs_Teq);
@@ -485,14 +483,6 @@ void read_cooling_tables(struct cooling_function_data *restrict cooling) {
   if (status < 0) error("error closing hydrogen fractions dataset");
 
   /* All hydrogen fractions */
-  if (swift_memalign(
-          "cooling_table.Hfracs", (void **)&cooling->table.logHfracs_all,
-          SWIFT_STRUCT_ALIGNMENT,
-          colibre_cooling_N_redshifts * colibre_cooling_N_temperature *
-              colibre_cooling_N_metallicity * colibre_cooling_N_density * 3 *
-              sizeof(float)) != 0)
-    error("Failed to allocate big hydrogen fractions array\n");
-
   dataset = H5Dopen(tempfile_id, "/Tdep/HydrogenFractionsVol", H5P_DEFAULT);
   status = H5Dread(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT,
                    cooling->table.logHfracs_all);
@@ -504,13 +494,6 @@ void read_cooling_tables(struct cooling_function_data *restrict cooling) {
   H5Fclose(tempfile_id);
 
   /* Pressure at thermal equilibrium temperature */
-  if (swift_memalign("cooling_table.Peq", (void **)&cooling->table.logPeq,
-                     SWIFT_STRUCT_ALIGNMENT,
-                     colibre_cooling_N_redshifts *
-                         colibre_cooling_N_metallicity *
-                         colibre_cooling_N_density * sizeof(float)) != 0)
-    error("Failed to allocate logPeq array\n");
-
   const float log10_kB_cgs = cooling->log10_kB_cgs;
 
   /* Compute the pressures at thermal eq. */
@@ -536,6 +519,11 @@ void read_cooling_tables(struct cooling_function_data *restrict cooling) {
     }
   }
 
+#ifdef WITH_MPI
+  if (cooling->tables_node_shared)
+    mpi_node_shared_end_write(&cooling->tables_window);
+#endif
+
 #ifdef SWIFT_DEBUG_CHECKS
   message("Done reading in general cooling table");
 #endif
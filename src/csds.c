@@ -209,17 +209,26 @@ void csds_log_part(struct csds_writer *log, const struct part *p,
 /**
  * @brief Compute the size and the mask of all the fields that will be written.
  *
+ * A field with a cadence larger than one is only written in every cadence-th
+ * record of a particle. The records are numbered from zero after the last
+ * record containing all the fields, such that record zero contains all of
+ * them too.
+ *
  * @param fields The list of fields to write.
  * @param n_fields The number of fields to write.
+ * @param log_all_fields Should we log all the fields?
+ * @param record The number of records since the last one with all the fields.
  * @param size (output) The size of all the fields.
  * @param mask (output) The mask to use.
  */
-void csds_compute_size_and_mask(struct csds_field *fields, int n_fields,
+void csds_compute_size_and_mask(const struct csds_field *fields, int n_fields,
+                                const int log_all_fields, const int record,
                                 size_t *size, unsigned int *mask) {
   *size = 0;
   *mask = 0;
-  // TODO: write only some fields
   for (int i = 0; i < n_fields; i++) {
+    if (!log_all_fields && record % fields[i].cadence != 0) continue;
+
     *size += fields[i].size;
     *mask |= fields[i].mask;
   }
@@ -247,19 +256,25 @@ void csds_log_parts(struct csds_writer *log, const struct part *p,
   const uint32_t special_flags =
       csds_pack_flags_and_data(flag, flag_data, swift_type_gas);
 
-  /* Compute the size of the buffer. */
-  size_t size = 0;
-  unsigned int mask = 0;
-  // TODO: write only some fields
-  csds_compute_size_and_mask(log->field_pointers[swift_type_gas],
-                             log->number_fields[swift_type_gas], &size, &mask);
-  /* Add the flag */
+  /* Size of the header and of the flag */
+  size_t size_common = CSDS_HEADER_SIZE;
+  unsigned int mask_common = 0;
   if (flag != csds_flag_none) {
-    size += size_special_flag;
-    mask |= log->list_fields[CSDS_SPECIAL_FLAGS_INDEX].mask;
+    size_common += size_special_flag;
+    mask_common |= log->list_fields[CSDS_SPECIAL_FLAGS_INDEX].mask;
+  }
+
+  /* Compute the size of the buffer (the fields depend on the particle). */
+  size_t size_total = 0;
+  for (int i = 0; i < count; i++) {
+    size_t size = 0;
+    unsigned int mask = 0;
+    csds_compute_size_and_mask(
+        log->field_pointers[swift_type_gas], log->number_fields[swift_type_gas],
+        log_all_fields, xp[i].csds_data.records_since_full_output, &size,
+        &mask);
+    size_total += size + size_common;
   }
-  size += CSDS_HEADER_SIZE;
-  size_t size_total = count * size;
 
   /* Allocate a chunk of memory in the logfile of the right size. */
   size_t offset_new;
@@ -279,6 +294,16 @@ void csds_log_parts(struct csds_writer *log, const struct part *p,
       xp[i].csds_data.last_offset = 0;
     }
 
+    /* Get the fields to write */
+    size_t size = 0;
+    unsigned int mask = 0;
+    csds_compute_size_and_mask(
+        log->field_pointers[swift_type_gas], log->number_fields[swift_type_gas],
+        log_all_fields, xp[i].csds_data.records_since_full_output, &size,
+        &mask);
+    size += size_common;
+    mask |= mask_common;
+
     /* Copy everything into the buffer */
     csds_copy_part_fields(log, &p[i], &xp[i], e, mask,
                           &xp[i].csds_data.last_offset, offset_new, buff,
@@ -286,7 +311,7 @@ void csds_log_parts(struct csds_writer *log, const struct part *p,
 
     /* Update the pointers */
     xp[i].csds_data.last_offset = offset_new;
-    xp[i].csds_data.steps_since_last_output = 0;
+    csds_record_written(&xp[i].csds_data, log_all_fields);
     buff += size;
     offset_new += size;
   }
@@ -403,21 +428,26 @@ void csds_log_sparts(struct csds_writer *log, struct spart *sp, int count,
   const uint32_t special_flags =
       csds_pack_flags_and_data(flag, flag_data, swift_type_stars);
 
-  /* Compute the size of the buffer. */
-  // TODO: write only some fields
-  unsigned int mask = 0;
-  size_t size = 0;
-  csds_compute_size_and_mask(log->field_pointers[swift_type_stars],
-                             log->number_fields[swift_type_stars], &size,
-                             &mask);
-
-  /* Add the flag */
+  /* Size of the header and of the flag */
+  size_t size_common = CSDS_HEADER_SIZE;
+  unsigned int mask_common = 0;
   if (flag != csds_flag_none) {
-    mask |= log->list_fields[CSDS_SPECIAL_FLAGS_INDEX].mask;
-    size += size_special_flag;
+    mask_common |= log->list_fields[CSDS_SPECIAL_FLAGS_INDEX].mask;
+    size_common += size_special_flag;
+  }
+
+  /* Compute the size of the buffer (the fields depend on the particle). */
+  size_t size_total = 0;
+  for (int i = 0; i < count; i++) {
+    unsigned int mask = 0;
+    size_t size = 0;
+    csds_compute_size_and_mask(log->field_pointers[swift_type_stars],
+                               log->number_fields[swift_type_stars],
+                               log_all_fields,
+                               sp[i].csds_data.records_since_full_output,
+                               &size, &mask);
+    size_total += size + size_common;
   }
-  size += CSDS_HEADER_SIZE;
-  size_t size_total = count * size;
 
   /* Allocate a chunk of memory in the logfile of the right size. */
   size_t offset_new;
@@ -435,13 +465,24 @@ void csds_log_sparts(struct csds_writer *log, struct spart *sp, int count,
       sp[i].csds_data.last_offset = 0;
     }
 
+    /* Get the fields to write */
+    unsigned int mask = 0;
+    size_t size = 0;
+    csds_compute_size_and_mask(log->field_pointers[swift_type_stars],
+                               log->number_fields[swift_type_stars],
+                               log_all_fields,
+                               sp[i].csds_data.records_since_full_output,
+                               &size, &mask);
+    mask |= mask_common;
+    size += size_common;
+
     /* Copy everything into the buffer */
     csds_copy_spart_fields(log, &sp[i], e, mask, &sp[i].csds_data.last_offset,
                            offset_new, buff, special_flags);
 
     /* Update the pointers */
     sp[i].csds_data.last_offset = offset_new;
-    sp[i].csds_data.steps_since_last_output = 0;
+    csds_record_written(&sp[i].csds_data, log_all_fields);
     buff += size;
     offset_new += size;
   }
@@ -557,31 +598,32 @@ void csds_log_gparts(struct csds_writer *log, struct gpart *p, int count,
   const uint32_t special_flags =
       csds_pack_flags_and_data(flag, flag_data, swift_type_dark_matter);
 
-  /* Compute the size of the buffer. */
-  /* As we might have some non DM particles, we cannot log_all_fields blindly */
-  int count_dm = 0;
-  // TODO: write only some fields
+  /* Size of the header and of the flag */
+  size_t size_common = CSDS_HEADER_SIZE;
+  unsigned int mask_common = 0;
+  if (flag != csds_flag_none) {
+    mask_common |= log->list_fields[CSDS_SPECIAL_FLAGS_INDEX].mask;
+    size_common += size_special_flag;
+  }
+
+  /* Compute the size of the buffer (the fields depend on the particle). */
+  /* As we might have some non DM particles, we cannot log them blindly */
+  size_t size_total = 0;
   for (int i = 0; i < count; i++) {
     /* Log only the dark matter */
     if (p[i].type != swift_type_dark_matter &&
         p[i].type != swift_type_dark_matter_background)
       continue;
 
-    count_dm += 1;
-  }
-  unsigned int mask = 0;
-  size_t size = 0;
-  csds_compute_size_and_mask(log->field_pointers[swift_type_dark_matter],
-                             log->number_fields[swift_type_dark_matter], &size,
-                             &mask);
-
-  /* Add the flag */
-  if (flag != csds_flag_none) {
-    mask |= log->list_fields[CSDS_SPECIAL_FLAGS_INDEX].mask;
-    size += size_special_flag;
+    unsigned int mask = 0;
+    size_t size = 0;
+    csds_compute_size_and_mask(log->field_pointers[swift_type_dark_matter],
+                               log->number_fields[swift_type_dark_matter],
+                               log_all_fields,
+                               p[i].csds_data.records_since_full_output,
+                               &size, &mask);
+    size_total += size + size_common;
   }
-  size += CSDS_HEADER_SIZE;
-  size_t size_total = size * count_dm;
 
   /* Allocate a chunk of memory in the logfile of the right size. */
   size_t offset_new;
@@ -604,13 +646,24 @@ void csds_log_gparts(struct csds_writer *log, struct gpart *p, int count,
       p[i].csds_data.last_offset = 0;
     }
 
+    /* Get the fields to write */
+    unsigned int mask = 0;
+    size_t size = 0;
+    csds_compute_size_and_mask(log->field_pointers[swift_type_dark_matter],
+                               log->number_fields[swift_type_dark_matter],
+                               log_all_fields,
+                               p[i].csds_data.records_since_full_output,
+                               &size, &mask);
+    mask |= mask_common;
+    size += size_common;
+
     /* Copy everything into the buffer */
     csds_copy_gpart_fields(log, &p[i], e, mask, &p[i].csds_data.last_offset,
                            offset_new, buff, special_flags);
 
     /* Update the pointers */
     p[i].csds_data.last_offset = offset_new;
-    p[i].csds_data.steps_since_last_output = 0;
+    csds_record_written(&p[i].csds_data, log_all_fields);
     buff += size;
     offset_new += size;
   }
@@ -898,6 +951,35 @@ void csds_init(struct csds_writer *log, const struct engine *e,
   /* Initialize the list_fields */
   csds_init_masks(log, e);
 
+  /* Read how often each field is written (every record by default). */
+  for (int i = 0; i < log->total_number_fields; i++) {
+    struct csds_field *field = &log->list_fields[i];
+    field->cadence = 1;
+    if (i == CSDS_SPECIAL_FLAGS_INDEX || i == CSDS_TIMESTAMP_INDEX) continue;
+
+    char param_name[PARSER_MAX_LINE_SIZE];
+    sprintf(param_name, "CSDS:cadence_%s", field->name);
+    field->cadence = parser_get_opt_param_int(params, param_name, 1);
+    if (field->cadence < 1)
+      error("The cadence of the CSDS field %s must be at least 1 (got %d).",
+            field->name, field->cadence);
+  }
+
+  /* Every record needs at least one field. */
+  for (int i = 0; i < swift_type_count; i++) {
+    if (log->field_pointers[i] == NULL) continue;
+
+    int found = 0;
+    for (int j = 0; j < log->number_fields[i]; j++)
+      if (log->field_pointers[i][j].cadence == 1) found = 1;
+
+    if (!found)
+      error(
+          "At least one CSDS field of the particle type %s must be written in "
+          "every record (cadence of 1).",
+          part_type_names[i]);
+  }
+
   /* set initial value of parameters. */
   log->timestamp_offset = 0;
 
@@ -36,6 +36,7 @@
 #include "csds/src/logfile_writer.h"
 
 /* Forward declaration. */
+struct csds_field;
 struct gpart;
 struct part;
 struct engine;
@@ -104,6 +105,10 @@ struct csds_part_data {
   /* Number of particle updates since last output. */
   int steps_since_last_output;
 
+  /* Number of records written since the last one containing all the
+   * fields. */
+  int records_since_full_output;
+
   /* offset of last particle log entry. */
   uint64_t last_offset;
 };
@@ -147,6 +152,9 @@ int csds_read_timestamp(const struct csds_writer *log, integertime_t *t,
                         double *time, size_t *offset, const char *buff);
 void csds_struct_dump(const struct csds_writer *log, FILE *stream);
 void csds_struct_restore(struct csds_writer *log, FILE *stream);
+void csds_compute_size_and_mask(const struct csds_field *fields, int n_fields,
+                                const int log_all_fields, const int record,
+                                size_t *size, unsigned int *mask);
 
 /**
  * @brief Initialize the csds data for a particle.
@@ -156,6 +164,25 @@ void csds_struct_restore(struct csds_writer *log, FILE *stream);
 INLINE static void csds_part_data_init(struct csds_part_data *csds) {
   csds->last_offset = 0;
   csds->steps_since_last_output = 0;
+  csds->records_since_full_output = 0;
+}
+
+/**
+ * @brief Update the record counter of a particle after writing a record.
+ *
+ * A record containing all the fields restarts the count, such that the
+ * next record of the particle also contains all the fields.
+ *
+ * @param csds_data The #csds_part_data of the particle.
+ * @param log_all_fields Did the record contain all the fields?
+ */
+INLINE static void csds_record_written(struct csds_part_data *csds_data,
+                                       const int log_all_fields) {
+  csds_data->steps_since_last_output = 0;
+  if (log_all_fields)
+    csds_data->records_since_full_output = 0;
+  else
+    csds_data->records_since_full_output += 1;
 }
 
 /**
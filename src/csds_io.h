@@ -61,6 +61,10 @@ struct csds_field {
   /* Do we use the xpart or the normal one? */
   int use_xpart;
 
+  /* Number of records of a particle between two writes of this field
+   * (1 to write it in every record). */
+  int cadence;
+
   /* Conversion functions (NULL if none) */
   void *(*conversion_hydro)(const struct part *, const struct xpart *xp,
                             const struct engine *e, void *buffer);
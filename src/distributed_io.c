@@ -49,11 +49,13 @@
 #include "io_compression.h"
 #include "io_properties.h"
 #include "memuse.h"
+#include "mpi_node.h"
 #include "output_list.h"
 #include "output_options.h"
 #include "part.h"
 #include "part_type.h"
 #include "sink_io.h"
+#include "snapshot_async.h"
 #include "star_formation_io.h"
 #include "stars_io.h"
 #include "tools.h"
@@ -64,56 +66,113 @@
 /* Are we timing the i/o? */
 //#define IO_SPEED_MEASUREMENT
 
+/* Largest message used to send data to the writer of a node (in bytes) */
+#define NODE_GATHER_MAX_MESSAGE ((size_t)1 << 30)
+
 /**
- * @brief Writes a data array in given HDF5 group.
- *
- * @param e The #engine we are writing from.
- * @param grp The group in which to write.
- * @param fileName The name of the file in which the data is written
- * @param partTypeGroupName The name of the group containing the particles in
- * the HDF5 file.
- * @param props The #io_props of the field to read
- * @param N The number of particles to write.
- * @param lossy_compression Level of lossy compression to use for this field.
- * @param internal_units The #unit_system used internally
- * @param snapshot_units The #unit_system used in the snapshots
+ * @brief Gathers the converted data of all the ranks of this node on its
+ * first rank, in the order of their rank in the node.
  *
- * @todo A better version using HDF5 hyper-slabs to write the file directly from
- * the part array will be written once the structures have been stabilized.
+ * @param temp The local buffer. On the first rank of the node, it is
+ * replaced by a buffer holding the data of the whole node.
+ * @param node_counts The number of particles of each rank of the node.
+ * @param element_size The size in bytes of the data of one particle.
+ * @return The number of particles in the buffer of the first rank of the
+ * node, 0 on the other ranks.
  */
-void write_distributed_array(
-    const struct engine* e, hid_t grp, const char* fileName,
-    const char* partTypeGroupName, const struct io_props props, const size_t N,
-    const enum lossy_compression_schemes lossy_compression,
-    const struct unit_system* internal_units,
-    const struct unit_system* snapshot_units) {
-
-#ifdef IO_SPEED_MEASUREMENT
-  const ticks tic_total = getticks();
-#endif
-
-  const size_t typeSize = io_sizeof_type(props.type);
-  const size_t num_elements = N * props.dimension;
+static size_t gather_node_buffers(void** temp, const long long* node_counts,
+                                  const size_t element_size) {
+
+  /* Send our data in pieces MPI can count */
+  if (mpi_node_rank != 0) {
+    const size_t size = node_counts[mpi_node_rank] * element_size;
+    for (size_t offset = 0; offset < size; offset += NODE_GATHER_MAX_MESSAGE) {
+      const size_t count = min(size - offset, NODE_GATHER_MAX_MESSAGE);
+      const int res = MPI_Send((char*)*temp + offset, (int)count, MPI_BYTE,
+                               /*dest=*/0, /*tag=*/0, mpi_node_comm);
+      if (res != MPI_SUCCESS) mpi_error(res, "Failed to send node data");
+    }
+    return 0;
+  }
 
-  /* message("Writing '%s' array...", props.name); */
+  /* Room for everything */
+  size_t N_node = 0;
+  size_t nr_messages = 0;
+  for (int k = 0; k < mpi_node_size; ++k) {
+    N_node += node_counts[k];
+    nr_messages += (node_counts[k] * element_size + NODE_GATHER_MAX_MESSAGE -
+                    1) / NODE_GATHER_MAX_MESSAGE;
+  }
+  char* node_temp = NULL;
+  if (swift_memalign("writebuff", (void**)&node_temp, IO_BUFFER_ALIGNMENT,
+                     N_node * element_size) != 0)
+    error("Unable to allocate temporary i/o buffer for the node");
+  MPI_Request* requests =
+      (MPI_Request*)malloc((nr_messages + 1) * sizeof(MPI_Request));
+  if (requests == NULL) error("Unable to allocate node requests");
+
+  /* Our own data go first, followed by everybody else's */
+  memcpy(node_temp, *temp, node_counts[0] * element_size);
+  size_t node_offset = node_counts[0] * element_size;
+  int nr_requests = 0;
+  for (int k = 1; k < mpi_node_size; ++k) {
+    const size_t size = node_counts[k] * element_size;
+    for (size_t offset = 0; offset < size; offset += NODE_GATHER_MAX_MESSAGE) {
+      const size_t count = min(size - offset, NODE_GATHER_MAX_MESSAGE);
+      const int res =
+          MPI_Irecv(node_temp + node_offset + offset, (int)count, MPI_BYTE, k,
+                    /*tag=*/0, mpi_node_comm, &requests[nr_requests++]);
+      if (res != MPI_SUCCESS) mpi_error(res, "Failed to receive node data");
+    }
+    node_offset += size;
+  }
+  const int res = MPI_Waitall(nr_requests, requests, MPI_STATUSES_IGNORE);
+  if (res != MPI_SUCCESS) mpi_error(res, "Failed to gather node data");
+  free(requests);
 
-  /* Allocate temporary buffer */
-  void* temp = NULL;
-  if (swift_memalign("writebuff", (void**)&temp, IO_BUFFER_ALIGNMENT,
-                     num_elements * typeSize) != 0)
-    error("Unable to allocate temporary i/o buffer");
+  swift_free("writebuff", *temp);
+  *temp = node_temp;
+  return N_node;
+}
 
-#ifdef IO_SPEED_MEASUREMENT
-  ticks tic = getticks();
-#endif
+/**
+ * @brief A field converted and waiting to be written by
+ * write_distributed_array_buffer().
+ */
+struct write_distributed_array_data {
+  const struct engine* e;
+  hid_t grp;
+  struct io_props props;
+  size_t N;
+  enum lossy_compression_schemes lossy_compression;
+  const struct unit_system* snapshot_units;
+  void* temp;
+};
 
-  /* Copy the particle data to the temporary buffer */
-  io_copy_temp_buffer(temp, e, props, N, internal_units, snapshot_units);
+/**
+ * @brief Writes a converted data array in given HDF5 group and frees it.
+ *
+ * This is called by the #io_write_pipeline, possibly from its own thread.
+ *
+ * @param data The #write_distributed_array_data of the field.
+ */
+static void write_distributed_array_buffer(void* data) {
+
+  const struct write_distributed_array_data d =
+      *((struct write_distributed_array_data*)data);
+  free(data);
+
+  const struct engine* e = d.e;
+  const hid_t grp = d.grp;
+  const struct io_props props = d.props;
+  const size_t N = d.N;
+  const enum lossy_compression_schemes lossy_compression = d.lossy_compression;
+  const struct unit_system* snapshot_units = d.snapshot_units;
+  void* temp = d.temp;
+  const size_t typeSize = io_sizeof_type(props.type);
 
 #ifdef IO_SPEED_MEASUREMENT
-  if (engine_rank == IO_SPEED_MEASUREMENT || IO_SPEED_MEASUREMENT == -1)
-    message("Copying for '%s' took %.3f %s.", props.name,
-            clocks_from_ticks(getticks() - tic), clocks_getunit());
+  const ticks tic = getticks();
 #endif
 
   /* Create data space */
@@ -202,17 +261,28 @@ void write_distributed_array(
   if (h_data < 0) error("Error while creating dataspace '%s'.", props.name);
 
 #ifdef IO_SPEED_MEASUREMENT
-  tic = getticks();
+  const ticks tic_write = getticks();
 #endif
 
-  /* Write temporary buffer to HDF5 dataspace */
-  h_err = H5Dwrite(h_data, io_hdf5_type(props.type), h_space, H5S_ALL,
-                   H5P_DEFAULT, temp);
-  if (h_err < 0) error("Error while writing data array '%s'.", props.name);
+#ifdef IO_THREADED_DEFLATE
+  /* Compress on all the threads if only the lossless filters are used */
+  if (io_compression_uses_threadpool(e->snapshot_compression, N,
+                                     lossy_compression)) {
+    io_write_deflated_chunks((struct threadpool*)&e->threadpool, h_data, temp,
+                             N, props.dimension, typeSize, chunk_shape[0],
+                             e->snapshot_compression, props.name);
+  } else
+#endif
+  {
+    /* Write temporary buffer to HDF5 dataspace */
+    h_err = H5Dwrite(h_data, io_hdf5_type(props.type), h_space, H5S_ALL,
+                     H5P_DEFAULT, temp);
+    if (h_err < 0) error("Error while writing data array '%s'.", props.name);
+  }
 
 #ifdef IO_SPEED_MEASUREMENT
   ticks toc = getticks();
-  float ms = clocks_from_ticks(toc - tic);
+  float ms = clocks_from_ticks(toc - tic_write);
   int megaBytes = N * props.dimension * typeSize / (1024 * 1024);
   if (engine_rank == IO_SPEED_MEASUREMENT || IO_SPEED_MEASUREMENT == -1)
     message(
@@ -271,6 +341,107 @@ void write_distributed_array(
 #endif
 }
 
+
+/**
+ * @brief Writes a data array in given HDF5 group.
+ *
+ * @param e The #engine we are writing from.
+ * @param grp The group in which to write.
+ * @param fileName The name of the file in which the data is written
+ * @param partTypeGroupName The name of the group containing the particles in
+ * the HDF5 file.
+ * @param props The #io_props of the field to read
+ * @param N The number of particles to write.
+ * @param node_counts When the ranks of a node share a file, the number of
+ * particles of each of them (NULL otherwise). Only the first rank of the node
+ * then writes to the file.
+ * @param ptype The type of the particles (to keep the fields of keyframes).
+ * @param lossy_compression Level of lossy compression to use for this field.
+ * @param internal_units The #unit_system used internally
+ * @param snapshot_units The #unit_system used in the snapshots
+ * @param pipeline The #io_write_pipeline writing the fields. The data are
+ * converted (and gathered) here and written once the previous field has been
+ * written, possibly in the background.
+ *
+ * @todo A better version using HDF5 hyper-slabs to write the file directly from
+ * the part array will be written once the structures have been stabilized.
+ */
+void write_distributed_array(
+    const struct engine* e, hid_t grp, const char* fileName,
+    const char* partTypeGroupName, const struct io_props props, size_t N,
+    const long long* node_counts, const int ptype,
+    const enum lossy_compression_schemes lossy_compression,
+    const struct unit_system* internal_units,
+    const struct unit_system* snapshot_units,
+    struct io_write_pipeline* pipeline) {
+
+#ifdef IO_SPEED_MEASUREMENT
+  const ticks tic_total = getticks();
+#endif
+
+  const size_t typeSize = io_sizeof_type(props.type);
+  const size_t num_elements = N * props.dimension;
+
+  /* message("Writing '%s' array...", props.name); */
+
+  /* Allocate temporary buffer */
+  void* temp = NULL;
+  if (swift_memalign("writebuff", (void**)&temp, IO_BUFFER_ALIGNMENT,
+                     num_elements * typeSize) != 0)
+    error("Unable to allocate temporary i/o buffer");
+
+#ifdef IO_SPEED_MEASUREMENT
+  ticks tic = getticks();
+#endif
+
+  /* Copy the particle data to the temporary buffer */
+  io_copy_temp_buffer(temp, e, props, N, internal_units, snapshot_units);
+
+  /* Round the values if an error-bounded scheme was chosen */
+  if (compression_scheme_is_error_bounded(lossy_compression))
+    io_quantise_buffer((struct threadpool*)&e->threadpool, temp, num_elements,
+                       props.type, lossy_compression, props.name);
+
+#ifdef IO_SPEED_MEASUREMENT
+  if (engine_rank == IO_SPEED_MEASUREMENT || IO_SPEED_MEASUREMENT == -1)
+    message("Copying for '%s' took %.3f %s.", props.name,
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+#endif
+
+  /* Keep the values of a keyframe to write the next snapshots as deltas */
+  struct snapshot_keyframe* keyframe =
+      (struct snapshot_keyframe*)&e->snapshot_keyframe;
+  snapshot_keyframe_store_field(keyframe, ptype, &props, N, lossy_compression,
+                                temp);
+
+  /* Hand the data over to the writer of the node, if any. From now on, N is
+   * the number of particles in the file. */
+  if (node_counts != NULL) {
+    N = gather_node_buffers(&temp, node_counts, typeSize * props.dimension);
+    if (mpi_node_rank != 0) {
+      swift_free("writebuff", temp);
+      return;
+    }
+  }
+
+  /* Write it once the previous field is written. The writing can be done in
+   * the background unless it needs the threadpool to compress the data. */
+  struct write_distributed_array_data* data =
+      (struct write_distributed_array_data*)malloc(sizeof(*data));
+  if (data == NULL) error("Unable to allocate i/o pipeline data");
+  data->e = e;
+  data->grp = grp;
+  data->props = props;
+  data->N = N;
+  data->lossy_compression = lossy_compression;
+  data->snapshot_units = snapshot_units;
+  data->temp = temp;
+  io_write_pipeline_submit(
+      pipeline, write_distributed_array_buffer, data,
+      !io_compression_uses_threadpool(e->snapshot_compression, N,
+                                      lossy_compression));
+}
+
 /**
  * @brief Prepares an array in the snapshot.
  *
@@ -701,7 +872,10 @@ void write_virtual_file(struct engine* e, const char* fileName_base,
               (enum part_type)ptype, compression_level_current_default,
               e->verbose);
 
-      if (compression_level != compression_do_not_write) {
+      /* Deltas from a keyframe only make sense within their own file */
+      if (compression_level != compression_do_not_write &&
+          !snapshot_keyframe_field_is_delta(&e->snapshot_keyframe, ptype,
+                                            list[i].name, compression_level)) {
         write_array_virtual(e, h_grp, fileName_base, xmfFile, partTypeGroupName,
                             list[i], N_total[ptype], N_counts, num_ranks, ptype,
                             compression_level, snapshot_units);
@@ -743,7 +917,9 @@ void write_virtual_file(struct engine* e, const char* fileName_base,
  * @param comm The communicator used by the MPI ranks.
  * @param info The MPI information object.
  *
- * Creates a series of HDF5 output files (1 per MPI node) as a snapshot.
+ * Creates a series of HDF5 output files (1 per MPI rank, or 1 per physical
+ * node if the ranks of each node write through their first one) as a
+ * snapshot.
  * Writes the particles contained in the engine.
  * If such files already exist, it is erased and replaced by the new one.
  * The companion XMF file is also updated accordingly.
@@ -755,7 +931,12 @@ void write_output_distributed(struct engine* e,
                               MPI_Comm comm, MPI_Info info) {
 
   hid_t h_file = 0, h_grp = 0;
-  int numFiles = mpi_size;
+
+  /* Do the ranks of each node share a file written by the first of them? */
+  const int per_node = e->snapshot_distributed_per_node;
+  const int file_index = per_node ? mpi_node_index(mpi_rank) : mpi_rank;
+  const int writer = !per_node || mpi_node_rank == 0;
+  const int numFiles = per_node ? mpi_node_count_nodes() : mpi_size;
   const struct part* parts = e->s->parts;
   const struct xpart* xparts = e->s->xparts;
   const struct gpart* gparts = e->s->gparts;
@@ -837,7 +1018,7 @@ void write_output_distributed(struct engine* e,
 
     sprintf(fileName, "%s/%s_%0*d/%s_%0*d.%d.hdf5", snapshot_subdir_name,
             snapshot_base_name, number_digits, snap_count, snapshot_base_name,
-            number_digits, snap_count, mpi_rank);
+            number_digits, snap_count, file_index);
 
     sprintf(fileName_base, "%s/%s_%0*d/%s_%0*d", snapshot_subdir_name,
             snapshot_base_name, number_digits, snap_count, snapshot_base_name,
@@ -848,7 +1029,7 @@ void write_output_distributed(struct engine* e,
 
     sprintf(fileName, "%s_%0*d/%s_%0*d.%d.hdf5", snapshot_base_name,
             number_digits, snap_count, snapshot_base_name, number_digits,
-            snap_count, mpi_rank);
+            snap_count, file_index);
 
     sprintf(fileName_base, "%s_%0*d/%s_%0*d", snapshot_base_name, number_digits,
             snap_count, snapshot_base_name, number_digits, snap_count);
@@ -948,11 +1129,47 @@ void write_output_distributed(struct engine* e,
   long long N_total[swift_type_count] = {0};
   MPI_Allreduce(N, N_total, swift_type_count, MPI_LONG_LONG_INT, MPI_SUM, comm);
 
-  /* Collect the number of particles written by each rank */
+  /* Number of particles in our file and offset of ours in it */
+  long long N_file[swift_type_count];
+  long long file_offsets[swift_type_count] = {0};
+  for (int ptype = 0; ptype < swift_type_count; ++ptype)
+    N_file[ptype] = N[ptype];
+
+  /* When the ranks of a node share a file, collect the number of particles
+   * of each type written by each of them */
+  long long* node_counts = NULL;
+  if (per_node) {
+    const size_t size = mpi_node_size * swift_type_count * sizeof(long long);
+    long long* counts = (long long*)malloc(size);
+    node_counts = (long long*)malloc(size);
+    if (counts == NULL || node_counts == NULL)
+      error("Unable to allocate the node counts");
+    MPI_Allgather(N, swift_type_count, MPI_LONG_LONG_INT, counts,
+                  swift_type_count, MPI_LONG_LONG_INT, mpi_node_comm);
+
+    /* Sort them by type and add them up */
+    for (int ptype = 0; ptype < swift_type_count; ++ptype) {
+      N_file[ptype] = 0;
+      for (int k = 0; k < mpi_node_size; ++k) {
+        const long long count = counts[k * swift_type_count + ptype];
+        node_counts[ptype * mpi_node_size + k] = count;
+        if (k < mpi_node_rank) file_offsets[ptype] += count;
+        N_file[ptype] += count;
+      }
+    }
+    free(counts);
+  }
+
+  /* Collect the number of particles written in each file */
   long long* N_counts =
-      (long long*)malloc(mpi_size * swift_type_count * sizeof(long long));
-  MPI_Gather(N, swift_type_count, MPI_LONG_LONG_INT, N_counts, swift_type_count,
-             MPI_LONG_LONG_INT, 0, comm);
+      (long long*)malloc(numFiles * swift_type_count * sizeof(long long));
+  if (!per_node) {
+    MPI_Gather(N, swift_type_count, MPI_LONG_LONG_INT, N_counts,
+               swift_type_count, MPI_LONG_LONG_INT, 0, comm);
+  } else if (writer) {
+    MPI_Gather(N_file, swift_type_count, MPI_LONG_LONG_INT, N_counts,
+               swift_type_count, MPI_LONG_LONG_INT, 0, mpi_node_leaders_comm);
+  }
 
   /* List what fields to write.
    * Note that we want to want to write a 0-size dataset for some species
@@ -974,17 +1191,25 @@ void write_output_distributed(struct engine* e,
 
     char string[1200];
     sprintf(string, "lfs setstripe -c 1 -i %d %s",
-            ((e->nodeID + offset) % e->snapshot_lustre_OST_count), fileName);
-    const int result = system(string);
+            ((file_index + offset) % e->snapshot_lustre_OST_count), fileName);
+    const int result = writer ? system(string) : 0;
     if (result != 0) {
       message("lfs setstripe command returned error code %d", result);
     }
   }
 
-  /* Open file */
+  /* Is this a keyframe or a delta snapshot? */
+  snapshot_keyframe_start(&e->snapshot_keyframe, fileName);
+
+  /* Open file. The ranks that do not write build the meta-data in a file
+   * that only lives in memory and is discarded. */
   /* message("Opening file '%s'.", fileName); */
-  h_file = H5Fcreate(fileName, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  hid_t h_fapl = H5P_DEFAULT;
+  if (e->snapshot_async.enabled || !writer)
+    h_fapl = snapshot_async_create_fapl();
+  h_file = H5Fcreate(fileName, H5F_ACC_TRUNC, H5P_DEFAULT, h_fapl);
   if (h_file < 0) error("Error while opening file '%s'.", fileName);
+  if (h_fapl != H5P_DEFAULT) H5Pclose(h_fapl);
 
   /* Open header to write simulation properties */
   /* message("Writing file header..."); */
@@ -1056,7 +1281,7 @@ void write_output_distributed(struct engine* e,
     if (numFields[ptype] == 0) {
       numParticlesThisFile[ptype] = 0;
     } else {
-      numParticlesThisFile[ptype] = N[ptype];
+      numParticlesThisFile[ptype] = N_file[ptype];
     }
   }
 
@@ -1077,10 +1302,11 @@ void write_output_distributed(struct engine* e,
   io_write_attribute(h_grp, "Flag_Entropy_ICs", UINT, flagEntropy,
                      swift_type_count);
   io_write_attribute_i(h_grp, "NumFilesPerSnapshot", numFiles);
-  io_write_attribute_i(h_grp, "ThisFile", mpi_rank);
+  io_write_attribute_i(h_grp, "ThisFile", file_index);
   io_write_attribute_s(h_grp, "SelectOutput", current_selection_name);
   io_write_attribute_i(h_grp, "Virtual", 0);
   io_write_attribute(h_grp, "CanHaveTypes", INT, to_write, swift_type_count);
+  snapshot_keyframe_write_header(&e->snapshot_keyframe, h_grp);
 
   if (subsample_any) {
     io_write_attribute_s(h_grp, "OutputType", "SubSampled");
@@ -1100,9 +1326,9 @@ void write_output_distributed(struct engine* e,
   io_write_meta_data(h_file, e, internal_units, snapshot_units);
 
   /* Now write the top-level cell structure
-   * We use a global offset of 0 here. This means that the cells will write
-   * their offset with respect to the start of the file they belong to and
-   * not a global offset */
+   * We use the offset of our particles in our file here. This means that the
+   * cells will write their offset with respect to the start of the file they
+   * belong to and not a global offset */
   long long global_offsets[swift_type_count] = {0};
   h_grp = H5Gcreate(h_file, "/Cells", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
   if (h_grp < 0) error("Error while creating cells group");
@@ -1110,9 +1336,10 @@ void write_output_distributed(struct engine* e,
   /* Write the location of the particles in the arrays */
   io_write_cell_offsets(h_grp, e->s->cdim, e->s->dim, e->s->cells_top,
                         e->s->nr_cells, e->s->width, mpi_rank,
-                        /*distributed=*/1, subsample, subsample_fraction,
-                        e->snapshot_output_count, N_total, global_offsets,
-                        to_write, numFields, internal_units, snapshot_units);
+                        /*distributed=*/1, per_node ? mpi_node_indices() : NULL,
+                        subsample, subsample_fraction, e->snapshot_output_count,
+                        N_total, file_offsets, to_write, numFields,
+                        internal_units, snapshot_units);
   H5Gclose(h_grp);
 
   /* Loop over all particle types */
@@ -1140,7 +1367,7 @@ void write_output_distributed(struct engine* e,
     if (h_err < 0) error("Error while creating alias for particle group.\n");
 
     /* Write the number of particles as an attribute */
-    io_write_attribute_ll(h_grp, "NumberOfParticles", N[ptype]);
+    io_write_attribute_ll(h_grp, "NumberOfParticles", N_file[ptype]);
     io_write_attribute_ll(h_grp, "TotalNumberOfParticles", N_total[ptype]);
 
     int num_fields = 0;
@@ -1420,7 +1647,13 @@ void write_output_distributed(struct engine* e,
             output_options->select_output, current_selection_name,
             (enum part_type)ptype, e->verbose);
 
-    /* Write everything that is not cancelled */
+    /* Find the particles in the keyframe or record them as a new one */
+    snapshot_keyframe_start_type(&e->snapshot_keyframe, e, ptype, list,
+                                 num_fields, Nparticles);
+
+    /* Write everything that is not cancelled, converting each field while the
+     * previous one is being written */
+    struct io_write_pipeline pipeline = {0};
     int num_fields_written = 0;
     for (int i = 0; i < num_fields; ++i) {
 
@@ -1432,12 +1665,22 @@ void write_output_distributed(struct engine* e,
               e->verbose);
 
       if (compression_level != compression_do_not_write) {
-        write_distributed_array(e, h_grp, fileName, partTypeGroupName, list[i],
-                                Nparticles, compression_level, internal_units,
-                                snapshot_units);
+        if (snapshot_keyframe_field_is_delta(&e->snapshot_keyframe, ptype,
+                                             list[i].name, compression_level)) {
+          io_write_pipeline_wait(&pipeline);
+          snapshot_keyframe_write_delta(&e->snapshot_keyframe, e, h_grp, ptype,
+                                        &list[i], Nparticles, compression_level,
+                                        internal_units, snapshot_units);
+        } else {
+          write_distributed_array(
+              e, h_grp, fileName, partTypeGroupName, list[i], Nparticles,
+              per_node ? &node_counts[ptype * mpi_node_size] : NULL, ptype,
+              compression_level, internal_units, snapshot_units, &pipeline);
+        }
         num_fields_written++;
       }
     }
+    io_write_pipeline_wait(&pipeline);
 
     /* Only write this now that we know exactly how many fields there are. */
     io_write_attribute_i(h_grp, "NumberOfFields", num_fields_written);
@@ -1458,6 +1701,10 @@ void write_output_distributed(struct engine* e,
 
   /* message("Done writing particles..."); */
 
+  /* Hand the in-memory file over to the background writer */
+  if (e->snapshot_async.enabled && writer)
+    snapshot_async_submit(&e->snapshot_async, h_file, fileName);
+
   /* Close file */
   H5Fclose(h_file);
 
@@ -1466,7 +1713,7 @@ void write_output_distributed(struct engine* e,
   /* Write the virtual meta-file */
   if (mpi_rank == 0)
     write_virtual_file(e, fileName_base, xmfFileName, N_total, N_counts,
-                       mpi_size, to_write, numFields, current_selection_name,
+                       numFiles, to_write, numFields, current_selection_name,
                        internal_units, snapshot_units, subsample_any,
                        subsample_fraction);
 
@@ -1497,15 +1744,30 @@ void write_output_distributed(struct engine* e,
   /* We need to recompute the offsets since they are now with respect
    * to a single file. */
   for (int i = 0; i < swift_type_count; ++i) global_offsets[i] = 0;
-  MPI_Exscan(N, global_offsets, swift_type_count, MPI_LONG_LONG_INT, MPI_SUM,
-             comm);
+  if (!per_node) {
+    MPI_Exscan(N, global_offsets, swift_type_count, MPI_LONG_LONG_INT, MPI_SUM,
+               comm);
+  } else {
+
+    /* Offset of our file, plus ours in the file */
+    if (writer)
+      MPI_Exscan(N_file, global_offsets, swift_type_count, MPI_LONG_LONG_INT,
+                 MPI_SUM, mpi_node_leaders_comm);
+    if (file_index == 0)
+      for (int i = 0; i < swift_type_count; ++i) global_offsets[i] = 0;
+    MPI_Bcast(global_offsets, swift_type_count, MPI_LONG_LONG_INT, 0,
+              mpi_node_comm);
+    for (int i = 0; i < swift_type_count; ++i)
+      global_offsets[i] += file_offsets[i];
+  }
 
   /* Write the location of the particles in the arrays */
   io_write_cell_offsets(h_grp_cells, e->s->cdim, e->s->dim, e->s->cells_top,
                         e->s->nr_cells, e->s->width, mpi_rank,
-                        /*distributed=*/0, subsample, subsample_fraction,
-                        e->snapshot_output_count, N_total, global_offsets,
-                        to_write, numFields, internal_units, snapshot_units);
+                        /*distributed=*/0, /*rank_files=*/NULL, subsample,
+                        subsample_fraction, e->snapshot_output_count, N_total,
+                        global_offsets, to_write, numFields, internal_units,
+                        snapshot_units);
 
   /* Close everything */
   if (mpi_rank == 0) {
@@ -1515,8 +1777,9 @@ void write_output_distributed(struct engine* e,
 
 #endif
 
-  /* Free the counts-per-rank array */
+  /* Free the counts-per-file arrays */
   free(N_counts);
+  free(node_counts);
 
   /* Make sure nobody is allowed to progress until everyone is done. */
   MPI_Barrier(comm);
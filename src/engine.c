@@ -79,6 +79,7 @@
 #include "map.h"
 #include "memuse.h"
 #include "minmax.h"
+#include "mpi_node.h"
 #include "mpiuse.h"
 #include "multipole_struct.h"
 #include "neutrino.h"
@@ -528,16 +529,55 @@ void engine_exchange_top_multipoles(struct engine *e) {
   /* Each node (space) has constructed its own top-level multipoles.
    * We now need to make sure every other node has a copy of everything.
    *
-   * We use our home-made reduction operation that simply performs a XOR
-   * operation on the multipoles. Since only local multipoles are non-zero and
-   * each multipole is only present once, the bit-by-bit XOR will
-   * create the desired result.
+   * Rather than reducing the whole (mostly zero) array, every rank only
+   * contributes the multipoles of the cells it owns and we gather these.
+   * The top-level decomposition is known everywhere, so the number of cells
+   * coming from each rank and the cells they belong to (in increasing index
+   * order) can be reconstructed locally without exchanging any metadata.
    */
-  int err = MPI_Allreduce(MPI_IN_PLACE, e->s->multipoles_top, e->s->nr_cells,
-                          multipole_mpi_type, multipole_mpi_reduce_op,
-                          MPI_COMM_WORLD);
+  struct space *s = e->s;
+  const int nr_nodes = e->nr_nodes;
+  const int nr_cells = s->nr_cells;
+
+  int *counts = (int *)calloc(nr_nodes, sizeof(int));
+  int *displs = (int *)malloc(nr_nodes * sizeof(int));
+  int *cursor = (int *)malloc(nr_nodes * sizeof(int));
+  if (counts == NULL || displs == NULL || cursor == NULL)
+    error("Unable to allocate memory for the multipole exchange counts");
+
+  for (int i = 0; i < nr_cells; ++i) counts[s->cells_top[i].nodeID]++;
+  displs[0] = 0;
+  for (int k = 1; k < nr_nodes; ++k) displs[k] = displs[k - 1] + counts[k - 1];
+
+  struct gravity_tensors *buffer = NULL;
+  if (swift_memalign("top_multipoles_buffer", (void **)&buffer,
+                     SWIFT_CACHE_ALIGNMENT,
+                     nr_cells * sizeof(struct gravity_tensors)) != 0)
+    error("Unable to allocate memory for the top-level multipole exchange");
+
+  /* Pack our own multipoles in their slot of the gather buffer. */
+  int count = displs[engine_rank];
+  for (int i = 0; i < nr_cells; ++i)
+    if (s->cells_top[i].nodeID == engine_rank)
+      buffer[count++] = s->multipoles_top[i];
+
+  int err = MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, buffer, counts,
+                           displs, multipole_mpi_type, MPI_COMM_WORLD);
   if (err != MPI_SUCCESS)
-    mpi_error(err, "Failed to all-reduce the top-level multipoles.");
+    mpi_error(err, "Failed to gather the top-level multipoles.");
+
+  /* Scatter the foreign multipoles back to their cells. */
+  memcpy(cursor, displs, nr_nodes * sizeof(int));
+  for (int i = 0; i < nr_cells; ++i) {
+    const int nodeID = s->cells_top[i].nodeID;
+    if (nodeID != engine_rank) s->multipoles_top[i] = buffer[cursor[nodeID]];
+    cursor[nodeID]++;
+  }
+
+  swift_free("top_multipoles_buffer", buffer);
+  free(cursor);
+  free(displs);
+  free(counts);
 
 #ifdef SWIFT_DEBUG_CHECKS
   long long counter = 0;
@@ -727,6 +767,44 @@ void engine_exchange_proxy_multipoles(struct engine *e) {
 #endif
 }
 
+#ifdef WITH_MPI
+/**
+ * @brief (Re-)allocate a foreign particle buffer in a node-shared window.
+ *
+ * The windows are collective over the ranks of a node, so all of them
+ * re-allocate as soon as one of them needs more space. The content of the
+ * buffer is not preserved.
+ *
+ * @param label The label of the allocation.
+ * @param w The #mpi_node_window holding the buffer.
+ * @param buffer (return) The start of the local buffer.
+ * @param size The current size of the local buffer (in particles).
+ * @param count The number of particles the buffer must be able to hold.
+ * @param elem_size The size of one particle in bytes.
+ * @param alignment The alignment of the particle type.
+ *
+ * @return The new size of the local buffer (in particles).
+ */
+static size_t engine_allocate_node_shared_foreign(
+    const char *label, struct mpi_node_window *w, void **buffer,
+    const size_t size, const size_t count, const size_t elem_size,
+    const size_t alignment) {
+
+  int realloc = (count > size) || (w->base == NULL);
+  MPI_Allreduce(MPI_IN_PLACE, &realloc, 1, MPI_INT, MPI_MAX, mpi_node_comm);
+  if (!realloc) return size;
+
+  const size_t new_size =
+      (count > size) ? engine_foreign_alloc_margin * count : size;
+
+  mpi_node_window_free(label, w);
+  mpi_node_window_allocate(label, w, new_size * elem_size, alignment);
+  *buffer = w->base;
+
+  return new_size;
+}
+#endif
+
 /**
  * @brief Allocate memory for the foreign particles.
  *
@@ -738,6 +816,11 @@ void engine_exchange_proxy_multipoles(struct engine *e) {
  * When running FOF, we only need #gpart arrays so we restrict
  * the allocations to this particle type only
  *
+ * When the #part and #gpart exchanges between node-mates go through shared
+ * memory, these two buffers live in node-shared windows and this call becomes
+ * collective over the node. The offsets of the foreign cells in the buffers
+ * are then sent back to their owners.
+ *
  * @param e The #engine.
  * @param fof Are we allocating buffers just for FOF?
  */
@@ -796,7 +879,12 @@ void engine_allocate_foreign_particles(struct engine *e, const int fof) {
 
   /* Allocate space for the foreign particles we will receive */
   size_t old_size_parts_foreign = s->size_parts_foreign;
-  if (!fof && count_parts_in > s->size_parts_foreign) {
+  if (!fof && e->sched.mpi_node_shared_foreign) {
+    s->size_parts_foreign = engine_allocate_node_shared_foreign(
+        "parts_foreign", &s->parts_foreign_window, (void **)&s->parts_foreign,
+        s->size_parts_foreign, count_parts_in, sizeof(struct part),
+        part_align);
+  } else if (!fof && count_parts_in > s->size_parts_foreign) {
     if (s->parts_foreign != NULL) swift_free("parts_foreign", s->parts_foreign);
     s->size_parts_foreign = engine_foreign_alloc_margin * count_parts_in;
     if (swift_memalign("parts_foreign", (void **)&s->parts_foreign, part_align,
@@ -806,7 +894,12 @@ void engine_allocate_foreign_particles(struct engine *e, const int fof) {
 
   /* Allocate space for the foreign particles we will receive */
   size_t old_size_gparts_foreign = s->size_gparts_foreign;
-  if (count_gparts_in > s->size_gparts_foreign) {
+  if (e->sched.mpi_node_shared_foreign) {
+    s->size_gparts_foreign = engine_allocate_node_shared_foreign(
+        "gparts_foreign", &s->gparts_foreign_window,
+        (void **)&s->gparts_foreign, s->size_gparts_foreign, count_gparts_in,
+        sizeof(struct gpart), gpart_align);
+  } else if (count_gparts_in > s->size_gparts_foreign) {
     if (s->gparts_foreign != NULL)
       swift_free("gparts_foreign", s->gparts_foreign);
     s->size_gparts_foreign = engine_foreign_alloc_margin * count_gparts_in;
@@ -927,6 +1020,17 @@ void engine_allocate_foreign_particles(struct engine *e, const int fof) {
     message("Recursively linking foreign arrays took %.3f %s.",
             clocks_from_ticks(getticks() - tic), clocks_getunit());
 
+  /* Tell the node-mates where to write the particles they send us. */
+  if (e->sched.mpi_node_shared_foreign) {
+    tic = getticks();
+
+    proxy_node_offsets_exchange(e->proxies, nr_proxies, s);
+
+    if (e->verbose)
+      message("Exchanging node-shared foreign offsets took %.3f %s.",
+              clocks_from_ticks(getticks() - tic), clocks_getunit());
+  }
+
 #else
   error("SWIFT was not compiled with MPI support.");
 #endif
@@ -1404,14 +1508,32 @@ int engine_prepare(struct engine *e) {
   int drifted_all = 0;
   int repartitioned = 0;
 
+#ifdef WITH_MPI
+  /* At this point the rebuild flag has only been set from global quantities
+   * (the end-of-step reduction or triggers derived from it), so it is the
+   * same on all ranks. Only the unskip can set it locally. */
+  const int forcerebuild_global = e->forcerebuild;
+
+#ifdef SWIFT_DEBUG_CHECKS
+  {
+    int flags[2] = {!!e->forcerebuild, !e->forcerebuild};
+    MPI_Allreduce(MPI_IN_PLACE, flags, 2, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (flags[0] && flags[1])
+      error("Rebuild flag differs between ranks before the unskip.");
+  }
+#endif
+#endif
+
   /* Unskip active tasks and check for rebuild */
   if (!e->forcerebuild && !e->forcerepart && !e->restarting) engine_unskip(e);
 
   const ticks tic3 = getticks();
 
 #ifdef WITH_MPI
-  MPI_Allreduce(MPI_IN_PLACE, &e->forcerebuild, 1, MPI_INT, MPI_MAX,
-                MPI_COMM_WORLD);
+  /* No need to communicate if everyone already knows we are rebuilding. */
+  if (!forcerebuild_global)
+    MPI_Allreduce(MPI_IN_PLACE, &e->forcerebuild, 1, MPI_INT, MPI_MAX,
+                  MPI_COMM_WORLD);
 #endif
 
   if (e->verbose)
@@ -1776,6 +1898,12 @@ void engine_get_max_ids(struct engine *e) {
  * @brief Run the radiative transfer sub-cycles outside the
  * regular time-steps.
  *
+ * The sub-cycles only synchronise the threads of each rank. The number of
+ * particles updated in each of them is counted by the rt_collect_times
+ * tasks and only summed over the ranks, and reported, once all the
+ * sub-cycles of the step are done. Sub-cycles in which no local cell is
+ * active do not launch the threads at all.
+ *
  * @param e The #engine
  **/
 void engine_run_rt_sub_cycles(struct engine *e) {
@@ -1820,17 +1948,21 @@ void engine_run_rt_sub_cycles(struct engine *e) {
   if (e->policy & engine_policy_cosmology)
     error("Can't run RT subcycling with cosmology yet");
   const double dt_subcycle = rt_step_size * e->time_base;
-  double time = e->ti_current_subcycle * e->time_base + e->time_begin;
 
-  /* Collect and print info before it's gone */
+  /* The local number of updates of each cycle */
+  long long *rt_updates =
+      (long long *)malloc(nr_rt_cycles * sizeof(long long));
+  if (rt_updates == NULL)
+    error("Failed to allocate the RT sub-cycle update counts.");
+
+  /* Collect the info of the cycle done during the regular step before it's
+   * gone */
+  const integertime_t ti_first_cycle = e->ti_current_subcycle;
+  const timebin_t min_active_bin_first_cycle = e->min_active_bin_subcycle;
+  const timebin_t max_active_bin_first_cycle = e->max_active_bin_subcycle;
+  e->rt_updates = 0ll;
   engine_collect_end_of_sub_cycle(e);
-  if (e->nodeID == 0) {
-    printf(
-        "  %6d cycle   0 (during regular tasks) dt=%14e "
-        "min/max active bin=%2d/%2d rt_updates=%18lld\n",
-        e->step, dt_subcycle, e->min_active_bin_subcycle,
-        e->max_active_bin_subcycle, e->rt_updates);
-  }
+  rt_updates[0] = e->rt_updates;
 
   /* Take note of the (integer) time until which the radiative transfer
    * has been integrated so far. At the start of the sub-cycling, this
@@ -1847,27 +1979,14 @@ void engine_run_rt_sub_cycles(struct engine *e) {
     e->max_active_bin_subcycle = get_max_active_bin(e->ti_current_subcycle);
     e->min_active_bin_subcycle =
         get_min_active_bin(e->ti_current_subcycle, ti_subcycle_old);
-    /* think cosmology one day: needs adapting here */
-    if (e->policy & engine_policy_cosmology)
-      error("Can't run RT subcycling with cosmology yet");
-    time = e->ti_current_subcycle * e->time_base + e->time_begin;
 
-    /* Do the actual work now. */
+    /* Do the actual work now. The rt_collect_times tasks add the number of
+     * updated particles to e->rt_updates. */
     engine_unskip_rt_sub_cycle(e);
-    engine_launch(e, "cycles");
-
-    /* Collect number of updates and print */
-    engine_collect_end_of_sub_cycle(e);
+    if (e->sched.active_count > 0) engine_launch(e, "cycles");
 
+    rt_updates[sub_cycle] = e->rt_updates;
     rt_integration_end += rt_step_size;
-
-    if (e->nodeID == 0) {
-      printf(
-          "  %6d cycle %3d time=%13.6e     dt=%14e "
-          "min/max active bin=%2d/%2d rt_updates=%18lld\n",
-          e->step, sub_cycle, time, dt_subcycle, e->min_active_bin_subcycle,
-          e->max_active_bin_subcycle, e->rt_updates);
-    }
   }
 
   if (rt_integration_end != e->ti_end_min)
@@ -1877,7 +1996,43 @@ void engine_run_rt_sub_cycles(struct engine *e) {
         rt_integration_end, e->ti_end_min, e->ti_current, rt_step_size,
         nr_rt_cycles);
 
+  /* Aggregate the counts of all the cycles from the different nodes. */
+#ifdef WITH_MPI
+  if (e->nodeID == 0)
+    MPI_Reduce(MPI_IN_PLACE, rt_updates, nr_rt_cycles, MPI_LONG_LONG, MPI_SUM,
+               0, MPI_COMM_WORLD);
+  else
+    MPI_Reduce(rt_updates, NULL, nr_rt_cycles, MPI_LONG_LONG, MPI_SUM, 0,
+               MPI_COMM_WORLD);
+#endif
+
+  if (e->nodeID == 0) {
+
+    /* The first cycle was done during the regular step */
+    printf(
+        "  %6d cycle   0 (during regular tasks) dt=%14e "
+        "min/max active bin=%2d/%2d rt_updates=%18lld\n",
+        e->step, dt_subcycle, min_active_bin_first_cycle,
+        max_active_bin_first_cycle, rt_updates[0]);
+
+    integertime_t ti_cycle = ti_first_cycle;
+
+    for (int sub_cycle = 1; sub_cycle < nr_rt_cycles; ++sub_cycle) {
+      const integertime_t ti_cycle_old = ti_cycle;
+      ti_cycle = e->ti_current + sub_cycle * rt_step_size;
+      /* think cosmology one day: needs adapting here */
+      const double time = ti_cycle * e->time_base + e->time_begin;
+      printf(
+          "  %6d cycle %3d time=%13.6e     dt=%14e "
+          "min/max active bin=%2d/%2d rt_updates=%18lld\n",
+          e->step, sub_cycle, time, dt_subcycle,
+          get_min_active_bin(ti_cycle, ti_cycle_old),
+          get_max_active_bin(ti_cycle), rt_updates[sub_cycle]);
+    }
+  }
+
   /* Once we're done, clean up after ourselves */
+  free(rt_updates);
   e->rt_updates = 0ll;
 }
 
@@ -2593,6 +2748,23 @@ int engine_step(struct engine *e) {
   e->systime_last_step = end_systime - start_systime;
 #endif
 
+  /* Compute the local accumulated deadtime. */
+  const ticks deadticks = (e->nr_threads * e->sched.deadtime.waiting_ticks) -
+                          e->sched.deadtime.active_ticks;
+  e->local_deadtime = clocks_from_ticks(deadticks);
+
+  /* Collect the local information about the next time-step and start
+   * reducing it over all the ranks. */
+  engine_collect_end_of_step_start(e);
+
+#ifdef WITH_LIGHTCONE
+  /* Write out the lightcone particle buffers that have grown too large. This
+   * is purely local so can hide the latency of the reduction. */
+  lightcone_array_flush_particle_buffers(e->lightcone_array_properties,
+                                         e->cosmology, e->internal_units,
+                                         e->snapshot_units);
+#endif
+
 #ifdef SWIFT_HYDRO_DENSITY_CHECKS
   /* Run the brute-force hydro calculation for some parts */
   if (e->policy & engine_policy_hydro)
@@ -2643,13 +2815,8 @@ int engine_step(struct engine *e) {
   space_check_unskip_flags(e->s);
 #endif
 
-  /* Compute the local accumulated deadtime. */
-  const ticks deadticks = (e->nr_threads * e->sched.deadtime.waiting_ticks) -
-                          e->sched.deadtime.active_ticks;
-  e->local_deadtime = clocks_from_ticks(deadticks);
-
-  /* Collect information about the next time-step */
-  engine_collect_end_of_step(e, 1);
+  /* Complete the collection of the next time-step */
+  engine_collect_end_of_step_finish(e, 1);
   e->forcerebuild = e->collect_group1.forcerebuild;
   e->updates_since_rebuild += e->collect_group1.updated;
   e->g_updates_since_rebuild += e->collect_group1.g_updated;
@@ -3137,6 +3304,8 @@ void engine_init(
       parser_get_opt_param_int(params, "Snapshots:compression", 0);
   e->snapshot_distributed =
       parser_get_opt_param_int(params, "Snapshots:distributed", 0);
+  e->snapshot_distributed_per_node =
+      parser_get_opt_param_int(params, "Snapshots:distributed_per_node", 0);
   e->snapshot_lustre_OST_count =
       parser_get_opt_param_int(params, "Snapshots:lustre_OST_count", 0);
   e->snapshot_invoke_stf =
@@ -3183,6 +3352,8 @@ void engine_init(
   e->ti_next_stf = 0;
   e->ti_next_fof = 0;
   e->ti_next_ps = 0;
+  e->ti_next_stream = 0;
+  e->output_list_stream = NULL;
   e->verbose = verbose;
   e->wallclock_time = 0.f;
   e->physical_constants = physical_constants;
@@ -3300,6 +3471,16 @@ void engine_init(
         parser_get_opt_param_double(params, "PowerSpectrum:delta_time", -1.);
   }
 
+  /* Initialise the shared-memory stream output. */
+  if (parser_get_opt_param_int(params, "StreamOutput:enable", 0)) {
+    e->time_first_stream_output =
+        parser_get_opt_param_double(params, "StreamOutput:time_first", 0.);
+    e->a_first_stream_output = parser_get_opt_param_double(
+        params, "StreamOutput:scale_factor_first", 0.1);
+    e->delta_time_stream =
+        parser_get_opt_param_double(params, "StreamOutput:delta_time", -1.);
+  }
+
   /* Initialise FoF calls frequency. */
   if (e->policy & engine_policy_fof) {
 
@@ -3567,6 +3748,11 @@ void engine_recompute_displacement_constraint(struct engine *e) {
  * @param restart Was this a run that was restarted from check-point files?
  */
 void engine_clean(struct engine *e, const int fof, const int restart) {
+  /* Let any snapshot still being written reach the disk. */
+  snapshot_async_clean(&e->snapshot_async);
+  snapshot_keyframe_clean(&e->snapshot_keyframe);
+  stream_output_clean(&e->stream_output);
+
   /* Start by telling the runners to stop. */
   e->step_props = engine_step_prop_done;
   swift_barrier_wait(&e->run_barrier);
@@ -3581,6 +3767,7 @@ void engine_clean(struct engine *e, const int fof, const int restart) {
 #endif
     gravity_cache_clean(&e->runners[k].ci_gravity_cache);
     gravity_cache_clean(&e->runners[k].cj_gravity_cache);
+    ghost_ngb_lists_clean(&e->runners[k].ghost_ngbs);
   }
   swift_free("runners", e->runners);
   free(e->snapshot_units);
@@ -3590,6 +3777,7 @@ void engine_clean(struct engine *e, const int fof, const int restart) {
   output_list_clean(&e->output_list_stf);
   output_list_clean(&e->output_list_los);
   output_list_clean(&e->output_list_ps);
+  output_list_clean(&e->output_list_stream);
 
   output_options_clean(e->output_options);
 
@@ -3619,6 +3807,7 @@ void engine_clean(struct engine *e, const int fof, const int restart) {
   proxy_free_mpi_type();
   task_free_mpi_comms();
   mpicollect_free_MPI_type();
+  mpi_node_clean();
 #endif
 
   /* Close files */
@@ -3670,6 +3859,7 @@ void engine_clean(struct engine *e, const int fof, const int restart) {
     if (e->output_list_stf) free((void *)e->output_list_stf);
     if (e->output_list_los) free((void *)e->output_list_los);
     if (e->output_list_ps) free((void *)e->output_list_ps);
+    if (e->output_list_stream) free((void *)e->output_list_stream);
 #ifdef WITH_CSDS
     if (e->policy & engine_policy_csds) free((void *)e->csds);
 #endif
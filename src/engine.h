@@ -45,6 +45,9 @@
 #include "partition.h"
 #include "runner.h"
 #include "scheduler.h"
+#include "snapshot_async.h"
+#include "snapshot_keyframe.h"
+#include "stream_output.h"
 #include "space.h"
 #include "task.h"
 #include "tracers_triggers.h"
@@ -346,8 +349,14 @@ struct engine {
   float snapshot_subsample_fraction[swift_type_count];
   int snapshot_run_on_dump;
   int snapshot_distributed;
+  int snapshot_distributed_per_node;
   int snapshot_lustre_OST_count;
   int snapshot_compression;
+  struct snapshot_async snapshot_async;
+  struct snapshot_keyframe snapshot_keyframe;
+
+  /* Stream of outputs to shared memory */
+  struct stream_output stream_output;
   int snapshot_invoke_stf;
   int snapshot_invoke_fof;
   int snapshot_invoke_ps;
@@ -412,6 +421,17 @@ struct engine {
   /* Integer time of the next ps output */
   integertime_t ti_next_ps;
 
+  /* Shared-memory stream output information */
+  double a_first_stream_output;
+  double time_first_stream_output;
+  double delta_time_stream;
+
+  /* Output_List for the shared-memory stream */
+  struct output_list *output_list_stream;
+
+  /* Integer time of the next stream output */
+  integertime_t ti_next_stream;
+
   /* Statistics information */
   double a_first_statistics;
   double time_first_statistics;
@@ -680,6 +700,7 @@ void engine_compute_next_fof_time(struct engine *e);
 void engine_compute_next_statistics_time(struct engine *e);
 void engine_compute_next_los_time(struct engine *e);
 void engine_compute_next_ps_time(struct engine *e);
+void engine_compute_next_stream_time(struct engine *e);
 void engine_recompute_displacement_constraint(struct engine *e);
 void engine_unskip(struct engine *e);
 void engine_unskip_rt_sub_cycle(struct engine *e);
@@ -691,9 +712,12 @@ void engine_print_stats(struct engine *e);
 void engine_io(struct engine *e);
 void engine_io_check_snapshot_triggers(struct engine *e);
 void engine_collect_end_of_step(struct engine *e, int apply);
+void engine_collect_end_of_step_start(struct engine *e);
+void engine_collect_end_of_step_finish(struct engine *e, int apply);
 void engine_collect_end_of_sub_cycle(struct engine *e);
 void engine_dump_snapshot(struct engine *e);
 void engine_run_on_dump(struct engine *e);
+void engine_snapshot_async_complete(struct engine *e);
 void engine_init_output_lists(struct engine *e, struct swift_params *params,
                               const struct output_options *output_options);
 void engine_init(
@@ -209,6 +209,28 @@ void engine_collect_end_of_step_mapper(void *map_data, int num_elements,
  */
 void engine_collect_end_of_step(struct engine *e, int apply) {
 
+  engine_collect_end_of_step_start(e);
+  engine_collect_end_of_step_finish(e, apply);
+}
+
+#if defined(WITH_MPI) && defined(SWIFT_DEBUG_CHECKS)
+/*! Local (pre-reduction) values of the last collection, for checking. */
+static struct collectgroup1 engine_collect_local_group1;
+#endif
+
+/**
+ * @brief Collects the local next time-step and rebuild flag and starts
+ * their reduction across all nodes.
+ *
+ * The results only become available after a call to
+ * engine_collect_end_of_step_finish(). Work that does not depend on the
+ * global values can be done in between to hide the latency of the
+ * reduction.
+ *
+ * @param e The #engine.
+ */
+void engine_collect_end_of_step_start(struct engine *e) {
+
   const ticks tic = getticks();
   struct space *s = e->s;
   struct end_of_step_data data;
@@ -269,18 +291,43 @@ void engine_collect_end_of_step(struct engine *e, int apply) {
       data.sfh, data.runtime, data.flush_lightcone_maps, data.deadtime,
       data.csds_file_size_gb);
 
-/* Aggregate collective data from the different nodes for this step. */
-#ifdef WITH_MPI
-  collectgroup1_reduce(&e->collect_group1);
+#if defined(WITH_MPI) && defined(SWIFT_DEBUG_CHECKS)
+  engine_collect_local_group1 = e->collect_group1;
+#endif
+
+  /* Start aggregating the collective data from the different nodes. */
+  collectgroup1_reduce_start(&e->collect_group1);
+
+  if (e->verbose)
+    message("took %.3f %s.", clocks_from_ticks(getticks() - tic),
+            clocks_getunit());
+}
+
+/**
+ * @brief Completes the collection started by
+ * engine_collect_end_of_step_start().
+ *
+ * @param e The #engine.
+ * @param apply whether to apply the results to the engine or just keep in the
+ *              group1 struct.
+ */
+void engine_collect_end_of_step_finish(struct engine *e, int apply) {
+
+  const ticks tic = getticks();
 
-#ifdef SWIFT_DEBUG_CHECKS
+  /* Aggregate collective data from the different nodes for this step. */
+  collectgroup1_reduce_finish(&e->collect_group1);
+
+#if defined(WITH_MPI) && defined(SWIFT_DEBUG_CHECKS)
   {
+    const struct collectgroup1 *data = &engine_collect_local_group1;
+
     /* Check the above using the original MPI calls. */
     integertime_t in_i[2], out_i[2];
     in_i[0] = 0;
     in_i[1] = 0;
-    out_i[0] = data.ti_hydro_end_min;
-    out_i[1] = data.ti_gravity_end_min;
+    out_i[0] = data->ti_hydro_end_min;
+    out_i[1] = data->ti_gravity_end_min;
     if (MPI_Allreduce(out_i, in_i, 2, MPI_LONG_LONG_INT, MPI_MIN,
                       MPI_COMM_WORLD) != MPI_SUCCESS)
       error("Failed to aggregate ti_end_min.");
@@ -292,10 +339,10 @@ void engine_collect_end_of_step(struct engine *e, int apply) {
             in_i[1], e->collect_group1.ti_gravity_end_min);
 
     long long in_ll[4], out_ll[4];
-    out_ll[0] = data.updated;
-    out_ll[1] = data.g_updated;
-    out_ll[2] = data.s_updated;
-    out_ll[3] = data.b_updated;
+    out_ll[0] = data->updated;
+    out_ll[1] = data->g_updated;
+    out_ll[2] = data->s_updated;
+    out_ll[3] = data->b_updated;
     if (MPI_Allreduce(out_ll, in_ll, 4, MPI_LONG_LONG_INT, MPI_SUM,
                       MPI_COMM_WORLD) != MPI_SUCCESS)
       error("Failed to aggregate particle counts.");
@@ -312,10 +359,10 @@ void engine_collect_end_of_step(struct engine *e, int apply) {
       error("Failed to get same b_updated, is %lld, should be %lld", in_ll[3],
             e->collect_group1.b_updated);
 
-    out_ll[0] = data.inhibited;
-    out_ll[1] = data.g_inhibited;
-    out_ll[2] = data.s_inhibited;
-    out_ll[3] = data.b_inhibited;
+    out_ll[0] = data->inhibited;
+    out_ll[1] = data->g_inhibited;
+    out_ll[2] = data->s_inhibited;
+    out_ll[3] = data->b_inhibited;
     if (MPI_Allreduce(out_ll, in_ll, 4, MPI_LONG_LONG_INT, MPI_SUM,
                       MPI_COMM_WORLD) != MPI_SUCCESS)
       error("Failed to aggregate particle counts.");
@@ -333,7 +380,7 @@ void engine_collect_end_of_step(struct engine *e, int apply) {
             e->collect_group1.b_inhibited);
 
     int buff = 0;
-    if (MPI_Allreduce(&e->forcerebuild, &buff, 1, MPI_INT, MPI_MAX,
+    if (MPI_Allreduce(&data->forcerebuild, &buff, 1, MPI_INT, MPI_MAX,
                       MPI_COMM_WORLD) != MPI_SUCCESS)
       error("Failed to aggregate the rebuild flag across nodes.");
     if (!!buff != !!e->collect_group1.forcerebuild)
@@ -342,7 +389,6 @@ void engine_collect_end_of_step(struct engine *e, int apply) {
           "should be %d",
           buff, e->collect_group1.forcerebuild);
   }
-#endif
 #endif
 
   /* Apply to the engine, if requested. */
@@ -393,6 +439,10 @@ void engine_collect_end_of_sub_cycle_mapper(void *map_data, int num_elements,
  * This function does not collect any data relevant to the
  * time-steps or time integration.
  *
+ * Only the local counts are collected. They are summed over the ranks
+ * once all the sub-cycles of the step are done, see
+ * engine_run_rt_sub_cycles().
+ *
  * @param e The #engine.
  */
 void engine_collect_end_of_sub_cycle(struct engine *e) {
@@ -405,16 +455,6 @@ void engine_collect_end_of_sub_cycle(struct engine *e) {
                  s->local_cells_top, s->nr_local_cells, sizeof(int),
                  threadpool_auto_chunk_size, e);
 
-  /* Aggregate collective data from the different nodes for this step. */
-#ifdef WITH_MPI
-  long long rt_updates_tot = 0ll;
-  int test = MPI_Reduce(&e->rt_updates, &rt_updates_tot, 1, MPI_LONG_LONG,
-                        MPI_SUM, 0, MPI_COMM_WORLD);
-  if (test != MPI_SUCCESS) error("MPI reduce failed");
-  /* Overwrite only on rank 0. */
-  if (e->nodeID == 0) e->rt_updates = rt_updates_tot;
-#endif
-
   if (e->verbose)
     message("took %.3f %s.", clocks_from_ticks(getticks() - tic),
             clocks_getunit());
@@ -37,6 +37,7 @@
 
 /* Local headers. */
 #include "fof.h"
+#include "mpi_node.h"
 #include "mpiuse.h"
 #include "part.h"
 #include "pressure_floor.h"
@@ -238,6 +239,49 @@ void engine_config(int restart, int fof, struct engine *e,
     parser_get_param_string(params, "Restarts:resubmit_command",
                             e->resubmit_command);
 
+  /* Asynchronous snapshots (also re-initialised when restarting as no write
+   * can be in progress). */
+  int snapshot_async =
+      parser_get_opt_param_int(params, "Snapshots:asynchronous", 0);
+#ifdef WITH_MPI
+  if (snapshot_async && !e->snapshot_distributed) {
+    if (nodeID == 0)
+      message(
+          "WARNING: Asynchronous snapshots need Snapshots:distributed, "
+          "writing them synchronously.");
+    snapshot_async = 0;
+  }
+#endif
+  snapshot_async_init(&e->snapshot_async, snapshot_async);
+
+  /* Keyframe-plus-delta snapshots. The keyframe is not part of the restart
+   * files, so the first snapshot after a restart is always a keyframe. */
+  int keyframe_interval =
+      parser_get_opt_param_int(params, "Snapshots:keyframe_interval", 0);
+  if (keyframe_interval < 0)
+    error("Snapshots:keyframe_interval must be positive or zero.");
+#ifdef WITH_MPI
+  if (keyframe_interval && !e->snapshot_distributed) {
+    if (nodeID == 0)
+      message(
+          "WARNING: Keyframe snapshots need Snapshots:distributed, writing "
+          "full snapshots only.");
+    keyframe_interval = 0;
+  }
+  if (keyframe_interval && e->snapshot_distributed_per_node) {
+    if (nodeID == 0)
+      message(
+          "WARNING: Keyframe snapshots need one file per rank, writing full "
+          "snapshots only.");
+    keyframe_interval = 0;
+  }
+#endif
+  snapshot_keyframe_init(&e->snapshot_keyframe, keyframe_interval);
+
+  /* Stream of outputs to shared memory (the segment is re-created when
+   * restarting). */
+  stream_output_init(&e->stream_output, params, nodeID, nr_nodes, verbose);
+
   /* Get the number of queues */
   int nr_queues =
       parser_get_opt_param_int(params, "Scheduler:nr_queues", e->nr_threads);
@@ -732,6 +776,13 @@ void engine_config(int restart, int fof, struct engine *e,
       engine_compute_next_stf_time(e);
     }
 
+    /* Find the time of the first stream output */
+    if (e->stream_output.enabled) {
+      if (e->delta_time_stream == -1. && !e->output_list_stream)
+        error("A value for `StreamOutput:delta_time` must be specified");
+      engine_compute_next_stream_time(e);
+    }
+
     /* Find the time of the first stf output */
     if (e->policy & engine_policy_fof &&
         e->fof_properties->seed_black_holes_enabled) {
@@ -785,11 +836,19 @@ void engine_config(int restart, int fof, struct engine *e,
 
 /* Construct types for MPI communications */
 #ifdef WITH_MPI
+
+  /* Do the ranks running on the same node exchange their particles through
+   * node-shared foreign buffers rather than MPI messages? Off by default. Can
+   * be changed on restart. */
+  const int mpi_node_shared_foreign =
+      parser_get_opt_param_int(params, "Scheduler:mpi_node_shared_foreign", 0);
+
+  mpi_node_init();
   part_create_mpi_types();
   multipole_create_mpi_types();
   stats_create_mpi_type();
   proxy_create_mpi_type();
-  task_create_mpi_comms();
+  task_create_mpi_comms(mpi_node_shared_foreign);
 #ifdef WITH_FOF
   fof_create_mpi_types();
 #endif /* WITH_FOF */
@@ -846,6 +905,17 @@ void engine_config(int restart, int fof, struct engine *e,
   e->sched.mpi_message_limit =
       parser_get_opt_param_int(params, "Scheduler:mpi_message_limit", 4) * 1024;
 
+#ifdef WITH_MPI
+  e->sched.mpi_node_shared_foreign = mpi_node_shared_foreign;
+  if (e->nodeID == 0 && mpi_node_shared_foreign)
+    message(
+        "Ranks on the same node exchange particles through shared memory "
+        "(%d ranks on %d nodes).",
+        nr_nodes, mpi_node_count_nodes());
+#else
+  e->sched.mpi_node_shared_foreign = 0;
+#endif
+
   if (restart) {
 
     /* Overwrite the constants for the scheduler */
@@ -953,6 +1023,7 @@ void engine_config(int restart, int fof, struct engine *e,
     cache_init(&e->runners[k].ci_cache, CACHE_SIZE);
     cache_init(&e->runners[k].cj_cache, CACHE_SIZE);
 #endif
+    ghost_ngb_lists_init(&e->runners[k].ghost_ngbs);
 
     if (verbose) {
       if (with_aff)
@@ -274,6 +274,9 @@ void engine_dump_snapshot(struct engine *e) {
   struct clocks_time time1, time2;
   clocks_gettime(&time1);
 
+  /* Make sure the previous snapshot has reached the disk. */
+  engine_snapshot_async_complete(e);
+
 #ifdef SWIFT_DEBUG_CHECKS
   /* Check that all cells have been drifted to the current time.
    * That can include cells that have not
@@ -320,6 +323,10 @@ void engine_dump_snapshot(struct engine *e) {
             e->time_base, with_cosmology, e->cosmology);
   }
 
+  /* Flag the snapshot as started on all ranks, whether they write a file
+   * or not. */
+  if (e->snapshot_async.enabled) e->snapshot_async.pending = 1;
+
 /* Dump (depending on the chosen strategy) ... */
 #if defined(HAVE_HDF5)
 #if defined(WITH_MPI)
@@ -367,12 +374,40 @@ void engine_dump_snapshot(struct engine *e) {
     message("writing particle properties took %.3f %s.",
             (float)clocks_diff(&time1, &time2), clocks_getunit());
 
-  /* Run the post-dump command if required */
-  if (e->nodeID == 0) {
+  /* Run the post-dump command if required. For asynchronous snapshots, this
+   * is done once the files are on disk. */
+  if (e->nodeID == 0 && !e->snapshot_async.enabled) {
     engine_run_on_dump(e);
   }
 }
 
+/**
+ * @brief Wait for the snapshot being written in the background, if any, to
+ * be on disk on all ranks and run the post-dump command.
+ *
+ * Collective over all ranks when snapshots are written asynchronously.
+ *
+ * @param e The #engine.
+ */
+void engine_snapshot_async_complete(struct engine *e) {
+
+  /* Nothing to do if no snapshot was started. This flag is the same on all
+   * ranks, whether they write a file or not. */
+  if (!e->snapshot_async.pending) return;
+
+  snapshot_async_wait(&e->snapshot_async, e->verbose);
+
+#ifdef WITH_MPI
+  /* The files are written by the ranks, wait for all of them. */
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif
+
+  e->snapshot_async.pending = 0;
+
+  /* Run the post-dump command if required */
+  if (e->nodeID == 0) engine_run_on_dump(e);
+}
+
 /**
  * @brief Runs the snapshot_dump_command if relevant. Note that we
  *        perform no error checking on this command, and assume
@@ -422,6 +457,7 @@ void engine_io(struct engine *e) {
     output_ps,
     output_stf,
     output_los,
+    output_stream,
   };
 
   /* What kind of output do we want? And at which time ?
@@ -475,6 +511,16 @@ void engine_io(struct engine *e) {
     }
   }
 
+  /* Do we want to stream the particles? */
+  if (e->stream_output.enabled) {
+    if (e->ti_end_min > e->ti_next_stream && e->ti_next_stream > 0) {
+      if (e->ti_next_stream < ti_output) {
+        ti_output = e->ti_next_stream;
+        type = output_stream;
+      }
+    }
+  }
+
   /* Store information before attempting extra dump-related drifts */
   const integertime_t ti_current = e->ti_current;
   const timebin_t max_active_bin = e->max_active_bin;
@@ -624,6 +670,17 @@ void engine_io(struct engine *e) {
 
         break;
 
+      case output_stream:
+
+        /* Publish the particles (or drop the output if the consumer is
+         * not keeping up) */
+        stream_output_publish(&e->stream_output, e);
+
+        /* Move on */
+        engine_compute_next_stream_time(e);
+
+        break;
+
       default:
         error("Invalid dump type");
     }
@@ -678,6 +735,16 @@ void engine_io(struct engine *e) {
       }
     }
 
+    /* Stream the particles ? */
+    if (e->stream_output.enabled) {
+      if (e->ti_end_min > e->ti_next_stream && e->ti_next_stream > 0) {
+        if (e->ti_next_stream < ti_output) {
+          ti_output = e->ti_next_stream;
+          type = output_stream;
+        }
+      }
+    }
+
   } /* While loop over output types */
 
   /* Restore the information we stored */
@@ -1141,6 +1208,75 @@ void engine_compute_next_ps_time(struct engine *e) {
   }
 }
 
+/**
+ * @brief Computes the next time (on the time line) for a stream output
+ *
+ * @param e The #engine.
+ */
+void engine_compute_next_stream_time(struct engine *e) {
+  /* Do output_list file case */
+  if (e->output_list_stream) {
+    output_list_read_next_time(e->output_list_stream, e, "stream output",
+                               &e->ti_next_stream);
+    return;
+  }
+
+  /* Find upper-bound on last output */
+  double time_end;
+  if (e->policy & engine_policy_cosmology)
+    time_end = e->cosmology->a_end * e->delta_time_stream;
+  else
+    time_end = e->time_end + e->delta_time_stream;
+
+  /* Find next stream output above current time */
+  double time;
+  if (e->policy & engine_policy_cosmology)
+    time = e->a_first_stream_output;
+  else
+    time = e->time_first_stream_output;
+
+  int found_stream_time = 0;
+  while (time < time_end) {
+
+    /* Output time on the integer timeline */
+    if (e->policy & engine_policy_cosmology)
+      e->ti_next_stream = log(time / e->cosmology->a_begin) / e->time_base;
+    else
+      e->ti_next_stream = (time - e->time_begin) / e->time_base;
+
+    /* Found it? */
+    if (e->ti_next_stream > e->ti_current) {
+      found_stream_time = 1;
+      break;
+    }
+
+    if (e->policy & engine_policy_cosmology)
+      time *= e->delta_time_stream;
+    else
+      time += e->delta_time_stream;
+  }
+
+  /* Deal with last stream output */
+  if (!found_stream_time) {
+    e->ti_next_stream = -1;
+    if (e->verbose) message("No further stream output time.");
+  } else {
+
+    /* Be nice, talk... */
+    if (e->policy & engine_policy_cosmology) {
+      const double next_stream_time =
+          exp(e->ti_next_stream * e->time_base) * e->cosmology->a_begin;
+      if (e->verbose)
+        message("Next output time for stream set to a=%e.", next_stream_time);
+    } else {
+      const double next_stream_time =
+          e->ti_next_stream * e->time_base + e->time_begin;
+      if (e->verbose)
+        message("Next output time for stream set to t=%e.", next_stream_time);
+    }
+  }
+}
+
 /**
  * @brief Initialize all the output_list required by the engine
  *
@@ -1225,6 +1361,25 @@ void engine_init_output_lists(struct engine *e, struct swift_params *params,
     }
   }
 
+  /* Deal with the shared-memory stream */
+  e->output_list_stream = NULL;
+  if (e->stream_output.enabled) {
+
+    output_list_init(&e->output_list_stream, e, "StreamOutput",
+                     &e->delta_time_stream);
+
+    if (e->output_list_stream) {
+      engine_compute_next_stream_time(e);
+
+      if (e->policy & engine_policy_cosmology)
+        e->a_first_stream_output =
+            exp(e->ti_next_stream * e->time_base) * e->cosmology->a_begin;
+      else
+        e->time_first_stream_output =
+            e->ti_next_stream * e->time_base + e->time_begin;
+    }
+  }
+
   /* Deal with power-spectra */
   if (e->policy & engine_policy_power_spectra) {
 
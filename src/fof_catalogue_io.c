@@ -156,6 +156,11 @@ void write_fof_hdf5_array(
   /* Copy the particle data to the temporary buffer */
   io_copy_temp_buffer(temp, e, props, N, internal_units, snapshot_units);
 
+  /* Round the values if an error-bounded scheme was chosen */
+  if (compression_scheme_is_error_bounded(lossy_compression))
+    io_quantise_buffer((struct threadpool*)&e->threadpool, temp, num_elements,
+                       props.type, lossy_compression, props.name);
+
   /* Create data space */
   hid_t h_space;
   if (N > 0)
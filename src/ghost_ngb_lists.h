@@ -0,0 +1,199 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2024 The SWIFT team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_GHOST_NGB_LISTS_H
+#define SWIFT_GHOST_NGB_LISTS_H
+
+/* Config parameters. */
+#include <config.h>
+
+/* Some standard headers. */
+#include <stdlib.h>
+#include <string.h>
+
+/* Local headers */
+#include "error.h"
+#include "inline.h"
+#include "part.h"
+
+/*! Ratio of the smoothing length a list is built for to the current one */
+#define ghost_ngb_lists_h_factor 1.2f
+
+/**
+ * @brief A candidate neighbour of a particle iterating on its smoothing
+ * length in the ghost.
+ *
+ * The separation is stored exactly as the subset density loops compute it,
+ * such that the interactions done from the list are identical to the ones
+ * the loops would do.
+ */
+struct ghost_ngb {
+
+  /*! The neighbour */
+  struct part *pj;
+
+  /*! Separation vector between the particle and its neighbour */
+  float dx[3];
+
+  /*! Squared separation */
+  float r2;
+
+  /*! Index of the particle in the list the loops were called with */
+  int i;
+};
+
+/**
+ * @brief Per-runner store of the neighbour lists of the particles of a cell
+ * iterating on their smoothing length in the ghost.
+ *
+ * While #collecting is set, the subset density loops record the neighbours
+ * they find in #found instead of interacting with them. The records are
+ * then sorted by particle into #ngbs where each particle's list is a
+ * contiguous range, in the order the loops found the neighbours.
+ */
+struct ghost_ngb_lists {
+
+  /*! Are the subset density loops recording neighbours? */
+  int collecting;
+
+  /*! Neighbours recorded since the collection started */
+  struct ghost_ngb *found;
+
+  /*! Number of recorded neighbours and size of #found */
+  size_t found_count, found_size;
+
+  /*! The lists of the particles of the current cell */
+  struct ghost_ngb *ngbs;
+
+  /*! Number of entries used in #ngbs and size of #ngbs */
+  size_t count, size;
+};
+
+/**
+ * @brief Initialise an empty #ghost_ngb_lists.
+ *
+ * @param l The #ghost_ngb_lists.
+ */
+__attribute__((always_inline)) INLINE static void ghost_ngb_lists_init(
+    struct ghost_ngb_lists *l) {
+  bzero(l, sizeof(struct ghost_ngb_lists));
+}
+
+/**
+ * @brief Free the memory of a #ghost_ngb_lists.
+ *
+ * @param l The #ghost_ngb_lists.
+ */
+__attribute__((always_inline)) INLINE static void ghost_ngb_lists_clean(
+    struct ghost_ngb_lists *l) {
+  free(l->found);
+  free(l->ngbs);
+  ghost_ngb_lists_init(l);
+}
+
+/**
+ * @brief Drop the lists built for the previous cell.
+ *
+ * @param l The #ghost_ngb_lists.
+ */
+__attribute__((always_inline)) INLINE static void ghost_ngb_lists_reset(
+    struct ghost_ngb_lists *l) {
+  l->count = 0;
+}
+
+/**
+ * @brief Record a neighbour found by the subset density loops.
+ *
+ * @param l The #ghost_ngb_lists.
+ * @param i Index of the particle in the list the loops were called with.
+ * @param pj The neighbour.
+ * @param dx The separation vector.
+ * @param r2 The squared separation.
+ */
+__attribute__((always_inline)) INLINE static void ghost_ngb_lists_record(
+    struct ghost_ngb_lists *l, const int i, struct part *pj, const float *dx,
+    const float r2) {
+
+  if (l->found_count == l->found_size) {
+    l->found_size = l->found_size > 0 ? 2 * l->found_size : 1024;
+    l->found = (struct ghost_ngb *)realloc(
+        l->found, l->found_size * sizeof(struct ghost_ngb));
+    if (l->found == NULL) error("Failed to grow the ghost neighbour records.");
+  }
+
+  struct ghost_ngb *ngb = &l->found[l->found_count++];
+  ngb->pj = pj;
+  ngb->dx[0] = dx[0];
+  ngb->dx[1] = dx[1];
+  ngb->dx[2] = dx[2];
+  ngb->r2 = r2;
+  ngb->i = i;
+}
+
+/**
+ * @brief Start recording the neighbours found by the subset density loops.
+ *
+ * @param l The #ghost_ngb_lists.
+ */
+__attribute__((always_inline)) INLINE static void ghost_ngb_lists_start(
+    struct ghost_ngb_lists *l) {
+  l->collecting = 1;
+  l->found_count = 0;
+}
+
+/**
+ * @brief Stop recording and turn the records into one list per particle.
+ *
+ * The lists are appended to the ones already built for this cell. The
+ * records of the particle with index j in the list the loops were called
+ * with end up in ngbs[first[ind[j]]] to ngbs[first[ind[j]] + num[ind[j]]].
+ *
+ * @param l The #ghost_ngb_lists.
+ * @param ind Position of each particle of the loops in @c first and @c num.
+ * @param count Number of particles the loops were called with.
+ * @param first (return) Start of the list of each particle.
+ * @param num (return) Length of the list of each particle.
+ */
+__attribute__((always_inline)) INLINE static void ghost_ngb_lists_end(
+    struct ghost_ngb_lists *l, const int *ind, const int count,
+    size_t *first, int *num) {
+
+  l->collecting = 0;
+
+  if (l->count + l->found_count > l->size) {
+    l->size = 2 * (l->count + l->found_count);
+    l->ngbs = (struct ghost_ngb *)realloc(
+        l->ngbs, l->size * sizeof(struct ghost_ngb));
+    if (l->ngbs == NULL) error("Failed to grow the ghost neighbour lists.");
+  }
+
+  /* Count the neighbours of each particle and place the lists */
+  for (int j = 0; j < count; j++) num[ind[j]] = 0;
+  for (size_t k = 0; k < l->found_count; k++) num[ind[l->found[k].i]]++;
+  for (int j = 0; j < count; j++) {
+    first[ind[j]] = l->count;
+    l->count += num[ind[j]];
+  }
+
+  /* Fill them, keeping the order in which the neighbours were found */
+  for (size_t k = 0; k < l->found_count; k++)
+    l->ngbs[first[ind[l->found[k].i]]++] = l->found[k];
+  for (int j = 0; j < count; j++) first[ind[j]] -= num[ind[j]];
+}
+
+#endif /* SWIFT_GHOST_NGB_LISTS_H */
@@ -67,6 +67,13 @@ struct gpart {
   /*! Type of the #gpart (DM, gas, star, ...) */
   enum part_type type;
 
+#ifdef SWIFT_NEUTRINO_CACHE
+  /*! Background phase-space density at the initial momentum of a neutrino
+   * particle, used for its delta-f weight (neutrinos only). Exact, as
+   * fermi_dirac_density() is computed in single precision. */
+  float neutrino_f_initial;
+#endif
+
 #ifdef HAVE_VELOCIRAPTOR_ORPHANS
   /* Flag to indicate this particle should be output at subsequent VR
      invocations because it was the most bound in a group at some point */
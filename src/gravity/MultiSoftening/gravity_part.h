@@ -69,6 +69,13 @@ struct gpart {
   /*! Type of the #gpart (DM, gas, star, ...) */
   enum part_type type;
 
+#ifdef SWIFT_NEUTRINO_CACHE
+  /*! Background phase-space density at the initial momentum of a neutrino
+   * particle, used for its delta-f weight (neutrinos only). Exact, as
+   * fermi_dirac_density() is computed in single precision. */
+  float neutrino_f_initial;
+#endif
+
 #ifdef WITH_CSDS
   /* Additional data for the particle csds */
   struct csds_part_data csds_data;
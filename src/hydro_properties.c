@@ -101,6 +101,10 @@ void hydro_props_init(struct hydro_props *p,
   if (p->max_smoothing_iterations <= 10)
     error("The number of smoothing length iterations should be > 10");
 
+  /* Neighbour lists for the ghost iterations */
+  p->use_ghost_neighbour_lists =
+      parser_get_opt_param_int(params, "SPH:use_ghost_neighbour_lists", 0);
+
   /* ------ Neighbour number definition ------------ */
 
   /* Non-conventional neighbour number definition */
@@ -252,6 +256,9 @@ void hydro_props_print(const struct hydro_props *p) {
     message("Maximal iterations in ghost task set to %d (default is %d)",
             p->max_smoothing_iterations, hydro_props_default_max_iterations);
 
+  if (p->use_ghost_neighbour_lists)
+    message("Re-using neighbour lists across the ghost iterations");
+
   if (p->initial_temperature != hydro_props_default_init_temp)
     message("Initial gas temperature set to %f", p->initial_temperature);
 
@@ -360,6 +367,7 @@ void hydro_props_init_no_hydro(struct hydro_props *p) {
   p->h_min = 0.f;
   p->h_min_ratio = hydro_props_default_h_min_ratio;
   p->max_smoothing_iterations = hydro_props_default_max_iterations;
+  p->use_ghost_neighbour_lists = 0;
   p->CFL_condition = 0.1;
   p->log_max_h_change = logf(powf(1.4, hydro_dimension_inv));
 
@@ -73,6 +73,9 @@ struct hydro_props {
   /*! Maximal number of iterations to converge h */
   int max_smoothing_iterations;
 
+  /*! Are we re-using neighbour lists across the ghost iterations? */
+  int use_ghost_neighbour_lists;
+
   /* ------ Neighbour number definition ------------ */
 
   /*! Are we using the mass-weighted definition of neighbour number? */
@@ -25,11 +25,19 @@
 
 /* Local includes. */
 #include "error.h"
+#include "memuse.h"
+#include "threadpool.h"
 
 /* Some standard headers. */
+#include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef IO_THREADED_DEFLATE
+#include <zlib.h>
+#endif
+
 /**
  * @brief Names of the compression levels, used in the select_output.yml
  *        parameter file.
@@ -38,7 +46,10 @@ const char* lossy_compression_schemes_names[compression_level_count] = {
     "off",        "on",          "DScale1",   "DScale2",    "DScale3",
     "DScale4",    "DScale5",     "DScale6",   "DMantissa9", "DMantissa13",
     "FMantissa9", "FMantissa13", "HalfFloat", "BFloat16",   "Nbit32",
-    "Nbit36",     "Nbit40",      "Nbit44",    "Nbit48",     "Nbit56"};
+    "Nbit36",     "Nbit40",      "Nbit44",    "Nbit48",     "Nbit56",
+    "AbsErr1",    "AbsErr2",     "AbsErr3",   "AbsErr4",    "AbsErr5",
+    "AbsErr6",    "RelErr2",     "RelErr3",   "RelErr4",    "RelErr5",
+    "RelErr6"};
 
 /**
  * @brief Returns the lossy compression scheme given its name
@@ -59,6 +70,172 @@ enum lossy_compression_schemes compression_scheme_from_name(const char* name) {
   return (enum lossy_compression_schemes)0;
 }
 
+/**
+ * @brief Is this one of the error-bounded schemes?
+ *
+ * These are applied by SWIFT to the data before they are written, rather than
+ * by HDF5 filters.
+ *
+ * @param comp The #lossy_compression_schemes.
+ */
+int compression_scheme_is_error_bounded(
+    const enum lossy_compression_schemes comp) {
+  return comp >= compression_write_abs_err_1 &&
+         comp <= compression_write_rel_err_6;
+}
+
+/**
+ * @brief Spacing of the grid the values are rounded to by an absolute
+ * error-bounded scheme.
+ *
+ * This is the largest power of two not exceeding twice the tolerance.
+ *
+ * @param comp The #lossy_compression_schemes (one of the AbsErr ones).
+ */
+double compression_scheme_abs_err_step(
+    const enum lossy_compression_schemes comp) {
+
+  if (comp < compression_write_abs_err_1 || comp > compression_write_abs_err_6)
+    error("Scheme '%s' does not have an absolute error bound.",
+          lossy_compression_schemes_names[comp]);
+
+  const int n = comp - compression_write_abs_err_1 + 1;
+  return ldexp(1., ilogb(2. * pow(10., -n)));
+}
+
+/**
+ * @brief Parameters of the rounding done by #io_quantise_mapper.
+ */
+struct io_quantise_data {
+
+  /*! Are we rounding to a relative (rather than absolute) error? */
+  int relative;
+
+  /*! Absolute error: spacing of the grid the values are rounded to. */
+  double step;
+
+  /*! Relative error: number of mantissa bits dropped. */
+  int drop_bits;
+
+  /*! Are the values double precision? */
+  int is_double;
+};
+
+/**
+ * @brief Threadpool mapper rounding values to a given error bound.
+ *
+ * Absolute errors are obtained by rounding to the nearest multiple of a power
+ * of two, relative ones by rounding the mantissa to fewer bits (round half to
+ * even). Either way the result is exactly representable and its low mantissa
+ * bits are zero, which the shuffle and deflate filters then compress well.
+ * Inf and NaN are left untouched.
+ */
+static void io_quantise_mapper(void* map_data, int num_elements,
+                               void* extra_data) {
+
+  const struct io_quantise_data* q = (const struct io_quantise_data*)extra_data;
+
+  if (q->relative && !q->is_double) {
+
+    uint32_t* v = (uint32_t*)map_data;
+    const uint32_t half = (uint32_t)1 << (q->drop_bits - 1);
+    const uint32_t mask = ~(((uint32_t)1 << q->drop_bits) - 1);
+    const uint32_t exp_mask = 0x7f800000u;
+
+    for (int i = 0; i < num_elements; i++) {
+      if ((v[i] & exp_mask) == exp_mask) continue;
+      const uint32_t r =
+          (v[i] + half - 1 + ((v[i] >> q->drop_bits) & 1)) & mask;
+      /* Don't round the largest values up to Inf */
+      v[i] = ((r & exp_mask) == exp_mask) ? (v[i] & mask) : r;
+    }
+
+  } else if (q->relative) {
+
+    uint64_t* v = (uint64_t*)map_data;
+    const uint64_t half = (uint64_t)1 << (q->drop_bits - 1);
+    const uint64_t mask = ~(((uint64_t)1 << q->drop_bits) - 1);
+    const uint64_t exp_mask = 0x7ff0000000000000ull;
+
+    for (int i = 0; i < num_elements; i++) {
+      if ((v[i] & exp_mask) == exp_mask) continue;
+      const uint64_t r =
+          (v[i] + half - 1 + ((v[i] >> q->drop_bits) & 1)) & mask;
+      v[i] = ((r & exp_mask) == exp_mask) ? (v[i] & mask) : r;
+    }
+
+  } else if (!q->is_double) {
+
+    /* Beyond 2^24 steps the values are already on the grid */
+    float* v = (float*)map_data;
+    const float step = (float)q->step;
+    const float inv_step = (float)(1. / q->step);
+    const float limit = step * (float)(1 << 24);
+
+    for (int i = 0; i < num_elements; i++)
+      if (fabsf(v[i]) < limit) v[i] = rintf(v[i] * inv_step) * step;
+
+  } else {
+
+    /* Beyond 2^53 steps the values are already on the grid */
+    double* v = (double*)map_data;
+    const double step = q->step;
+    const double inv_step = 1. / q->step;
+    const double limit = step * 9007199254740992.;
+
+    for (int i = 0; i < num_elements; i++)
+      if (fabs(v[i]) < limit) v[i] = rint(v[i] * inv_step) * step;
+  }
+}
+
+/**
+ * @brief Round the values of an output buffer to the tolerance of an
+ * error-bounded scheme.
+ *
+ * An absolute error of 10^-n is guaranteed by rounding to the largest power
+ * of two not exceeding 2 x 10^-n (see #compression_scheme_abs_err_step); a
+ * relative error of 10^-n by keeping the smallest number of mantissa bits m
+ * with 2^-(m+1) <= 10^-n. The values are written with the usual type, so no
+ * filter is needed to read them back.
+ *
+ * @param tp The #threadpool to use.
+ * @param buffer The values to round (in the units they will be written in).
+ * @param count The number of values.
+ * @param type The type of the values, FLOAT or DOUBLE.
+ * @param comp The error-bounded #lossy_compression_schemes to apply.
+ * @param field_name The name of the field (for error messages).
+ */
+void io_quantise_buffer(struct threadpool* tp, void* buffer, const size_t count,
+                        const enum IO_DATA_TYPE type,
+                        const enum lossy_compression_schemes comp,
+                        const char* field_name) {
+
+  if (!compression_scheme_is_error_bounded(comp))
+    error("Scheme '%s' is not an error-bounded one.",
+          lossy_compression_schemes_names[comp]);
+  if (type != FLOAT && type != DOUBLE)
+    error("Scheme '%s' can only be applied to floating-point fields ('%s').",
+          lossy_compression_schemes_names[comp], field_name);
+
+  struct io_quantise_data q;
+  q.is_double = (type == DOUBLE);
+  q.relative = (comp >= compression_write_rel_err_2);
+
+  if (q.relative) {
+    const int n = comp - compression_write_rel_err_2 + 2;
+    const int kept_bits = (int)ceil(n * log2(10.)) - 1;
+    q.drop_bits = (q.is_double ? 52 : 23) - kept_bits;
+    q.step = 0.;
+  } else {
+    q.step = compression_scheme_abs_err_step(comp);
+    q.drop_bits = 0;
+  }
+
+  const size_t size = q.is_double ? sizeof(double) : sizeof(float);
+  threadpool_map(tp, io_quantise_mapper, buffer, count, size,
+                 threadpool_auto_chunk_size, &q);
+}
+
 #ifdef HAVE_HDF5
 
 /**
@@ -520,11 +697,311 @@ void set_hdf5_lossy_compression(hid_t* h_prop, hid_t* h_type,
       error("Error while setting n-bit filter for field '%s'.", field_name);
   }
 
-  /* Other case: Do nothing! */
+  /* Other cases, including the error-bounded schemes applied by
+   * io_quantise_buffer(): Do nothing! */
 
   /* Finish by returning the filter name */
   if (comp != compression_write_lossless)
     snprintf(filter_name, 32, "%s", lossy_compression_schemes_names[comp]);
 }
 
+/**
+ * @brief Is the GZIP compression of a field done on the threadpool (see
+ * io_write_deflated_chunks()) rather than by HDF5 itself?
+ *
+ * @param gzip_level The GZIP level used for the snapshots (0 for none).
+ * @param N The number of particles written.
+ * @param comp The #lossy_compression_schemes of the field.
+ */
+int io_compression_uses_threadpool(const int gzip_level, const size_t N,
+                                   const enum lossy_compression_schemes comp) {
+#ifdef IO_THREADED_DEFLATE
+  return gzip_level > 0 && N > 0 &&
+         (comp == compression_write_lossless ||
+          compression_scheme_is_error_bounded(comp));
+#else
+  return 0;
+#endif
+}
+
+#ifdef IO_THREADED_DEFLATE
+
+/*! Size of the pieces of a chunk deflated independently (bytes). */
+#define io_deflate_block_size (256 * 1024)
+
+/*! Size of the deflate window, i.e. the largest useful dictionary (bytes). */
+#define io_deflate_window_size (32 * 1024)
+
+/*! Extra room for the flush marker and the header of a deflated block. */
+#define io_deflate_block_margin 64
+
+/**
+ * @brief A piece of a shuffled chunk, deflated independently of the others.
+ */
+struct io_deflate_block {
+
+  /*! The input and its size. */
+  const unsigned char* in;
+  size_t in_size;
+
+  /*! The input preceding this block, used as a dictionary. */
+  size_t dict_size;
+
+  /*! Is this the last block of the chunk? */
+  int last;
+
+  /*! The output, its capacity and the number of bytes written. */
+  unsigned char* out;
+  size_t out_capacity;
+  size_t out_size;
+
+  /*! Adler-32 checksum of the input. */
+  uLong adler;
+};
+
+/**
+ * @brief Data needed by #io_shuffle_mapper.
+ */
+struct io_shuffle_data {
+
+  /*! The chunk to shuffle and where to write it. */
+  const unsigned char* in;
+  unsigned char* out;
+
+  /*! Number of elements in the chunk that are set, the rest is padding. */
+  size_t count;
+
+  /*! Number of elements in the chunk. */
+  size_t nr_elements;
+
+  /*! Size of an element in bytes. */
+  size_t type_size;
+};
+
+/**
+ * @brief Threadpool mapper applying HDF5's byte-shuffle to a range of
+ * elements of a chunk.
+ *
+ * Byte j of element i goes to position j * nr_elements + i. The padding at the
+ * end of an edge chunk is set to zero, the default fill value.
+ */
+static void io_shuffle_mapper(void* map_data, int num_elements,
+                              void* extra_data) {
+
+  const struct io_shuffle_data* data =
+      (const struct io_shuffle_data*)extra_data;
+  const size_t first = (size_t)((unsigned char*)map_data - data->in) /
+                       data->type_size;
+  const size_t last = first + num_elements;
+  const size_t n = data->nr_elements;
+  const size_t size = data->type_size;
+
+  for (size_t j = 0; j < size; j++) {
+    unsigned char* out = data->out + j * n;
+    for (size_t i = first; i < last; i++)
+      out[i] = (i < data->count) ? data->in[i * size + j] : 0;
+  }
+}
+
+/**
+ * @brief Threadpool mapper deflating blocks of a chunk into raw deflate
+ * streams that can be concatenated.
+ *
+ * Each block is primed with the input preceding it, so the compression ratio
+ * is essentially the one of a single stream.
+ */
+static void io_deflate_mapper(void* map_data, int num_elements,
+                              void* extra_data) {
+
+  struct io_deflate_block* blocks = (struct io_deflate_block*)map_data;
+  const int level = *(const int*)extra_data;
+
+  for (int k = 0; k < num_elements; k++) {
+    struct io_deflate_block* b = &blocks[k];
+
+    z_stream strm;
+    bzero(&strm, sizeof(z_stream));
+    if (deflateInit2(&strm, level, Z_DEFLATED, /*windowBits=*/-15,
+                     /*memLevel=*/8, Z_DEFAULT_STRATEGY) != Z_OK)
+      error("Failed to initialise zlib.");
+    if (b->dict_size > 0 &&
+        deflateSetDictionary(&strm, b->in - b->dict_size, b->dict_size) !=
+            Z_OK)
+      error("Failed to set the deflate dictionary.");
+
+    strm.next_in = (Bytef*)b->in;
+    strm.avail_in = b->in_size;
+    strm.next_out = b->out;
+    strm.avail_out = b->out_capacity;
+    const int ret = deflate(&strm, b->last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (ret != (b->last ? Z_STREAM_END : Z_OK) || strm.avail_in != 0)
+      error("Failed to deflate a snapshot chunk (%d).", ret);
+    b->out_size = b->out_capacity - strm.avail_out;
+    deflateEnd(&strm);
+
+    b->adler = adler32(adler32(0L, Z_NULL, 0), b->in, b->in_size);
+  }
+}
+
+/**
+ * @brief Fletcher-32 checksum as computed by HDF5's fletcher32 filter.
+ */
+static uint32_t io_fletcher32(const unsigned char* data, size_t size) {
+
+  size_t len = size / 2;
+  uint32_t sum1 = 0, sum2 = 0;
+
+  while (len) {
+    size_t tlen = len > 360 ? 360 : len;
+    len -= tlen;
+    do {
+      sum1 += (uint32_t)(((uint16_t)data[0]) << 8) | ((uint16_t)data[1]);
+      data += 2;
+      sum2 += sum1;
+    } while (--tlen);
+    sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+    sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+  }
+
+  /* Odd number of bytes */
+  if (size % 2) {
+    sum1 += (uint32_t)(((uint16_t)*data) << 8);
+    sum2 += sum1;
+    sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+    sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+  }
+
+  sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+  sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+  return (sum2 << 16) | sum1;
+}
+
+/**
+ * @brief Write a dataset compressed with the shuffle, deflate and fletcher32
+ * filters, doing the compression on all the threads.
+ *
+ * HDF5 applies its filters on one thread only, inside H5Dwrite(). Here, each
+ * chunk is shuffled and cut into blocks that are deflated in parallel and
+ * stitched into a single zlib stream (as done by pigz). The filtered chunk is
+ * then handed to HDF5 with H5Dwrite_chunk(). The result is identical to what
+ * the HDF5 filters would produce, so the files can be read by any HDF5
+ * library.
+ *
+ * The dataset must have been created with exactly these filters, in this
+ * order, and with chunks spanning whole rows of the array.
+ *
+ * @param tp The #threadpool to use.
+ * @param h_data The dataset to write to.
+ * @param data The data to write.
+ * @param N The number of rows of the dataset.
+ * @param dimension The number of elements per row.
+ * @param type_size The size of an element in bytes.
+ * @param chunk_rows The number of rows per chunk.
+ * @param level The deflate level.
+ * @param field_name The name of the field (for error messages).
+ */
+void io_write_deflated_chunks(struct threadpool* tp, hid_t h_data,
+                              const void* data, const size_t N,
+                              const int dimension, const size_t type_size,
+                              const size_t chunk_rows, const int level,
+                              const char* field_name) {
+
+  const size_t row_size = dimension * type_size;
+  const size_t chunk_size = chunk_rows * row_size;
+  const size_t nr_elements = chunk_size / type_size;
+  const int nr_blocks =
+      (chunk_size + io_deflate_block_size - 1) / io_deflate_block_size;
+  const size_t block_capacity =
+      deflateBound(NULL, io_deflate_block_size) + io_deflate_block_margin;
+
+  /* Space for the shuffled chunk and for the filtered one, with room for
+   * the zlib header (2 bytes) and trailers (adler32 and fletcher32). */
+  unsigned char* shuffled = NULL;
+  unsigned char* filtered = NULL;
+  if ((shuffled = (unsigned char*)swift_malloc("deflate_buff", chunk_size)) ==
+          NULL ||
+      (filtered = (unsigned char*)swift_malloc(
+           "deflate_buff", 2 + nr_blocks * block_capacity + 8)) == NULL)
+    error("Unable to allocate the compression buffers for field '%s'.",
+          field_name);
+
+  struct io_deflate_block* blocks = (struct io_deflate_block*)malloc(
+      nr_blocks * sizeof(struct io_deflate_block));
+  if (blocks == NULL) error("Unable to allocate the compression blocks.");
+
+  /* The zlib header, compression method deflate with a 32k window. */
+  const int flevel = (level < 2) ? 0 : (level < 6) ? 1 : (level == 6) ? 2 : 3;
+  unsigned char header[2] = {0x78, (unsigned char)(flevel << 6)};
+  header[1] += 31 - (header[0] * 256 + header[1]) % 31;
+
+  for (size_t first = 0; first < N; first += chunk_rows) {
+
+    const size_t rows = (N - first < chunk_rows) ? N - first : chunk_rows;
+
+    /* Byte-shuffle the chunk. HDF5 stores edge chunks in full. */
+    struct io_shuffle_data shuffle_data = {
+        (const unsigned char*)data + first * row_size, shuffled,
+        rows * dimension, nr_elements, type_size};
+    if (type_size > 1 && nr_elements > 1) {
+      threadpool_map(tp, io_shuffle_mapper, (void*)shuffle_data.in,
+                     nr_elements, type_size, threadpool_auto_chunk_size,
+                     &shuffle_data);
+    } else {
+      memcpy(shuffled, shuffle_data.in, rows * row_size);
+      bzero(shuffled + rows * row_size, chunk_size - rows * row_size);
+    }
+
+    /* Deflate the blocks of the chunk. */
+    for (int k = 0; k < nr_blocks; k++) {
+      const size_t offset = k * (size_t)io_deflate_block_size;
+      blocks[k].in = shuffled + offset;
+      blocks[k].in_size = (chunk_size - offset < io_deflate_block_size)
+                              ? chunk_size - offset
+                              : io_deflate_block_size;
+      blocks[k].dict_size =
+          (offset < io_deflate_window_size) ? offset : io_deflate_window_size;
+      blocks[k].last = (k == nr_blocks - 1);
+      blocks[k].out = filtered + 2 + k * block_capacity;
+      blocks[k].out_capacity = block_capacity;
+    }
+    int level_copy = level;
+    threadpool_map(tp, io_deflate_mapper, blocks, nr_blocks,
+                   sizeof(struct io_deflate_block), /*chunk=*/1, &level_copy);
+
+    /* Stitch the blocks together behind the header (blocks only ever move
+     * towards the start of the buffer) and combine their checksums. */
+    memcpy(filtered, header, 2);
+    size_t size = 2;
+    uLong adler = adler32(0L, Z_NULL, 0);
+    for (int k = 0; k < nr_blocks; k++) {
+      memmove(filtered + size, blocks[k].out, blocks[k].out_size);
+      size += blocks[k].out_size;
+      adler = adler32_combine(adler, blocks[k].adler, blocks[k].in_size);
+    }
+    filtered[size++] = (adler >> 24) & 0xff;
+    filtered[size++] = (adler >> 16) & 0xff;
+    filtered[size++] = (adler >> 8) & 0xff;
+    filtered[size++] = adler & 0xff;
+
+    /* HDF5's checksum of the deflated chunk, stored little-endian. */
+    const uint32_t fletcher = io_fletcher32(filtered, size);
+    filtered[size++] = fletcher & 0xff;
+    filtered[size++] = (fletcher >> 8) & 0xff;
+    filtered[size++] = (fletcher >> 16) & 0xff;
+    filtered[size++] = (fletcher >> 24) & 0xff;
+
+    /* All the filters were applied. */
+    const hsize_t chunk_offset[2] = {first, 0};
+    if (H5Dwrite_chunk(h_data, H5P_DEFAULT, /*filters=*/0, chunk_offset, size,
+                       filtered) < 0)
+      error("Error while writing a chunk of data array '%s'.", field_name);
+  }
+
+  free(blocks);
+  swift_free("deflate_buff", filtered);
+  swift_free("deflate_buff", shuffled);
+}
+
+#endif /* IO_THREADED_DEFLATE */
+
 #endif /* HAVE_HDF5 */
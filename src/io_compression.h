@@ -22,6 +22,9 @@
 /* Config parameters. */
 #include <config.h>
 
+/* Local headers. */
+#include "common_io.h"
+
 /**
  * @brief Compression levels for snapshot fields
  */
@@ -46,6 +49,17 @@ enum lossy_compression_schemes {
   compression_write_Nbit_44, /*!< Conversion to 44-bit int (from long long) */
   compression_write_Nbit_48, /*!< Conversion to 48-bit int (from long long) */
   compression_write_Nbit_56, /*!< Conversion to 56-bit int (from long long) */
+  compression_write_abs_err_1, /*!< Rounding to an absolute error of 10^-1 */
+  compression_write_abs_err_2, /*!< Rounding to an absolute error of 10^-2 */
+  compression_write_abs_err_3, /*!< Rounding to an absolute error of 10^-3 */
+  compression_write_abs_err_4, /*!< Rounding to an absolute error of 10^-4 */
+  compression_write_abs_err_5, /*!< Rounding to an absolute error of 10^-5 */
+  compression_write_abs_err_6, /*!< Rounding to an absolute error of 10^-6 */
+  compression_write_rel_err_2, /*!< Rounding to a relative error of 10^-2 */
+  compression_write_rel_err_3, /*!< Rounding to a relative error of 10^-3 */
+  compression_write_rel_err_4, /*!< Rounding to a relative error of 10^-4 */
+  compression_write_rel_err_5, /*!< Rounding to a relative error of 10^-5 */
+  compression_write_rel_err_6, /*!< Rounding to a relative error of 10^-6 */
   /* Counter, always leave last */
   compression_level_count,
 };
@@ -58,6 +72,18 @@ extern const char* lossy_compression_schemes_names[];
 
 enum lossy_compression_schemes compression_scheme_from_name(const char* name);
 
+int compression_scheme_is_error_bounded(
+    const enum lossy_compression_schemes comp);
+double compression_scheme_abs_err_step(
+    const enum lossy_compression_schemes comp);
+
+struct threadpool;
+
+void io_quantise_buffer(struct threadpool* tp, void* buffer, const size_t count,
+                        const enum IO_DATA_TYPE type,
+                        const enum lossy_compression_schemes comp,
+                        const char* field_name);
+
 #ifdef HAVE_HDF5
 
 #include <hdf5.h>
@@ -66,6 +92,20 @@ void set_hdf5_lossy_compression(hid_t* h_prop, hid_t* h_type,
                                 const enum lossy_compression_schemes comp,
                                 const char* field_name, char filter_name[32]);
 
+int io_compression_uses_threadpool(const int gzip_level, const size_t N,
+                                   const enum lossy_compression_schemes comp);
+
+/* Direct chunk writes appeared in HDF5 1.10.3 */
+#if defined(HAVE_ZLIB) && H5_VERSION_GE(1, 10, 3)
+#define IO_THREADED_DEFLATE
+
+void io_write_deflated_chunks(struct threadpool* tp, hid_t h_data,
+                              const void* data, const size_t N,
+                              const int dimension, const size_t type_size,
+                              const size_t chunk_rows, const int level,
+                              const char* field_name);
+#endif
+
 #endif /* HAVE_HDF5 */
 
 #endif /* SWIFT_IO_COMPRESSION_H */
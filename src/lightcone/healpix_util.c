@@ -287,6 +287,7 @@ void healpix_query_disc_range(int nside, double vec[3], double radius,
         if (nr_ranges && range) {
           (*range)[*nr_ranges].first = first;
           (*range)[*nr_ranges].last = last;
+          (*range)[*nr_ranges].ring = iring;
           *nr_ranges += 1;
         }
       } else {
@@ -298,6 +299,7 @@ void healpix_query_disc_range(int nside, double vec[3], double radius,
         if (nr_ranges && range) {
           (*range)[*nr_ranges].first = first;
           (*range)[*nr_ranges].last = last;
+          (*range)[*nr_ranges].ring = iring;
           *nr_ranges += 1;
         }
         /* my_low to end of ring */
@@ -307,6 +309,7 @@ void healpix_query_disc_range(int nside, double vec[3], double radius,
         if (nr_ranges && range) {
           (*range)[*nr_ranges].first = first;
           (*range)[*nr_ranges].last = last;
+          (*range)[*nr_ranges].ring = iring;
           *nr_ranges += 1;
         }
       }
@@ -319,6 +322,68 @@ void healpix_query_disc_range(int nside, double vec[3], double radius,
   *pix_max = (pixel_index_t)pix_max_ll;
 }
 
+/**
+ * @brief Compute the dot products of the centres of the pixels in a set of
+ * ranges with a vector
+ *
+ * Each range returned by healpix_query_disc_range() is within a single ring,
+ * in which the pixel centres are equally spaced in phi. The dot products are
+ * therefore computed from the ring geometry with one rotation per pixel,
+ * rather than by finding the centre of each pixel from its index.
+ *
+ * @param nside HEALPix resolution parameter
+ * @param vec the vector (need not be normalized)
+ * @param nr_ranges the number of ranges
+ * @param range the array of pixel ranges
+ * @param dp returns the dot products, one per pixel, in the order of the
+ * pixels in the ranges
+ */
+void healpix_ranges_dot_product(int nside, const double vec[3], int nr_ranges,
+                                const struct pixel_range *range, double *dp) {
+
+  /* Get the normalized vector in terms of z and phi */
+  const double norm =
+      sqrt(vec[0] * vec[0] + vec[1] * vec[1] + vec[2] * vec[2]);
+  const double z0 = vec[2] / norm;
+  const double st0 = sqrt(vec[0] * vec[0] + vec[1] * vec[1]) / norm;
+  double phi0 = 0.0;
+  if ((vec[0] != 0) || (vec[1] != 0)) phi0 = atan2(vec[1], vec[0]);
+
+  size_t n = 0;
+  for (int range_nr = 0; range_nr < nr_ranges; range_nr += 1) {
+
+    /* Find the geometry of the ring containing this range */
+    const int iring = range[range_nr].ring;
+    int npr, kshift;
+    long long npnorth;
+    pixels_per_ring(nside, iring, &npr, &kshift, &npnorth);
+    const double z = ring2z(nside, iring);
+    const double st = sqrt((1.0 - z) * (1.0 + z));
+    const double dphi = 2 * M_PI / npr;
+
+    /* Angle between the vector and the first pixel centre in phi */
+    const long long iphi = range[range_nr].first - (npnorth - npr);
+    const double phi = (iphi + 0.5 * kshift) * dphi - phi0;
+
+    /* Step along the ring by rotating (cos, sin) of the phi difference,
+       recomputing them every few pixels to bound the rounding errors */
+    const double cos_dphi = cos(dphi);
+    const double sin_dphi = sin(dphi);
+    const long long nr_pix = range[range_nr].last - range[range_nr].first + 1;
+    double c = 0.0, s = 0.0;
+    for (long long i = 0; i < nr_pix; i += 1) {
+      if (i % 64 == 0) {
+        c = cos(phi + i * dphi);
+        s = sin(phi + i * dphi);
+      }
+      dp[n++] = z * z0 + st * st0 * c;
+      const double c_next = c * cos_dphi - s * sin_dphi;
+      s = s * cos_dphi + c * sin_dphi;
+      c = c_next;
+    }
+  }
+}
+
 /**
  * @brief Make a 3D vector given z and phi coordinates
  *
@@ -33,6 +33,7 @@
 struct pixel_range {
   pixel_index_t first;
   pixel_index_t last;
+  int ring;
 };
 
 /*
@@ -44,3 +45,6 @@ double healpix_max_pixrad(int nside);
 void healpix_query_disc_range(int nside, double vec[3], double radius,
                               pixel_index_t *pix_min, pixel_index_t *pix_max,
                               int *nr_ranges, struct pixel_range **range);
+
+void healpix_ranges_dot_product(int nside, const double vec[3], int nr_ranges,
+                                const struct pixel_range *range, double *dp);
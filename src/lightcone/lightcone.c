@@ -44,6 +44,7 @@
 #include "extra_io.h"
 #include "gravity_io.h"
 #include "hydro.h"
+#include "lightcone/healpix_util.h"
 #include "lightcone/lightcone_particle_io.h"
 #include "lightcone/lightcone_replications.h"
 #include "lock.h"
@@ -111,6 +112,9 @@ static void read_map_types_file(const char *map_types_file, int *nr_map_types,
       /* Look up compression scheme */
       (*map_types)[map_type_nr].compression =
           compression_scheme_from_name(compression);
+      if (compression_scheme_is_error_bounded(
+              (*map_types)[map_type_nr].compression))
+        error("Scheme '%s' is not supported for lightcone maps.", compression);
 
       /* Only keep maps which have not been disabled */
       if ((*map_types)[map_type_nr].compression != compression_do_not_write)
@@ -602,6 +606,14 @@ void lightcone_init(struct lightcone_props *props, const int index,
   props->max_updates_buffered = parser_get_opt_param_int(
       params, YML_NAME("max_updates_buffered"), 1000000);
 
+  /* Sum updates which only affect a single pixel in a table of up to this
+   * many pixels per shell rather than buffering them individually */
+  props->max_pixels_accumulated = parser_get_opt_param_int(
+      params, YML_NAME("max_pixels_accumulated"), 65536);
+  if (props->max_pixels_accumulated < 0 ||
+      props->max_pixels_accumulated > (1 << 29))
+    error("max_pixels_accumulated must be in the range 0 to 2^29");
+
   /*! Whether to write distributed maps in MPI mode */
   props->distributed_maps =
       parser_get_opt_param_int(params, YML_NAME("distributed_maps"), 1);
@@ -678,7 +690,7 @@ void lightcone_init(struct lightcone_props *props, const int index,
   props->shell = lightcone_shell_array_init(
       cosmo, props->radius_file, props->nr_maps, props->map_type, props->nside,
       total_nr_pix, props->part_type, props->buffer_chunk_size,
-      &props->nr_shells);
+      props->max_pixels_accumulated, &props->nr_shells);
 
   /* Compute area of a healpix pixel */
   props->pixel_area_steradians = 4 * M_PI / total_nr_pix;
@@ -1157,6 +1169,7 @@ void lightcone_dump_completed_shells(struct lightcone_props *props,
         /* Free the pixel data associated with this shell */
         for (int map_nr = 0; map_nr < nr_maps; map_nr += 1)
           lightcone_map_free_pixels(&(props->shell[shell_nr].map[map_nr]));
+        lightcone_shell_free_pixel_sums(&(props->shell[shell_nr]));
 
         /* Update status of this shell */
         props->shell[shell_nr].state = shell_complete;
@@ -1381,6 +1394,7 @@ void lightcone_prepare_for_step(struct lightcone_props *props,
           for (int map_nr = 0; map_nr < nr_maps; map_nr += 1)
             lightcone_map_allocate_pixels(&(props->shell[shell_nr].map[map_nr]),
                                           /* zero_pixels = */ 1);
+          lightcone_shell_allocate_pixel_sums(&(props->shell[shell_nr]));
           props->shell[shell_nr].state = shell_current;
           break;
         case shell_complete:
@@ -1429,6 +1443,7 @@ void lightcone_prepare_for_step(struct lightcone_props *props,
 int lightcone_trigger_map_update(struct lightcone_props *props) {
 
   size_t total_updates = 0;
+  int sums_full = 0;
   const int nr_shells = props->nr_shells;
   for (int shell_nr = 0; shell_nr < nr_shells; shell_nr += 1) {
     if (props->shell[shell_nr].state == shell_current) {
@@ -1436,9 +1451,13 @@ int lightcone_trigger_map_update(struct lightcone_props *props) {
         total_updates += particle_buffer_num_elements(
             &(props->shell[shell_nr].buffer[ptype]));
       }
+      /* Also flush once a table of per-pixel sums is full */
+      const struct lightcone_pixel_sums *sums = &props->shell[shell_nr].sums;
+      if (sums->pixel != NULL && sums->count >= sums->max_count) sums_full = 1;
     }
   }
-  return total_updates >= ((size_t)props->max_updates_buffered);
+  return sums_full ||
+         total_updates >= ((size_t)props->max_updates_buffered);
 }
 
 /**
@@ -1581,6 +1600,24 @@ void lightcone_buffer_map_update(struct lightcone_props *props,
     radius = 0.0;
   }
 
+  /* Check whether this update only affects a single pixel, in which case
+   * it can be summed per pixel. The test and the pixel are computed as when
+   * applying buffered updates, from the angles and radius as stored. */
+  const int theta_int = angle_to_int(theta);
+  const int phi_int = angle_to_int(phi);
+  int single_pixel = (part_type_info->nr_smoothed_maps == 0);
+  if (!single_pixel && props->max_pixels_accumulated > 0) {
+    const double max_pixrad = healpix_max_pixrad(props->nside);
+    single_pixel = ((float)radius) * kernel_gamma < max_pixrad;
+  }
+  pixel_index_t pixel = -1;
+  if (single_pixel && props->max_pixels_accumulated > 0) {
+    int64_t ipring;
+    ang2pix_ring64(props->nside, int_to_angle(theta_int),
+                   int_to_angle(phi_int), &ipring);
+    pixel = ipring;
+  }
+
   /* Loop over shells to update */
   for (int shell_nr = props->shell_nr_min; shell_nr <= props->shell_nr_max;
        shell_nr += 1) {
@@ -1593,37 +1630,49 @@ void lightcone_buffer_map_update(struct lightcone_props *props,
       if (props->shell[shell_nr].state == shell_complete)
         error("Attempt to update shell which has been written out");
 
-      /* Allocate storage for updates and set particle coordinates and radius */
-      union lightcone_map_buffer_entry *data =
-          (union lightcone_map_buffer_entry *)malloc(
-              part_type_info->buffer_element_size);
-      data[0].i = angle_to_int(theta);
-      data[1].i = angle_to_int(phi);
-      data[2].f = radius;
-
-      /* Loop over healpix maps which this particle type contributes to and find
-       * values to add */
+      /* Find the values to add to the healpix maps which this particle type
+       * contributes to */
+      double *val = (double *)malloc(sizeof(double) * part_type_info->nr_maps);
       for (int i = 0; i < part_type_info->nr_maps; i += 1) {
         int map_nr = part_type_info->map_index[i];
-        /* The value to add to the map may need to be scaled to fit in a float
-         */
-        const double fac = props->map_type[map_nr].buffer_scale_factor;
-        /* Fetch the value to add to the map */
-        const double val =
+        val[i] =
             props->map_type[map_nr].update_map(e, props, gp, a_cross, x_cross);
-        /* Store the scaled value */
-        data[3 + i].f = fac * val;
 #ifdef LIGHTCONE_MAP_CHECK_TOTAL
         /* Accumulate total quantity added to each map for consistency check */
-        atomic_add_d(&props->shell[shell_nr].map[map_nr].total, val);
+        atomic_add_d(&props->shell[shell_nr].map[map_nr].total, val[i]);
 #endif
       }
 
-      /* Buffer the updates */
-      particle_buffer_append(&(props->shell[shell_nr].buffer[gp->type]), data);
+      /* Sum the values in the pixel if we can, or buffer the update */
+      if (pixel < 0 ||
+          !lightcone_shell_accumulate_pixel(&(props->shell[shell_nr]), pixel,
+                                            part_type_info, val)) {
+
+        /* Allocate storage for updates and set particle coordinates and
+         * radius */
+        union lightcone_map_buffer_entry *data =
+            (union lightcone_map_buffer_entry *)malloc(
+                part_type_info->buffer_element_size);
+        data[0].i = theta_int;
+        data[1].i = phi_int;
+        data[2].f = radius;
+
+        /* The values to add to the maps may need to be scaled to fit in a
+         * float */
+        for (int i = 0; i < part_type_info->nr_maps; i += 1) {
+          int map_nr = part_type_info->map_index[i];
+          const double fac = props->map_type[map_nr].buffer_scale_factor;
+          data[3 + i].f = fac * val[i];
+        }
+
+        /* Buffer the updates */
+        particle_buffer_append(&(props->shell[shell_nr].buffer[gp->type]),
+                               data);
 
-      /* Free update info */
-      free(data);
+        /* Free update info */
+        free(data);
+      }
+      free(val);
     }
   } /* Next shell */
 #else
@@ -1666,6 +1715,12 @@ void lightcone_memory_use(struct lightcone_props *props,
           particle_buffer_memory_use(&(props->shell[shell_nr].buffer[ptype]));
     }
 
+    /* Summed single pixel updates */
+    const struct lightcone_pixel_sums *sums = &(props->shell[shell_nr].sums);
+    if (sums->pixel)
+      *map_buffer_bytes +=
+          sums->size * (sizeof(pixel_index_t) + nr_maps * sizeof(double));
+
     /* Pixel data - one buffer per map per shell */
     for (int map_nr = 0; map_nr < nr_maps; map_nr += 1) {
       struct lightcone_map *map = &(props->shell[shell_nr].map[map_nr]);
@@ -178,6 +178,10 @@ struct lightcone_props {
   /*! Number of pending map updates to trigger communication */
   int max_updates_buffered;
 
+  /*! Maximum number of pixels per shell for which to sum single pixel map
+   * updates instead of buffering them (0 to always buffer) */
+  int max_pixels_accumulated;
+
   /*! Whether to write distributed maps in MPI mode */
   int distributed_maps;
 
@@ -214,6 +214,32 @@ void lightcone_array_flush(struct lightcone_array_props *props,
   }
 }
 
+/**
+ * @brief Flush the particle buffers of all lightcones that have grown large
+ *
+ * Each rank writes its own particle files, so unlike lightcone_array_flush()
+ * this involves no communication.
+ *
+ * props the #lightcone_array_props struct
+ * cosmo the #cosmology struct
+ * internal_units swift internal unit system
+ * snapshot_units swift snapshot unit system
+ *
+ */
+void lightcone_array_flush_particle_buffers(
+    struct lightcone_array_props *props, const struct cosmology *cosmo,
+    const struct unit_system *internal_units,
+    const struct unit_system *snapshot_units) {
+
+  const int nr_lightcones = props->nr_lightcones;
+  for (int lightcone_nr = 0; lightcone_nr < nr_lightcones; lightcone_nr += 1) {
+    struct lightcone_props *lc_props = props->lightcone + lightcone_nr;
+    lightcone_flush_particle_buffers(lc_props, cosmo->a, internal_units,
+                                     snapshot_units, /*flush_all=*/0,
+                                     /*end_file=*/0);
+  }
+}
+
 /**
  * @brief Make a refined replication list for each lightcone
  *
@@ -247,6 +273,80 @@ struct replication_list *lightcone_array_refine_replications(
   return lists;
 }
 
+/**
+ * @brief Make the replication lists of each lightcone to check the particles
+ * of a #cell against during a drift
+ *
+ * Only the replications in which some particle of the cell could cross the
+ * lightcone between ti_old and ti_current are kept. Returns NULL if there are
+ * none, in which case the particles don't need to be checked at all.
+ * Otherwise, the array must be freed with lightcone_array_free_replications().
+ *
+ * props the #lightcone_array_props struct
+ * cosmo the #cosmology
+ * cell the #cell being drifted
+ * lists_in the replication lists refined for this cell or one of its parents
+ * (NULL if there are no lightcones)
+ * ti_old beginning of the drift on the integer time line
+ * ti_current end of the drift on the integer time line
+ *
+ */
+struct replication_list *lightcone_array_refine_replications_for_drift(
+    struct lightcone_array_props *props, const struct cosmology *cosmo,
+    const struct cell *cell, const struct replication_list *lists_in,
+    const integertime_t ti_old, const integertime_t ti_current) {
+
+  if (lists_in == NULL) return NULL;
+
+  /* Determine expansion factor at start and end of the drift */
+  const double a_start = cosmo->a_begin * exp(ti_old * cosmo->time_base);
+  const double a_end = cosmo->a_begin * exp(ti_current * cosmo->time_base);
+
+  /* Find comoving distance to these expansion factors */
+  const double comoving_dist_start =
+      cosmology_get_comoving_distance(cosmo, a_start);
+  const double comoving_dist_end =
+      cosmology_get_comoving_distance(cosmo, a_end);
+  const double comoving_dist_2_start =
+      comoving_dist_start * comoving_dist_start;
+  const double comoving_dist_2_end = comoving_dist_end * comoving_dist_end;
+
+  /* Get number of lightcones */
+  const int nr_lightcones = props->nr_lightcones;
+
+  /* Allocate a replication list for each lightcone */
+  struct replication_list *lists = (struct replication_list *)malloc(
+      sizeof(struct replication_list) * nr_lightcones);
+  if (lists == NULL) error("Failed to allocate drift replication lists");
+
+  /* Loop over lightcones */
+  int nrep_tot = 0;
+  for (int lightcone_nr = 0; lightcone_nr < nr_lightcones; lightcone_nr += 1) {
+    const struct lightcone_props *lightcone = props->lightcone + lightcone_nr;
+
+    /* Does this drift overlap the lightcone redshift range? */
+    if (a_start > lightcone->a_max || a_end < lightcone->a_min) {
+      lists[lightcone_nr] = lists_in[lightcone_nr];
+      lists[lightcone_nr].nrep = 0;
+      lists[lightcone_nr].replication = NULL;
+      continue;
+    }
+
+    replication_list_subset_for_drift(
+        lists_in + lightcone_nr, cell, lightcone->observer_position,
+        comoving_dist_2_start, comoving_dist_2_end, lists + lightcone_nr);
+    nrep_tot += lists[lightcone_nr].nrep;
+  }
+
+  /* Nothing to check? */
+  if (nrep_tot == 0) {
+    free(lists);
+    return NULL;
+  }
+
+  return lists;
+}
+
 /**
  * @brief Free lists returned by lightcone_array_refine_replications
  *
@@ -87,9 +87,19 @@ void lightcone_array_flush(struct lightcone_array_props *props,
                            int flush_map_updates, int flush_particles,
                            int end_file, int dump_all_shells);
 
+void lightcone_array_flush_particle_buffers(
+    struct lightcone_array_props *props, const struct cosmology *cosmo,
+    const struct unit_system *internal_units,
+    const struct unit_system *snapshot_units);
+
 struct replication_list *lightcone_array_refine_replications(
     struct lightcone_array_props *props, const struct cell *cell);
 
+struct replication_list *lightcone_array_refine_replications_for_drift(
+    struct lightcone_array_props *props, const struct cosmology *cosmo,
+    const struct cell *cell, const struct replication_list *lists_in,
+    const integertime_t ti_old, const integertime_t ti_current);
+
 void lightcone_array_free_replications(struct lightcone_array_props *props,
                                        struct replication_list *lists);
 
@@ -81,6 +81,9 @@ void lightcone_io_field_list_append(struct lightcone_io_field_list *list,
   r->units = units;
   r->scale_factor_exponent = scale_factor_exponent;
   r->compression = compression_scheme_from_name(compression);
+  if (compression_scheme_is_error_bounded(r->compression))
+    error("Scheme '%s' is not supported for lightcone particles ('%s').",
+          compression, name);
   r->next = NULL;
 
   /* Append to the linked list */
@@ -176,7 +176,8 @@ void replication_list_init_empty(struct replication_list *replication_list) {
  * @param replication_list Pointer to the struct to deallocate.
  */
 void replication_list_clean(struct replication_list *replication_list) {
-  swift_free("lightcone_replications", replication_list->replication);
+  if (replication_list->replication != NULL)
+    swift_free("lightcone_replications", replication_list->replication);
   replication_list->replication = NULL;
   replication_list->nrep = 0;
 }
@@ -201,6 +202,46 @@ void replication_list_write(struct replication_list *replication_list,
   }
 }
 
+/**
+ * @brief Compute the range of distances (squared) from the observer to a
+ * periodic replication of the region where the particles of a #cell can be.
+ *
+ * Particles can wander out of a top-level cell by up to half a cell width,
+ * so we use an 'effective' width twice the width of the cell.
+ *
+ * @param rep The replication
+ * @param cell The #cell
+ * @param observer_position Location of the observer
+ * @param rmin2 (return) The minimum distance squared
+ * @param rmax2 (return) The maximum distance squared
+ */
+static void replication_cell_distance_range(const struct replication *rep,
+                                            const struct cell *cell,
+                                            const double observer_position[3],
+                                            double *rmin2, double *rmax2) {
+
+  *rmin2 = 0.0;
+  *rmax2 = 0.0;
+  for (int j = 0; j < 3; j += 1) {
+
+    /* Find coordinates of centre of this replication of the cell relative to
+     * the observer */
+    const double cell_centre = cell->loc[j] + 0.5 * cell->width[j];
+    const double cell_rep_centre =
+        rep->coord[j] + cell_centre - observer_position[j];
+
+    /* Half of the 'effective' width of the cell */
+    const double half_eff_width = cell->width[j];
+
+    double dx = fabs(cell_rep_centre) - half_eff_width;
+    if (dx < 0.0) dx = 0.0;
+    *rmin2 += dx * dx;
+
+    dx = fabs(cell_rep_centre) + half_eff_width;
+    *rmax2 += dx * dx;
+  }
+}
+
 /**
  * Determine subset of replications which overlap a #cell
  *
@@ -217,16 +258,6 @@ void replication_list_subset_for_cell(const struct replication_list *rep_in,
                                       const double observer_position[3],
                                       struct replication_list *rep_out) {
 
-  /* Find centre coordinates of this cell */
-  const double cell_centre[] = {cell->loc[0] + 0.5 * cell->width[0],
-                                cell->loc[1] + 0.5 * cell->width[1],
-                                cell->loc[2] + 0.5 * cell->width[2]};
-
-  /* Find 'effective' width of this cell - particles can wander out of the cell
-   * by up to half a cell width */
-  const double cell_eff_width[] = {2.0 * cell->width[0], 2.0 * cell->width[1],
-                                   2.0 * cell->width[2]};
-
   /* Allocate array of replications for the new list */
   const int nrep_max = rep_in->nrep;
   if (swift_memalign("lightcone_replications", (void **)&rep_out->replication,
@@ -246,30 +277,11 @@ void replication_list_subset_for_cell(const struct replication_list *rep_in,
     /* Get a pointer to this input replication */
     const struct replication *rep = rep_in->replication + i;
 
-    /* Find coordinates of centre of this replication of the cell relative to
-     * the observer */
-    double cell_rep_centre[3];
-    for (int j = 0; j < 3; j += 1) {
-      cell_rep_centre[j] =
-          rep->coord[j] + cell_centre[j] - observer_position[j];
-    }
-
-    /* Compute minimum possible distance squared from observer to this
-     * replication of this cell */
-    double cell_rmin2 = 0.0;
-    for (int j = 0; j < 3; j += 1) {
-      double dx = fabs(cell_rep_centre[j]) - 0.5 * cell_eff_width[j];
-      if (dx < 0.0) dx = 0.0;
-      cell_rmin2 += dx * dx;
-    }
-
-    /* Compute maximum possible distance squared from observer to this
-     * replication of this cell */
-    double cell_rmax2 = 0.0;
-    for (int j = 0; j < 3; j += 1) {
-      double dx = fabs(cell_rep_centre[j]) + 0.5 * cell_eff_width[j];
-      cell_rmax2 += dx * dx;
-    }
+    /* Compute minimum and maximum possible distance squared from observer to
+     * this replication of this cell */
+    double cell_rmin2, cell_rmax2;
+    replication_cell_distance_range(rep, cell, observer_position, &cell_rmin2,
+                                    &cell_rmax2);
 
     /* Decide whether this cell could contribute to this replication */
     if (cell_rmax2 >= lightcone_rmin2 && cell_rmin2 <= lightcone_rmax2) {
@@ -284,3 +296,95 @@ void replication_list_subset_for_cell(const struct replication_list *rep_in,
   rep_out->lightcone_rmin = rep_in->lightcone_rmin;
   rep_out->lightcone_rmax = rep_in->lightcone_rmax;
 }
+
+/**
+ * Determine subset of replications in which the particles of a #cell can
+ * cross the lightcone during a drift
+ *
+ * This applies the tests of lightcone_check_particle_crosses() to the
+ * region where the particles of the cell can be rather than to each
+ * particle: a replication is kept if the region can be inside the lightcone
+ * surface at the start of the drift and close enough to it to be outside at
+ * the end of the drift (assuming v < c). The order of the input list is
+ * preserved.
+ *
+ * The particles of a cell below the top level may have drifted out of it
+ * since the last rebuild, so the region is the top-level cell grown by half
+ * its width, as in replication_list_subset_for_cell(). The cull only gains
+ * from the drift interval of the cell being shorter than the step.
+ *
+ * @param rep_in The input replication list
+ * @param cell The input cell (any level)
+ * @param observer_position Location of the observer
+ * @param comoving_dist_2_start Comoving distance squared to the lightcone
+ * surface at the start of the drift
+ * @param comoving_dist_2_end Comoving distance squared to the lightcone
+ * surface at the end of the drift
+ * @param rep_out The output replication list
+ *
+ * Initializes rep_out, which must then be freed with
+ * replication_list_clean(). No memory is allocated if no replication is
+ * kept.
+ */
+void replication_list_subset_for_drift(const struct replication_list *rep_in,
+                                       const struct cell *cell,
+                                       const double observer_position[3],
+                                       const double comoving_dist_2_start,
+                                       const double comoving_dist_2_end,
+                                       struct replication_list *rep_out) {
+
+  /* Where the particles can be: the top-level cell and its margin */
+  const struct cell *top = cell->top;
+
+  /* Thickness of the shell swept by the lightcone surface during the drift */
+  const double boundary = comoving_dist_2_start - comoving_dist_2_end;
+
+  rep_out->nrep = 0;
+  rep_out->replication = NULL;
+  rep_out->lightcone_rmin = rep_in->lightcone_rmin;
+  rep_out->lightcone_rmax = rep_in->lightcone_rmax;
+
+  /* Flag the replications to keep. We check the same conditions twice rather
+   * than allocate a list for the (common) cells that can't cross anything. */
+  const int nrep_max = rep_in->nrep;
+  int first = -1;
+  for (int i = 0; i < nrep_max; i += 1) {
+    const struct replication *rep = rep_in->replication + i;
+
+    /* The replications are in ascending order of rmin: if the whole box is
+     * beyond the lightcone surface at the start, so are all the next ones */
+    if (rep->rmin2 > comoving_dist_2_start) break;
+
+    double cell_rmin2, cell_rmax2;
+    replication_cell_distance_range(rep, top, observer_position, &cell_rmin2,
+                                    &cell_rmax2);
+    if (cell_rmin2 > comoving_dist_2_start) continue;
+    if (cell_rmax2 + boundary < comoving_dist_2_end) continue;
+
+    if (first < 0) first = i;
+    rep_out->nrep += 1;
+  }
+  if (rep_out->nrep == 0) return;
+
+  /* Allocate array of replications for the new list */
+  if (swift_memalign("lightcone_replications", (void **)&rep_out->replication,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     sizeof(struct replication) * rep_out->nrep) != 0) {
+    error("Failed to allocate drift lightcone replication list");
+  }
+
+  /* And copy them */
+  int nrep = 0;
+  for (int i = first; nrep < rep_out->nrep; i += 1) {
+    const struct replication *rep = rep_in->replication + i;
+
+    double cell_rmin2, cell_rmax2;
+    replication_cell_distance_range(rep, top, observer_position, &cell_rmin2,
+                                    &cell_rmax2);
+    if (cell_rmin2 > comoving_dist_2_start) continue;
+    if (cell_rmax2 + boundary < comoving_dist_2_end) continue;
+
+    memcpy(rep_out->replication + nrep, rep, sizeof(struct replication));
+    nrep += 1;
+  }
+}
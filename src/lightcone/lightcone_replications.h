@@ -72,4 +72,11 @@ void replication_list_subset_for_cell(const struct replication_list *rep_in,
                                       const double observer_position[3],
                                       struct replication_list *rep_out);
 
+void replication_list_subset_for_drift(const struct replication_list *rep_in,
+                                       const struct cell *cell,
+                                       const double observer_position[3],
+                                       const double comoving_dist_2_start,
+                                       const double comoving_dist_2_end,
+                                       struct replication_list *rep_out);
+
 #endif
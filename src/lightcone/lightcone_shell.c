@@ -23,6 +23,7 @@
 /* Some standard headers. */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* HEALPix C API */
 #ifdef HAVE_CHEALPIX
@@ -35,6 +36,7 @@
 #include "exchange_structs.h"
 #include "hydro.h"
 #include "lightcone/healpix_util.h"
+#include "memuse.h"
 
 /* This object's header. */
 #include "lightcone/lightcone_shell.h"
@@ -168,6 +170,8 @@ static void read_shell_radii(const struct cosmology *cosmo,
  * @param total_nr_pix number of pixels in each map
  * @param part_type specifies which particle types update which maps
  * @param elements_per_block size of blocks used in the update buffers
+ * @param max_pixels_accumulated maximum number of pixels for which to sum
+ * single pixel updates (0 to buffer all updates)
  * @param nr_shells_out returns the number of lightcone shells in the array
  *
  */
@@ -175,7 +179,7 @@ struct lightcone_shell *lightcone_shell_array_init(
     const struct cosmology *cosmo, const char *radius_file, int nr_maps,
     struct lightcone_map_type *map_type, int nside, pixel_index_t total_nr_pix,
     struct lightcone_particle_type *part_type, size_t elements_per_block,
-    int *nr_shells_out) {
+    size_t max_pixels_accumulated, int *nr_shells_out) {
 
   /* Read in the shell radii */
   int nr_shells = 0;
@@ -257,6 +261,11 @@ struct lightcone_shell *lightcone_shell_array_init(
     }
   }
 
+  /* Size the tables of per-pixel sums: these are only allocated while the
+     shell is current */
+  for (int shell_nr = 0; shell_nr < nr_shells; shell_nr += 1)
+    lightcone_shell_init_pixel_sums(&shell[shell_nr], max_pixels_accumulated);
+
   /* Return the array of shells */
   *nr_shells_out = nr_shells;
   return shell;
@@ -291,6 +300,7 @@ void lightcone_shell_array_free(struct lightcone_shell *shell, int nr_shells) {
     for (int ptype = 0; ptype < swift_type_count; ptype += 1) {
       particle_buffer_free(&shell[shell_nr].buffer[ptype]);
     }
+    lightcone_shell_free_pixel_sums(&shell[shell_nr]);
   }
 
   /* Free the array of shells */
@@ -358,9 +368,137 @@ struct lightcone_shell *lightcone_shell_array_restore(
     }
   }
 
+  /* Re-allocate the (empty) per-pixel sums of the current shells */
+  for (int shell_nr = 0; shell_nr < nr_shells; shell_nr += 1) {
+    shell[shell_nr].sums.pixel = NULL;
+    shell[shell_nr].sums.value = NULL;
+    if (shell[shell_nr].state == shell_current)
+      lightcone_shell_allocate_pixel_sums(&shell[shell_nr]);
+  }
+
   return shell;
 }
 
+/**
+ * @brief Set the size of the table of per-pixel sums of a shell
+ *
+ * The table is left unallocated. At most half of the slots are used to keep
+ * the probing short.
+ *
+ * @param shell the #lightcone_shell
+ * @param max_pixels_accumulated maximum number of pixels for which to sum
+ * single pixel updates (0 to buffer all updates)
+ */
+void lightcone_shell_init_pixel_sums(struct lightcone_shell *shell,
+                                     const size_t max_pixels_accumulated) {
+
+  struct lightcone_pixel_sums *sums = &shell->sums;
+  sums->size = 0;
+  if (max_pixels_accumulated > 0) {
+    sums->size = 1;
+    while (sums->size < 2 * max_pixels_accumulated) sums->size *= 2;
+  }
+  sums->count = 0;
+  sums->max_count = max_pixels_accumulated;
+  sums->pixel = NULL;
+  sums->value = NULL;
+}
+
+/**
+ * @brief Allocate the table of per-pixel sums of a shell
+ *
+ * Called when the shell becomes current. Does nothing if accumulating
+ * per-pixel sums is disabled.
+ *
+ * @param shell the #lightcone_shell
+ */
+void lightcone_shell_allocate_pixel_sums(struct lightcone_shell *shell) {
+
+  struct lightcone_pixel_sums *sums = &shell->sums;
+  sums->count = 0;
+  if (sums->size == 0 || shell->nr_maps == 0) return;
+
+  if (swift_memalign("lightcone_pixel_sums", (void **)&sums->pixel,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     sizeof(pixel_index_t) * sums->size) != 0)
+    error("Failed to allocate lightcone pixel sums");
+  if (swift_memalign("lightcone_pixel_sums", (void **)&sums->value,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     sizeof(double) * sums->size * shell->nr_maps) != 0)
+    error("Failed to allocate lightcone pixel sums");
+
+  for (size_t i = 0; i < sums->size; i += 1) sums->pixel[i] = -1;
+  memset(sums->value, 0, sizeof(double) * sums->size * shell->nr_maps);
+}
+
+/**
+ * @brief Free the table of per-pixel sums of a shell
+ *
+ * @param shell the #lightcone_shell
+ */
+void lightcone_shell_free_pixel_sums(struct lightcone_shell *shell) {
+
+  struct lightcone_pixel_sums *sums = &shell->sums;
+  if (sums->pixel) swift_free("lightcone_pixel_sums", sums->pixel);
+  if (sums->value) swift_free("lightcone_pixel_sums", sums->value);
+  sums->pixel = NULL;
+  sums->value = NULL;
+  sums->count = 0;
+}
+
+/**
+ * @brief Add the contributions of a particle to a single pixel of the maps
+ *
+ * The values are added to the per-pixel sums of the shell. This is thread
+ * safe. Returns 0 if the table is not in use or full, in which case the
+ * update must be buffered instead.
+ *
+ * @param shell the #lightcone_shell
+ * @param pixel global index of the pixel to update
+ * @param pt the #lightcone_particle_type of the particle
+ * @param value the values to add to each of the maps of the particle type
+ */
+int lightcone_shell_accumulate_pixel(struct lightcone_shell *shell,
+                                     const pixel_index_t pixel,
+                                     const struct lightcone_particle_type *pt,
+                                     const double *value) {
+
+  struct lightcone_pixel_sums *sums = &shell->sums;
+  if (sums->pixel == NULL) return 0;
+
+  /* Multiplicative hashing spreads neighbouring pixels over the table */
+  const size_t mask = sums->size - 1;
+  size_t slot = (size_t)((uint64_t)pixel * 0x9E3779B97F4A7C15ull) & mask;
+
+  /* Linear probing, giving up after a few attempts */
+  for (int probe = 0; probe < 32; probe += 1) {
+
+    pixel_index_t key = sums->pixel[slot];
+
+    /* Claim an empty slot, unless we already used as many as allowed */
+    if (key == -1) {
+      if (sums->count >= sums->max_count) return 0;
+      key = atomic_cas(&sums->pixel[slot], (pixel_index_t)-1, pixel);
+      if (key == -1) {
+        atomic_inc(&sums->count);
+        key = pixel;
+      }
+    }
+
+    /* Add the contributions if the slot is (now) for our pixel */
+    if (key == pixel) {
+      double *sum = &sums->value[slot * shell->nr_maps];
+      for (int i = 0; i < pt->nr_maps; i += 1)
+        atomic_add_d(&sum[pt->map_index[i]], value[i]);
+      return 1;
+    }
+
+    slot = (slot + 1) & mask;
+  }
+
+  return 0;
+}
+
 struct healpix_smoothing_mapper_data {
 
   /*! MPI rank */
@@ -407,14 +545,12 @@ struct buffer_block_info {
   int *last_dest;
 };
 
-#ifdef HAVE_CHEALPIX
 static int pixel_to_rank(int comm_size, pixel_index_t pix_per_rank,
                          pixel_index_t pixel) {
   int rank = pixel / pix_per_rank;
   if (rank >= comm_size) rank = comm_size - 1;
   return rank;
 }
-#endif
 
 /**
  * @brief Count elements to send to each rank from each buffer block
@@ -638,6 +774,10 @@ void healpix_smoothing_mapper(void *map_data, int num_elements,
   pixel_index_t local_pix_offset = shell->map[0].local_pix_offset;
   pixel_index_t local_nr_pix = shell->map[0].local_nr_pix;
 
+  /* Kernel weights of the pixels in a disc, re-used between updates */
+  double *pixel_weight = NULL;
+  size_t pixel_weight_size = 0;
+
   /* Loop over updates to apply */
   for (int i = 0; i < num_elements; i += 1) {
 
@@ -695,57 +835,43 @@ void healpix_smoothing_mapper(void *map_data, int num_elements,
         healpix_query_disc_range(shell->nside, part_vec, search_radius,
                                  &pix_min, &pix_max, &nr_ranges, &range);
 
+        /* Make sure we have space for the weights of all the pixels */
+        size_t nr_pix = 0;
+        for (int range_nr = 0; range_nr < nr_ranges; range_nr += 1)
+          nr_pix += range[range_nr].last - range[range_nr].first + 1;
+        if (nr_pix > pixel_weight_size) {
+          free(pixel_weight);
+          pixel_weight = (double *)malloc(sizeof(double) * nr_pix);
+          if (pixel_weight == NULL)
+            error("Failed to allocate lightcone pixel weights");
+          pixel_weight_size = nr_pix;
+        }
+
+        /* Evaluate the kernel at each pixel centre, once for the whole
+           disc. The pixel centres are found ring by ring. */
+        healpix_ranges_dot_product(shell->nside, part_vec, nr_ranges, range,
+                                   pixel_weight);
+        projected_kernel_eval_cos_array(kernel_table, smoothing_radius,
+                                        nr_pix, pixel_weight);
+
         /* Compute total weight of pixels to update */
         double total_weight = 0;
-        for (int range_nr = 0; range_nr < nr_ranges; range_nr += 1) {
-          for (pixel_index_t pix = range[range_nr].first;
-               pix <= range[range_nr].last; pix += 1) {
-
-            /* Get vector at the centre of this pixel */
-            double pixel_vec[3];
-            pix2vec_ring64(shell->nside, pix, pixel_vec);
-
-            /* Find angle between this pixel centre and the particle.
-               Dot product may be a tiny bit greater than one due to rounding
-               error */
-            const double dp =
-                (pixel_vec[0] * part_vec[0] + pixel_vec[1] * part_vec[1] +
-                 pixel_vec[2] * part_vec[2]);
-            const double angle = dp < 1.0 ? acos(dp) : 0.0;
-
-            /* Evaluate the kernel at this radius */
-            total_weight +=
-                projected_kernel_eval(kernel_table, angle / smoothing_radius);
-          }
-        }
+        for (size_t pix_nr = 0; pix_nr < nr_pix; pix_nr += 1)
+          total_weight += pixel_weight[pix_nr];
 
         /* Update the pixels */
+        size_t pix_nr = 0;
         for (int range_nr = 0; range_nr < nr_ranges; range_nr += 1) {
           for (pixel_index_t pix = range[range_nr].first;
-               pix <= range[range_nr].last; pix += 1) {
+               pix <= range[range_nr].last; pix += 1, pix_nr += 1) {
 
             /* Check if this pixel is stored locally */
             pixel_index_t global_pix = pix;
             if ((global_pix >= local_pix_offset) &&
                 (global_pix < local_pix_offset + local_nr_pix)) {
 
-              /* Get vector at the centre of this pixel */
-              double pixel_vec[3];
-              pix2vec_ring64(shell->nside, pix, pixel_vec);
-
-              /* Find angle between this pixel centre and the particle.
-                 Dot product may be a tiny bit greater than one due to rounding
-                 error */
-              const double dp =
-                  (pixel_vec[0] * part_vec[0] + pixel_vec[1] * part_vec[1] +
-                   pixel_vec[2] * part_vec[2]);
-              const double angle = dp < 1.0 ? acos(dp) : 0.0;
-
-              /* Evaluate the kernel at this radius */
-              const double weight =
-                  projected_kernel_eval(kernel_table,
-                                        angle / smoothing_radius) /
-                  total_weight;
+              /* Normalise the weight of this pixel */
+              const double weight = pixel_weight[pix_nr] / total_weight;
 
               /* Find local index of the pixel to update */
               const pixel_index_t local_pix = global_pix - local_pix_offset;
@@ -796,6 +922,8 @@ void healpix_smoothing_mapper(void *map_data, int num_elements,
       } /* if part_type->nr_unsmoothed_maps > 0 */
     }
   } /* End loop over updates to apply */
+
+  free(pixel_weight);
 #else
   error("Need HEALPix C API for lightcone maps");
 #endif
@@ -1030,6 +1158,164 @@ void lightcone_shell_flush_map_updates_for_type(
 #endif
 }
 
+#ifndef WITH_MPI
+
+/**
+ * @brief Mapper function to add the per-pixel sums to the local maps
+ *
+ * map_data is a section of the shell's array of pixel indexes. The slots
+ * are reset to empty as they are applied. Each slot holds a different pixel,
+ * so no atomics are needed.
+ *
+ * @param map_data Pointer to an array of pixel_index_t
+ * @param num_elements Number of elements in map_data
+ * @param extra_data Pointer to the #lightcone_shell
+ */
+static void apply_pixel_sums_mapper(void *map_data, int num_elements,
+                                    void *extra_data) {
+
+  struct lightcone_shell *shell = (struct lightcone_shell *)extra_data;
+  pixel_index_t *pixel = (pixel_index_t *)map_data;
+  const int nr_maps = shell->nr_maps;
+  double *value = &shell->sums.value[(pixel - shell->sums.pixel) * nr_maps];
+
+  for (int i = 0; i < num_elements; i += 1) {
+    if (pixel[i] < 0) continue;
+    const pixel_index_t local_pix = pixel[i] - shell->local_pix_offset;
+    for (int map_nr = 0; map_nr < nr_maps; map_nr += 1) {
+      shell->map[map_nr].data[local_pix] += value[i * nr_maps + map_nr];
+      value[i * nr_maps + map_nr] = 0.0;
+    }
+    pixel[i] = -1;
+  }
+}
+
+#else
+
+/**
+ * @brief An entry of the per-pixel sums sent to the rank owning the pixel.
+ *
+ * Each sent record is one pixel index followed by nr_maps values.
+ */
+union lightcone_pixel_sum_entry {
+  pixel_index_t pixel;
+  double value;
+};
+
+/**
+ * @brief Mapper function to add received per-pixel sums to the local maps
+ *
+ * @param map_data Pointer to an array of records
+ * @param num_elements Number of records in map_data
+ * @param extra_data Pointer to the #lightcone_shell
+ */
+static void apply_received_pixel_sums_mapper(void *map_data, int num_elements,
+                                             void *extra_data) {
+
+  struct lightcone_shell *shell = (struct lightcone_shell *)extra_data;
+  const int nr_maps = shell->nr_maps;
+  const union lightcone_pixel_sum_entry *entry =
+      (union lightcone_pixel_sum_entry *)map_data;
+
+  for (int i = 0; i < num_elements; i += 1) {
+    const union lightcone_pixel_sum_entry *record = &entry[i * (1 + nr_maps)];
+    const pixel_index_t local_pix = record[0].pixel - shell->local_pix_offset;
+    if (local_pix < 0 || local_pix >= shell->local_nr_pix)
+      error("Received a pixel sum for a pixel stored on another rank");
+    for (int map_nr = 0; map_nr < nr_maps; map_nr += 1)
+      if (record[1 + map_nr].value != 0.0)
+        atomic_add_d(&shell->map[map_nr].data[local_pix],
+                     record[1 + map_nr].value);
+  }
+}
+#endif
+
+/**
+ * @brief Apply the per-pixel sums of a shell to its maps and empty the table
+ *
+ * In MPI mode each rank sends one record per pixel it has accumulated to the
+ * rank storing that pixel, so the data exchanged scales with the number of
+ * pixels touched rather than with the number of particles.
+ *
+ * @param shell the #lightcone_shell to update
+ * @param tp the #threadpool used to execute the updates
+ */
+static void lightcone_shell_flush_pixel_sums(struct lightcone_shell *shell,
+                                             struct threadpool *tp) {
+
+  struct lightcone_pixel_sums *sums = &shell->sums;
+  if (sums->pixel == NULL) return;
+
+#ifdef WITH_MPI
+
+  int comm_size;
+  MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+  const int nr_maps = shell->nr_maps;
+  const size_t record_size =
+      (1 + nr_maps) * sizeof(union lightcone_pixel_sum_entry);
+
+  /* Count records to send to each rank */
+  size_t *send_count = (size_t *)calloc(comm_size, sizeof(size_t));
+  size_t *send_offset = (size_t *)malloc(sizeof(size_t) * comm_size);
+  for (size_t slot = 0; slot < sums->size; slot += 1)
+    if (sums->pixel[slot] >= 0)
+      send_count[pixel_to_rank(comm_size, shell->pix_per_rank,
+                               sums->pixel[slot])] += 1;
+  send_offset[0] = 0;
+  for (int i = 1; i < comm_size; i += 1)
+    send_offset[i] = send_offset[i - 1] + send_count[i - 1];
+  const size_t total_nr_send = send_offset[comm_size - 1] +
+                               send_count[comm_size - 1];
+
+  /* Pack the records, sorted by destination, and empty the table */
+  union lightcone_pixel_sum_entry *sendbuf =
+      (union lightcone_pixel_sum_entry *)malloc(record_size * total_nr_send);
+  for (size_t slot = 0; slot < sums->size; slot += 1) {
+    if (sums->pixel[slot] < 0) continue;
+    const int dest =
+        pixel_to_rank(comm_size, shell->pix_per_rank, sums->pixel[slot]);
+    union lightcone_pixel_sum_entry *record =
+        &sendbuf[send_offset[dest] * (1 + nr_maps)];
+    send_offset[dest] += 1;
+    record[0].pixel = sums->pixel[slot];
+    for (int map_nr = 0; map_nr < nr_maps; map_nr += 1) {
+      record[1 + map_nr].value = sums->value[slot * nr_maps + map_nr];
+      sums->value[slot * nr_maps + map_nr] = 0.0;
+    }
+    sums->pixel[slot] = -1;
+  }
+  sums->count = 0;
+
+  /* Exchange the records */
+  size_t *recv_count = (size_t *)malloc(comm_size * sizeof(size_t));
+  MPI_Alltoall(send_count, sizeof(size_t), MPI_BYTE, recv_count,
+               sizeof(size_t), MPI_BYTE, MPI_COMM_WORLD);
+  size_t total_nr_recv = 0;
+  for (int i = 0; i < comm_size; i += 1) total_nr_recv += recv_count[i];
+  union lightcone_pixel_sum_entry *recvbuf =
+      (union lightcone_pixel_sum_entry *)malloc(record_size * total_nr_recv);
+  exchange_structs(send_count, sendbuf, recv_count, recvbuf, record_size);
+
+  /* Add them to the local pixels */
+  threadpool_map(tp, apply_received_pixel_sums_mapper, recvbuf, total_nr_recv,
+                 record_size, threadpool_auto_chunk_size, shell);
+
+  free(send_count);
+  free(send_offset);
+  free(sendbuf);
+  free(recv_count);
+  free(recvbuf);
+
+#else
+
+  /* All pixels are local: add the sums to the maps directly */
+  threadpool_map(tp, apply_pixel_sums_mapper, sums->pixel, sums->size,
+                 sizeof(pixel_index_t), threadpool_auto_chunk_size, shell);
+  sums->count = 0;
+
+#endif
+}
+
 /**
  * @brief Apply buffered updates to all lightcone maps in a shell
  *
@@ -1048,6 +1334,9 @@ void lightcone_shell_flush_map_updates(
   if (shell->state != shell_current)
     error("Attempt to flush updates for non-current shell!");
 
+  /* Apply the sums of the single pixel updates */
+  lightcone_shell_flush_pixel_sums(shell, tp);
+
   for (int ptype = 0; ptype < swift_type_count; ptype += 1) {
     if ((shell->nr_maps > 0) && (part_type[ptype].nr_maps > 0)) {
       lightcone_shell_flush_map_updates_for_type(shell, tp, part_type, ptype,
@@ -102,6 +102,34 @@ struct lightcone_particle_type {
   size_t buffer_element_size;
 };
 
+/**
+ * @brief Per-pixel sums of map contributions
+ *
+ * Particles which only update a single pixel of the maps (small particles or
+ * particle types which contribute to no smoothed maps) are summed in this
+ * open-addressing hash table keyed by the global pixel index, rather than
+ * being buffered one update per particle. Many particles crossing the
+ * lightcone within a step land in the same pixels, so this reduces the
+ * memory used and the data communicated when the updates are applied.
+ */
+struct lightcone_pixel_sums {
+
+  /*! Number of slots in the table (a power of two, or zero if not in use) */
+  size_t size;
+
+  /*! Number of slots in use */
+  size_t count;
+
+  /*! Maximum number of slots to use before falling back to buffering */
+  size_t max_count;
+
+  /*! Global pixel index for each slot (-1 for unused slots) */
+  pixel_index_t *pixel;
+
+  /*! Sums for each map of the shell, nr_maps values per slot */
+  double *value;
+};
+
 /**
  * @brief Information about each lightcone shell
  *
@@ -142,6 +170,9 @@ struct lightcone_shell {
   /*! Buffers to store the map updates for each particle type */
   struct particle_buffer buffer[swift_type_count];
 
+  /*! Sums of the updates which affect a single pixel */
+  struct lightcone_pixel_sums sums;
+
   /*! Healpix nside parameter */
   int nside;
 
@@ -162,7 +193,7 @@ struct lightcone_shell *lightcone_shell_array_init(
     const struct cosmology *cosmo, const char *radius_file, int nr_maps,
     struct lightcone_map_type *map_type, int nside, pixel_index_t total_nr_pix,
     struct lightcone_particle_type *part_type, size_t elements_per_block,
-    int *nr_shells_out);
+    size_t max_pixels_accumulated, int *nr_shells_out);
 
 void lightcone_shell_array_free(struct lightcone_shell *shell, int nr_shells);
 
@@ -173,6 +204,18 @@ struct lightcone_shell *lightcone_shell_array_restore(
     FILE *stream, int nr_shells, struct lightcone_particle_type *part_type,
     size_t elements_per_block);
 
+void lightcone_shell_init_pixel_sums(struct lightcone_shell *shell,
+                                     const size_t max_pixels_accumulated);
+
+void lightcone_shell_allocate_pixel_sums(struct lightcone_shell *shell);
+
+void lightcone_shell_free_pixel_sums(struct lightcone_shell *shell);
+
+int lightcone_shell_accumulate_pixel(struct lightcone_shell *shell,
+                                     const pixel_index_t pixel,
+                                     const struct lightcone_particle_type *pt,
+                                     const double *value);
+
 void lightcone_shell_flush_map_updates(
     struct lightcone_shell *shell, struct threadpool *tp,
     struct lightcone_particle_type *part_type,
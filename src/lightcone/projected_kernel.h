@@ -23,6 +23,10 @@
 /* Config parameters. */
 #include <config.h>
 
+/* Standard headers */
+#include <math.h>
+#include <stddef.h>
+
 /* Local headers */
 #include "error.h"
 #include "inline.h"
@@ -62,6 +66,45 @@ __attribute__((always_inline)) INLINE static double projected_kernel_eval(
   return (1.0 - f) * tab->value[i] + f * tab->value[i + 1];
 }
 
+/**
+ * @brief Computes the 2D projection of the 3D kernel function for an array
+ * of pixels.
+ *
+ * On input w contains the cosines of the angles between the pixel centres and
+ * the particle. These are replaced with the kernel evaluated at each angle
+ * divided by the angular smoothing length. The loop has no early exits so
+ * that the compiler can vectorize it.
+ *
+ * @param tab The #projected_kernel_table
+ * @param radius The angular smoothing length
+ * @param n The number of pixels
+ * @param w The cosines of the angles on input, the kernel values on output
+ */
+__attribute__((always_inline)) INLINE static void
+projected_kernel_eval_cos_array(const struct projected_kernel_table *tab,
+                                const double radius, const size_t n,
+                                double *restrict w) {
+
+  const double u_max = tab->u_max;
+  const double du = tab->du;
+  const double inv_du = tab->inv_du;
+  const double *restrict value = tab->value;
+
+  for (size_t j = 0; j < n; j += 1) {
+
+    /* Dot product may be a tiny bit greater than one due to rounding error */
+    const double angle = w[j] < 1.0 ? acos(w[j]) : 0.0;
+    const double u = angle / radius;
+
+    /* Interpolate in the table, clamping u to its range */
+    const double u_tab = u < u_max ? u : 0.0;
+    const int i = u_tab * inv_du;
+    const double f = (u_tab - i * du) * inv_du;
+    const double kernel = (1.0 - f) * value[i] + f * value[i + 1];
+    w[j] = u < u_max ? kernel : 0.0;
+  }
+}
+
 void projected_kernel_init(struct projected_kernel_table *tab);
 void projected_kernel_clean(struct projected_kernel_table *tab);
 void projected_kernel_dump(void);
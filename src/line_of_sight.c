@@ -32,18 +32,43 @@
 #include "io_properties.h"
 #include "kernel_hydro.h"
 #include "line_of_sight.h"
+#include "lock.h"
 #include "periodic.h"
 #include "version.h"
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /**
- * @brief Will the line of sight intersect a given cell?
+ * @brief Distance along one axis from a sightline to an interval.
  *
- * Also return 0 if the cell is empty.
+ * @param pos The position of the sightline along the axis.
+ * @param loc The start of the interval.
+ * @param width The width of the interval.
+ * @param periodic Is the axis periodic?
+ * @param dim The size of the box along the axis.
+ */
+static INLINE double los_distance_to_interval(const double pos,
+                                              const double loc,
+                                              const double width,
+                                              const int periodic,
+                                              const double dim) {
+
+  double d = pos - (loc + 0.5 * width);
+  if (periodic) d = nearest(d, dim);
+  return max(fabs(d) - 0.5 * width, 0.);
+}
+
+/**
+ * @brief Could a part of a given cell be in the line of sight?
  *
- * @param c The top level cell.
+ * Also return 0 if the cell is empty. The test accounts for the smoothing
+ * lengths and for the particles having drifted out of the cell since the
+ * last rebuild.
+ *
+ * @param c The cell.
  * @param los The line of sight structure.
  */
 static INLINE int does_los_intersect(const struct cell *c,
@@ -56,41 +81,77 @@ static INLINE int does_los_intersect(const struct cell *c,
   if (c->hydro.h_max <= 0.) error("Invalid h_max for does_los_intersect");
 #endif
 
-  /* Distance from LOS to left and bottom cell edge. */
-  const double cx_min = c->loc[los->xaxis];
-  const double cy_min = c->loc[los->yaxis];
+  /* How far can a part of this cell be from the cell and still smooth into
+   * the sightline? */
+  const double reach = c->hydro.h_max * kernel_gamma + c->hydro.dx_max_part;
 
-  /* Distance from LOS to right and top cell edge. */
-  const double cx_max = c->loc[los->xaxis] + c->width[los->xaxis];
-  const double cy_max = c->loc[los->yaxis] + c->width[los->yaxis];
+  /* Is the cell outside the range considered along the sightline? */
+  const double cz_min = c->loc[los->zaxis] - c->hydro.dx_max_part;
+  const double cz_max =
+      c->loc[los->zaxis] + c->width[los->zaxis] + c->hydro.dx_max_part;
+  if (cz_max < los->range_when_shooting_down_axis[0] ||
+      cz_min > los->range_when_shooting_down_axis[1])
+    return 0;
 
-  /* Maximum smoothing length of a part in this top level cell. */
-  const double hsml = c->hydro.h_max * kernel_gamma;
-  const double hsml2 = hsml * hsml;
+  /* Distance from the LOS to the cell in the plane of the sky. */
+  const double dx = los_distance_to_interval(
+      los->Xpos, c->loc[los->xaxis], c->width[los->xaxis], los->periodic,
+      los->dim[los->xaxis]);
+  const double dy = los_distance_to_interval(
+      los->Ypos, c->loc[los->yaxis], c->width[los->yaxis], los->periodic,
+      los->dim[los->yaxis]);
 
-  double dx, dy;
+  return dx * dx + dy * dy <= reach * reach;
+}
 
-  if (los->periodic) {
-    dx = min(fabs(nearest(cx_min - los->Xpos, los->dim[los->xaxis])),
-             fabs(nearest(cx_max - los->Xpos, los->dim[los->xaxis])));
-    dy = min(fabs(nearest(cy_min - los->Ypos, los->dim[los->yaxis])),
-             fabs(nearest(cy_max - los->Ypos, los->dim[los->yaxis])));
-  } else {
-    dx = fabs(cx_max - los->Xpos);
-    dy = fabs(cy_max - los->Ypos);
-  }
+/**
+ * @brief Is a given part in the line of sight?
+ *
+ * @param p The #part.
+ * @param los The line of sight structure.
+ */
+static INLINE int is_part_in_los(const struct part *p,
+                                 const struct line_of_sight *los) {
 
-  /* Is sightline directly within this top level cell? */
-  if (dx < (1.01 * c->width[los->xaxis]) / 2. &&
-      dy < (1.01 * c->width[los->yaxis]) / 2.) {
-    return 1;
-    /* Could a part from this top level cell smooth into the sightline? */
-  } else if (dx * dx + dy * dy < hsml2) {
-    return 1;
-    /* Don't need to work with this top level cell. */
-  } else {
+  /* Don't consider inhibited parts. */
+  if (p->time_bin == time_bin_inhibited) return 0;
+  if (p->time_bin == time_bin_not_created) return 0;
+
+  /* Don't consider part if outwith allowed z-range. */
+  if (p->x[los->zaxis] < los->range_when_shooting_down_axis[0] ||
+      p->x[los->zaxis] > los->range_when_shooting_down_axis[1])
     return 0;
-  }
+
+  /* Distance from this part to LOS along x dim. */
+  double dx = p->x[los->xaxis] - los->Xpos;
+
+  /* Periodic wrap. */
+  if (los->periodic) dx = nearest(dx, los->dim[los->xaxis]);
+
+  /* Square. */
+  const double dx2 = dx * dx;
+
+  /* Smoothing length of this part. */
+  const double hsml = p->h * kernel_gamma;
+  const double hsml2 = hsml * hsml;
+
+  /* Does this particle fall into our LOS? */
+  if (dx2 >= hsml2) return 0;
+
+  /* Distance from this part to LOS along y dim. */
+  double dy = p->x[los->yaxis] - los->Ypos;
+
+  /* Periodic wrap. */
+  if (los->periodic) dy = nearest(dy, los->dim[los->yaxis]);
+
+  /* Square. */
+  const double dy2 = dy * dy;
+
+  /* Does this part still fall into our LOS? */
+  if (dy2 >= hsml2) return 0;
+
+  /* 2D distance to LOS. */
+  return dx2 + dy2 <= hsml2;
 }
 
 /**
@@ -590,117 +651,357 @@ void los_first_loop_mapper(void *restrict map_data, int count,
   size_t los_particle_count = 0;
 
   /* Loop over each part to find those in LOS. */
-  for (int i = 0; i < count; i++) {
+  for (int i = 0; i < count; i++)
+    if (is_part_in_los(&parts[i], LOS_list)) los_particle_count++;
+
+  atomic_add(&LOS_list->particles_in_los_local, los_particle_count);
+}
 
-    /* Don't consider inhibited parts. */
-    if (parts[i].time_bin == time_bin_inhibited) continue;
+/**
+ * @brief A part found in a line of sight.
+ */
+struct los_hit {
 
-    /* Don't consider part if outwith allowed z-range. */
-    if (parts[i].x[LOS_list->zaxis] <
-            LOS_list->range_when_shooting_down_axis[0] ||
-        parts[i].x[LOS_list->zaxis] >
-            LOS_list->range_when_shooting_down_axis[1])
-      continue;
+  /*! Index of the line of sight. */
+  int los;
 
-    /* Distance from this part to LOS along x dim. */
-    double dx = parts[i].x[LOS_list->xaxis] - LOS_list->Xpos;
+  /*! Index of the part in the space's array. */
+  size_t index;
+};
 
-    /* Periodic wrap. */
-    if (LOS_list->periodic) dx = nearest(dx, LOS_list->dim[LOS_list->xaxis]);
+/**
+ * @brief Compare two #los_hit by line of sight and then by part index.
+ */
+static int los_hit_compare(const void *a, const void *b) {
 
-    /* Square. */
-    const double dx2 = dx * dx;
+  const struct los_hit *ha = (const struct los_hit *)a;
+  const struct los_hit *hb = (const struct los_hit *)b;
+  if (ha->los != hb->los) return ha->los < hb->los ? -1 : 1;
+  if (ha->index != hb->index) return ha->index < hb->index ? -1 : 1;
+  return 0;
+}
 
-    /* Smoothing length of this part. */
-    const double hsml = parts[i].h * kernel_gamma;
-    const double hsml2 = hsml * hsml;
+/**
+ * @brief Data needed to find the parts in all the lines of sight at once.
+ */
+struct los_collect_data {
+
+  /*! The space we work on. */
+  const struct space *s;
 
-    /* Does this particle fall into our LOS? */
-    if (dx2 < hsml2) {
+  /*! The lines of sight. */
+  struct line_of_sight *LOS_list;
 
-      /* Distance from this part to LOS along y dim. */
-      double dy = parts[i].x[LOS_list->yaxis] - LOS_list->Ypos;
+  /*! Sightlines shooting down each axis binned by the top-level column they
+   * pass through: for axis a, the sightlines in column k are
+   * bin_los[a][bin_offset[a][k]] to bin_los[a][bin_offset[a][k + 1] - 1]. */
+  int *bin_offset[3];
+  int *bin_los[3];
 
-      /* Periodic wrap. */
-      if (LOS_list->periodic) dy = nearest(dy, LOS_list->dim[LOS_list->yaxis]);
+  /*! The parts found in the lines of sight. */
+  struct los_hit *hits;
+  size_t num_hits;
+  size_t size_hits;
+  swift_lock_type lock;
+};
 
-      /* Square. */
-      const double dy2 = dy * dy;
+/**
+ * @brief A growable list of #los_hit.
+ */
+struct los_hit_list {
+  struct los_hit *hits;
+  size_t count;
+  size_t size;
+};
 
-      /* Does this part still fall into our LOS? */
-      if (dy2 < hsml2) {
+/**
+ * @brief Add a hit to a #los_hit_list.
+ */
+static void los_hit_list_append(struct los_hit_list *list, const int los,
+                                const size_t index) {
+
+  if (list->count == list->size) {
+    list->size = list->size ? 2 * list->size : 256;
+    list->hits = (struct los_hit *)realloc(list->hits,
+                                           list->size * sizeof(struct los_hit));
+    if (list->hits == NULL) error("Failed to allocate LOS hits.");
+  }
+  list->hits[list->count].los = los;
+  list->hits[list->count].index = index;
+  list->count++;
+}
 
-        /* 2D distance to LOS. */
-        if (dx2 + dy2 <= hsml2) {
+/**
+ * @brief Recursively find the parts of a cell in a set of lines of sight.
+ *
+ * The sightlines that cannot reach the cell are dropped at each level, so
+ * only the leaves close to a sightline have their parts tested.
+ *
+ * @param c The cell.
+ * @param data The #los_collect_data.
+ * @param los The indices of the sightlines that may reach the parent.
+ * @param num_los The number of such sightlines.
+ * @param list The list to add the parts found to.
+ */
+static void los_collect_recursive(const struct cell *c,
+                                  const struct los_collect_data *data,
+                                  const int *los, const int num_los,
+                                  struct los_hit_list *list) {
+
+  /* Keep the sightlines that could reach this cell */
+  int *los_cell = (int *)malloc(num_los * sizeof(int));
+  if (los_cell == NULL) error("Failed to allocate LOS list.");
+  int num_los_cell = 0;
+  for (int k = 0; k < num_los; k++)
+    if (does_los_intersect(c, &data->LOS_list[los[k]]))
+      los_cell[num_los_cell++] = los[k];
+
+  if (num_los_cell > 0) {
+    if (c->split) {
+
+      /* Recurse */
+      for (int k = 0; k < 8; k++)
+        if (c->progeny[k] != NULL)
+          los_collect_recursive(c->progeny[k], data, los_cell, num_los_cell,
+                                list);
+    } else {
 
-          /* We've found one. */
-          los_particle_count++;
-        }
-      }
+      /* Test the parts of this leaf against each remaining sightline */
+      const struct part *parts = c->hydro.parts;
+      const size_t offset = parts - data->s->parts;
+      for (int i = 0; i < c->hydro.count; i++)
+        for (int k = 0; k < num_los_cell; k++)
+          if (is_part_in_los(&parts[i], &data->LOS_list[los_cell[k]]))
+            los_hit_list_append(list, los_cell[k], offset + i);
     }
-  } /* End of loop over all parts */
+  }
 
-  atomic_add(&LOS_list->particles_in_los_local, los_particle_count);
+  free(los_cell);
 }
 
 /**
- * @brief Find all top level cells that a LOS will intersect.
+ * @brief Find the parts of a set of top-level cells in all the lines of
+ * sight.
  *
- * This includes the top level cells the LOS directly passes through
- * and the neighbouring top level cells whose parts could smooth into the LOS.
+ * The candidate sightlines of each top-level cell are read from the columns
+ * of the top-level grid within reach of the cell, then filtered down the
+ * cell tree.
  *
- * @param e The engine.
- * @param los The line_of_sight structure.
- * @param los_cells_top (return) Array indicating whether this cell is
- * intersected.
- * @param cells The array of top-level cells.
- * @param local_cells_with_particles The list of local non-empty top-level
- * cells.
- * @param nr_local_cells_with_particles The number of local non-empty top-level
- * cells.
+ * @param map_data The indices of the local top-level cells with particles.
+ * @param num_elements The number of cells.
+ * @param extra_data The #los_collect_data.
  */
-void find_intersecting_top_level_cells(
-    const struct engine *e, struct line_of_sight *los,
-    int *restrict los_cells_top, const struct cell *cells,
-    const int *restrict local_cells_with_particles,
-    const int nr_local_cells_with_particles) {
+static void los_collect_mapper(void *map_data, int num_elements,
+                               void *extra_data) {
+
+  struct los_collect_data *data = (struct los_collect_data *)extra_data;
+  const struct space *s = data->s;
+  const int *cell_indices = (int *)map_data;
+
+  struct los_hit_list list = {NULL, 0, 0};
+  int *candidates = NULL;
+  int size_candidates = 0;
+
+  for (int n = 0; n < num_elements; n++) {
+
+    const struct cell *c = &s->cells_top[cell_indices[n]];
+    if (c->hydro.count == 0) continue;
+
+    /* How many columns away can a sightline be and still be reached? */
+    const double reach = c->hydro.h_max * kernel_gamma + c->hydro.dx_max_part;
+
+    /* Gather the candidate sightlines along each axis */
+    int num_candidates = 0;
+    for (int zaxis = 0; zaxis < 3; zaxis++) {
+
+      const int xaxis = (zaxis == simulation_x_axis) ? simulation_y_axis
+                                                     : simulation_x_axis;
+      const int yaxis = (zaxis == simulation_z_axis) ? simulation_y_axis
+                                                     : simulation_z_axis;
+      const int cdim_x = s->cdim[xaxis], cdim_y = s->cdim[yaxis];
+      const int ci = (int)(c->loc[xaxis] * s->iwidth[xaxis] + 0.5);
+      const int cj = (int)(c->loc[yaxis] * s->iwidth[yaxis] + 0.5);
+      const int nx = (int)ceil(reach * s->iwidth[xaxis]);
+      const int ny = (int)ceil(reach * s->iwidth[yaxis]);
+
+      for (int di = -nx; di <= nx; di++) {
+        int i = ci + di;
+        if (2 * nx + 1 >= cdim_x) {
+          /* All the columns are in reach: visit each once */
+          if (di >= cdim_x - nx) break;
+          i = di + nx;
+        } else if (s->periodic) {
+          i = (i + cdim_x) % cdim_x;
+        } else if (i < 0 || i >= cdim_x) {
+          continue;
+        }
 
-  /* Keep track of how many top level cells we intersect. */
-  int num_intersecting_top_level_cells = 0;
+        for (int dj = -ny; dj <= ny; dj++) {
+          int j = cj + dj;
+          if (2 * ny + 1 >= cdim_y) {
+            if (dj >= cdim_y - ny) break;
+            j = dj + ny;
+          } else if (s->periodic) {
+            j = (j + cdim_y) % cdim_y;
+          } else if (j < 0 || j >= cdim_y) {
+            continue;
+          }
 
-  /* Loop over each top level cell */
-  for (int n = 0; n < nr_local_cells_with_particles; n++) {
+          const int bin = i * cdim_y + j;
+          for (int k = data->bin_offset[zaxis][bin];
+               k < data->bin_offset[zaxis][bin + 1]; k++) {
+            if (num_candidates == size_candidates) {
+              size_candidates = size_candidates ? 2 * size_candidates : 64;
+              candidates =
+                  (int *)realloc(candidates, size_candidates * sizeof(int));
+              if (candidates == NULL) error("Failed to allocate LOS list.");
+            }
+            candidates[num_candidates++] = data->bin_los[zaxis][k];
+          }
+        }
+      }
+    }
 
-    /* This top level cell. */
-    const struct cell *c = &cells[local_cells_with_particles[n]];
+    /* Record which sightlines this top-level cell intersects */
+    for (int k = 0; k < num_candidates; k++)
+      if (does_los_intersect(c, &data->LOS_list[candidates[k]]))
+        atomic_inc(
+            &data->LOS_list[candidates[k]].num_intersecting_top_level_cells);
 
-    if (does_los_intersect(c, los)) {
-      num_intersecting_top_level_cells++;
-      los_cells_top[n] = 1;
+    /* Walk down the tree */
+    if (num_candidates > 0)
+      los_collect_recursive(c, data, candidates, num_candidates, &list);
+  }
+
+  /* Add the parts found to the global list */
+  if (list.count > 0) {
+    if (lock_lock(&data->lock) != 0) error("Failed to lock LOS hits.");
+    if (data->num_hits + list.count > data->size_hits) {
+      data->size_hits = 2 * (data->num_hits + list.count);
+      data->hits = (struct los_hit *)realloc(
+          data->hits, data->size_hits * sizeof(struct los_hit));
+      if (data->hits == NULL) error("Failed to allocate LOS hits.");
     }
+    memcpy(&data->hits[data->num_hits], list.hits,
+           list.count * sizeof(struct los_hit));
+    data->num_hits += list.count;
+    if (lock_unlock(&data->lock) != 0) error("Failed to unlock LOS hits.");
   }
 
-#ifdef WITH_MPI
-  if (MPI_Allreduce(MPI_IN_PLACE, &num_intersecting_top_level_cells, 1, MPI_INT,
-                    MPI_SUM, MPI_COMM_WORLD) != MPI_SUCCESS)
-    error("Failed to allreduce num_intersecting_top_level_cells.");
+  free(list.hits);
+  free(candidates);
+}
+
+/**
+ * @brief Find the parts in all the lines of sight in one pass over the
+ * local cells.
+ *
+ * On return the hits are sorted by line of sight and then by part index,
+ * and each sightline's local count of parts and number of intersected
+ * top-level cells (on this rank) are set.
+ *
+ * @param s The #space.
+ * @param tp The #threadpool to use.
+ * @param LOS_list The lines of sight.
+ * @param num_los The number of lines of sight.
+ * @param hits (return) The parts found, to be freed by the caller.
+ * @param first_hit (return) Index of the first hit of each line of sight
+ * (num_los + 1 elements), to be freed by the caller.
+ */
+static void los_collect(const struct space *s, struct threadpool *tp,
+                        struct line_of_sight *LOS_list, const int num_los,
+                        struct los_hit **hits, size_t **first_hit) {
+
+  struct los_collect_data data;
+  data.s = s;
+  data.LOS_list = LOS_list;
+  data.hits = NULL;
+  data.num_hits = 0;
+  data.size_hits = 0;
+  if (lock_init(&data.lock) != 0) error("Failed to initialise lock.");
+
+  /* Bin the sightlines by the top-level column they pass through */
+  for (int zaxis = 0; zaxis < 3; zaxis++) {
+
+    const int xaxis =
+        (zaxis == simulation_x_axis) ? simulation_y_axis : simulation_x_axis;
+    const int yaxis =
+        (zaxis == simulation_z_axis) ? simulation_y_axis : simulation_z_axis;
+    const int cdim_x = s->cdim[xaxis], cdim_y = s->cdim[yaxis];
+    const int num_bins = cdim_x * cdim_y;
+
+    data.bin_offset[zaxis] = (int *)calloc(num_bins + 1, sizeof(int));
+    data.bin_los[zaxis] = (int *)malloc(num_los * sizeof(int));
+    int *bin = (int *)malloc(num_los * sizeof(int));
+    if (data.bin_offset[zaxis] == NULL || data.bin_los[zaxis] == NULL ||
+        bin == NULL)
+      error("Failed to allocate LOS bins.");
+
+    for (int j = 0; j < num_los; j++) {
+      bin[j] = -1;
+      if ((int)LOS_list[j].zaxis != zaxis) continue;
+#ifdef SWIFT_DEBUG_CHECKS
+      if ((int)LOS_list[j].xaxis != xaxis || (int)LOS_list[j].yaxis != yaxis)
+        error("Unexpected LOS axes.");
 #endif
+      int i = (int)(LOS_list[j].Xpos * s->iwidth[xaxis]);
+      int k = (int)(LOS_list[j].Ypos * s->iwidth[yaxis]);
+      i = (i < 0) ? 0 : (i >= cdim_x ? cdim_x - 1 : i);
+      k = (k < 0) ? 0 : (k >= cdim_y ? cdim_y - 1 : k);
+      bin[j] = i * cdim_y + k;
+      data.bin_offset[zaxis][bin[j] + 1]++;
+    }
+    for (int k = 0; k < num_bins; k++)
+      data.bin_offset[zaxis][k + 1] += data.bin_offset[zaxis][k];
+    int *fill = (int *)malloc(num_bins * sizeof(int));
+    if (fill == NULL) error("Failed to allocate LOS bins.");
+    memcpy(fill, data.bin_offset[zaxis], num_bins * sizeof(int));
+    for (int j = 0; j < num_los; j++)
+      if (bin[j] >= 0) data.bin_los[zaxis][fill[bin[j]]++] = j;
+    free(fill);
+    free(bin);
+  }
+
+  /* Find all the parts in all the sightlines */
+  for (int j = 0; j < num_los; j++) {
+    LOS_list[j].num_intersecting_top_level_cells = 0;
+    LOS_list[j].particles_in_los_local = 0;
+  }
+  threadpool_map(tp, los_collect_mapper, s->local_cells_with_particles_top,
+                 s->nr_local_cells_with_particles, sizeof(int),
+                 threadpool_auto_chunk_size, &data);
+
+  /* Sort them by sightline then by position in memory */
+  qsort(data.hits, data.num_hits, sizeof(struct los_hit), los_hit_compare);
+
+  *first_hit = (size_t *)malloc((num_los + 1) * sizeof(size_t));
+  if (*first_hit == NULL) error("Failed to allocate LOS offsets.");
+  size_t h = 0;
+  for (int j = 0; j < num_los; j++) {
+    (*first_hit)[j] = h;
+    while (h < data.num_hits && data.hits[h].los == j) h++;
+    LOS_list[j].particles_in_los_local = h - (*first_hit)[j];
+  }
+  (*first_hit)[num_los] = h;
+  *hits = data.hits;
 
-  /* Store how many top level cells this LOS intersects. */
-  los->num_intersecting_top_level_cells = num_intersecting_top_level_cells;
+  for (int zaxis = 0; zaxis < 3; zaxis++) {
+    free(data.bin_offset[zaxis]);
+    free(data.bin_los[zaxis]);
+  }
+  if (lock_destroy(&data.lock) != 0) error("Failed to destroy lock.");
 }
 
 /**
  * @brief Main work function for computing line of sights.
  *
  * 1) Construct N random line of sight positions.
- * 2) Loop over each line of sight.
- *  - 2.1) Find which top level cells sightline intersects.
- *  - 2.2) Loop over each part in these top level cells to see which intersect
- * sightline.
- *  - 2.3) Use this count to construct a LOS parts/xparts array.
- *  - 2.4) Loop over each part and extract those in sightline to new array.
- *  - 2.5) Save sightline parts to HDF5 file.
+ * 2) Find the parts in all the sightlines in one pass over the cell trees,
+ * walking down from the top level cells only where a sightline is in reach.
+ * 3) Loop over each line of sight.
+ *  - 3.1) Use the count of parts to construct a LOS parts/xparts array.
+ *  - 3.2) Copy the parts found in the sightline to the new array.
+ *  - 3.3) Save sightline parts to HDF5 file.
  *
  * @param e The engine.
  */
@@ -754,38 +1055,42 @@ void do_line_of_sight(struct engine *e) {
   /* Main loop over each random LOS. */
   /* ------------------------------- */
 
-  /* Get list of local non-empty top level cells. */
-  const struct cell *cells = e->s->cells_top;
-  const int *local_cells_with_particles = e->s->local_cells_with_particles_top;
-  const int nr_local_cells_with_particles = s->nr_local_cells_with_particles;
+  /* Find the parts of all the sightlines in one pass over the cells. */
+  struct los_hit *hits = NULL;
+  size_t *first_hit = NULL;
+  los_collect(s, &e->threadpool, LOS_list, LOS_params->num_tot, &hits,
+              &first_hit);
+
+#ifdef WITH_MPI
+  /* Total number of top level cells intersected by each LOS */
+  int *num_cells = (int *)malloc(LOS_params->num_tot * sizeof(int));
+  for (int j = 0; j < LOS_params->num_tot; j++)
+    num_cells[j] = LOS_list[j].num_intersecting_top_level_cells;
+  if (MPI_Allreduce(MPI_IN_PLACE, num_cells, LOS_params->num_tot, MPI_INT,
+                    MPI_SUM, MPI_COMM_WORLD) != MPI_SUCCESS)
+    error("Failed to allreduce num_intersecting_top_level_cells.");
+  for (int j = 0; j < LOS_params->num_tot; j++)
+    LOS_list[j].num_intersecting_top_level_cells = num_cells[j];
+  free(num_cells);
+
+  /* How many parts does each rank have for each LOS? */
+  int *local_counts = (int *)malloc(LOS_params->num_tot * sizeof(int));
+  int *all_counts =
+      (int *)malloc(LOS_params->num_tot * e->nr_nodes * sizeof(int));
+  for (int j = 0; j < LOS_params->num_tot; j++)
+    local_counts[j] = LOS_list[j].particles_in_los_local;
+  MPI_Allgather(local_counts, LOS_params->num_tot, MPI_INT, all_counts,
+                LOS_params->num_tot, MPI_INT, MPI_COMM_WORLD);
+  free(local_counts);
+#endif
 
   /* Loop over each random LOS. */
   for (int j = 0; j < LOS_params->num_tot; j++) {
 
-    /* Create empty top level cell list for this LOS */
-    int *los_cells_top = (int *)swift_malloc(
-        "tl_cells_los", nr_local_cells_with_particles * sizeof(int));
-    bzero(los_cells_top, nr_local_cells_with_particles * sizeof(int));
-
-    /* Find all top level cells this LOS will intersect. */
-    find_intersecting_top_level_cells(e, &LOS_list[j], los_cells_top, cells,
-                                      local_cells_with_particles,
-                                      nr_local_cells_with_particles);
-
-    /* Next count all the parts that intersect with this line of sight */
-    for (int n = 0; n < nr_local_cells_with_particles; n++) {
-      if (los_cells_top[n] == 1) {
-        const struct cell *c = &cells[local_cells_with_particles[n]];
-        threadpool_map(&s->e->threadpool, los_first_loop_mapper, c->hydro.parts,
-                       c->hydro.count, sizeof(struct part),
-                       threadpool_auto_chunk_size, &LOS_list[j]);
-      }
-    }
-
 #ifdef SWIFT_DEBUG_CHECKS
     /* Confirm we are capturing all the parts that intersect the LOS by redoing
      * the count looping over all parts in the space (not just those in the
-     * subset of top level cells). */
+     * cells close to the sightline). */
 
     struct part *parts = s->parts;
     const size_t nr_parts = s->nr_parts;
@@ -808,13 +1113,12 @@ void do_line_of_sight(struct engine *e) {
     int *counts = (int *)malloc(sizeof(int) * e->nr_nodes);
     int *offsets = (int *)malloc(sizeof(int) * e->nr_nodes);
 
-    /* How many parts does each rank have for this LOS? */
-    MPI_Allgather(&LOS_list[j].particles_in_los_local, 1, MPI_INT, counts, 1,
-                  MPI_INT, MPI_COMM_WORLD);
-
     int offset_count = 0;
     for (int k = 0; k < e->nr_nodes; k++) {
 
+      /* Parts of this LOS on rank k. */
+      counts[k] = all_counts[k * LOS_params->num_tot + j];
+
       /* Total parts in this LOS. */
       LOS_list[j].particles_in_los_total += counts[k];
 
@@ -842,7 +1146,6 @@ void do_line_of_sight(struct engine *e) {
       free(offsets);
       offsets = NULL;
 #endif
-      swift_free("tl_cells_los", los_cells_top);
       continue;
     }
 
@@ -886,75 +1189,14 @@ void do_line_of_sight(struct engine *e) {
         error("Failed to allocate LOS gpart memory.");
     }
 
-    /* Loop over each part again, pulling out those in LOS. */
+    /* Copy the parts found in this LOS. */
     int count = 0;
-
-    for (int n = 0; n < e->s->nr_local_cells_with_particles; ++n) {
-
-      if (los_cells_top[n] == 0) continue;
-
-      const struct cell *c = &cells[local_cells_with_particles[n]];
-      const struct part *cell_parts = c->hydro.parts;
-      const struct xpart *cell_xparts = c->hydro.xparts;
-      const size_t num_parts_in_cell = c->hydro.count;
-
-      for (size_t i = 0; i < num_parts_in_cell; i++) {
-
-        /* Don't consider inhibited parts. */
-        if (cell_parts[i].time_bin == time_bin_inhibited) continue;
-        if (cell_parts[i].time_bin == time_bin_not_created) continue;
-
-        /* Don't consider part if outwith allowed z-range. */
-        if (cell_parts[i].x[LOS_list[j].zaxis] <
-                LOS_list[j].range_when_shooting_down_axis[0] ||
-            cell_parts[i].x[LOS_list[j].zaxis] >
-                LOS_list[j].range_when_shooting_down_axis[1])
-          continue;
-
-        /* Distance from this part to LOS along x dim. */
-        double dx = cell_parts[i].x[LOS_list[j].xaxis] - LOS_list[j].Xpos;
-
-        /* Periodic wrap. */
-        if (LOS_list[j].periodic)
-          dx = nearest(dx, LOS_list[j].dim[LOS_list[j].xaxis]);
-
-        /* Square */
-        const double dx2 = dx * dx;
-
-        /* Smoothing length of this part. */
-        const double hsml = cell_parts[i].h * kernel_gamma;
-        const double hsml2 = hsml * hsml;
-
-        /* Does this part fall into our LOS? */
-        if (dx2 < hsml2) {
-
-          /* Distance from this part to LOS along y dim. */
-          double dy = cell_parts[i].x[LOS_list[j].yaxis] - LOS_list[j].Ypos;
-
-          /* Periodic wrap. */
-          if (LOS_list[j].periodic)
-            dy = nearest(dy, LOS_list[j].dim[LOS_list[j].yaxis]);
-
-          /* Square */
-          const double dy2 = dy * dy;
-
-          /* Does this part still fall into our LOS? */
-          if (dy2 < hsml2) {
-            /* 2D distance to LOS. */
-
-            if (dx2 + dy2 <= hsml2) {
-
-              /* Store part and xpart properties. */
-              memcpy(&LOS_parts[count], &cell_parts[i], sizeof(struct part));
-              memcpy(&LOS_xparts[count], &cell_xparts[i], sizeof(struct xpart));
-              memcpy(&LOS_gparts[count], cell_parts[i].gpart,
-                     sizeof(struct gpart));
-
-              count++;
-            }
-          }
-        }
-      }
+    for (size_t h = first_hit[j]; h < first_hit[j + 1]; h++) {
+      const size_t i = hits[h].index;
+      memcpy(&LOS_parts[count], &s->parts[i], sizeof(struct part));
+      memcpy(&LOS_xparts[count], &s->xparts[i], sizeof(struct xpart));
+      memcpy(&LOS_gparts[count], s->parts[i].gpart, sizeof(struct gpart));
+      count++;
     }
 
 #ifdef SWIFT_DEBUG_CHECKS
@@ -1031,13 +1273,18 @@ void do_line_of_sight(struct engine *e) {
     free(counts);
     free(offsets);
 #endif
-    swift_free("tl_cells_los", los_cells_top);
     swift_free("los_parts_array", LOS_parts);
     swift_free("los_xparts_array", LOS_xparts);
     swift_free("los_gparts_array", LOS_gparts);
 
   } /* End of loop over each LOS */
 
+  free(hits);
+  free(first_hit);
+#ifdef WITH_MPI
+  free(all_counts);
+#endif
+
   if (e->nodeID == 0) {
     /* Write header */
     write_hdf5_header(h_file, e, LOS_params, total_num_parts_in_los);
@@ -27,10 +27,13 @@
 #include <config.h>
 
 /* Standard includes. */
+#include <errno.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -548,3 +551,111 @@ const char *memuse_process(int inmb) {
   }
   return buffer;
 }
+
+/* Maximum number of live file mappings. */
+#define MEMUSE_MAXMAPPINGS 16
+
+/* The live mappings made by swift_mmap_file(). */
+static struct {
+  void *ptr;
+  size_t size;
+} memuse_mappings[MEMUSE_MAXMAPPINGS];
+static pthread_mutex_t memuse_mappings_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*! Number of live mappings, lets swift_free() skip the search if none. */
+int memuse_nr_mappings = 0;
+
+/**
+ * @brief allocate memory that starts with the contents of a region of a file
+ *        without reading it. The use and results are otherwise the same as
+ *        swift_memalign() with page alignment and the memory must be released
+ *        using swift_free().
+ *
+ * The memory is an anonymous private mapping of size bytes over the start of
+ * which the whole pages of the file region are mapped privately, i.e. copy on
+ * write. The pages of the file are only read when first touched, although
+ * the kernel is asked to start reading them ahead. The bytes of the region
+ * beyond the last whole page (returned as file_size - mapped) are not mapped
+ * and must be read by the caller. The file can be closed and unlinked
+ * afterwards, but must not be truncated or modified in place.
+ *
+ * @param label a symbolic label for the memory, i.e. "parts".
+ * @param memptr pointer to the allocated memory.
+ * @param size the quantity of bytes to allocate.
+ * @param fd the file descriptor of the file, opened for reading.
+ * @param offset the start of the region in the file, a multiple of the
+ *               page size.
+ * @param file_size the size of the region of the file, at most size.
+ * @param mapped (return) the number of bytes of the region that were mapped.
+ * @result zero on success, otherwise an error code.
+ */
+int swift_mmap_file(const char *label, void **memptr, size_t size, int fd,
+                    size_t offset, size_t file_size, size_t *mapped) {
+
+  const size_t page = sysconf(_SC_PAGESIZE);
+  if (offset % page != 0 || file_size > size || size == 0) return EINVAL;
+
+  /* Reserve all the memory. */
+  void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED) return errno;
+
+  /* Map the whole pages of the file over it. */
+  *mapped = (file_size / page) * page;
+  if (*mapped > 0) {
+    if (mmap(ptr, *mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd,
+             offset) == MAP_FAILED) {
+      const int result = errno;
+      munmap(ptr, size);
+      return result;
+    }
+
+    /* Start reading in the background. */
+    madvise(ptr, *mapped, MADV_WILLNEED);
+  }
+
+  /* And remember the mapping for its release. */
+  pthread_mutex_lock(&memuse_mappings_lock);
+  int ind = 0;
+  while (ind < MEMUSE_MAXMAPPINGS && memuse_mappings[ind].ptr != NULL) ind++;
+  if (ind == MEMUSE_MAXMAPPINGS) {
+    pthread_mutex_unlock(&memuse_mappings_lock);
+    munmap(ptr, size);
+    return ENOMEM;
+  }
+  memuse_mappings[ind].ptr = ptr;
+  memuse_mappings[ind].size = size;
+  memuse_nr_mappings++;
+  pthread_mutex_unlock(&memuse_mappings_lock);
+
+#ifdef SWIFT_MEMUSE_REPORTS
+  memuse_log_allocation(label, ptr, 1, size);
+#endif
+
+  *memptr = ptr;
+  return 0;
+}
+
+/**
+ * @brief release the memory if it was allocated by swift_mmap_file().
+ *
+ * @param ptr pointer to the memory.
+ * @result 1 if the memory was a mapping and has been released, 0 otherwise.
+ */
+int memuse_unmap(void *ptr) {
+
+  int found = 0;
+  pthread_mutex_lock(&memuse_mappings_lock);
+  for (int k = 0; k < MEMUSE_MAXMAPPINGS; k++) {
+    if (ptr != NULL && memuse_mappings[k].ptr == ptr) {
+      if (munmap(ptr, memuse_mappings[k].size) != 0)
+        error("Failed to unmap memory (%s)", strerror(errno));
+      memuse_mappings[k].ptr = NULL;
+      memuse_nr_mappings--;
+      found = 1;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&memuse_mappings_lock);
+  return found;
+}
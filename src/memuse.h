@@ -30,6 +30,12 @@ void memuse_use(long *size, long *resident, long *shared, long *text,
                 long *data, long *library, long *dirty);
 const char *memuse_process(int inmb);
 
+/* Memory mapped from files, see swift_mmap_file(). */
+extern int memuse_nr_mappings;
+int swift_mmap_file(const char *label, void **memptr, size_t size, int fd,
+                    size_t offset, size_t file_size, size_t *mapped);
+int memuse_unmap(void *ptr);
+
 #ifdef SWIFT_MEMUSE_REPORTS
 void memuse_log_dump(const char *filename);
 void memuse_log_dump_error(int rank);
@@ -160,8 +166,8 @@ __attribute__((always_inline)) inline void *swift_realloc(const char *label,
 
 /**
  * @brief free aligned memory. The use and results are the same as the
- *        free function. The label should match a prior call to swift_memalign
- *        or swift_malloc.
+ *        free function. The label should match a prior call to swift_memalign,
+ *        swift_malloc or swift_mmap_file.
  *
  * @param label a symbolic label for the memory, i.e. "parts".
  * @param ptr pointer to the allocated memory.
@@ -171,6 +177,8 @@ __attribute__((always_inline)) inline void swift_free(const char *label,
 #ifdef SWIFT_MEMUSE_REPORTS
   memuse_log_allocation(label, ptr, 0, 0);
 #endif
+  /* Memory mapped from a file is released differently. */
+  if (memuse_nr_mappings > 0 && memuse_unmap(ptr)) return;
   free(ptr);
   return;
 }
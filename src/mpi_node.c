@@ -0,0 +1,332 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2024 The SWIFT team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/**
+ *  @file mpi_node.c
+ *  @brief Support for the ranks sharing a physical node (MPI-3 shared
+ *  memory).
+ */
+
+/* Config parameters. */
+#include <config.h>
+
+#ifdef WITH_MPI
+
+/* Standard includes. */
+#include <stdlib.h>
+#include <string.h>
+
+/* This object's header. */
+#include "mpi_node.h"
+
+/* Local includes. */
+#include "align.h"
+#include "error.h"
+#include "memuse.h"
+
+/*! The communicator spanning all the ranks running on this node. */
+MPI_Comm mpi_node_comm = MPI_COMM_NULL;
+
+/*! Rank and size of this rank in #mpi_node_comm. */
+int mpi_node_rank = 0;
+int mpi_node_size = 1;
+
+/*! Map from MPI_COMM_WORLD ranks to #mpi_node_comm ranks (-1 if the rank
+ * lives on another node). */
+static int *mpi_node_world_to_local = NULL;
+
+/*! Number of distinct nodes the run is spread over. */
+static int mpi_node_nr_nodes = 1;
+
+/*! The communicator spanning the first rank of each node (MPI_COMM_NULL on
+ * the other ranks). */
+MPI_Comm mpi_node_leaders_comm = MPI_COMM_NULL;
+
+/*! Map from MPI_COMM_WORLD ranks to the index of their node. */
+static int *mpi_node_world_to_node = NULL;
+
+/**
+ * @brief Create the node-local communicator and the map from world ranks
+ * to node-local ranks.
+ *
+ * Collective over MPI_COMM_WORLD. Repeated calls are no-ops.
+ */
+void mpi_node_init(void) {
+
+  if (mpi_node_comm != MPI_COMM_NULL) return;
+
+  int world_rank, world_size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+  int err = MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED,
+                                world_rank, MPI_INFO_NULL, &mpi_node_comm);
+  if (err != MPI_SUCCESS) mpi_error(err, "Failed to split node communicator.");
+  MPI_Comm_rank(mpi_node_comm, &mpi_node_rank);
+  MPI_Comm_size(mpi_node_comm, &mpi_node_size);
+
+  /* Translate the world ranks into node-local ranks. Ranks not in the node
+   * communicator come back as MPI_UNDEFINED. */
+  MPI_Group world_group, node_group;
+  MPI_Comm_group(MPI_COMM_WORLD, &world_group);
+  MPI_Comm_group(mpi_node_comm, &node_group);
+
+  int *world_ranks = (int *)malloc(world_size * sizeof(int));
+  mpi_node_world_to_local = (int *)malloc(world_size * sizeof(int));
+  if (world_ranks == NULL || mpi_node_world_to_local == NULL)
+    error("Failed to allocate node rank map.");
+  for (int k = 0; k < world_size; k++) world_ranks[k] = k;
+  MPI_Group_translate_ranks(world_group, world_size, world_ranks, node_group,
+                            mpi_node_world_to_local);
+  for (int k = 0; k < world_size; k++)
+    if (mpi_node_world_to_local[k] == MPI_UNDEFINED)
+      mpi_node_world_to_local[k] = -1;
+
+  free(world_ranks);
+  MPI_Group_free(&world_group);
+  MPI_Group_free(&node_group);
+
+  /* Count the nodes: one leader (node rank 0) per node. */
+  int leader = (mpi_node_rank == 0);
+  MPI_Allreduce(&leader, &mpi_node_nr_nodes, 1, MPI_INT, MPI_SUM,
+                MPI_COMM_WORLD);
+
+  /* Number the nodes in the order of their first rank. */
+  err = MPI_Comm_split(MPI_COMM_WORLD, leader ? 0 : MPI_UNDEFINED, world_rank,
+                       &mpi_node_leaders_comm);
+  if (err != MPI_SUCCESS)
+    mpi_error(err, "Failed to split node leaders communicator.");
+  int node_index = 0;
+  if (leader) MPI_Comm_rank(mpi_node_leaders_comm, &node_index);
+  MPI_Bcast(&node_index, 1, MPI_INT, 0, mpi_node_comm);
+
+  if ((mpi_node_world_to_node = (int *)malloc(world_size * sizeof(int))) ==
+      NULL)
+    error("Failed to allocate node index map.");
+  MPI_Allgather(&node_index, 1, MPI_INT, mpi_node_world_to_node, 1, MPI_INT,
+                MPI_COMM_WORLD);
+}
+
+/**
+ * @brief Free the resources associated with the node-local communicator.
+ */
+void mpi_node_clean(void) {
+
+  if (mpi_node_comm == MPI_COMM_NULL) return;
+  MPI_Comm_free(&mpi_node_comm);
+  if (mpi_node_leaders_comm != MPI_COMM_NULL)
+    MPI_Comm_free(&mpi_node_leaders_comm);
+  free(mpi_node_world_to_local);
+  mpi_node_world_to_local = NULL;
+  free(mpi_node_world_to_node);
+  mpi_node_world_to_node = NULL;
+  mpi_node_rank = 0;
+  mpi_node_size = 1;
+  mpi_node_nr_nodes = 1;
+}
+
+/**
+ * @brief Return the rank in #mpi_node_comm of a given MPI_COMM_WORLD rank.
+ *
+ * @param world_rank The rank in MPI_COMM_WORLD.
+ * @return The node-local rank or -1 if that rank runs on another node.
+ */
+int mpi_node_local_rank(int world_rank) {
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (mpi_node_world_to_local == NULL)
+    error("Node communicator has not been initialised.");
+#endif
+  return mpi_node_world_to_local[world_rank];
+}
+
+/**
+ * @brief Return the number of physical nodes the run is spread over.
+ */
+int mpi_node_count_nodes(void) { return mpi_node_nr_nodes; }
+
+/**
+ * @brief Return the index of the node a given MPI_COMM_WORLD rank runs on.
+ *
+ * The nodes are numbered from 0 in the order of their lowest rank, which is
+ * also their rank in #mpi_node_leaders_comm.
+ *
+ * @param world_rank The rank in MPI_COMM_WORLD.
+ */
+int mpi_node_index(int world_rank) {
+
+#ifdef SWIFT_DEBUG_CHECKS
+  if (mpi_node_world_to_node == NULL)
+    error("Node communicator has not been initialised.");
+#endif
+  return mpi_node_world_to_node[world_rank];
+}
+
+/**
+ * @brief Return the map from MPI_COMM_WORLD ranks to the index of their
+ * node (see #mpi_node_index).
+ */
+const int *mpi_node_indices(void) { return mpi_node_world_to_node; }
+
+/**
+ * @brief Allocate a segment of a node-shared window.
+ *
+ * Collective over #mpi_node_comm. Each rank can request a different size
+ * (including zero). On return the base address of each node-mate's segment
+ * is available in w->bases and a passive-target access epoch is open on the
+ * window, so that #mpi_node_window_sync can be used to order accesses.
+ *
+ * @param label The label used to record the allocation in the memory logs.
+ * @param w The #mpi_node_window to initialise.
+ * @param size The size of the local segment in bytes.
+ * @param alignment The required alignment of the local segment.
+ */
+void mpi_node_window_allocate(const char *label, struct mpi_node_window *w,
+                              size_t size, size_t alignment) {
+
+  /* Ask for the segments to be contiguous per rank but not across them, so
+   * the implementation is free to place each segment on its owner's NUMA
+   * domain. We pad to keep the required alignment. */
+  MPI_Info info;
+  MPI_Info_create(&info);
+  MPI_Info_set(info, "alloc_shared_noncontig", "true");
+
+  const size_t padded = size + alignment;
+  int err = MPI_Win_allocate_shared(padded, /*disp_unit=*/1, info,
+                                    mpi_node_comm, &w->base, &w->win);
+  MPI_Info_free(&info);
+  if (err != MPI_SUCCESS)
+    mpi_error(err, "Failed to allocate node-shared window (%s).", label);
+
+  /* Align the local segment. All ranks apply the same rule to the remote
+   * segments, so the views agree. */
+  w->base = (void *)(((size_t)w->base + alignment - 1) / alignment * alignment);
+  w->size = size;
+
+  if ((w->bases = (char **)malloc(mpi_node_size * sizeof(char *))) == NULL)
+    error("Failed to allocate node-shared window bases.");
+  for (int k = 0; k < mpi_node_size; k++) {
+    MPI_Aint remote_size;
+    int disp_unit;
+    void *ptr = NULL;
+    MPI_Win_shared_query(w->win, k, &remote_size, &disp_unit, &ptr);
+    w->bases[k] = (char *)(((size_t)ptr + alignment - 1) / alignment *
+                           alignment);
+  }
+
+  /* Open a passive-target epoch for the lifetime of the window. */
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, w->win);
+
+  memuse_log_allocation(label, w->base, 1, size);
+}
+
+/**
+ * @brief Free a node-shared window.
+ *
+ * Collective over #mpi_node_comm. Does nothing if the window has not been
+ * allocated, but then it must not have been allocated on any node-mate
+ * either.
+ *
+ * @param label The label used to record the allocation in the memory logs.
+ * @param w The #mpi_node_window to free.
+ */
+void mpi_node_window_free(const char *label, struct mpi_node_window *w) {
+
+  if (w->base == NULL) return;
+
+  memuse_log_allocation(label, w->base, 0, 0);
+
+  MPI_Win_unlock_all(w->win);
+  MPI_Win_free(&w->win);
+  free(w->bases);
+  w->bases = NULL;
+  w->base = NULL;
+  w->size = 0;
+}
+
+/**
+ * @brief Synchronise the private and public copies of a node-shared window.
+ *
+ * Acts as a memory barrier: writes made before the call on one rank are
+ * visible to a node-mate calling this after it has been told (e.g. by an MPI
+ * message) that the writes have happened.
+ *
+ * @param w The #mpi_node_window.
+ */
+void mpi_node_window_sync(struct mpi_node_window *w) {
+  int err = MPI_Win_sync(w->win);
+  if (err != MPI_SUCCESS) mpi_error(err, "Failed to sync node-shared window.");
+}
+
+/**
+ * @brief Allocate a block of memory holding a single copy per node of some
+ * read-only data, e.g. tables read from disk.
+ *
+ * Collective over #mpi_node_comm. The memory lives in the segment of the
+ * first rank of the node and all the node-mates get the same view of it.
+ * It must only be written between calls to #mpi_node_shared_begin_write and
+ * #mpi_node_shared_end_write, and then only by the rank for which the former
+ * returned 1. Free with #mpi_node_window_free.
+ *
+ * @param label The label used to record the allocation in the memory logs.
+ * @param w The #mpi_node_window to initialise.
+ * @param size The size of the block in bytes.
+ * @return The address of the block in this rank's address space.
+ */
+void *mpi_node_shared_allocate(const char *label, struct mpi_node_window *w,
+                               size_t size) {
+
+  mpi_node_window_allocate(label, w, mpi_node_rank == 0 ? size : 0,
+                           SWIFT_STRUCT_ALIGNMENT);
+  return w->bases[0];
+}
+
+/**
+ * @brief Start an update of a block allocated by #mpi_node_shared_allocate.
+ *
+ * Collective over #mpi_node_comm. Waits for all the node-mates to be done
+ * reading the block.
+ *
+ * @param w The #mpi_node_window of the block.
+ * @return 1 if this rank has to write the new content, 0 otherwise.
+ */
+int mpi_node_shared_begin_write(struct mpi_node_window *w) {
+
+  MPI_Barrier(mpi_node_comm);
+  mpi_node_window_sync(w);
+  return mpi_node_rank == 0;
+}
+
+/**
+ * @brief Complete an update of a block allocated by
+ * #mpi_node_shared_allocate.
+ *
+ * Collective over #mpi_node_comm. On return the new content is visible to
+ * all the node-mates.
+ *
+ * @param w The #mpi_node_window of the block.
+ */
+void mpi_node_shared_end_write(struct mpi_node_window *w) {
+
+  mpi_node_window_sync(w);
+  MPI_Barrier(mpi_node_comm);
+  mpi_node_window_sync(w);
+}
+
+#endif /* WITH_MPI */
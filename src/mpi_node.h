@@ -0,0 +1,86 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2024 The SWIFT team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_MPI_NODE_H
+#define SWIFT_MPI_NODE_H
+
+/* Config parameters. */
+#include <config.h>
+
+/* Standard headers. */
+#include <stddef.h>
+
+/* MPI headers. */
+#ifdef WITH_MPI
+#include <mpi.h>
+#endif
+
+#ifdef WITH_MPI
+
+/**
+ * @brief A memory segment allocated in an MPI-3 shared-memory window that
+ * spans all the ranks running on the same physical node.
+ *
+ * Each rank owns one segment of the window. The base address of every
+ * segment is cached so that node-mates can read or write it directly.
+ */
+struct mpi_node_window {
+
+  /*! The MPI window handle. */
+  MPI_Win win;
+
+  /*! Local segment of the window (NULL if not allocated). */
+  void *base;
+
+  /*! Size of the local segment in bytes. */
+  size_t size;
+
+  /*! Base address of the segment of each node-local rank. */
+  char **bases;
+};
+
+/* The communicator spanning all the ranks running on this node. */
+extern MPI_Comm mpi_node_comm;
+
+/* Rank and size of this rank in #mpi_node_comm. */
+extern int mpi_node_rank;
+extern int mpi_node_size;
+
+/* The communicator spanning the first rank of each node. */
+extern MPI_Comm mpi_node_leaders_comm;
+
+void mpi_node_init(void);
+void mpi_node_clean(void);
+int mpi_node_local_rank(int world_rank);
+int mpi_node_count_nodes(void);
+int mpi_node_index(int world_rank);
+const int *mpi_node_indices(void);
+
+void mpi_node_window_allocate(const char *label, struct mpi_node_window *w,
+                              size_t size, size_t alignment);
+void mpi_node_window_free(const char *label, struct mpi_node_window *w);
+void mpi_node_window_sync(struct mpi_node_window *w);
+
+void *mpi_node_shared_allocate(const char *label, struct mpi_node_window *w,
+                               size_t size);
+int mpi_node_shared_begin_write(struct mpi_node_window *w);
+void mpi_node_shared_end_write(struct mpi_node_window *w);
+
+#endif /* WITH_MPI */
+
+#endif /* SWIFT_MPI_NODE_H */
@@ -27,21 +27,6 @@
 #include "lightcone/lightcone.h"
 #include "lightcone/lightcone_map_types.h"
 
-/* Compute the dimensionless neutrino momentum (units of kb*T).
- *
- * @param v The internal 3-velocity
- * @param m_eV The neutrino mass in electron-volts
- * @param fac Conversion factor = 1. / (speed_of_light * T_nu_eV)
- */
-INLINE static double neutrino_momentum(const float v[3], const double m_eV,
-                                       const double fac) {
-
-  float v2 = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
-  float vmag = sqrtf(v2);
-  double p = vmag * fac * m_eV;
-  return p;
-}
-
 /**
  * @brief Gather neutrino constants
  *
@@ -59,71 +44,6 @@ void gather_neutrino_consts(const struct space *s, struct neutrino_model *nm) {
   nm->neutrino_seed = s->e->neutrino_properties->neutrino_seed;
 }
 
-/**
- * @brief Compute delta-f weight of a neutrino particle, but *only* when using
- * the delta-f method exclusively on the mesh (otherwise the mass is already
- * weighted).
- *
- * @param gp The #gpart.
- * @param nm Properties of the neutrino model
- * @param weight The resulting weight (output)
- */
-void gpart_neutrino_weight_mesh_only(const struct gpart *gp,
-                                     const struct neutrino_model *nm,
-                                     double *weight) {
-  /* Anything to do? */
-  if (!nm->use_delta_f_mesh_only) return;
-
-  /* Use a particle id dependent seed */
-  const long long seed = gp->id_or_neg_offset + nm->neutrino_seed;
-
-  /* Compute the initial dimensionless momentum from the seed */
-  const double pi = neutrino_seed_to_fermi_dirac(seed);
-
-  /* The neutrino mass and degeneracy (we cycle based on the seed) */
-  const double m_eV = neutrino_seed_to_mass(nm->N_nu, nm->M_nu_eV, seed);
-
-  /* Compute the current dimensionless momentum */
-  double p = neutrino_momentum(gp->v_full, m_eV, nm->fac);
-
-  /* Compute the initial and current background phase-space density */
-  double fi = fermi_dirac_density(pi);
-  double f = fermi_dirac_density(p);
-  *weight = 1.0 - f / fi;
-}
-
-/**
- * @brief Compute the mass and delta-f weight of a neutrino particle
- *
- * @param gp The #gpart.
- * @param nm Properties of the neutrino model
- * @param mass The mass (output)
- * @param weight The resulting weight (output)
- */
-void gpart_neutrino_mass_weight(const struct gpart *gp,
-                                const struct neutrino_model *nm, double *mass,
-                                double *weight) {
-
-  /* Use a particle id dependent seed */
-  const long long seed = gp->id_or_neg_offset + nm->neutrino_seed;
-
-  /* Compute the initial dimensionless momentum from the seed */
-  const double pi = neutrino_seed_to_fermi_dirac(seed);
-
-  /* The neutrino mass and degeneracy (we cycle based on the seed) */
-  const double m_eV = neutrino_seed_to_mass(nm->N_nu, nm->M_nu_eV, seed);
-  const double deg = neutrino_seed_to_degeneracy(nm->N_nu, nm->deg_nu, seed);
-  *mass = deg * m_eV * nm->inv_mass_factor;
-
-  /* Compute the current dimensionless momentum */
-  const double p = neutrino_momentum(gp->v_full, m_eV, nm->fac);
-
-  /* Compute the initial and current background phase-space density */
-  const double fi = fermi_dirac_density(pi);
-  const double f = fermi_dirac_density(p);
-  *weight = 1.0 - f / fi;
-}
-
 /**
  * @brief Compute diagnostics for the neutrino delta-f method, including
  * the mean squared weight.
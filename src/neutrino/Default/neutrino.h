@@ -46,12 +46,110 @@ struct neutrino_model {
 };
 
 void gather_neutrino_consts(const struct space *s, struct neutrino_model *nm);
-void gpart_neutrino_weight_mesh_only(const struct gpart *gp,
-                                     const struct neutrino_model *nm,
-                                     double *weight);
-void gpart_neutrino_mass_weight(const struct gpart *gp,
-                                const struct neutrino_model *nm, double *mass,
-                                double *weight);
+
+/* Compute the dimensionless neutrino momentum (units of kb*T).
+ *
+ * @param v The internal 3-velocity
+ * @param m_eV The neutrino mass in electron-volts
+ * @param fac Conversion factor = 1. / (speed_of_light * T_nu_eV)
+ */
+__attribute__((always_inline)) INLINE static double neutrino_momentum(
+    const float v[3], const double m_eV, const double fac) {
+
+  float v2 = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+  float vmag = sqrtf(v2);
+  double p = vmag * fac * m_eV;
+  return p;
+}
+
+/**
+ * @brief Background phase-space density at the initial momentum of a
+ * neutrino particle.
+ *
+ * When configured with --enable-neutrino-cache, this was stored in the
+ * #gpart by gravity_first_init_neutrino(). Otherwise, the initial momentum
+ * is drawn again from the particle's seed. As fermi_dirac_density() is
+ * evaluated in single precision, a float holds it exactly and both give the
+ * same value. This matters as the delta-f weight 1 - f / fi cancels while
+ * the momentum is close to its initial value.
+ *
+ * @param gp The #gpart.
+ * @param neutrino_seed The global neutrino seed.
+ */
+__attribute__((always_inline)) INLINE static double
+gpart_neutrino_initial_density(const struct gpart *gp,
+                               const long long neutrino_seed) {
+#ifdef SWIFT_NEUTRINO_CACHE
+  return gp->neutrino_f_initial;
+#else
+  /* Use a particle id dependent seed */
+  const long long seed = gp->id_or_neg_offset + neutrino_seed;
+
+  /* Compute the initial dimensionless momentum from the seed */
+  const double pi = neutrino_seed_to_fermi_dirac(seed);
+  return fermi_dirac_density(pi);
+#endif
+}
+
+/**
+ * @brief Compute delta-f weight of a neutrino particle, but *only* when using
+ * the delta-f method exclusively on the mesh (otherwise the mass is already
+ * weighted).
+ *
+ * @param gp The #gpart.
+ * @param nm Properties of the neutrino model
+ * @param weight The resulting weight (output)
+ */
+__attribute__((always_inline)) INLINE static void
+gpart_neutrino_weight_mesh_only(const struct gpart *gp,
+                                const struct neutrino_model *nm,
+                                double *weight) {
+  /* Anything to do? */
+  if (!nm->use_delta_f_mesh_only) return;
+
+  /* Use a particle id dependent seed */
+  const long long seed = gp->id_or_neg_offset + nm->neutrino_seed;
+
+  /* The neutrino mass and degeneracy (we cycle based on the seed) */
+  const double m_eV = neutrino_seed_to_mass(nm->N_nu, nm->M_nu_eV, seed);
+
+  /* Compute the current dimensionless momentum */
+  double p = neutrino_momentum(gp->v_full, m_eV, nm->fac);
+
+  /* Compute the initial and current background phase-space density */
+  double fi = gpart_neutrino_initial_density(gp, nm->neutrino_seed);
+  double f = fermi_dirac_density(p);
+  *weight = 1.0 - f / fi;
+}
+
+/**
+ * @brief Compute the mass and delta-f weight of a neutrino particle
+ *
+ * @param gp The #gpart.
+ * @param nm Properties of the neutrino model
+ * @param mass The mass (output)
+ * @param weight The resulting weight (output)
+ */
+__attribute__((always_inline)) INLINE static void gpart_neutrino_mass_weight(
+    const struct gpart *gp, const struct neutrino_model *nm, double *mass,
+    double *weight) {
+
+  /* Use a particle id dependent seed */
+  const long long seed = gp->id_or_neg_offset + nm->neutrino_seed;
+
+  /* The neutrino mass and degeneracy (we cycle based on the seed) */
+  const double m_eV = neutrino_seed_to_mass(nm->N_nu, nm->M_nu_eV, seed);
+  const double deg = neutrino_seed_to_degeneracy(nm->N_nu, nm->deg_nu, seed);
+  *mass = deg * m_eV * nm->inv_mass_factor;
+
+  /* Compute the current dimensionless momentum */
+  const double p = neutrino_momentum(gp->v_full, m_eV, nm->fac);
+
+  /* Compute the initial and current background phase-space density */
+  const double fi = gpart_neutrino_initial_density(gp, nm->neutrino_seed);
+  const double f = fermi_dirac_density(p);
+  *weight = 1.0 - f / fi;
+}
 
 /* Compute the ratio of macro particle mass in internal mass units to
  * the mass of one microscopic neutrino in eV.
@@ -95,13 +193,29 @@ INLINE static double neutrino_mass_factor(
  * This function is called only once just after the ICs have been read in
  * and after IDs have been remapped (if used) by space_remap_ids().
  *
+ * When configured with --enable-neutrino-cache, the background density at
+ * the initial momentum drawn from the particle's seed is stored in the
+ * particle, such that the delta-f weights do not need to draw it again.
+ *
  * @param gp The particle to act upon
  * @param engine The engine of the run
  */
 __attribute__((always_inline)) INLINE static void gravity_first_init_neutrino(
     struct gpart *gp, const struct engine *e) {
 
-  /* Do we need to do anything? */
+  /* Use a particle id dependent seed */
+  const long long neutrino_seed = e->neutrino_properties->neutrino_seed;
+  const long long seed = gp->id_or_neg_offset + neutrino_seed;
+
+  /* Compute the initial dimensionless momentum from the seed */
+  const double pi = neutrino_seed_to_fermi_dirac(seed);
+
+#ifdef SWIFT_NEUTRINO_CACHE
+  /* Store the background density at that momentum for the delta-f weights */
+  gp->neutrino_f_initial = fermi_dirac_density(pi);
+#endif
+
+  /* Do we need to do anything else? */
   if (!e->neutrino_properties->generate_ics) return;
 
   /* Retrieve physical and cosmological constants */
@@ -112,13 +226,6 @@ __attribute__((always_inline)) INLINE static void gravity_first_init_neutrino(
   const double T_eV = e->cosmology->T_nu_0_eV;
   const double inv_fac = c_vel * T_eV;
   const double inv_mass_factor = 1. / e->neutrino_mass_conversion_factor;
-  const long long neutrino_seed = e->neutrino_properties->neutrino_seed;
-
-  /* Use a particle id dependent seed */
-  const long long seed = gp->id_or_neg_offset + neutrino_seed;
-
-  /* Compute the initial dimensionless momentum from the seed */
-  const double pi = neutrino_seed_to_fermi_dirac(seed);
 
   /* The neutrino mass and degeneracy (we cycle based on the neutrino seed) */
   const double m_eV = neutrino_seed_to_mass(N_nu, m_eV_array, seed);
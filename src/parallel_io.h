@@ -30,6 +30,7 @@
 /* Includes. */
 #include "ic_info.h"
 #include "part.h"
+#include "partition.h"
 
 struct engine;
 struct unit_system;
@@ -47,7 +48,8 @@ void read_ic_parallel(char* fileName, const struct unit_system* internal_units,
                       const int cleanup_sqrt_a, const double h, const double a,
                       const int mpi_rank, const int mpi_size, MPI_Comm comm,
                       MPI_Info info, const int nr_threads, const int dry_run,
-                      const int remap_ids, struct ic_info* ics_metadata);
+                      const int remap_ids, struct ic_info* ics_metadata,
+                      struct partition* initial_partition);
 
 void write_output_parallel(struct engine* e,
                            const struct unit_system* internal_units,
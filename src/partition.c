@@ -68,7 +68,8 @@ const char *initial_partition_name[] = {
     "axis aligned grids of cells", "vectorized point associated cells",
     "memory balanced, using particle weighted cells",
     "similar sized regions, using unweighted cells",
-    "memory and edge balanced cells using particle weights"};
+    "memory and edge balanced cells using particle weights",
+    "cells of the initial conditions, as read by each rank"};
 
 /* Simple descriptions of repartition types for reports. */
 const char *repartition_name[] = {
@@ -2017,6 +2018,36 @@ void partition_initial_partition(struct partition *initial_partition,
     error("SWIFT was not compiled with METIS or ParMETIS support");
 #endif
 
+  } else if (initial_partition->type == INITPART_ICS) {
+
+    /* Each rank only read the particles of some of the top-level cells of
+     * the ICs, so give each cell to the rank that read the IC cell
+     * containing its centre. */
+    const int *ic_cdim = initial_partition->ic_cdim;
+    for (int k = 0; k < s->nr_cells; k++) {
+      struct cell *c = &s->cells_top[k];
+      int ind[3];
+      for (int j = 0; j < 3; j++) {
+        ind[j] = (c->loc[j] + 0.5 * c->width[j]) / s->dim[j] * ic_cdim[j];
+        if (ind[j] < 0) ind[j] = 0;
+        if (ind[j] >= ic_cdim[j]) ind[j] = ic_cdim[j] - 1;
+      }
+      const int cid = cell_getid(ic_cdim, ind[0], ind[1], ind[2]);
+      c->nodeID = initial_partition->ic_cell_ranks[cid];
+    }
+
+    free(initial_partition->ic_cell_ranks);
+    initial_partition->ic_cell_ranks = NULL;
+
+    /* A coarser cell grid than the one of the ICs could miss a rank. */
+    if (!check_complete(s, (nodeID == 0), nr_nodes)) {
+      if (nodeID == 0)
+        message("ICs initial partition failed, using a vectorised partition");
+      initial_partition->type = INITPART_VECTORIZE;
+      partition_initial_partition(initial_partition, nodeID, nr_nodes, s);
+      return;
+    }
+
   } else if (initial_partition->type == INITPART_VECTORIZE) {
 
 #if defined(WITH_MPI)
@@ -2090,6 +2121,9 @@ void partition_init(struct partition *partition,
     case 'v':
       partition->type = INITPART_VECTORIZE;
       break;
+    case 'i':
+      partition->type = INITPART_ICS;
+      break;
 #if defined(HAVE_METIS) || defined(HAVE_PARMETIS)
     case 'r':
       partition->type = INITPART_METIS_NOWEIGHT;
@@ -2103,17 +2137,20 @@ void partition_init(struct partition *partition,
     default:
       message("Invalid choice of initial partition type '%s'.", part_type);
       error(
-          "Permitted values are: 'grid', 'region', 'memory', 'edgememory' or "
-          "'vectorized'");
+          "Permitted values are: 'grid', 'region', 'memory', 'edgememory', "
+          "'ics' or 'vectorized'");
 #else
     default:
       message("Invalid choice of initial partition type '%s'.", part_type);
       error(
-          "Permitted values are: 'grid' or 'vectorized' when compiled "
+          "Permitted values are: 'grid', 'ics' or 'vectorized' when compiled "
           "without METIS or ParMETIS.");
 #endif
   }
 
+  /* Only known once the ICs have been read. */
+  partition->ic_cell_ranks = NULL;
+
   /* In case of grid, read more parameters */
   if (part_type[0] == 'g') {
     parser_get_opt_param_int_array(params, "DomainDecomposition:initial_grid",
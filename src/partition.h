@@ -29,7 +29,8 @@ enum partition_type {
   INITPART_VECTORIZE,
   INITPART_METIS_WEIGHT,
   INITPART_METIS_NOWEIGHT,
-  INITPART_METIS_WEIGHT_EDGE
+  INITPART_METIS_WEIGHT_EDGE,
+  INITPART_ICS
 };
 
 /* Simple descriptions of types for reports. */
@@ -40,6 +41,10 @@ struct partition {
   enum partition_type type;
   int grid[3];
   int usemetis;
+
+  /* Top-level cells of the ICs and the rank that read each of them. */
+  int ic_cdim[3];
+  int *ic_cell_ranks;
 };
 
 /* Repartition type to use. */
@@ -24,6 +24,7 @@
 #include <float.h>
 #include <limits.h>
 #include <sched.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -42,6 +43,7 @@
 #include "engine.h"
 #include "error.h"
 #include "memuse.h"
+#include "mpi_node.h"
 #include "space.h"
 #include "threadpool.h"
 
@@ -187,12 +189,328 @@ void proxy_tags_exchange(struct proxy *proxies, int num_proxies,
 #endif
 }
 
+/**
+ * @brief Exchange the offsets of the foreign particles in the node-shared
+ * foreign buffers between node-mates.
+ *
+ * Every rank sends to each of its node-mates the offsets at which the
+ * particles of the cells it receives from them start in its node-shared
+ * foreign buffers. The owner of the cells attaches these offsets to its send
+ * tasks so that it can write the particles there directly.
+ *
+ * Note that this function assumes that the foreign particles have been
+ * linked, e.g. via #engine_allocate_foreign_particles, and that the send
+ * tasks exist.
+ *
+ * @param proxies The list of #proxy that will send/recv offsets.
+ * @param num_proxies The number of proxies.
+ * @param s The space holding the foreign buffers.
+ */
+void proxy_node_offsets_exchange(struct proxy *proxies, int num_proxies,
+                                 struct space *s) {
+
+#ifdef WITH_MPI
+
+  /* Count the offsets going to and coming from the node-mates. */
+  int count_in = 0;
+  int count_out = 0;
+  int num_reqs = 0;
+  for (int k = 0; k < num_proxies; k++) {
+    if (mpi_node_local_rank(proxies[k].nodeID) < 0) continue;
+    for (int j = 0; j < proxies[k].nr_cells_in; j++)
+      count_out += 2 * proxies[k].cells_in[j]->mpi.pcell_size;
+    for (int j = 0; j < proxies[k].nr_cells_out; j++)
+      count_in += 2 * proxies[k].cells_out[j]->mpi.pcell_size;
+    num_reqs += proxies[k].nr_cells_in + proxies[k].nr_cells_out;
+  }
+
+  /* Allocate the offsets and the requests. */
+  long long *offsets_in = NULL;
+  long long *offsets_out = NULL;
+  if (swift_memalign("node_offsets_in", (void **)&offsets_in,
+                     SWIFT_CACHE_ALIGNMENT, sizeof(long long) * count_in) != 0 ||
+      swift_memalign("node_offsets_out", (void **)&offsets_out,
+                     SWIFT_CACHE_ALIGNMENT,
+                     sizeof(long long) * count_out) != 0)
+    error("Failed to allocate node offsets buffers.");
+  MPI_Request *reqs = NULL;
+  if ((reqs = (MPI_Request *)malloc(sizeof(MPI_Request) * num_reqs)) == NULL)
+    error("Failed to allocate MPI_Request arrays.");
+
+  /* Pack our offsets and emit the sends and recvs. */
+  for (int rid = 0, ind_in = 0, ind_out = 0, k = 0; k < num_proxies; k++) {
+    if (mpi_node_local_rank(proxies[k].nodeID) < 0) continue;
+
+    for (int j = 0; j < proxies[k].nr_cells_in; j++) {
+      struct cell *c = proxies[k].cells_in[j];
+      const int cid = c - s->cells_top;
+      const int count = 2 * cell_pack_node_offsets(c, s, &offsets_out[ind_out]);
+      int err = MPI_Isend(&offsets_out[ind_out], count, MPI_LONG_LONG_INT,
+                          proxies[k].nodeID, cid, MPI_COMM_WORLD, &reqs[rid]);
+      if (err != MPI_SUCCESS) mpi_error(err, "Failed to isend node offsets.");
+      ind_out += count;
+      rid += 1;
+    }
+    for (int j = 0; j < proxies[k].nr_cells_out; j++) {
+      const struct cell *c = proxies[k].cells_out[j];
+      const int cid = c - s->cells_top;
+      const int count = 2 * c->mpi.pcell_size;
+      int err = MPI_Irecv(&offsets_in[ind_in], count, MPI_LONG_LONG_INT,
+                          proxies[k].nodeID, cid, MPI_COMM_WORLD, &reqs[rid]);
+      if (err != MPI_SUCCESS) mpi_error(err, "Failed to irecv node offsets.");
+      ind_in += count;
+      rid += 1;
+    }
+  }
+
+  if (MPI_Waitall(num_reqs, reqs, MPI_STATUSES_IGNORE) != MPI_SUCCESS)
+    error("MPI_Waitall on node offsets failed.");
+
+  /* Attach the offsets we received to our send tasks. */
+  for (int ind_in = 0, k = 0; k < num_proxies; k++) {
+    if (mpi_node_local_rank(proxies[k].nodeID) < 0) continue;
+
+    for (int j = 0; j < proxies[k].nr_cells_out; j++) {
+      ind_in += 2 * cell_unpack_node_offsets(proxies[k].cells_out[j],
+                                             proxies[k].nodeID,
+                                             &offsets_in[ind_in]);
+    }
+  }
+
+  /* Clean up. */
+  swift_free("node_offsets_in", offsets_in);
+  swift_free("node_offsets_out", offsets_out);
+  free(reqs);
+
+#else
+  error("SWIFT was not compiled with MPI support.");
+#endif
+}
+
+/*! Kinds of records in the encoded cell tree buffers. */
+enum proxy_pcell_record {
+  proxy_pcell_record_full = 0,
+  proxy_pcell_record_patch = 1,
+};
+
+/*! Number of blocks of fields a #pcell is split into for the patches. */
+#define proxy_pcell_nr_blocks 8
+
+/*! Boundaries of the blocks. They cover the whole #pcell, padding included,
+ * and separate the multipole from the gravity counts and times as the latter
+ * change much more often. */
+static const size_t proxy_pcell_blocks[proxy_pcell_nr_blocks + 1] = {
+    offsetof(struct pcell, hydro),
+    offsetof(struct pcell, grav),
+    offsetof(struct pcell, grav.ti_end_min),
+    offsetof(struct pcell, stars),
+    offsetof(struct pcell, black_holes),
+    offsetof(struct pcell, sinks),
+    offsetof(struct pcell, rt),
+    offsetof(struct pcell, maxdepth),
+    sizeof(struct pcell)};
+
+/**
+ * @brief Encode a cell tree relative to the version sent at the previous
+ * exchange.
+ *
+ * If the structure of the tree has not changed, only the #pcell that differ
+ * are written, each restricted to the blocks of fields that changed. The
+ * tree is written in full otherwise, or if the patch would not be smaller.
+ *
+ * @param prev The tree sent at the previous exchange (NULL if none).
+ * @param prev_size The number of #pcell in prev.
+ * @param cur The current tree.
+ * @param cur_size The number of #pcell in cur.
+ * @param buffer The buffer to write the record to.
+ * @return The number of bytes written.
+ */
+size_t proxy_pcell_encode(const struct pcell *prev, const int prev_size,
+                          const struct pcell *cur, const int cur_size,
+                          char *buffer) {
+
+  int header[2];
+  char *out = buffer + sizeof(header);
+  const size_t full_bytes = cur_size * sizeof(struct pcell);
+
+  /* Same tree structure? */
+  int patch = (prev != NULL && prev_size == cur_size);
+  for (int i = 0; patch && i < cur_size; i++)
+    if (memcmp(prev[i].progeny, cur[i].progeny, sizeof(cur[i].progeny)) != 0)
+      patch = 0;
+
+  if (patch) {
+    int nr_changed = 0;
+    size_t used = 0;
+    for (int i = 0; i < cur_size; i++) {
+      const char *p_prev = (const char *)&prev[i];
+      const char *p_cur = (const char *)&cur[i];
+
+      /* Which blocks have changed? */
+      int mask = 0;
+      size_t record = 2 * sizeof(int);
+      for (int b = 0; b < proxy_pcell_nr_blocks; b++) {
+        const size_t offset = proxy_pcell_blocks[b];
+        const size_t size = proxy_pcell_blocks[b + 1] - offset;
+        if (memcmp(p_prev + offset, p_cur + offset, size) != 0) {
+          mask |= (1 << b);
+          record += size;
+        }
+      }
+      if (mask == 0) continue;
+
+      /* Give up if this is getting larger than the full tree. */
+      if (used + record > full_bytes) {
+        patch = 0;
+        break;
+      }
+
+      memcpy(out + used, &i, sizeof(int));
+      memcpy(out + used + sizeof(int), &mask, sizeof(int));
+      used += 2 * sizeof(int);
+      for (int b = 0; b < proxy_pcell_nr_blocks; b++) {
+        if (!(mask & (1 << b))) continue;
+        const size_t offset = proxy_pcell_blocks[b];
+        const size_t size = proxy_pcell_blocks[b + 1] - offset;
+        memcpy(out + used, p_cur + offset, size);
+        used += size;
+      }
+      nr_changed++;
+    }
+
+    if (patch) {
+      header[0] = proxy_pcell_record_patch;
+      header[1] = nr_changed;
+      memcpy(buffer, header, sizeof(header));
+      return sizeof(header) + used;
+    }
+  }
+
+  /* Send the whole tree. */
+  header[0] = proxy_pcell_record_full;
+  header[1] = cur_size;
+  memcpy(buffer, header, sizeof(header));
+  memcpy(out, cur, full_bytes);
+  return sizeof(header) + full_bytes;
+}
+
+/**
+ * @brief Decode a cell tree record written by #proxy_pcell_encode.
+ *
+ * @param buffer The buffer to read the record from.
+ * @param prev The tree received at the previous exchange (NULL if none).
+ * @param prev_size The number of #pcell in prev.
+ * @param cur Where to write the tree, or NULL to only get its size.
+ * @param cur_size (return) The number of #pcell in the tree.
+ * @return The number of bytes read.
+ */
+size_t proxy_pcell_decode(const char *buffer, const struct pcell *prev,
+                          const int prev_size, struct pcell *cur,
+                          int *cur_size) {
+
+  int header[2];
+  memcpy(header, buffer, sizeof(header));
+  const char *in = buffer + sizeof(header);
+
+  if (header[0] == proxy_pcell_record_full) {
+    *cur_size = header[1];
+    if (cur != NULL) memcpy(cur, in, header[1] * sizeof(struct pcell));
+    return sizeof(header) + header[1] * sizeof(struct pcell);
+  }
+
+  if (header[0] != proxy_pcell_record_patch)
+    error("Invalid cell tree record (%d).", header[0]);
+  if (prev == NULL) error("Received changes to a tree we do not have.");
+
+  *cur_size = prev_size;
+  if (cur != NULL) memcpy(cur, prev, prev_size * sizeof(struct pcell));
+
+  size_t used = 0;
+  for (int k = 0; k < header[1]; k++) {
+    int index, mask;
+    memcpy(&index, in + used, sizeof(int));
+    memcpy(&mask, in + used + sizeof(int), sizeof(int));
+    used += 2 * sizeof(int);
+    if (index < 0 || index >= prev_size)
+      error("Invalid cell index in tree patch (%d/%d).", index, prev_size);
+    for (int b = 0; b < proxy_pcell_nr_blocks; b++) {
+      if (!(mask & (1 << b))) continue;
+      const size_t offset = proxy_pcell_blocks[b];
+      const size_t size = proxy_pcell_blocks[b + 1] - offset;
+      if (cur != NULL) memcpy((char *)&cur[index] + offset, in + used, size);
+      used += size;
+    }
+  }
+  return sizeof(header) + used;
+}
+
+#ifdef WITH_MPI
+
+/**
+ * @brief Rebuild the foreign cell trees of a proxy from the received
+ * changes and the trees of the previous exchange.
+ *
+ * @param p The #proxy.
+ */
+static void proxy_cells_decode(struct proxy *p) {
+
+  const char *buffer = (const char *)p->pcells_delta_in;
+  const size_t size_buffer = p->size_pcells_delta_in * sizeof(struct pcell);
+
+  int *offset = (int *)swift_malloc("pcells_in_offset",
+                                    (p->nr_cells_in + 1) * sizeof(int));
+  if (offset == NULL) error("Failed to allocate pcell_in offsets.");
+
+  /* Get the size of the new trees. */
+  size_t bytes = 0;
+  offset[0] = 0;
+  for (int j = 0; j < p->nr_cells_in; j++) {
+    const int cached = p->pcells_cached;
+    const int prev_offset = cached ? p->pcells_in_offset[j] : 0;
+    const int prev_size = cached ? p->pcells_in_offset[j + 1] - prev_offset : 0;
+    int size = 0;
+    bytes += proxy_pcell_decode(buffer + bytes,
+                                cached ? &p->pcells_in[prev_offset] : NULL,
+                                prev_size, /*cur=*/NULL, &size);
+    if (bytes > size_buffer) error("Cell tree records overflow the buffer.");
+    offset[j + 1] = offset[j] + size;
+  }
+
+  /* Apply the changes. */
+  struct pcell *pcells = NULL;
+  if (swift_memalign("pcells_in", (void **)&pcells, SWIFT_STRUCT_ALIGNMENT,
+                     sizeof(struct pcell) * offset[p->nr_cells_in]) != 0)
+    error("Failed to allocate pcell_in buffer.");
+
+  bytes = 0;
+  for (int j = 0; j < p->nr_cells_in; j++) {
+    const int cached = p->pcells_cached;
+    const int prev_offset = cached ? p->pcells_in_offset[j] : 0;
+    const int prev_size = cached ? p->pcells_in_offset[j + 1] - prev_offset : 0;
+    int size = 0;
+    bytes += proxy_pcell_decode(buffer + bytes,
+                                cached ? &p->pcells_in[prev_offset] : NULL,
+                                prev_size, &pcells[offset[j]], &size);
+  }
+
+  /* Keep the new trees for the next exchange. */
+  if (p->pcells_in != NULL) swift_free("pcells_in", p->pcells_in);
+  if (p->pcells_in_offset != NULL)
+    swift_free("pcells_in_offset", p->pcells_in_offset);
+  p->pcells_in = pcells;
+  p->pcells_in_offset = offset;
+  p->size_pcells_in = offset[p->nr_cells_in];
+}
+
+#endif /* WITH_MPI */
+
 /**
  * @brief Exchange cells with a remote node, first part.
  *
- * The first part of the transaction sends the local cell count and the packed
- * #pcell array to the destination node, and enqueues an @c MPI_Irecv for
- * the foreign cell counts.
+ * The first part of the transaction encodes the changes to the local cell
+ * trees since the last exchange with this node, sends their size and the
+ * encoded buffer to the destination node, and enqueues an @c MPI_Irecv for
+ * the size of the foreign buffer.
  *
  * @param p The #proxy.
  */
@@ -200,48 +518,76 @@ void proxy_cells_exchange_first(struct proxy *p) {
 
 #ifdef WITH_MPI
 
-  /* Get the number of pcells we will need to send. */
-  p->size_pcells_out = 0;
+  /* Get the number of pcells in the trees we will send. */
+  int size_pcells = 0;
   for (int k = 0; k < p->nr_cells_out; k++)
-    p->size_pcells_out += p->cells_out[k]->mpi.pcell_size;
+    size_pcells += p->cells_out[k]->mpi.pcell_size;
+
+  /* Allocate the buffer for the encoded trees. A record is never larger
+   * than its full tree plus a header, which fits in one pcell. */
+  if (swift_memalign("pcells_delta_out", (void **)&p->pcells_delta_out,
+                     SWIFT_STRUCT_ALIGNMENT,
+                     sizeof(struct pcell) * (size_pcells + p->nr_cells_out)) !=
+      0)
+    error("Failed to allocate pcell_delta_out buffer.");
+
+  /* Encode the trees against the ones we sent last time. */
+  char *buffer = (char *)p->pcells_delta_out;
+  size_t bytes = 0;
+  for (int k = 0; k < p->nr_cells_out; k++) {
+    const struct cell *c = p->cells_out[k];
+    const int cached = p->pcells_cached;
+    const int prev_offset = cached ? p->pcells_out_offset[k] : 0;
+    const int prev_size =
+        cached ? p->pcells_out_offset[k + 1] - prev_offset : 0;
+    bytes += proxy_pcell_encode(cached ? &p->pcells_out[prev_offset] : NULL,
+                                prev_size, c->mpi.pcell, c->mpi.pcell_size,
+                                buffer + bytes);
+  }
+  p->size_pcells_delta_out =
+      (bytes + sizeof(struct pcell) - 1) / sizeof(struct pcell);
+  memset(buffer + bytes, 0,
+         p->size_pcells_delta_out * sizeof(struct pcell) - bytes);
 
-  /* Send the number of pcells. */
-  int err = MPI_Isend(&p->size_pcells_out, 1, MPI_INT, p->nodeID,
+  /* Send the size of the encoded buffer. */
+  int err = MPI_Isend(&p->size_pcells_delta_out, 1, MPI_INT, p->nodeID,
                       p->mynodeID * proxy_tag_shift + proxy_tag_count,
                       MPI_COMM_WORLD, &p->req_cells_count_out);
   if (err != MPI_SUCCESS) mpi_error(err, "Failed to isend nr of pcells.");
-  // message( "isent pcell count (%i) from node %i to node %i." ,
-  // p->size_pcells_out , p->mynodeID , p->nodeID ); fflush(stdout);
 
-  /* Allocate and fill the pcell buffer. */
+  /* Send the encoded buffer. */
+  err = MPI_Isend(p->pcells_delta_out, p->size_pcells_delta_out,
+                  pcell_mpi_type, p->nodeID,
+                  p->mynodeID * proxy_tag_shift + proxy_tag_cells,
+                  MPI_COMM_WORLD, &p->req_cells_out);
+  if (err != MPI_SUCCESS) mpi_error(err, "Failed to pcell_out buffer.");
+
+  /* Keep a copy of the current trees to encode the next exchange. */
   if (p->pcells_out != NULL) swift_free("pcells_out", p->pcells_out);
   if (swift_memalign("pcells_out", (void **)&p->pcells_out,
                      SWIFT_STRUCT_ALIGNMENT,
-                     sizeof(struct pcell) * p->size_pcells_out) != 0)
+                     sizeof(struct pcell) * size_pcells) != 0)
     error("Failed to allocate pcell_out buffer.");
-
-  for (int ind = 0, k = 0; k < p->nr_cells_out; k++) {
+  if (p->pcells_out_offset != NULL)
+    swift_free("pcells_out_offset", p->pcells_out_offset);
+  if ((p->pcells_out_offset = (int *)swift_malloc(
+           "pcells_out_offset", (p->nr_cells_out + 1) * sizeof(int))) == NULL)
+    error("Failed to allocate pcell_out offsets.");
+
+  p->pcells_out_offset[0] = 0;
+  for (int k = 0; k < p->nr_cells_out; k++) {
+    const int ind = p->pcells_out_offset[k];
     memcpy(&p->pcells_out[ind], p->cells_out[k]->mpi.pcell,
            sizeof(struct pcell) * p->cells_out[k]->mpi.pcell_size);
-    ind += p->cells_out[k]->mpi.pcell_size;
+    p->pcells_out_offset[k + 1] = ind + p->cells_out[k]->mpi.pcell_size;
   }
+  p->size_pcells_out = size_pcells;
 
-  /* Send the pcell buffer. */
-  err = MPI_Isend(p->pcells_out, p->size_pcells_out, pcell_mpi_type, p->nodeID,
-                  p->mynodeID * proxy_tag_shift + proxy_tag_cells,
-                  MPI_COMM_WORLD, &p->req_cells_out);
-
-  if (err != MPI_SUCCESS) mpi_error(err, "Failed to pcell_out buffer.");
-  // message( "isent pcells (%i) from node %i to node %i." , p->size_pcells_out
-  // , p->mynodeID , p->nodeID ); fflush(stdout);
-
-  /* Receive the number of pcells. */
-  err = MPI_Irecv(&p->size_pcells_in, 1, MPI_INT, p->nodeID,
+  /* Receive the size of the foreign encoded buffer. */
+  err = MPI_Irecv(&p->size_pcells_delta_in, 1, MPI_INT, p->nodeID,
                   p->nodeID * proxy_tag_shift + proxy_tag_count, MPI_COMM_WORLD,
                   &p->req_cells_count_in);
   if (err != MPI_SUCCESS) mpi_error(err, "Failed to irecv nr of pcells.");
-    // message( "irecv pcells count on node %i from node %i." , p->mynodeID ,
-    // p->nodeID ); fflush(stdout);
 
 #else
   error("SWIFT was not compiled with MPI support.");
@@ -251,9 +597,8 @@ void proxy_cells_exchange_first(struct proxy *p) {
 /**
  * @brief Exchange cells with a remote node, second part.
  *
- * Once the incomming cell count has been received, allocate a buffer
- * for the foreign packed #pcell array and emit the @c MPI_Irecv for
- * it.
+ * Once the size of the incoming encoded buffer has been received, allocate
+ * it and emit the @c MPI_Irecv for it.
  *
  * @param p The #proxy.
  */
@@ -261,21 +606,19 @@ void proxy_cells_exchange_second(struct proxy *p) {
 
 #ifdef WITH_MPI
 
-  /* Re-allocate the pcell_in buffer. */
-  if (p->pcells_in != NULL) swift_free("pcells_in", p->pcells_in);
-  if (swift_memalign("pcells_in", (void **)&p->pcells_in,
+  /* Allocate the encoded buffer. */
+  if (swift_memalign("pcells_delta_in", (void **)&p->pcells_delta_in,
                      SWIFT_STRUCT_ALIGNMENT,
-                     sizeof(struct pcell) * p->size_pcells_in) != 0)
-    error("Failed to allocate pcell_in buffer.");
+                     sizeof(struct pcell) * p->size_pcells_delta_in) != 0)
+    error("Failed to allocate pcell_delta_in buffer.");
 
-  /* Receive the particle buffers. */
-  int err = MPI_Irecv(p->pcells_in, p->size_pcells_in, pcell_mpi_type,
-                      p->nodeID, p->nodeID * proxy_tag_shift + proxy_tag_cells,
+  /* Receive the encoded trees. */
+  int err = MPI_Irecv(p->pcells_delta_in, p->size_pcells_delta_in,
+                      pcell_mpi_type, p->nodeID,
+                      p->nodeID * proxy_tag_shift + proxy_tag_cells,
                       MPI_COMM_WORLD, &p->req_cells_in);
 
   if (err != MPI_SUCCESS) mpi_error(err, "Failed to irecv part data.");
-    // message( "irecv pcells (%i) on node %i from node %i." , p->size_pcells_in
-    // , p->mynodeID , p->nodeID ); fflush(stdout);
 
 #else
   error("SWIFT was not compiled with MPI support.");
@@ -368,11 +711,13 @@ void proxy_cells_exchange(struct proxy *proxies, int num_proxies,
     message("Counting cells to send took %.3f %s.",
             clocks_from_ticks(getticks() - tic2), clocks_getunit());
 
-  /* Allocate the pcells. */
+  /* Allocate the pcells. They are compared bytewise with the previous
+   * exchange's, so clear the padding and the unused fields. */
   struct pcell *pcells = NULL;
   if (swift_memalign("pcells", (void **)&pcells, SWIFT_CACHE_ALIGNMENT,
                      sizeof(struct pcell) * count_out) != 0)
     error("Failed to allocate pcell buffer.");
+  bzero(pcells, sizeof(struct pcell) * count_out);
 
   tic2 = getticks();
 
@@ -395,6 +740,17 @@ void proxy_cells_exchange(struct proxy *proxies, int num_proxies,
     reqs_out[k] = proxies[k].req_cells_count_out;
   }
 
+  if (s->e->verbose) {
+    size_t bytes_full = 0, bytes_sent = 0;
+    for (int k = 0; k < num_proxies; k++) {
+      bytes_full += proxies[k].size_pcells_out * sizeof(struct pcell);
+      bytes_sent += proxies[k].size_pcells_delta_out * sizeof(struct pcell);
+    }
+    message("Sending %zd bytes of cell tree changes (%.1f%% of the full trees).",
+            bytes_sent,
+            bytes_full > 0 ? 100. * bytes_sent / bytes_full : 0.);
+  }
+
   /* Wait for each count to come in and start the recv. */
   for (int k = 0; k < num_proxies; k++) {
     int pid = MPI_UNDEFINED;
@@ -426,6 +782,7 @@ void proxy_cells_exchange(struct proxy *proxies, int num_proxies,
         pid == MPI_UNDEFINED)
       error("MPI_Waitany failed.");
     // message( "cell data from proxy %i has arrived." , pid );
+    proxy_cells_decode(&proxies[pid]);
     for (int count = 0, j = 0; j < proxies[pid].nr_cells_in; j++)
       count += cell_unpack(&proxies[pid].pcells_in[count],
                            proxies[pid].cells_in[j], s, with_gravity);
@@ -444,10 +801,13 @@ void proxy_cells_exchange(struct proxy *proxies, int num_proxies,
   swift_free("pcells", pcells);
   swift_free("proxy_cell_offset", offset);
   for (int k = 0; k < num_proxies; k++) {
-    swift_free("pcells_in", proxies[k].pcells_in);
-    swift_free("pcells_out", proxies[k].pcells_out);
-    proxies[k].pcells_in = NULL;
-    proxies[k].pcells_out = NULL;
+    swift_free("pcells_delta_in", proxies[k].pcells_delta_in);
+    swift_free("pcells_delta_out", proxies[k].pcells_delta_out);
+    proxies[k].pcells_delta_in = NULL;
+    proxies[k].pcells_delta_out = NULL;
+
+    /* The trees we just exchanged are the base for the next exchange. */
+    proxies[k].pcells_cached = 1;
   }
 
 #else
@@ -958,6 +1318,19 @@ void proxy_init(struct proxy *p, int mynodeID, int nodeID) {
   }
   p->nr_cells_out = 0;
 
+  /* The cell lists are new, forget the trees of the previous exchanges. */
+  if (p->pcells_in != NULL) swift_free("pcells_in", p->pcells_in);
+  if (p->pcells_out != NULL) swift_free("pcells_out", p->pcells_out);
+  if (p->pcells_in_offset != NULL)
+    swift_free("pcells_in_offset", p->pcells_in_offset);
+  if (p->pcells_out_offset != NULL)
+    swift_free("pcells_out_offset", p->pcells_out_offset);
+  p->pcells_in = NULL;
+  p->pcells_out = NULL;
+  p->pcells_in_offset = NULL;
+  p->pcells_out_offset = NULL;
+  p->pcells_cached = 0;
+
   /* Allocate the part send and receive buffers, if needed. */
   if (p->parts_in == NULL) {
     p->size_parts_in = proxy_buffinit;
@@ -1038,6 +1411,8 @@ void proxy_clean(struct proxy *p) {
   swift_free("cells_out_type", p->cells_out_type);
   swift_free("pcells_in", p->pcells_in);
   swift_free("pcells_out", p->pcells_out);
+  swift_free("pcells_in_offset", p->pcells_in_offset);
+  swift_free("pcells_out_offset", p->pcells_out_offset);
   swift_free("parts_out", p->parts_out);
   swift_free("xparts_out", p->xparts_out);
   swift_free("gparts_out", p->gparts_out);
@@ -65,6 +65,17 @@ struct proxy {
   struct pcell *pcells_out;
   int nr_cells_out, size_cells_out, size_pcells_out;
 
+  /* Offsets of each cell's tree in pcells_in and pcells_out. These buffers
+   * are kept between rebuilds so that only the changes need sending. */
+  int *pcells_in_offset, *pcells_out_offset;
+
+  /* Do pcells_in and pcells_out hold the trees of the last exchange? */
+  int pcells_cached;
+
+  /* Encoded changes to the cell trees, in units of #pcell. */
+  struct pcell *pcells_delta_in, *pcells_delta_out;
+  int size_pcells_delta_in, size_pcells_delta_out;
+
   /* The parts and xparts buffers for input and output. */
   struct part *parts_in, *parts_out;
   struct xpart *xparts_in, *xparts_out;
@@ -113,6 +124,14 @@ void proxy_cells_exchange(struct proxy *proxies, int num_proxies,
                           struct space *s, int with_gravity);
 void proxy_tags_exchange(struct proxy *proxies, int num_proxies,
                          struct space *s);
+void proxy_node_offsets_exchange(struct proxy *proxies, int num_proxies,
+                                 struct space *s);
+size_t proxy_pcell_encode(const struct pcell *prev, const int prev_size,
+                          const struct pcell *cur, const int cur_size,
+                          char *buffer);
+size_t proxy_pcell_decode(const char *buffer, const struct pcell *prev,
+                          const int prev_size, struct pcell *cur,
+                          int *cur_size);
 void proxy_create_mpi_type(void);
 void proxy_free_mpi_type(void);
 
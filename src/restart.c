@@ -28,6 +28,7 @@
 /* Standard headers. */
 #include "engine.h"
 #include "error.h"
+#include "memuse.h"
 #include "restart.h"
 #include "version.h"
 
@@ -46,6 +47,12 @@
 #define FNAMELEN 200
 #define LABLEN 20
 
+/* Alignment in the file of the blocks that can be memory mapped. */
+#define MAPALIGN 65536
+
+/* Whether the blocks aligned in the file are memory mapped when read. */
+static int restart_memory_map = 0;
+
 /* Structure for a dumped header. */
 struct header {
   size_t len;             /* Total length of data in bytes. */
@@ -133,6 +140,12 @@ void restart_write(struct engine *e, const char *filename) {
   /* Save a backup the existing restart file, if requested. */
   if (e->restart_save) restart_save_previous(filename);
 
+  /* Never overwrite the file in place, the particles of a run started from
+   * it may still be memory mapped from it (see restart_read). */
+  if (unlink(filename) != 0 && errno != ENOENT)
+    error("Failed to remove old restart file: %s (%s)", filename,
+          strerror(errno));
+
   /* Use a single Lustre stripe with a rank-based OST offset? */
   if (e->restart_lustre_OST_count != 0) {
 
@@ -180,12 +193,19 @@ void restart_write(struct engine *e, const char *filename) {
 /**
  * @brief Read a restart file to construct a saved engine struct state.
  *
+ * The large blocks, i.e. the particles, can be memory mapped from the file
+ * rather than read, in which case they are only read from disk when first
+ * used, letting the run start much sooner.
+ *
  * @param e the engine to recover from the saved state.
  * @param filename name of the file containing the staved state.
+ * @param memory_map whether to memory map the particles.
  */
-void restart_read(struct engine *e, const char *filename) {
+void restart_read(struct engine *e, const char *filename,
+                  const int memory_map) {
 
   const ticks tic = getticks();
+  restart_memory_map = memory_map;
 
   FILE *stream = fopen(filename, "r");
   if (stream == NULL)
@@ -217,6 +237,7 @@ void restart_read(struct engine *e, const char *filename) {
 
   engine_struct_restore(e, stream);
   fclose(stream);
+  restart_memory_map = 0;
 
   if (e->verbose)
     message("took %.3f %s.", clocks_from_ticks(getticks() - tic),
@@ -297,6 +318,116 @@ void restart_write_blocks(void *ptr, size_t size, size_t nblocks, FILE *stream,
   }
 }
 
+/**
+ * @brief Allocate memory and read blocks written by
+ *        restart_write_aligned_blocks into it. Exits the application if
+ *        the read fails.
+ *
+ * When requested by restart_read, the blocks are memory mapped from the file
+ * rather than read. The memory must be released using swift_free in either
+ * case.
+ *
+ * @param label the label of the memory for swift_memalign.
+ * @param ptr pointer to the memory, allocated here.
+ * @param alignment alignment of the memory, at most the page size.
+ * @param size size of a block.
+ * @param nblocks number of blocks to read.
+ * @param nalloc number of blocks to allocate, at least nblocks.
+ * @param stream the file stream.
+ * @param errstr a context string to qualify any errors.
+ */
+void restart_read_aligned_blocks(const char *label, void **ptr,
+                                 size_t alignment, size_t size,
+                                 size_t nblocks, size_t nalloc, FILE *stream,
+                                 const char *errstr) {
+
+  struct header head;
+  size_t nread = fread(&head, sizeof(struct header), 1, stream);
+  if (nread != 1)
+    error("Failed to read the %s header from restart file (%s)", errstr,
+          strerror(errno));
+  if (head.len != nblocks * size)
+    error("Mismatched data length in restart file for %s (%zu != %zu)", errstr,
+          head.len, nblocks * size);
+
+  /* Skip the padding. */
+  const long pos = ftell(stream);
+  const long offset = ((pos + MAPALIGN - 1) / MAPALIGN) * MAPALIGN;
+  if (pos < 0 || fseek(stream, offset, SEEK_SET) != 0)
+    error("Failed to seek to %s in restart file (%s)", errstr,
+          strerror(errno));
+
+  /* Map what we can, if asked to. */
+  size_t mapped = 0;
+  int result = -1;
+  if (restart_memory_map && MAPALIGN % sysconf(_SC_PAGESIZE) == 0) {
+    result = swift_mmap_file(label, ptr, nalloc * size, fileno(stream), offset,
+                             head.len, &mapped);
+    if (result != 0)
+      message("WARNING: failed to map %s from restart file (%s), reading it.",
+              errstr, strerror(result));
+  }
+  if (result != 0) {
+    mapped = 0;
+    if (swift_memalign(label, ptr, alignment, nalloc * size) != 0)
+      error("Failed to allocate restore %s array.", errstr);
+  }
+
+  /* Read the rest. */
+  if (mapped < head.len) {
+    if (mapped > 0 && fseek(stream, offset + mapped, SEEK_SET) != 0)
+      error("Failed to seek to %s in restart file (%s)", errstr,
+            strerror(errno));
+    nread = fread((char *)(*ptr) + mapped, 1, head.len - mapped, stream);
+    if (nread != head.len - mapped)
+      error("Failed to restore %s from restart file (%s)", errstr,
+            ferror(stream) ? strerror(errno) : "unexpected end of file");
+  } else if (fseek(stream, offset + head.len, SEEK_SET) != 0) {
+    error("Failed to seek past %s in restart file (%s)", errstr,
+          strerror(errno));
+  }
+}
+
+/**
+ * @brief Write blocks of memory to a file stream from a memory location,
+ *        starting them at a large alignment in the file so that they can
+ *        be memory mapped. Exits the application if the write fails.
+ *
+ * The blocks must be read back with restart_read_aligned_blocks.
+ *
+ * @param ptr pointer to the memory
+ * @param size the blocks
+ * @param nblocks number of blocks to write
+ * @param stream the file stream
+ * @param label a label for the content, can only be 20 characters.
+ * @param errstr a context string to qualify any errors.
+ */
+void restart_write_aligned_blocks(void *ptr, size_t size, size_t nblocks,
+                                  FILE *stream, const char *label,
+                                  const char *errstr) {
+
+  struct header head;
+  head.len = nblocks * size;
+  strncpy(head.label, label, LABLEN);
+  head.label[LABLEN] = '\0';
+
+  size_t nwrite = fwrite(&head, sizeof(struct header), 1, stream);
+  if (nwrite != 1)
+    error("Failed to save %s header to restart file (%s)", errstr,
+          strerror(errno));
+
+  /* Leave a hole up to the alignment. */
+  const long pos = ftell(stream);
+  const long offset = ((pos + MAPALIGN - 1) / MAPALIGN) * MAPALIGN;
+  if (pos < 0 || fseek(stream, offset, SEEK_SET) != 0)
+    error("Failed to seek to %s in restart file (%s)", errstr,
+          strerror(errno));
+
+  nwrite = fwrite(ptr, size, nblocks, stream);
+  if (nwrite != nblocks)
+    error("Failed to save %s to restart file (%s)", errstr, strerror(errno));
+}
+
 /**
  * @brief check if the stop file exists in the given directory and optionally
  *        remove it if found.
@@ -24,7 +24,8 @@
 struct engine;
 
 void restart_write(struct engine *e, const char *filename);
-void restart_read(struct engine *e, const char *filename);
+void restart_read(struct engine *e, const char *filename,
+                  const int memory_map);
 
 char **restart_locate(const char *dir, const char *basename, int *nfiles);
 void restart_locate_free(int nfiles, char **files);
@@ -35,6 +36,13 @@ void restart_read_blocks(void *ptr, size_t size, size_t nblocks, FILE *stream,
                          char *label, const char *errstr);
 void restart_write_blocks(void *ptr, size_t size, size_t nblocks, FILE *stream,
                           const char *label, const char *errstr);
+void restart_read_aligned_blocks(const char *label, void **ptr,
+                                 size_t alignment, size_t size,
+                                 size_t nblocks, size_t nalloc, FILE *stream,
+                                 const char *errstr);
+void restart_write_aligned_blocks(void *ptr, size_t size, size_t nblocks,
+                                  FILE *stream, const char *label,
+                                  const char *errstr);
 
 int restart_stop_now(const char *dir, int cleanup);
 
@@ -25,6 +25,7 @@
 /* Some standard headers. */
 #include <cvode/cvode.h>
 #include <cvode/cvode_direct.h> /* access to CVDls interface            */
+#include <pthread.h>
 #include <string.h>
 #include <sunlinsol/sunlinsol_dense.h>
 #include <sunmatrix/sunmatrix_dense.h>
@@ -35,6 +36,152 @@
 #include "rt_getters.h"
 #include "rt_setters.h"
 
+/**
+ * @brief The CVODE objects used to integrate the reduced network of one
+ * particle.
+ *
+ * Setting up the integrator and its dense linear solver is much more
+ * expensive than the integration itself for the short time-steps of most
+ * particles. Every thread therefore keeps one set of objects that is
+ * re-initialised with the state of each particle with CVodeReInit().
+ */
+struct rt_cvode_workspace {
+
+  /*! The CVODE integrator memory */
+  void* cvode_mem;
+
+  /*! The state vector */
+  N_Vector y;
+
+  /*! The absolute tolerance of each entry of the state vector */
+  N_Vector abstol_vector;
+
+  /*! The Jacobian matrix */
+  SUNMatrix A_sun;
+
+  /*! The dense linear solver */
+  SUNLinearSolver LS_sun;
+
+  /*! The number of entries in the network */
+  int network_size;
+
+  /*! The tolerances the integrator was set up with */
+  double reltol, abstol;
+};
+
+/*! The key to the #rt_cvode_workspace of each thread */
+static pthread_key_t rt_cvode_workspace_key;
+
+/*! Guard for the creation of #rt_cvode_workspace_key */
+static pthread_once_t rt_cvode_workspace_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Release the CVODE objects of a thread.
+ *
+ * @param ptr The #rt_cvode_workspace to free.
+ */
+static void rt_cvode_workspace_free(void* ptr) {
+
+  struct rt_cvode_workspace* ws = (struct rt_cvode_workspace*)ptr;
+  if (ws == NULL) return;
+
+  SUNLinSolFree(ws->LS_sun);
+  SUNMatDestroy(ws->A_sun);
+  N_VDestroy_Serial(ws->y);
+  N_VDestroy_Serial(ws->abstol_vector);
+  CVodeFree(&ws->cvode_mem);
+  free(ws);
+}
+
+/**
+ * @brief Create the key used to store the CVODE objects of each thread.
+ */
+static void rt_cvode_workspace_key_create(void) {
+  if (pthread_key_create(&rt_cvode_workspace_key, rt_cvode_workspace_free) !=
+      0)
+    error("Failed to create the CVODE workspace key.");
+}
+
+/**
+ * @brief Return the CVODE objects of the calling thread, creating them on
+ * first use.
+ *
+ * The objects are rebuilt if the size of the network or the tolerances
+ * changed since they were created.
+ *
+ * @param network_size The number of entries in the network.
+ * @param reltol The relative tolerance of the integration.
+ * @param abstol The absolute tolerance of the integration.
+ */
+static struct rt_cvode_workspace* rt_cvode_workspace_get(
+    const int network_size, const double reltol, const double abstol) {
+
+  pthread_once(&rt_cvode_workspace_once, rt_cvode_workspace_key_create);
+
+  struct rt_cvode_workspace* ws =
+      (struct rt_cvode_workspace*)pthread_getspecific(rt_cvode_workspace_key);
+
+  if (ws != NULL && ws->network_size == network_size &&
+      ws->reltol == reltol && ws->abstol == abstol)
+    return ws;
+
+  rt_cvode_workspace_free(ws);
+  ws = (struct rt_cvode_workspace*)malloc(sizeof(struct rt_cvode_workspace));
+  if (ws == NULL) error("Failed to allocate the CVODE workspace.");
+  ws->network_size = network_size;
+  ws->reltol = reltol;
+  ws->abstol = abstol;
+
+  ws->y = N_VNew_Serial(network_size);
+  ws->abstol_vector = N_VNew_Serial(network_size);
+  if (ws->y == NULL || ws->abstol_vector == NULL)
+    error("Failed to allocate the CVODE vectors.");
+  N_VConst((realtype)0., ws->y);
+  N_VConst((realtype)abstol, ws->abstol_vector);
+
+  /* Use CVodeCreate to create the solver
+   * memory and specify the Backward Differentiation
+   * Formula. Note that CVODE now uses Newton iteration
+   * iteration by default, so no need to specify this. */
+  ws->cvode_mem = CVodeCreate(CV_BDF);
+  if (ws->cvode_mem == NULL) error("Failed to create the CVODE integrator.");
+
+  /* Use CVodeSetMaxNumSteps to set the maximum number
+   * of steps CVode takes. */
+  CVodeSetMaxNumSteps(ws->cvode_mem, 100000);
+
+  /* Use CVodeInit to initialise the integrator
+   * memory and specify the right hand side
+   * function in y' = f(t,y) (i.e. the rate
+   * equations). The initial conditions are set
+   * for each particle with CVodeReInit. */
+  CVodeInit(ws->cvode_mem, rt_frateeq, 0.0f, ws->y);
+
+  /* Use CVodeSVtolerances to specify the scalar
+   * relative and absolute tolerances. */
+  CVodeSVtolerances(ws->cvode_mem, (realtype)reltol, ws->abstol_vector);
+
+  /* Create a dense SUNMatrix and a dense
+   * SUNLinearSolver object to use in CVode. */
+  ws->A_sun = SUNDenseMatrix(network_size, network_size);
+  ws->LS_sun = SUNDenseLinearSolver(ws->y, ws->A_sun);
+  if (ws->A_sun == NULL || ws->LS_sun == NULL)
+    error("Failed to create the CVODE linear solver.");
+
+  /* Attach the matrix and linear
+   * solver to CVode. */
+  CVDlsSetLinearSolver(ws->cvode_mem, ws->LS_sun, ws->A_sun);
+
+  /* Specify the maximum number of convergence
+   * test failures. */
+  CVodeSetMaxConvFails(ws->cvode_mem, 5000);
+
+  if (pthread_setspecific(rt_cvode_workspace_key, ws) != 0)
+    error("Failed to store the CVODE workspace.");
+
+  return ws;
+}
+
 /**
  * @brief Main function for the thermochemistry step.
  *
@@ -343,10 +490,8 @@ void rt_do_thermochemistry(struct part* restrict p, struct xpart* restrict xp,
      * Explicit solution is insufficient. *
      * Use implicit solver.               *
      **************************************/
-    realtype reltol, t;
-    N_Vector abstol_vector, y;
+    realtype t;
 
-    int maxsteps = 100000;
     int network_size, icount = 0;
     /* 3 for species;   */
     network_size = 3;
@@ -359,75 +504,35 @@ void rt_do_thermochemistry(struct part* restrict p, struct xpart* restrict xp,
       network_size += 3;
     }
 
-    y = N_VNew_Serial(network_size);
-    abstol_vector = N_VNew_Serial(network_size);
+    /* Get the integrator of this thread */
+    struct rt_cvode_workspace* ws = rt_cvode_workspace_get(
+        network_size, rt_props->relativeTolerance, rt_props->absoluteTolerance);
+    N_Vector y = ws->y;
+
     for (int i = 0; i < 3; i++) {
       NV_Ith_S(y, icount) = (realtype)data.abundances[aindex[i]];
-      NV_Ith_S(abstol_vector, icount) = (realtype)(rt_props->absoluteTolerance);
       icount += 1;
     }
     if (coolingon == 1) {
       NV_Ith_S(y, icount) = (realtype)u_cgs;
-      NV_Ith_S(abstol_vector, icount) = (realtype)rt_props->absoluteTolerance;
       icount += 1;
     }
     if (fixphotondensity == 0) {
       for (int i = 0; i < 3; i++) {
         NV_Ith_S(y, icount) = (realtype)data.ngamma_cgs[i];
-        NV_Ith_S(abstol_vector, icount) = (realtype)rt_props->absoluteTolerance;
         icount += 1;
       }
     }
-    /* Set up the solver */
-    /* Set the tolerances*/
-    reltol = (realtype)rt_props->relativeTolerance;
-
-    /* Use CVodeCreate to create the solver
-     * memory and specify the Backward Differentiation
-     * Formula. Note that CVODE now uses Newton iteration
-     * iteration by default, so no need to specify this. */
-    void* cvode_mem;
-    cvode_mem = CVodeCreate(CV_BDF);
 
     /* Set the user data for CVode */
-    CVodeSetUserData(cvode_mem, &data);
-
-    /* Use CVodeSetMaxNumSteps to set the maximum number
-     * of steps CVode takes. */
-    CVodeSetMaxNumSteps(cvode_mem, maxsteps);
-
-    /* Use CVodeInit to initialise the integrator
-     * memory and specify the right hand side
-     * function in y' = f(t,y) (i.e. the rate
-     * equations), the initial time 0.0 and the
-     * initial conditions, in y. */
-    CVodeInit(cvode_mem, rt_frateeq, 0.0f, y);
-
-    /* Use CVodeSVtolerances to specify the scalar
-     * relative and absolute tolerances. */
-    CVodeSVtolerances(cvode_mem, reltol, abstol_vector);
-
-    /* Create a dense SUNMatrix to use in the
-     * linear solver. */
-    SUNMatrix A_sun;
-
-    A_sun = SUNDenseMatrix(network_size, network_size);
-
-    /* Create a denst SUNLinearSolver object
-     * to use in CVode. */
-    SUNLinearSolver LS_sun;
-    LS_sun = SUNDenseLinearSolver(y, A_sun);
-
-    /* Attach the matrix and linear
-     * solver to CVode. */
-    CVDlsSetLinearSolver(cvode_mem, LS_sun, A_sun);
+    CVodeSetUserData(ws->cvode_mem, &data);
 
-    /* Specify the maximum number of convergence
-     * test failures. */
-    CVodeSetMaxConvFails(cvode_mem, 5000);
+    /* Restart the integrator from the initial time 0.0
+     * and the initial conditions of this particle, in y. */
+    CVodeReInit(ws->cvode_mem, 0.0f, y);
 
     /* Call CVode() to integrate the chemistry. */
-    CVode(cvode_mem, (realtype)dt_cgs, y, &t, CV_NORMAL);
+    CVode(ws->cvode_mem, (realtype)dt_cgs, y, &t, CV_NORMAL);
 
     /* Write the output abundances to the gas cell
      * Note that species not included in the reduced
@@ -519,11 +624,6 @@ void rt_do_thermochemistry(struct part* restrict p, struct xpart* restrict xp,
       }
     }
     rt_set_physical_radiation_opacity(p, cosmo, chi_new);
-    SUNLinSolFree(LS_sun);
-    SUNMatDestroy(A_sun);
-    N_VDestroy_Serial(y);
-    N_VDestroy_Serial(abstol_vector);
-    CVodeFree(&cvode_mem);
 
     rt_check_unphysical_elem_spec(p, rt_props);
   }
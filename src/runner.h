@@ -28,6 +28,7 @@
 
 /* Local headers. */
 #include "cache.h"
+#include "ghost_ngb_lists.h"
 #include "gravity_cache.h"
 
 struct cell;
@@ -75,6 +76,9 @@ struct runner {
   /*! Time this runner was active during the last engine_launch. */
   ticks active_time;
 
+  /*! The neighbour lists of the particles iterating in the hydro ghost. */
+  struct ghost_ngb_lists ghost_ngbs;
+
 #ifdef WITH_VECTORIZATION
 
   /*! The particle cache of cell ci. */
@@ -148,6 +152,8 @@ void runner_do_recv_spart(struct runner *r, struct cell *c, int clear_sorts,
                           int timer);
 void runner_do_recv_bpart(struct runner *r, struct cell *c, int clear_sorts,
                           int timer);
+void runner_do_recv_node_shared(struct runner *r, struct task *t);
+void runner_do_send_node_shared(struct runner *r, struct task *t);
 void runner_do_pack_limiter(struct runner *r, struct cell *c, void **buffer,
                             const int timer);
 void runner_do_unpack_limiter(struct runner *r, struct cell *c, void *buffer,
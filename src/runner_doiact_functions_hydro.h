@@ -671,6 +671,14 @@ void DOPAIR_SUBSET_NAIVE(struct runner *r, struct cell *restrict ci,
       /* Hit or miss? */
       if (r2 < hig2) {
 
+#if (FUNCTION_TASK_LOOP == TASK_LOOP_DENSITY)
+        /* Recording the neighbours for the ghost? */
+        if (r->ghost_ngbs.collecting) {
+          ghost_ngb_lists_record(&r->ghost_ngbs, pid, pj, dx, r2);
+          continue;
+        }
+#endif
+
         IACT_NONSYM(r2, dx, hi, pj->h, pi, pj, a, H);
         IACT_NONSYM_MHD(r2, dx, hi, pj->h, pi, pj, mu_0, a, H);
 #if (FUNCTION_TASK_LOOP == TASK_LOOP_DENSITY)
@@ -780,6 +788,14 @@ void DOPAIR_SUBSET(struct runner *r, struct cell *restrict ci,
         /* Hit or miss? */
         if (r2 < hig2) {
 
+#if (FUNCTION_TASK_LOOP == TASK_LOOP_DENSITY)
+          /* Recording the neighbours for the ghost? */
+          if (r->ghost_ngbs.collecting) {
+            ghost_ngb_lists_record(&r->ghost_ngbs, pid, pj, dx, r2);
+            continue;
+          }
+#endif
+
           IACT_NONSYM(r2, dx, hi, hj, pi, pj, a, H);
           IACT_NONSYM_MHD(r2, dx, hi, hj, pi, pj, mu_0, a, H);
 #if (FUNCTION_TASK_LOOP == TASK_LOOP_DENSITY)
@@ -846,6 +862,14 @@ void DOPAIR_SUBSET(struct runner *r, struct cell *restrict ci,
         /* Hit or miss? */
         if (r2 < hig2) {
 
+#if (FUNCTION_TASK_LOOP == TASK_LOOP_DENSITY)
+          /* Recording the neighbours for the ghost? */
+          if (r->ghost_ngbs.collecting) {
+            ghost_ngb_lists_record(&r->ghost_ngbs, pid, pj, dx, r2);
+            continue;
+          }
+#endif
+
           IACT_NONSYM(r2, dx, hi, hj, pi, pj, a, H);
           IACT_NONSYM_MHD(r2, dx, hi, hj, pi, pj, mu_0, a, H);
 #if (FUNCTION_TASK_LOOP == TASK_LOOP_DENSITY)
@@ -925,7 +949,7 @@ void DOPAIR_SUBSET_BRANCH(struct runner *r, struct cell *restrict ci,
     DOPAIR_SUBSET_NAIVE(r, ci, parts_i, ind, count, cj, shift);
   } else {
 #if defined(WITH_VECTORIZATION) && defined(GADGET2_SPH)
-    if (sort_is_face(sid))
+    if (sort_is_face(sid) && !r->ghost_ngbs.collecting)
       runner_dopair_subset_density_vec(r, ci, parts_i, ind, count, cj, sid,
                                        flipped, shift);
     else
@@ -1013,6 +1037,14 @@ void DOSELF_SUBSET(struct runner *r, struct cell *restrict ci,
       /* Hit or miss? */
       if (r2 < hig2) {
 
+#if (FUNCTION_TASK_LOOP == TASK_LOOP_DENSITY)
+        /* Recording the neighbours for the ghost? */
+        if (r->ghost_ngbs.collecting) {
+          ghost_ngb_lists_record(&r->ghost_ngbs, pid, pj, dx, r2);
+          continue;
+        }
+#endif
+
         IACT_NONSYM(r2, dx, hi, hj, pi, pj, a, H);
         IACT_NONSYM_MHD(r2, dx, hi, hj, pi, pj, mu_0, a, H);
 #if (FUNCTION_TASK_LOOP == TASK_LOOP_DENSITY)
@@ -1050,12 +1082,86 @@ void DOSELF_SUBSET_BRANCH(struct runner *r, struct cell *restrict ci,
                           int count) {
 
 #if defined(WITH_VECTORIZATION) && defined(GADGET2_SPH)
-  runner_doself_subset_density_vec(r, ci, parts, ind, count);
+  if (!r->ghost_ngbs.collecting)
+    runner_doself_subset_density_vec(r, ci, parts, ind, count);
+  else
+    DOSELF_SUBSET(r, ci, parts, ind, count);
 #else
   DOSELF_SUBSET(r, ci, parts, ind, count);
 #endif
 }
 
+#if (FUNCTION_TASK_LOOP == TASK_LOOP_DENSITY)
+/**
+ * @brief Compute the interactions of the given particles with the neighbours
+ * recorded in their lists in the #ghost_ngb_lists of the runner.
+ *
+ * The lists hold the candidates found by the subset loops for a larger
+ * smoothing length. Only the ones within the current kernel interact, in the
+ * order in which the subset loops found them.
+ *
+ * @param r The #runner.
+ * @param parts The #part to interact.
+ * @param ind The list of indices of particles to interact.
+ * @param first The start of the list of each particle in @c ind.
+ * @param num The length of the list of each particle in @c ind.
+ * @param count The number of particles in @c ind.
+ */
+void DOSUBSET_NGB_LISTS(struct runner *r, struct part *restrict parts,
+                        const int *restrict ind, const size_t *restrict first,
+                        const int *restrict num, int count) {
+
+  const struct engine *e = r->e;
+  const struct cosmology *cosmo = e->cosmology;
+  const struct ghost_ngb *restrict ngbs = r->ghost_ngbs.ngbs;
+
+  TIMER_TIC;
+
+  /* Cosmological terms and physical constants */
+  const float a = cosmo->a;
+  const float H = cosmo->H;
+  GET_MU0();
+
+  /* Loop over the particles. */
+  for (int pid = 0; pid < count; pid++) {
+
+    /* Get a hold of the particle and its list. */
+    struct part *restrict pi = &parts[ind[pid]];
+    const struct ghost_ngb *restrict list = &ngbs[first[pid]];
+    const float hi = pi->h;
+    const float hig2 = hi * hi * kernel_gamma2;
+
+#ifdef SWIFT_DEBUG_CHECKS
+    if (!part_is_active(pi, e)) error("Inactive particle in subset function!");
+#endif
+
+    /* Loop over the candidate neighbours. */
+    for (int k = 0; k < num[pid]; k++) {
+
+      const float r2 = list[k].r2;
+
+      /* Hit or miss? */
+      if (r2 < hig2) {
+
+        struct part *restrict pj = list[k].pj;
+        const float hj = pj->h;
+        float dx[3] = {list[k].dx[0], list[k].dx[1], list[k].dx[2]};
+
+        IACT_NONSYM(r2, dx, hi, hj, pi, pj, a, H);
+        IACT_NONSYM_MHD(r2, dx, hi, hj, pi, pj, mu_0, a, H);
+        runner_iact_nonsym_chemistry(r2, dx, hi, hj, pi, pj, a, H);
+        runner_iact_nonsym_pressure_floor(r2, dx, hi, hj, pi, pj, a, H);
+        runner_iact_nonsym_star_formation(r2, dx, hi, hj, pi, pj, a, H);
+        runner_iact_nonsym_sink(r2, dx, hi, hj, pi, pj, a, H,
+                                e->sink_properties);
+      }
+    } /* loop over the candidate neighbours. */
+  }   /* loop over the particles. */
+
+  TIMER_TOC(timer_dosubset_ngb_lists);
+}
+#endif
+
 /**
  * @brief Compute the interactions between a cell pair (non-symmetric).
  *
@@ -95,6 +95,9 @@
 #define _DOSUB_SUBSET(f) PASTE(runner_dosub_subset, f)
 #define DOSUB_SUBSET _DOSUB_SUBSET(FUNCTION)
 
+#define _DOSUBSET_NGB_LISTS(f) PASTE(runner_dosubset_ngb_lists, f)
+#define DOSUBSET_NGB_LISTS _DOSUBSET_NGB_LISTS(FUNCTION)
+
 #define _IACT_NONSYM(f) PASTE(runner_iact_nonsym, f)
 #define IACT_NONSYM _IACT_NONSYM(FUNCTION)
 
@@ -189,3 +192,7 @@ void DOPAIR_SUBSET_BRANCH(struct runner *r, struct cell *restrict ci,
 
 void DOSUB_SUBSET(struct runner *r, struct cell *ci, struct part *parts,
                   int *ind, int count, struct cell *cj, int gettimer);
+
+void DOSUBSET_NGB_LISTS(struct runner *r, struct part *restrict parts,
+                        const int *restrict ind, const size_t *restrict first,
+                        const int *restrict num, int count);
@@ -1074,6 +1074,125 @@ void runner_do_extra_ghost(struct runner *r, struct cell *c, int timer) {
 #endif
 }
 
+/**
+ * @brief Redo the density loop for a subset of the particles of a cell over
+ * all the neighbouring cells.
+ *
+ * @param r The runner thread.
+ * @param c The cell.
+ * @param parts The particles of the cell.
+ * @param pid The indices of the particles to update.
+ * @param count The number of particles in @c pid.
+ */
+static void runner_do_ghost_density_subset(struct runner *r, struct cell *c,
+                                           struct part *parts, int *pid,
+                                           const int count) {
+
+  /* Climb up the cell hierarchy. */
+  for (struct cell *finger = c; finger != NULL; finger = finger->parent) {
+
+    /* Run through this cell's density interactions. */
+    for (struct link *l = finger->hydro.density; l != NULL; l = l->next) {
+
+#ifdef SWIFT_DEBUG_CHECKS
+      if (l->t->ti_run < r->e->ti_current)
+        error("Density task should have been run.");
+#endif
+
+      /* Self-interaction? */
+      if (l->t->type == task_type_self)
+        runner_doself_subset_branch_density(r, finger, parts, pid, count);
+
+      /* Otherwise, pair interaction? */
+      else if (l->t->type == task_type_pair) {
+
+        /* Left or right? */
+        if (l->t->ci == finger)
+          runner_dopair_subset_branch_density(r, finger, parts, pid, count,
+                                              l->t->cj);
+        else
+          runner_dopair_subset_branch_density(r, finger, parts, pid, count,
+                                              l->t->ci);
+      }
+
+      /* Otherwise, sub-self interaction? */
+      else if (l->t->type == task_type_sub_self)
+        runner_dosub_subset_density(r, finger, parts, pid, count, NULL, 1);
+
+      /* Otherwise, sub-pair interaction? */
+      else if (l->t->type == task_type_sub_pair) {
+
+        /* Left or right? */
+        if (l->t->ci == finger)
+          runner_dosub_subset_density(r, finger, parts, pid, count, l->t->cj,
+                                      1);
+        else
+          runner_dosub_subset_density(r, finger, parts, pid, count, l->t->ci,
+                                      1);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Redo the density loop for a subset of the particles of a cell using
+ * their neighbour lists.
+ *
+ * The particles whose smoothing length grew beyond the one their list was
+ * built for (or that have no list yet) first get a new list. It is built by
+ * running the subset loops in recording mode for a larger smoothing length:
+ * #ghost_ngb_lists_h_factor times the current one or the current one plus
+ * twice the last change, whichever is larger, capped by the upper bound of
+ * the bisection. All the particles then interact with their lists only.
+ *
+ * @param r The runner thread.
+ * @param c The cell.
+ * @param parts The particles of the cell.
+ * @param pid The indices of the particles to update.
+ * @param right The upper bound on the smoothing length of each particle.
+ * @param h_step The last change of the smoothing length of each particle.
+ * @param h_list The smoothing length the list of each particle was built for.
+ * @param first The start of the list of each particle.
+ * @param num The length of the list of each particle.
+ * @param cid Scratch space for @c count indices.
+ * @param cpid Scratch space for @c count indices.
+ * @param h_save Scratch space for @c count smoothing lengths.
+ * @param count The number of particles in @c pid.
+ */
+static void runner_do_ghost_density_ngb_lists(
+    struct runner *r, struct cell *c, struct part *parts, int *pid,
+    const float *right, const float *h_step, float *h_list, size_t *first,
+    int *num, int *cid, int *cpid, float *h_save, const int count) {
+
+  /* Find the particles that need a new list */
+  int count_collect = 0;
+  for (int i = 0; i < count; i++) {
+    struct part *p = &parts[pid[i]];
+    if (p->h > h_list[i]) {
+      cid[count_collect] = i;
+      cpid[count_collect] = pid[i];
+      h_save[count_collect] = p->h;
+      const float h_grown =
+          max(ghost_ngb_lists_h_factor * p->h, p->h + 2.f * h_step[i]);
+      const float h_capped = min(right[i], h_grown);
+      h_list[i] = max(p->h, h_capped);
+      p->h = h_list[i];
+      ++count_collect;
+    }
+  }
+
+  /* Record their candidate neighbours for the larger smoothing length */
+  if (count_collect > 0) {
+    ghost_ngb_lists_start(&r->ghost_ngbs);
+    runner_do_ghost_density_subset(r, c, parts, cpid, count_collect);
+    ghost_ngb_lists_end(&r->ghost_ngbs, cid, count_collect, first, num);
+    for (int j = 0; j < count_collect; j++) parts[cpid[j]].h = h_save[j];
+  }
+
+  /* And interact with the neighbours within the actual kernels */
+  runner_dosubset_ngb_lists_density(r, parts, pid, first, num, count);
+}
+
 /**
  * @brief Intermediate task after the density to check that the smoothing
  * lengths are correct.
@@ -1106,6 +1225,7 @@ void runner_do_ghost(struct runner *r, struct cell *c, int timer) {
   const int use_mass_weighted_num_ngb =
       e->hydro_properties->use_mass_weighted_num_ngb;
   const int max_smoothing_iter = e->hydro_properties->max_smoothing_iterations;
+  const int use_ngb_lists = e->hydro_properties->use_ghost_neighbour_lists;
   int redo = 0, count = 0;
 
   /* Running value of the maximal smoothing length */
@@ -1145,12 +1265,41 @@ void runner_do_ghost(struct runner *r, struct cell *c, int timer) {
       error("Can't allocate memory for left.");
     if ((right = (float *)malloc(sizeof(float) * c->hydro.count)) == NULL)
       error("Can't allocate memory for right.");
+
+    /* Init the neighbour lists of the particles if we use them. */
+    float *h_list = NULL;
+    float *h_step = NULL;
+    size_t *ngb_first = NULL;
+    int *ngb_num = NULL;
+    int *cid = NULL;
+    int *cpid = NULL;
+    float *h_save = NULL;
+    if (use_ngb_lists) {
+      if ((h_list = (float *)malloc(sizeof(float) * c->hydro.count)) == NULL)
+        error("Can't allocate memory for h_list.");
+      if ((h_step = (float *)malloc(sizeof(float) * c->hydro.count)) == NULL)
+        error("Can't allocate memory for h_step.");
+      if ((ngb_first = (size_t *)malloc(sizeof(size_t) * c->hydro.count)) ==
+          NULL)
+        error("Can't allocate memory for ngb_first.");
+      if ((ngb_num = (int *)malloc(sizeof(int) * c->hydro.count)) == NULL)
+        error("Can't allocate memory for ngb_num.");
+      if ((cid = (int *)malloc(sizeof(int) * c->hydro.count)) == NULL)
+        error("Can't allocate memory for cid.");
+      if ((cpid = (int *)malloc(sizeof(int) * c->hydro.count)) == NULL)
+        error("Can't allocate memory for cpid.");
+      if ((h_save = (float *)malloc(sizeof(float) * c->hydro.count)) == NULL)
+        error("Can't allocate memory for h_save.");
+      ghost_ngb_lists_reset(&r->ghost_ngbs);
+    }
+
     for (int k = 0; k < c->hydro.count; k++)
       if (part_is_active(&parts[k], e)) {
         pid[count] = k;
         h_0[count] = parts[k].h;
         left[count] = 0.f;
         right[count] = hydro_h_max;
+        if (use_ngb_lists) h_list[count] = -1.f;
         ++count;
       }
 
@@ -1375,6 +1524,12 @@ void runner_do_ghost(struct runner *r, struct cell *c, int timer) {
             h_0[redo] = h_0[i];
             left[redo] = left[i];
             right[redo] = right[i];
+            if (use_ngb_lists) {
+              h_step[redo] = fabsf(p->h - h_old);
+              h_list[redo] = h_list[i];
+              ngb_first[redo] = ngb_first[i];
+              ngb_num[redo] = ngb_num[i];
+            }
             redo += 1;
 
             /* Re-initialise everything */
@@ -1498,52 +1653,12 @@ void runner_do_ghost(struct runner *r, struct cell *c, int timer) {
       /* Re-set the counter for the next loop (potentially). */
       count = redo;
       if (count > 0) {
-
-        /* Climb up the cell hierarchy. */
-        for (struct cell *finger = c; finger != NULL; finger = finger->parent) {
-
-          /* Run through this cell's density interactions. */
-          for (struct link *l = finger->hydro.density; l != NULL; l = l->next) {
-
-#ifdef SWIFT_DEBUG_CHECKS
-            if (l->t->ti_run < r->e->ti_current)
-              error("Density task should have been run.");
-#endif
-
-            /* Self-interaction? */
-            if (l->t->type == task_type_self)
-              runner_doself_subset_branch_density(r, finger, parts, pid, count);
-
-            /* Otherwise, pair interaction? */
-            else if (l->t->type == task_type_pair) {
-
-              /* Left or right? */
-              if (l->t->ci == finger)
-                runner_dopair_subset_branch_density(r, finger, parts, pid,
-                                                    count, l->t->cj);
-              else
-                runner_dopair_subset_branch_density(r, finger, parts, pid,
-                                                    count, l->t->ci);
-            }
-
-            /* Otherwise, sub-self interaction? */
-            else if (l->t->type == task_type_sub_self)
-              runner_dosub_subset_density(r, finger, parts, pid, count, NULL,
-                                          1);
-
-            /* Otherwise, sub-pair interaction? */
-            else if (l->t->type == task_type_sub_pair) {
-
-              /* Left or right? */
-              if (l->t->ci == finger)
-                runner_dosub_subset_density(r, finger, parts, pid, count,
-                                            l->t->cj, 1);
-              else
-                runner_dosub_subset_density(r, finger, parts, pid, count,
-                                            l->t->ci, 1);
-            }
-          }
-        }
+        if (use_ngb_lists)
+          runner_do_ghost_density_ngb_lists(r, c, parts, pid, right, h_step,
+                                            h_list, ngb_first, ngb_num, cid,
+                                            cpid, h_save, count);
+        else
+          runner_do_ghost_density_subset(r, c, parts, pid, count);
       }
     }
 
@@ -1564,6 +1679,13 @@ void runner_do_ghost(struct runner *r, struct cell *c, int timer) {
     free(right);
     free(pid);
     free(h_0);
+    free(h_list);
+    free(h_step);
+    free(ngb_first);
+    free(ngb_num);
+    free(cid);
+    free(cpid);
+    free(h_save);
   }
 
   /* Update h_max */
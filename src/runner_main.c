@@ -478,7 +478,9 @@ void *runner_main(void *data) {
           break;
 #ifdef WITH_MPI
         case task_type_send:
-          if (t->subtype == task_subtype_tend) {
+          if (scheduler_task_is_node_shared(sched, t)) {
+            runner_do_send_node_shared(r, t);
+          } else if (t->subtype == task_subtype_tend) {
             free(t->buff);
           } else if (t->subtype == task_subtype_sf_counts) {
             free(t->buff);
@@ -491,6 +493,8 @@ void *runner_main(void *data) {
           }
           break;
         case task_type_recv:
+          if (scheduler_task_is_node_shared(sched, t))
+            runner_do_recv_node_shared(r, t);
           if (t->subtype == task_subtype_tend) {
             cell_unpack_end_step(ci, (struct pcell_step *)t->buff);
             free(t->buff);
@@ -33,10 +33,17 @@
 #include "engine.h"
 #include "timers.h"
 
+/*! Number of neutrinos whose weights are computed together */
+#define neutrino_weighting_chunk_size 64
+
 /**
  * @brief Weight the active neutrino particles in a cell using the delta-f
  * method.
  *
+ * The neutrinos are gathered in chunks of #neutrino_weighting_chunk_size
+ * such that their phase-space densities and weights are computed in a loop
+ * over contiguous arrays which the compiler can vectorise.
+ *
  * @param r The runner thread.
  * @param c The cell.
  * @param timer Are we timing this ?
@@ -66,25 +73,54 @@ void runner_do_neutrino_weighting(struct runner *r, struct cell *c, int timer) {
       if (c->progeny[k] != NULL)
         runner_do_neutrino_weighting(r, c->progeny[k], 0);
   } else {
-    /* Loop over the gparts in this cell. */
-    for (int k = 0; k < gcount; k++) {
-      /* Get a handle on the part. */
-      struct gpart *restrict gp = &gparts[k];
 
-      /* Only act on neutrinos that needed to be kicked */
-      if (!(gp->type == swift_type_neutrino && gpart_is_starting(gp, e)))
-        continue;
+    int index[neutrino_weighting_chunk_size];
+    double p[neutrino_weighting_chunk_size];
+    double f_i[neutrino_weighting_chunk_size];
+    double mass[neutrino_weighting_chunk_size];
+
+    for (int k = 0; k < gcount;) {
+
+      /* Gather the next chunk of neutrinos that needed to be kicked */
+      int count = 0;
+      for (; k < gcount && count < neutrino_weighting_chunk_size; k++) {
+        const struct gpart *restrict gp = &gparts[k];
+
+        if (!(gp->type == swift_type_neutrino && gpart_is_starting(gp, e)))
+          continue;
 
-      /* Compute the mass and delta-f weight */
-      double mass, weight;
-      gpart_neutrino_mass_weight(gp, &nu_model, &mass, &weight);
+        /* Use a particle id dependent seed */
+        const long long seed = gp->id_or_neg_offset + nu_model.neutrino_seed;
+
+        /* The neutrino mass and degeneracy (we cycle based on the seed) */
+        const double m_eV =
+            neutrino_seed_to_mass(nu_model.N_nu, nu_model.M_nu_eV, seed);
+        const double deg =
+            neutrino_seed_to_degeneracy(nu_model.N_nu, nu_model.deg_nu, seed);
+
+        index[count] = k;
+        mass[count] = deg * m_eV * nu_model.inv_mass_factor;
+        p[count] = neutrino_momentum(gp->v_full, m_eV, nu_model.fac);
+        f_i[count] =
+            gpart_neutrino_initial_density(gp, nu_model.neutrino_seed);
+        count++;
+      }
+
+      /* Compute the delta-f weights and the weighted masses */
+      for (int i = 0; i < count; i++) {
+        const double f = fermi_dirac_density(p[i]);
+        mass[i] *= 1.0 - f / f_i[i];
+      }
 
-      /* Set the statistically weighted mass */
-      gp->mass = mass * weight;
+      /* Set the statistically weighted masses */
+      for (int i = 0; i < count; i++) {
+        struct gpart *restrict gp = &gparts[index[i]];
+        gp->mass = mass[i];
 
-      /* Prevent degeneracies */
-      if (gp->mass == 0.) {
-        gp->mass = FLT_MIN;
+        /* Prevent degeneracies */
+        if (gp->mass == 0.) {
+          gp->mass = FLT_MIN;
+        }
       }
     }
   }
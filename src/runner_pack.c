@@ -30,6 +30,8 @@
 
 /* Local headers. */
 #include "cell.h"
+#include "engine.h"
+#include "mpi_node.h"
 #include "timers.h"
 
 /**
@@ -66,3 +68,50 @@ void runner_do_unpack_limiter(struct runner *r, struct cell *c, void *buffer,
 
   free(buffer);
 }
+
+/**
+ * @brief Write the particles of a send task straight into the node-shared
+ * foreign buffer of the receiving node-mate and signal that they are there.
+ *
+ * The node-mate has told us it is ready to receive (that was the message the
+ * task waited for), so its foreign copy of the cell is not in use anymore.
+ *
+ * @param r The runner thread.
+ * @param t The send #task.
+ */
+void runner_do_send_node_shared(struct runner *r, struct task *t) {
+
+#ifdef WITH_MPI
+  struct space *s = r->e->s;
+  const struct cell *c = t->ci;
+  const int node_rank = mpi_node_local_rank(t->cj->nodeID);
+
+  if (t->node_offset < 0)
+    error("No node-shared offset for send task (%s/%s tag=%lld, rank %d).",
+          taskID_names[t->type], subtaskID_names[t->subtype], t->flags,
+          t->cj->nodeID);
+
+  struct mpi_node_window *w = NULL;
+  if (t->subtype == task_subtype_gpart) {
+    w = &s->gparts_foreign_window;
+    memcpy(w->bases[node_rank] + t->node_offset * sizeof(struct gpart),
+           c->grav.parts, c->grav.count * sizeof(struct gpart));
+  } else {
+    w = &s->parts_foreign_window;
+    memcpy(w->bases[node_rank] + t->node_offset * sizeof(struct part),
+           c->hydro.parts, c->hydro.count * sizeof(struct part));
+  }
+
+  /* Make the data visible to the node-mate before telling it about it. */
+  mpi_node_window_sync(w);
+
+  MPI_Request req;
+  int err = MPI_Isend(NULL, 0, MPI_BYTE, t->cj->nodeID, t->flags,
+                      subtaskMPI_comms[t->subtype], &req);
+  if (err == MPI_SUCCESS) err = MPI_Request_free(&req);
+  if (err != MPI_SUCCESS)
+    mpi_error(err, "Failed to signal node-shared particle data.");
+#else
+  error("SWIFT was not compiled with MPI support.");
+#endif
+}
@@ -32,8 +32,30 @@
 
 /* Local headers. */
 #include "engine.h"
+#include "mpi_node.h"
 #include "timers.h"
 
+/**
+ * @brief Make the particles a node-mate wrote into our node-shared foreign
+ * buffer visible to this rank.
+ *
+ * @param r The runner thread.
+ * @param t The recv #task.
+ */
+void runner_do_recv_node_shared(struct runner *r, struct task *t) {
+#ifdef WITH_MPI
+
+  struct space *s = r->e->s;
+  if (t->subtype == task_subtype_gpart)
+    mpi_node_window_sync(&s->gparts_foreign_window);
+  else
+    mpi_node_window_sync(&s->parts_foreign_window);
+
+#else
+  error("SWIFT was not compiled with MPI support.");
+#endif
+}
+
 /**
  * @brief Construct the cell properties from the received #part.
  *
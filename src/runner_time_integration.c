@@ -1723,6 +1723,26 @@ void runner_do_rt_advance_cell_time(struct runner *r, struct cell *c,
   if (timer) TIMER_TOC(timer_do_rt_advance_cell_time);
 }
 
+/**
+ * @brief Add the number of particles updated in a top-level cell during an
+ * RT sub-cycle to the count of the sub-cycle in the #engine.
+ *
+ * The counts are only summed over the ranks once all the sub-cycles of the
+ * step are done.
+ *
+ * @param e The #engine.
+ * @param c The top-level #cell.
+ */
+static void runner_add_rt_sub_cycle_updates(struct engine *e, struct cell *c) {
+
+  if (c->top != c) return;
+
+  if (c->nodeID == e->nodeID) atomic_add(&e->rt_updates, c->rt.updated);
+
+  /* Collected, so clear for next time. */
+  c->rt.updated = 0;
+}
+
 /**
  * @brief Recursively collect the end-of-timestep information from the top-level
  * to the super level for the RT sub-cycling. (During sub-cycles, the regular
@@ -1736,7 +1756,7 @@ void runner_do_rt_advance_cell_time(struct runner *r, struct cell *c,
 void runner_do_collect_rt_times(struct runner *r, struct cell *c,
                                 const int timer) {
 
-  const struct engine *e = r->e;
+  struct engine *e = r->e;
   size_t rt_updated = 0;
 
   if (e->ti_current == e->ti_current_subcycle)
@@ -1765,6 +1785,7 @@ void runner_do_collect_rt_times(struct runner *r, struct cell *c,
     }
     c->rt.advanced_time = 0;
 #endif
+    runner_add_rt_sub_cycle_updates(e, c);
     return;
   }
 
@@ -1792,6 +1813,7 @@ void runner_do_collect_rt_times(struct runner *r, struct cell *c,
   c->rt.ti_rt_end_min = ti_rt_end_min;
   c->rt.ti_rt_beg_max = ti_rt_beg_max;
   c->rt.updated = rt_updated;
+  runner_add_rt_sub_cycle_updates(e, c);
 
   if (timer) TIMER_TOC(timer_do_rt_collect_times);
 }
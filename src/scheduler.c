@@ -1733,6 +1733,9 @@ struct task *scheduler_addtask(struct scheduler *s, enum task_types type,
   t->tic = 0;
   t->toc = 0;
   t->total_ticks = 0;
+#ifdef WITH_MPI
+  t->node_offset = -1;
+#endif
 
   if (ci != NULL) cell_set_flag(ci, cell_flag_has_tasks);
   if (cj != NULL) cell_set_flag(cj, cell_flag_has_tasks);
@@ -2588,8 +2591,22 @@ void scheduler_enqueue(struct scheduler *s, struct task *t) {
           error("Unknown communication sub-type");
         }
 
-        err = MPI_Irecv(buff, count, type, t->ci->nodeID, t->flags,
-                        subtaskMPI_comms[t->subtype], &t->req);
+        if (scheduler_task_is_node_shared(s, t)) {
+
+          /* The node-mate writes the particles straight into our foreign
+           * buffer once we tell it that we are ready for them, and then
+           * sends an empty message to signal that it is done. */
+          MPI_Request ready_req;
+          err = MPI_Isend(NULL, 0, MPI_BYTE, t->ci->nodeID, t->flags,
+                          subtaskMPI_node_comms[t->subtype], &ready_req);
+          if (err == MPI_SUCCESS) err = MPI_Request_free(&ready_req);
+          if (err == MPI_SUCCESS)
+            err = MPI_Irecv(NULL, 0, MPI_BYTE, t->ci->nodeID, t->flags,
+                            subtaskMPI_comms[t->subtype], &t->req);
+        } else {
+          err = MPI_Irecv(buff, count, type, t->ci->nodeID, t->flags,
+                          subtaskMPI_comms[t->subtype], &t->req);
+        }
 
         if (err != MPI_SUCCESS) {
           mpi_error(err, "Failed to emit irecv for particle data.");
@@ -2685,7 +2702,13 @@ void scheduler_enqueue(struct scheduler *s, struct task *t) {
           error("Unknown communication sub-type");
         }
 
-        if (size > s->mpi_message_limit) {
+        if (scheduler_task_is_node_shared(s, t)) {
+
+          /* Wait for the node-mate to be ready to receive. The particles
+           * are then copied in runner_do_send_node_shared(). */
+          err = MPI_Irecv(NULL, 0, MPI_BYTE, t->cj->nodeID, t->flags,
+                          subtaskMPI_node_comms[t->subtype], &t->req);
+        } else if (size > s->mpi_message_limit) {
           err = MPI_Isend(buff, count, type, t->cj->nodeID, t->flags,
                           subtaskMPI_comms[t->subtype], &t->req);
         } else {
@@ -35,6 +35,7 @@
 #include "cell.h"
 #include "inline.h"
 #include "lock.h"
+#include "mpi_node.h"
 #include "queue.h"
 #include "task.h"
 #include "threadpool.h"
@@ -106,6 +107,9 @@ struct scheduler {
    * MPI. */
   size_t mpi_message_limit;
 
+  /* Do node-mates exchange particles through node-shared foreign buffers? */
+  int mpi_node_shared_foreign;
+
   /* Total ticks spent running the tasks */
   ticks total_ticks;
 
@@ -143,6 +147,42 @@ __attribute__((always_inline)) INLINE static void scheduler_activate(
   }
 }
 
+/**
+ * @brief Does a given send or recv task move its data through the
+ * node-shared foreign buffers rather than through an MPI message?
+ *
+ * That is the case for the #part and #gpart communications between ranks
+ * running on the same node when the node-shared mode is switched on.
+ *
+ * @param s The #scheduler.
+ * @param t The send or recv #task.
+ */
+__attribute__((always_inline)) INLINE static int scheduler_task_is_node_shared(
+    const struct scheduler *s, const struct task *t) {
+#ifdef WITH_MPI
+  if (!s->mpi_node_shared_foreign) return 0;
+
+  switch (t->subtype) {
+    case task_subtype_xv:
+    case task_subtype_rho:
+    case task_subtype_gradient:
+    case task_subtype_rt_gradient:
+    case task_subtype_rt_transport:
+    case task_subtype_part_prep1:
+    case task_subtype_gpart:
+      break;
+    default:
+      return 0;
+  }
+
+  const int other_rank =
+      (t->type == task_type_send) ? t->cj->nodeID : t->ci->nodeID;
+  return mpi_node_local_rank(other_rank) >= 0;
+#else
+  return 0;
+#endif
+}
+
 /**
  * @brief Search a given linked list of task for a given subtype and activate
  * it.
@@ -431,6 +431,11 @@ void write_array_serial(const struct engine* e, hid_t grp, char* fileName,
   /* Copy the particle data to the temporary buffer */
   io_copy_temp_buffer(temp, e, props, N, internal_units, snapshot_units);
 
+  /* Round the values if an error-bounded scheme was chosen */
+  if (compression_scheme_is_error_bounded(lossy_compression))
+    io_quantise_buffer((struct threadpool*)&e->threadpool, temp, num_elements,
+                       props.type, lossy_compression, props.name);
+
   /* Construct information for the hyper-slab */
   int rank;
   hsize_t shape[2];
@@ -522,6 +527,9 @@ void write_array_serial(const struct engine* e, hid_t grp, char* fileName,
  * @param dry_run If 1, don't read the particle. Only allocates the arrays.
  * @param remap_ids Are we ignoring the ICs' IDs and remapping them to [1, N[ ?
  * @param ics_metadata Will store metadata group copied from the ICs file
+ * @param initial_partition The #partition to use for the initial domain
+ * decomposition. If it follows the cells of the ICs, each rank only reads the
+ * particles of the cells it is given.
  *
  * Opens the HDF5 file fileName and reads the particles contained
  * in the parts array. N is the returned number of particles found
@@ -544,7 +552,8 @@ void read_ic_serial(char* fileName, const struct unit_system* internal_units,
                     const int cleanup_sqrt_a, double h, double a,
                     const int mpi_rank, int mpi_size, MPI_Comm comm,
                     MPI_Info info, const int n_threads, const int dry_run,
-                    const int remap_ids, struct ic_info* ics_metadata) {
+                    const int remap_ids, struct ic_info* ics_metadata,
+                    struct partition* initial_partition) {
 
   hid_t h_file = 0, h_grp = 0;
   /* GADGET has only cubic boxes (in cosmological mode) */
@@ -700,10 +709,26 @@ void read_ic_serial(char* fileName, const struct unit_system* internal_units,
   MPI_Bcast(ic_units, sizeof(struct unit_system), MPI_BYTE, 0, comm);
   ic_info_struct_broadcast(ics_metadata, 0);
 
-  /* Divide the particles among the tasks. */
-  for (int ptype = 0; ptype < swift_type_count; ++ptype) {
-    offset[ptype] = mpi_rank * N_total[ptype] / mpi_size;
-    N[ptype] = (mpi_rank + 1) * N_total[ptype] / mpi_size - offset[ptype];
+  /* If the initial partition is to follow the cells of the ICs, each rank
+   * only reads the particles of its cells. */
+  int read_by_cells = 0;
+  if (initial_partition->type == INITPART_ICS) {
+    read_by_cells = io_read_cell_regions(
+        fileName, N_total, mpi_rank, mpi_size, initial_partition->ic_cdim,
+        &initial_partition->ic_cell_ranks, offset, N);
+    if (!read_by_cells) {
+      if (mpi_rank == 0)
+        message("Cannot read the ICs by cell, using a vectorised partition");
+      initial_partition->type = INITPART_VECTORIZE;
+    }
+  }
+
+  /* Otherwise divide the particles evenly among the tasks. */
+  if (!read_by_cells) {
+    for (int ptype = 0; ptype < swift_type_count; ++ptype) {
+      offset[ptype] = mpi_rank * N_total[ptype] / mpi_size;
+      N[ptype] = (mpi_rank + 1) * N_total[ptype] / mpi_size - offset[ptype];
+    }
   }
 
   /* Allocate memory to store SPH particles */
@@ -1319,9 +1344,10 @@ void write_output_serial(struct engine* e,
   /* Write the location of the particles in the arrays */
   io_write_cell_offsets(h_grp_cells, e->s->cdim, e->s->dim, e->s->cells_top,
                         e->s->nr_cells, e->s->width, mpi_rank,
-                        /*distributed=*/0, subsample, subsample_fraction,
-                        e->snapshot_output_count, N_total, offset, to_write,
-                        numFields, internal_units, snapshot_units);
+                        /*distributed=*/0, /*rank_files=*/NULL, subsample,
+                        subsample_fraction, e->snapshot_output_count, N_total,
+                        offset, to_write, numFields, internal_units,
+                        snapshot_units);
 
   /* Close everything */
   if (mpi_rank == 0) {
@@ -56,6 +56,7 @@
 #include "part_type.h"
 #include "rt_io.h"
 #include "sink_io.h"
+#include "snapshot_async.h"
 #include "star_formation_io.h"
 #include "stars_io.h"
 #include "tools.h"
@@ -220,42 +221,46 @@ void read_array_single(hid_t h_grp, const struct io_props props, size_t N,
 }
 
 /**
- * @brief Writes a data array in given HDF5 group.
+ * @brief A field converted and waiting to be written by
+ * write_array_single_buffer().
+ */
+struct write_array_single_data {
+  const struct engine* e;
+  hid_t grp;
+  const char* fileName;
+  FILE* xmfFile;
+  const char* partTypeGroupName;
+  struct io_props props;
+  size_t N;
+  enum lossy_compression_schemes lossy_compression;
+  const struct unit_system* snapshot_units;
+  void* temp;
+};
+
+/**
+ * @brief Writes a converted data array in given HDF5 group and frees it.
  *
- * @param e The #engine we are writing from.
- * @param grp The group in which to write.
- * @param fileName The name of the file in which the data is written
- * @param xmfFile The FILE used to write the XMF description
- * @param partTypeGroupName The name of the group containing the particles in
- * the HDF5 file.
- * @param props The #io_props of the field to read
- * @param N The number of particles to write.
- * @param internal_units The #unit_system used internally
- * @param snapshot_units The #unit_system used in the snapshots
+ * This is called by the #io_write_pipeline, possibly from its own thread.
  *
- * @todo A better version using HDF5 hyper-slabs to write the file directly from
- * the part array will be written once the structures have been stabilized.
+ * @param data The #write_array_single_data of the field.
  */
-void write_array_single(const struct engine* e, hid_t grp, const char* fileName,
-                        FILE* xmfFile, const char* partTypeGroupName,
-                        const struct io_props props, const size_t N,
-                        const enum lossy_compression_schemes lossy_compression,
-                        const struct unit_system* internal_units,
-                        const struct unit_system* snapshot_units) {
-
+static void write_array_single_buffer(void* data) {
+
+  const struct write_array_single_data d =
+      *((struct write_array_single_data*)data);
+  free(data);
+
+  const struct engine* e = d.e;
+  const hid_t grp = d.grp;
+  const char* fileName = d.fileName;
+  FILE* xmfFile = d.xmfFile;
+  const char* partTypeGroupName = d.partTypeGroupName;
+  const struct io_props props = d.props;
+  const size_t N = d.N;
+  const enum lossy_compression_schemes lossy_compression = d.lossy_compression;
+  const struct unit_system* snapshot_units = d.snapshot_units;
+  void* temp = d.temp;
   const size_t typeSize = io_sizeof_type(props.type);
-  const size_t num_elements = N * props.dimension;
-
-  /* message("Writing '%s' array...", props.name); */
-
-  /* Allocate temporary buffer */
-  void* temp = NULL;
-  if (swift_memalign("writebuff", (void**)&temp, IO_BUFFER_ALIGNMENT,
-                     num_elements * typeSize) != 0)
-    error("Unable to allocate temporary i/o buffer");
-
-  /* Copy the particle data to the temporary buffer */
-  io_copy_temp_buffer(temp, e, props, N, internal_units, snapshot_units);
 
   /* Create data space */
   const hid_t h_space = H5Screate(H5S_SIMPLE);
@@ -337,10 +342,21 @@ void write_array_single(const struct engine* e, hid_t grp, const char* fileName,
                                  h_prop, H5P_DEFAULT);
   if (h_data < 0) error("Error while creating dataspace '%s'.", props.name);
 
-  /* Write temporary buffer to HDF5 dataspace */
-  h_err = H5Dwrite(h_data, io_hdf5_type(props.type), h_space, H5S_ALL,
-                   H5P_DEFAULT, temp);
-  if (h_err < 0) error("Error while writing data array '%s'.", props.name);
+#ifdef IO_THREADED_DEFLATE
+  /* Compress on all the threads if only the lossless filters are used */
+  if (io_compression_uses_threadpool(e->snapshot_compression, N,
+                                     lossy_compression)) {
+    io_write_deflated_chunks((struct threadpool*)&e->threadpool, h_data, temp,
+                             N, props.dimension, typeSize, chunk_shape[0],
+                             e->snapshot_compression, props.name);
+  } else
+#endif
+  {
+    /* Write temporary buffer to HDF5 dataspace */
+    h_err = H5Dwrite(h_data, io_hdf5_type(props.type), h_space, H5S_ALL,
+                     H5P_DEFAULT, temp);
+    if (h_err < 0) error("Error while writing data array '%s'.", props.name);
+  }
 
   /* Write XMF description for this data set */
   if (xmfFile != NULL)
@@ -391,6 +407,83 @@ void write_array_single(const struct engine* e, hid_t grp, const char* fileName,
   H5Sclose(h_space);
 }
 
+/**
+ * @brief Writes a data array in given HDF5 group.
+ *
+ * @param e The #engine we are writing from.
+ * @param grp The group in which to write.
+ * @param fileName The name of the file in which the data is written
+ * @param xmfFile The FILE used to write the XMF description
+ * @param partTypeGroupName The name of the group containing the particles in
+ * the HDF5 file.
+ * @param props The #io_props of the field to read
+ * @param N The number of particles to write.
+ * @param ptype The type of the particles (to keep the fields of keyframes).
+ * @param lossy_compression Level of lossy compression to use for this field.
+ * @param internal_units The #unit_system used internally
+ * @param snapshot_units The #unit_system used in the snapshots
+ * @param pipeline The #io_write_pipeline writing the fields. The data are
+ * converted here and written once the previous field has been written,
+ * possibly in the background.
+ *
+ * @todo A better version using HDF5 hyper-slabs to write the file directly from
+ * the part array will be written once the structures have been stabilized.
+ */
+void write_array_single(const struct engine* e, hid_t grp, const char* fileName,
+                        FILE* xmfFile, const char* partTypeGroupName,
+                        const struct io_props props, const size_t N,
+                        const int ptype,
+                        const enum lossy_compression_schemes lossy_compression,
+                        const struct unit_system* internal_units,
+                        const struct unit_system* snapshot_units,
+                        struct io_write_pipeline* pipeline) {
+
+  const size_t typeSize = io_sizeof_type(props.type);
+  const size_t num_elements = N * props.dimension;
+
+  /* message("Writing '%s' array...", props.name); */
+
+  /* Allocate temporary buffer */
+  void* temp = NULL;
+  if (swift_memalign("writebuff", (void**)&temp, IO_BUFFER_ALIGNMENT,
+                     num_elements * typeSize) != 0)
+    error("Unable to allocate temporary i/o buffer");
+
+  /* Copy the particle data to the temporary buffer */
+  io_copy_temp_buffer(temp, e, props, N, internal_units, snapshot_units);
+
+  /* Round the values if an error-bounded scheme was chosen */
+  if (compression_scheme_is_error_bounded(lossy_compression))
+    io_quantise_buffer((struct threadpool*)&e->threadpool, temp, num_elements,
+                       props.type, lossy_compression, props.name);
+
+  /* Keep the values of a keyframe to write the next snapshots as deltas */
+  struct snapshot_keyframe* keyframe =
+      (struct snapshot_keyframe*)&e->snapshot_keyframe;
+  snapshot_keyframe_store_field(keyframe, ptype, &props, N, lossy_compression,
+                                temp);
+
+  /* Write it once the previous field is written. The writing can be done in
+   * the background unless it needs the threadpool to compress the data. */
+  struct write_array_single_data* data =
+      (struct write_array_single_data*)malloc(sizeof(*data));
+  if (data == NULL) error("Unable to allocate i/o pipeline data");
+  data->e = e;
+  data->grp = grp;
+  data->fileName = fileName;
+  data->xmfFile = xmfFile;
+  data->partTypeGroupName = partTypeGroupName;
+  data->props = props;
+  data->N = N;
+  data->lossy_compression = lossy_compression;
+  data->snapshot_units = snapshot_units;
+  data->temp = temp;
+  io_write_pipeline_submit(
+      pipeline, write_array_single_buffer, data,
+      !io_compression_uses_threadpool(e->snapshot_compression, N,
+                                      lossy_compression));
+}
+
 /**
  * @brief Reads an HDF5 initial condition file (GADGET-3 type)
  *
@@ -982,10 +1075,16 @@ void write_output_single(struct engine* e,
 
   };
 
+  /* Is this a keyframe or a delta snapshot? */
+  snapshot_keyframe_start(&e->snapshot_keyframe, fileName);
+
   /* Open file */
   /* message("Opening file '%s'.", fileName); */
-  h_file = H5Fcreate(fileName, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  hid_t h_fapl = H5P_DEFAULT;
+  if (e->snapshot_async.enabled) h_fapl = snapshot_async_create_fapl();
+  h_file = H5Fcreate(fileName, H5F_ACC_TRUNC, H5P_DEFAULT, h_fapl);
   if (h_file < 0) error("Error while opening file '%s'.", fileName);
+  if (e->snapshot_async.enabled) H5Pclose(h_fapl);
 
   /* Open header to write simulation properties */
   /* message("Writing file header..."); */
@@ -1077,6 +1176,7 @@ void write_output_single(struct engine* e,
   io_write_attribute_s(h_grp, "SelectOutput", current_selection_name);
   io_write_attribute_i(h_grp, "Virtual", 0);
   io_write_attribute(h_grp, "CanHaveTypes", INT, to_write, swift_type_count);
+  snapshot_keyframe_write_header(&e->snapshot_keyframe, h_grp);
 
   if (subsample_any) {
     io_write_attribute_s(h_grp, "OutputType", "SubSampled");
@@ -1103,9 +1203,10 @@ void write_output_single(struct engine* e,
   /* Write the location of the particles in the arrays */
   io_write_cell_offsets(h_grp, e->s->cdim, e->s->dim, e->s->cells_top,
                         e->s->nr_cells, e->s->width, e->nodeID,
-                        /*distributed=*/0, subsample, subsample_fraction,
-                        e->snapshot_output_count, N_total, global_offsets,
-                        to_write, numFields, internal_units, snapshot_units);
+                        /*distributed=*/0, /*rank_files=*/NULL, subsample,
+                        subsample_fraction, e->snapshot_output_count, N_total,
+                        global_offsets, to_write, numFields, internal_units,
+                        snapshot_units);
   H5Gclose(h_grp);
 
   /* Loop over all particle types */
@@ -1418,7 +1519,13 @@ void write_output_single(struct engine* e,
             output_options->select_output, current_selection_name,
             (enum part_type)ptype, e->verbose);
 
-    /* Write everything that is not cancelled */
+    /* Find the particles in the keyframe or record them as a new one */
+    snapshot_keyframe_start_type(&e->snapshot_keyframe, e, ptype, list,
+                                 num_fields, N);
+
+    /* Write everything that is not cancelled, converting each field while the
+     * previous one is being written */
+    struct io_write_pipeline pipeline = {0};
     int num_fields_written = 0;
     for (int i = 0; i < num_fields; ++i) {
 
@@ -1430,12 +1537,21 @@ void write_output_single(struct engine* e,
               e->verbose);
 
       if (compression_level != compression_do_not_write) {
-        write_array_single(e, h_grp, fileName, xmfFile, partTypeGroupName,
-                           list[i], N, compression_level, internal_units,
-                           snapshot_units);
+        if (snapshot_keyframe_field_is_delta(&e->snapshot_keyframe, ptype,
+                                             list[i].name, compression_level)) {
+          io_write_pipeline_wait(&pipeline);
+          snapshot_keyframe_write_delta(&e->snapshot_keyframe, e, h_grp, ptype,
+                                        &list[i], N, compression_level,
+                                        internal_units, snapshot_units);
+        } else {
+          write_array_single(e, h_grp, fileName, xmfFile, partTypeGroupName,
+                             list[i], N, ptype, compression_level,
+                             internal_units, snapshot_units, &pipeline);
+        }
         num_fields_written++;
       }
     }
+    io_write_pipeline_wait(&pipeline);
 
     /* Only write this now that we know exactly how many fields there are. */
     io_write_attribute_i(h_grp, "NumberOfFields", num_fields_written);
@@ -1462,6 +1578,10 @@ void write_output_single(struct engine* e,
 
   /* message("Done writing particles..."); */
 
+  /* Hand the in-memory file over to the background writer */
+  if (e->snapshot_async.enabled)
+    snapshot_async_submit(&e->snapshot_async, h_file, fileName);
+
   /* Close file */
   H5Fclose(h_file);
 
@@ -0,0 +1,178 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2024 The SWIFT team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/**
+ *  @file snapshot_async.c
+ *  @brief Write snapshot files to disk in the background.
+ *
+ *  The snapshot is written as usual, but into an in-memory HDF5 file (core
+ *  driver). The image of that file is then handed over to a thread that
+ *  writes it to disk with plain POSIX calls, so that neither HDF5 nor MPI is
+ *  used outside of the main thread.
+ */
+
+/* Config parameters. */
+#include <config.h>
+
+/* Standard headers. */
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+/* This object's header. */
+#include "snapshot_async.h"
+
+/* Local headers. */
+#include "clocks.h"
+#include "error.h"
+#include "memuse.h"
+
+/*! Growth increment of the in-memory files (bytes). */
+#define snapshot_async_core_increment (64 * 1024 * 1024)
+
+/**
+ * @brief Initialise the asynchronous writer.
+ *
+ * @param sa The #snapshot_async.
+ * @param enabled Are snapshots to be written asynchronously?
+ */
+void snapshot_async_init(struct snapshot_async *sa, const int enabled) {
+
+  bzero(sa, sizeof(struct snapshot_async));
+  sa->enabled = enabled;
+}
+
+/**
+ * @brief Body of the thread writing a file image to disk.
+ *
+ * @param arg The #snapshot_async.
+ */
+static void *snapshot_async_write(void *arg) {
+
+  struct snapshot_async *sa = (struct snapshot_async *)arg;
+  const ticks tic = getticks();
+
+  FILE *file = fopen(sa->file_name, "w");
+  if (file == NULL)
+    error("Unable to open snapshot file '%s' (%s).", sa->file_name,
+          strerror(errno));
+  if (fwrite(sa->image, 1, sa->size, file) != sa->size)
+    error("Failed to write snapshot file '%s' (%s).", sa->file_name,
+          strerror(errno));
+  if (fclose(file) != 0)
+    error("Failed to close snapshot file '%s' (%s).", sa->file_name,
+          strerror(errno));
+
+  sa->write_time = clocks_from_ticks(getticks() - tic);
+  return NULL;
+}
+
+/**
+ * @brief Wait for the write in progress, if any, to complete.
+ *
+ * @param sa The #snapshot_async.
+ * @param verbose Are we talkative?
+ * @return 1 if a write was in progress, 0 otherwise.
+ */
+int snapshot_async_wait(struct snapshot_async *sa, const int verbose) {
+
+  if (!sa->running) return 0;
+
+  const ticks tic = getticks();
+  if (pthread_join(sa->thread, NULL) != 0)
+    error("Failed to join the snapshot writer thread.");
+
+  if (verbose)
+    message("Writing '%s' (%.3f MB) took %.3f %s, waited %.3f %s for it.",
+            sa->file_name, sa->size / (1024. * 1024.), sa->write_time,
+            clocks_getunit(), clocks_from_ticks(getticks() - tic),
+            clocks_getunit());
+
+  swift_free("snapshot_image", sa->image);
+  sa->image = NULL;
+  sa->size = 0;
+  sa->running = 0;
+  return 1;
+}
+
+/**
+ * @brief Wait for any write in progress and release the writer.
+ *
+ * @param sa The #snapshot_async.
+ */
+void snapshot_async_clean(struct snapshot_async *sa) {
+  snapshot_async_wait(sa, /*verbose=*/0);
+}
+
+#ifdef HAVE_HDF5
+
+/**
+ * @brief Create the file access property list of an in-memory snapshot file.
+ *
+ * The file is never written by HDF5 itself. Its image has to be handed to
+ * #snapshot_async_submit before the file is closed.
+ */
+hid_t snapshot_async_create_fapl(void) {
+
+  hid_t h_fapl = H5Pcreate(H5P_FILE_ACCESS);
+  if (h_fapl < 0) error("Error while creating file access property list.");
+  if (H5Pset_fapl_core(h_fapl, snapshot_async_core_increment,
+                       /*backing_store=*/0) < 0)
+    error("Unable to set the HDF5 core driver.");
+  return h_fapl;
+}
+
+/**
+ * @brief Start writing an in-memory snapshot file to disk.
+ *
+ * The image of the file is copied, so the file can be closed as soon as this
+ * returns. Waits for the previous write, if any, to complete first.
+ *
+ * @param sa The #snapshot_async.
+ * @param h_file The open in-memory file (see #snapshot_async_create_fapl).
+ * @param file_name The name of the file to write on disk.
+ */
+void snapshot_async_submit(struct snapshot_async *sa, hid_t h_file,
+                           const char *file_name) {
+
+  /* Only one image in flight at a time. */
+  snapshot_async_wait(sa, /*verbose=*/0);
+
+  if (H5Fflush(h_file, H5F_SCOPE_GLOBAL) < 0)
+    error("Failed to flush in-memory snapshot file.");
+
+  const ssize_t size = H5Fget_file_image(h_file, NULL, 0);
+  if (size < 0) error("Failed to get the size of the snapshot file image.");
+
+  if ((sa->image = swift_malloc("snapshot_image", size)) == NULL)
+    error("Failed to allocate snapshot file image.");
+  if (H5Fget_file_image(h_file, sa->image, size) < 0)
+    error("Failed to copy the snapshot file image.");
+  sa->size = size;
+
+  if (strlen(file_name) >= FILENAME_BUFFER_SIZE)
+    error("Snapshot file name '%s' is too long.", file_name);
+  strcpy(sa->file_name, file_name);
+
+  if (pthread_create(&sa->thread, NULL, &snapshot_async_write, sa) != 0)
+    error("Failed to create the snapshot writer thread.");
+  sa->running = 1;
+}
+
+#endif /* HAVE_HDF5 */
@@ -0,0 +1,80 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2024 The SWIFT team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_SNAPSHOT_ASYNC_H
+#define SWIFT_SNAPSHOT_ASYNC_H
+
+/* Config parameters. */
+#include <config.h>
+
+/* Standard headers. */
+#include <pthread.h>
+#include <stddef.h>
+
+#ifdef HAVE_HDF5
+#include <hdf5.h>
+#endif
+
+/* Local headers. */
+#include "common_io.h"
+
+/**
+ * @brief State of the asynchronous snapshot writer.
+ *
+ * Snapshot files are built in memory with the HDF5 core driver while the
+ * simulation is paused, and the resulting file image is then written to disk
+ * by a background thread while the simulation carries on. At most one image
+ * is in flight at any time.
+ */
+struct snapshot_async {
+
+  /*! Are snapshots written asynchronously? */
+  int enabled;
+
+  /*! Is a write in progress? */
+  int running;
+
+  /*! Has a snapshot been started and not yet completed? Set on all the
+   * ranks, including those that do not write a file themselves. */
+  int pending;
+
+  /*! The thread writing the image. */
+  pthread_t thread;
+
+  /*! The file the image is written to. */
+  char file_name[FILENAME_BUFFER_SIZE];
+
+  /*! The in-memory image of the file and its size in bytes. */
+  void *image;
+  size_t size;
+
+  /*! Time spent by the thread writing the image (ms). */
+  double write_time;
+};
+
+void snapshot_async_init(struct snapshot_async *sa, const int enabled);
+int snapshot_async_wait(struct snapshot_async *sa, const int verbose);
+void snapshot_async_clean(struct snapshot_async *sa);
+
+#ifdef HAVE_HDF5
+hid_t snapshot_async_create_fapl(void);
+void snapshot_async_submit(struct snapshot_async *sa, hid_t h_file,
+                           const char *file_name);
+#endif
+
+#endif /* SWIFT_SNAPSHOT_ASYNC_H */
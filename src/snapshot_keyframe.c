@@ -0,0 +1,547 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2024 The SWIFT team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/**
+ *  @file snapshot_keyframe.c
+ *  @brief Keyframe-plus-delta snapshot series.
+ *
+ *  The fields written with an absolute error bound are rounded to a grid of
+ *  spacing q (see io_quantise_buffer()). Between keyframes, such a field is
+ *  written as the integer (x - x_keyframe) / q, which is exact and small for
+ *  particles that moved little. The position in the keyframe file of each
+ *  particle is written alongside, so that the full values can be recovered
+ *  without the particle IDs (see tools/reconstruct_keyframe_snapshot.py).
+ */
+
+/* Config parameters. */
+#include <config.h>
+
+/* Standard headers. */
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* This object's header. */
+#include "snapshot_keyframe.h"
+
+/* Local headers. */
+#include "engine.h"
+#include "error.h"
+#include "io_properties.h"
+#include "memuse.h"
+#include "threadpool.h"
+
+/*! Name of the group holding the deltas in each particle type group. */
+#define snapshot_keyframe_group_name "KeyframeDeltas"
+
+/*! Largest number of steps a delta can span and still be exact. */
+#define snapshot_keyframe_max_steps 9007199254740992. /* 2^53 */
+
+/**
+ * @brief Initialise the keyframe series.
+ *
+ * @param sk The #snapshot_keyframe.
+ * @param interval Number of snapshots between keyframes, 0 to always write
+ * full snapshots.
+ */
+void snapshot_keyframe_init(struct snapshot_keyframe *sk, const int interval) {
+
+  bzero(sk, sizeof(struct snapshot_keyframe));
+  sk->interval = interval;
+}
+
+/**
+ * @brief Release the data of the last keyframe of a particle type.
+ */
+static void snapshot_keyframe_clean_type(struct keyframe_type *kt) {
+
+  for (int i = 0; i < kt->nr_fields; i++)
+    swift_free("keyframe_values", kt->fields[i].values);
+  free(kt->fields);
+  swift_free("keyframe_ids", kt->ids);
+  swift_free("keyframe_order", kt->order);
+  swift_free("keyframe_match", kt->match);
+  bzero(kt, sizeof(struct keyframe_type));
+}
+
+/**
+ * @brief Release all the memory of the keyframe series.
+ *
+ * @param sk The #snapshot_keyframe.
+ */
+void snapshot_keyframe_clean(struct snapshot_keyframe *sk) {
+
+  for (int ptype = 0; ptype < swift_type_count; ptype++)
+    snapshot_keyframe_clean_type(&sk->types[ptype]);
+}
+
+/**
+ * @brief Start a new snapshot: decide whether it is a keyframe.
+ *
+ * @param sk The #snapshot_keyframe.
+ * @param file_name The name of the (local) file about to be written.
+ */
+void snapshot_keyframe_start(struct snapshot_keyframe *sk,
+                             const char *file_name) {
+
+  if (sk->interval <= 0) return;
+
+  sk->is_keyframe = (sk->count % sk->interval == 0);
+  sk->count++;
+
+  if (sk->is_keyframe) {
+    snapshot_keyframe_clean(sk);
+    if (strlen(file_name) >= FILENAME_BUFFER_SIZE)
+      error("Snapshot file name '%s' is too long.", file_name);
+    strcpy(sk->keyframe_name, file_name);
+  }
+}
+
+/**
+ * @brief A particle ID and its position in the keyframe.
+ */
+struct keyframe_id {
+  long long id;
+  long long index;
+};
+
+/**
+ * @brief Sort #keyframe_id by ID.
+ */
+static int keyframe_id_compare(const void *a, const void *b) {
+  const long long ia = ((const struct keyframe_id *)a)->id;
+  const long long ib = ((const struct keyframe_id *)b)->id;
+  return (ia > ib) - (ia < ib);
+}
+
+/**
+ * @brief Data needed by #snapshot_keyframe_match_mapper.
+ */
+struct keyframe_match_data {
+  const struct keyframe_type *kt;
+  const long long *ids;
+};
+
+/**
+ * @brief Threadpool mapper finding the particles of the snapshot being
+ * written in the last keyframe.
+ */
+static void snapshot_keyframe_match_mapper(void *map_data, int num_elements,
+                                           void *extra_data) {
+
+  const struct keyframe_match_data *data =
+      (const struct keyframe_match_data *)extra_data;
+  const struct keyframe_type *kt = data->kt;
+  const long long *ids = (const long long *)map_data;
+  const size_t first = ids - data->ids;
+
+  for (int i = 0; i < num_elements; i++) {
+
+    /* Binary search in the sorted IDs of the keyframe */
+    size_t lo = 0, hi = kt->N;
+    while (lo < hi) {
+      const size_t mid = lo + (hi - lo) / 2;
+      if (kt->ids[mid] < ids[i])
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    kt->match[first + i] =
+        (lo < kt->N && kt->ids[lo] == ids[i]) ? kt->order[lo] : -1;
+  }
+}
+
+/**
+ * @brief Start writing the particles of a given type.
+ *
+ * For a keyframe, records the IDs of the particles. Otherwise, finds each
+ * particle in the last keyframe.
+ *
+ * @param sk The #snapshot_keyframe.
+ * @param e The #engine.
+ * @param ptype The particle type.
+ * @param list The fields of that particle type.
+ * @param num_fields The number of fields in the list.
+ * @param N The number of particles written.
+ */
+void snapshot_keyframe_start_type(struct snapshot_keyframe *sk,
+                                  const struct engine *e, const int ptype,
+                                  const struct io_props *list,
+                                  const int num_fields, const size_t N) {
+
+  if (sk->interval <= 0) return;
+  struct keyframe_type *kt = &sk->types[ptype];
+  if (!sk->is_keyframe && !kt->valid) return;
+
+  /* Find the IDs amongst the fields */
+  int id_field = -1;
+  for (int i = 0; i < num_fields; i++)
+    if (strcmp(list[i].name, "ParticleIDs") == 0) id_field = i;
+  if (id_field < 0 || io_sizeof_type(list[id_field].type) != sizeof(long long))
+    return;
+
+  long long *ids = NULL;
+  if (swift_memalign("keyframe_ids", (void **)&ids, IO_BUFFER_ALIGNMENT,
+                     (N + 1) * sizeof(long long)) != 0)
+    error("Unable to allocate keyframe IDs.");
+  io_copy_temp_buffer(ids, e, list[id_field], N, e->internal_units,
+                      e->snapshot_units);
+
+  if (sk->is_keyframe) {
+
+    /* Sort the IDs, remembering where each one is in the file */
+    struct keyframe_id *sorted =
+        (struct keyframe_id *)malloc((N + 1) * sizeof(struct keyframe_id));
+    if (sorted == NULL) error("Unable to allocate keyframe IDs.");
+    for (size_t i = 0; i < N; i++) {
+      sorted[i].id = ids[i];
+      sorted[i].index = i;
+    }
+    qsort(sorted, N, sizeof(struct keyframe_id), keyframe_id_compare);
+
+    if (swift_memalign("keyframe_order", (void **)&kt->order,
+                       IO_BUFFER_ALIGNMENT, (N + 1) * sizeof(long long)) != 0)
+      error("Unable to allocate keyframe IDs.");
+    for (size_t i = 0; i < N; i++) {
+      ids[i] = sorted[i].id;
+      kt->order[i] = sorted[i].index;
+    }
+    free(sorted);
+
+    kt->ids = ids;
+    kt->N = N;
+    kt->valid = 1;
+
+  } else {
+
+    /* Find each particle in the keyframe */
+    swift_free("keyframe_match", kt->match);
+    if (swift_memalign("keyframe_match", (void **)&kt->match,
+                       IO_BUFFER_ALIGNMENT, (N + 1) * sizeof(long long)) != 0)
+      error("Unable to allocate keyframe match.");
+    kt->N_current = N;
+    kt->match_written = 0;
+
+    struct keyframe_match_data data = {kt, ids};
+    threadpool_map((struct threadpool *)&e->threadpool,
+                   snapshot_keyframe_match_mapper, ids, N, sizeof(long long),
+                   threadpool_auto_chunk_size, &data);
+    swift_free("keyframe_ids", ids);
+  }
+}
+
+/**
+ * @brief Find a stored field of the last keyframe.
+ *
+ * @return The #keyframe_field or NULL if the field was not stored.
+ */
+static const struct keyframe_field *snapshot_keyframe_find_field(
+    const struct keyframe_type *kt, const char *name) {
+
+  for (int i = 0; i < kt->nr_fields; i++)
+    if (strcmp(kt->fields[i].name, name) == 0) return &kt->fields[i];
+  return NULL;
+}
+
+/**
+ * @brief Is a field written as a delta from the last keyframe in the
+ * snapshot being written?
+ *
+ * @param sk The #snapshot_keyframe.
+ * @param ptype The particle type.
+ * @param name The name of the field.
+ * @param comp The #lossy_compression_schemes chosen for the field.
+ */
+int snapshot_keyframe_field_is_delta(
+    const struct snapshot_keyframe *sk, const int ptype, const char *name,
+    const enum lossy_compression_schemes comp) {
+
+  if (sk->interval <= 0 || sk->is_keyframe) return 0;
+  const struct keyframe_type *kt = &sk->types[ptype];
+  if (!kt->valid || kt->match == NULL) return 0;
+  const struct keyframe_field *f = snapshot_keyframe_find_field(kt, name);
+  return f != NULL && f->comp == comp;
+}
+
+/**
+ * @brief Keep the values of a field written in a keyframe.
+ *
+ * Only the fields with an absolute error bound are kept. The values are
+ * copied from the buffer the writer converted and rounded them into.
+ *
+ * @param sk The #snapshot_keyframe.
+ * @param ptype The particle type.
+ * @param props The #io_props of the field.
+ * @param N The number of particles written.
+ * @param comp The #lossy_compression_schemes chosen for the field.
+ * @param values The values as they are written in the snapshot.
+ */
+void snapshot_keyframe_store_field(struct snapshot_keyframe *sk,
+                                   const int ptype,
+                                   const struct io_props *props,
+                                   const size_t N,
+                                   const enum lossy_compression_schemes comp,
+                                   const void *values) {
+
+  if (sk->interval <= 0 || !sk->is_keyframe) return;
+  if (comp < compression_write_abs_err_1 || comp > compression_write_abs_err_6)
+    return;
+  struct keyframe_type *kt = &sk->types[ptype];
+  if (!kt->valid) return;
+
+  if (kt->nr_fields == kt->size_fields) {
+    kt->size_fields = kt->size_fields ? 2 * kt->size_fields : 4;
+    kt->fields = (struct keyframe_field *)realloc(
+        kt->fields, kt->size_fields * sizeof(struct keyframe_field));
+    if (kt->fields == NULL) error("Unable to allocate keyframe fields.");
+  }
+  struct keyframe_field *f = &kt->fields[kt->nr_fields++];
+  strcpy(f->name, props->name);
+  f->comp = comp;
+  f->type = props->type;
+  f->dimension = props->dimension;
+
+  const size_t size = N * props->dimension * io_sizeof_type(props->type);
+  if (swift_memalign("keyframe_values", &f->values, IO_BUFFER_ALIGNMENT,
+                     size + io_sizeof_type(props->type)) != 0)
+    error("Unable to allocate keyframe values.");
+  memcpy(f->values, values, size);
+}
+
+#ifdef HAVE_HDF5
+
+/**
+ * @brief Data needed by #snapshot_keyframe_delta_mapper.
+ */
+struct keyframe_delta_data {
+  const struct keyframe_field *f;
+  const long long *match;
+  const void *values;
+  unsigned long long *deltas;
+  double inv_step;
+};
+
+/**
+ * @brief Threadpool mapper computing the change of the values since the
+ * keyframe, in multiples of the rounding step.
+ *
+ * Both values are multiples of the step, so their difference is computed
+ * exactly in double precision as long as it spans less than 2^53 steps.
+ * Particles absent from the keyframe are stored relative to zero. The signed
+ * number of steps is zigzag-encoded (see snapshot_keyframe_zigzag_encode()).
+ */
+static void snapshot_keyframe_delta_mapper(void *map_data, int num_elements,
+                                           void *extra_data) {
+
+  const struct keyframe_delta_data *data =
+      (const struct keyframe_delta_data *)extra_data;
+  const struct keyframe_field *f = data->f;
+  const int dim = f->dimension;
+  const int is_double = (f->type == DOUBLE);
+  const long long *match = (const long long *)map_data;
+  const size_t first = match - data->match;
+
+  for (int i = 0; i < num_elements; i++) {
+    for (int k = 0; k < dim; k++) {
+
+      const size_t cur = (first + i) * dim + k;
+      const size_t key = match[i] * dim + k;
+      const double x = is_double ? ((const double *)data->values)[cur]
+                                 : ((const float *)data->values)[cur];
+      double x_key = 0.;
+      if (match[i] >= 0)
+        x_key = is_double ? ((const double *)f->values)[key]
+                          : ((const float *)f->values)[key];
+
+      const double steps = (x - x_key) * data->inv_step;
+      if (!(fabs(steps) < snapshot_keyframe_max_steps))
+        error(
+            "Cannot write field '%s' as a delta from the keyframe (value %e, "
+            "keyframe value %e).",
+            f->name, x, x_key);
+      data->deltas[cur] = snapshot_keyframe_zigzag_encode((long long)steps);
+    }
+  }
+}
+
+/**
+ * @brief Write an array of 64-bit integers, chunked and compressed like the
+ * other snapshot fields.
+ *
+ * @param grp The group to write to.
+ * @param name The name of the dataset.
+ * @param mem_type The HDF5 type of the data in memory.
+ * @param file_type The HDF5 type to use in the file (may be narrower).
+ * @param data The data.
+ * @param N The number of rows.
+ * @param dimension The number of elements per row.
+ * @param compression The deflate level.
+ */
+static void snapshot_keyframe_write_array(hid_t grp, const char *name,
+                                          hid_t mem_type, hid_t file_type,
+                                          const void *data, const size_t N,
+                                          const int dimension,
+                                          const int compression) {
+
+  const int rank = (dimension > 1) ? 2 : 1;
+  hsize_t shape[2] = {N, (hsize_t)dimension};
+  hsize_t chunk_shape[2] = {1 << 20, (hsize_t)dimension};
+  if (chunk_shape[0] > N) chunk_shape[0] = N;
+
+  const hid_t h_space = H5Screate_simple(rank, shape, NULL);
+  if (h_space < 0) error("Error while creating data space for '%s'.", name);
+
+  hid_t h_prop = H5Pcreate(H5P_DATASET_CREATE);
+  if (N > 0) {
+    if (H5Pset_chunk(h_prop, rank, chunk_shape) < 0)
+      error("Error while setting chunk size for '%s'.", name);
+    if (compression > 0) {
+      if (H5Pset_shuffle(h_prop) < 0 || H5Pset_deflate(h_prop, compression) < 0)
+        error("Error while setting compression options for '%s'.", name);
+    }
+    if (H5Pset_fletcher32(h_prop) < 0)
+      error("Error while setting checksum options for '%s'.", name);
+  }
+
+  const hid_t h_data = H5Dcreate(grp, name, file_type, h_space, H5P_DEFAULT,
+                                 h_prop, H5P_DEFAULT);
+  if (h_data < 0) error("Error while creating dataset '%s'.", name);
+  if (N > 0 &&
+      H5Dwrite(h_data, mem_type, H5S_ALL, H5S_ALL, H5P_DEFAULT, data) < 0)
+    error("Error while writing data array '%s'.", name);
+
+  H5Dclose(h_data);
+  H5Pclose(h_prop);
+  H5Sclose(h_space);
+}
+
+/**
+ * @brief Write the keyframe information in the header of a snapshot.
+ *
+ * @param sk The #snapshot_keyframe.
+ * @param h_grp The header group.
+ */
+void snapshot_keyframe_write_header(const struct snapshot_keyframe *sk,
+                                    hid_t h_grp) {
+
+  if (sk->interval <= 0) return;
+  io_write_attribute_i(h_grp, "IsKeyframe", sk->is_keyframe);
+  io_write_attribute_s(h_grp, "Keyframe", sk->keyframe_name);
+}
+
+/**
+ * @brief Write a field as its change since the last keyframe.
+ *
+ * The deltas go in the KeyframeDeltas group of the particle type, together
+ * with the position of each particle in the keyframe file (KeyframeIndex,
+ * -1 for particles that are not in the keyframe).
+ *
+ * @param sk The #snapshot_keyframe.
+ * @param e The #engine.
+ * @param grp The group of the particle type.
+ * @param ptype The particle type.
+ * @param props The #io_props of the field.
+ * @param N The number of particles written.
+ * @param comp The #lossy_compression_schemes chosen for the field.
+ * @param internal_units The #unit_system used internally.
+ * @param snapshot_units The #unit_system used in the snapshots.
+ */
+void snapshot_keyframe_write_delta(struct snapshot_keyframe *sk,
+                                   const struct engine *e, hid_t grp,
+                                   const int ptype,
+                                   const struct io_props *props,
+                                   const size_t N,
+                                   const enum lossy_compression_schemes comp,
+                                   const struct unit_system *internal_units,
+                                   const struct unit_system *snapshot_units) {
+
+  struct keyframe_type *kt = &sk->types[ptype];
+  const struct keyframe_field *f =
+      snapshot_keyframe_find_field(kt, props->name);
+  if (f == NULL || kt->match == NULL || kt->N_current != N)
+    error("Field '%s' cannot be written as a delta.", props->name);
+
+  const size_t num_elements = N * props->dimension;
+  const double step = compression_scheme_abs_err_step(comp);
+
+  /* The values as they would have been written */
+  void *values = NULL;
+  if (swift_memalign("writebuff", &values, IO_BUFFER_ALIGNMENT,
+                     (num_elements + 1) * io_sizeof_type(props->type)) != 0)
+    error("Unable to allocate temporary i/o buffer");
+  io_copy_temp_buffer(values, e, *props, N, internal_units, snapshot_units);
+  io_quantise_buffer((struct threadpool *)&e->threadpool, values,
+                     num_elements, props->type, comp, props->name);
+
+  /* Their change since the keyframe */
+  unsigned long long *deltas = NULL;
+  if (swift_memalign("keyframe_deltas", (void **)&deltas, IO_BUFFER_ALIGNMENT,
+                     (num_elements + 1) * sizeof(long long)) != 0)
+    error("Unable to allocate keyframe deltas.");
+  struct keyframe_delta_data data = {f, kt->match, values, deltas, 1. / step};
+  threadpool_map((struct threadpool *)&e->threadpool,
+                 snapshot_keyframe_delta_mapper, kt->match, N,
+                 sizeof(long long), threadpool_auto_chunk_size, &data);
+  swift_free("writebuff", values);
+
+  /* Use the narrowest unsigned type the deltas fit in */
+  unsigned long long max_delta = 0;
+  for (size_t k = 0; k < num_elements; k++)
+    if (deltas[k] > max_delta) max_delta = deltas[k];
+  hid_t file_type = H5T_STD_U64LE;
+  if (max_delta <= UINT8_MAX)
+    file_type = H5T_STD_U8LE;
+  else if (max_delta <= UINT16_MAX)
+    file_type = H5T_STD_U16LE;
+  else if (max_delta <= UINT32_MAX)
+    file_type = H5T_STD_U32LE;
+
+  /* Open or create the group of the deltas */
+  hid_t h_grp;
+  if (!kt->match_written) {
+    h_grp = H5Gcreate(grp, snapshot_keyframe_group_name, H5P_DEFAULT,
+                      H5P_DEFAULT, H5P_DEFAULT);
+    if (h_grp < 0) error("Error while creating the keyframe deltas group.");
+    snapshot_keyframe_write_array(h_grp, "KeyframeIndex", H5T_NATIVE_LLONG,
+                                  H5T_STD_I64LE, kt->match, N, 1,
+                                  e->snapshot_compression);
+    kt->match_written = 1;
+  } else {
+    h_grp = H5Gopen(grp, snapshot_keyframe_group_name, H5P_DEFAULT);
+    if (h_grp < 0) error("Error while opening the keyframe deltas group.");
+  }
+
+  snapshot_keyframe_write_array(h_grp, props->name, H5T_NATIVE_ULLONG,
+                                file_type, deltas, N, props->dimension,
+                                e->snapshot_compression);
+  swift_free("keyframe_deltas", deltas);
+
+  /* What is needed to turn the deltas back into values */
+  const hid_t h_data = H5Dopen(h_grp, props->name, H5P_DEFAULT);
+  if (h_data < 0) error("Error while opening dataset '%s'.", props->name);
+  io_write_attribute_d(h_data, "Step", step);
+  io_write_attribute_s(h_data, "Lossy compression filter",
+                       lossy_compression_schemes_names[comp]);
+  io_write_attribute_s(h_data, "Description", props->description);
+  H5Dclose(h_data);
+  H5Gclose(h_grp);
+}
+
+#endif /* HAVE_HDF5 */
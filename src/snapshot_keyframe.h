@@ -0,0 +1,177 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2024 The SWIFT team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_SNAPSHOT_KEYFRAME_H
+#define SWIFT_SNAPSHOT_KEYFRAME_H
+
+/* Config parameters. */
+#include <config.h>
+
+/* Standard headers. */
+#include <stddef.h>
+
+#ifdef HAVE_HDF5
+#include <hdf5.h>
+#endif
+
+/* Local headers. */
+#include "common_io.h"
+#include "inline.h"
+#include "io_compression.h"
+#include "part_type.h"
+
+/* Pre-declarations */
+struct engine;
+struct io_props;
+struct unit_system;
+
+/**
+ * @brief The values of a field as written in the last keyframe.
+ */
+struct keyframe_field {
+
+  /*! Name of the field. */
+  char name[FIELD_BUFFER_SIZE];
+
+  /*! Scheme the values were rounded with. */
+  enum lossy_compression_schemes comp;
+
+  /*! Type and dimension of the values. */
+  enum IO_DATA_TYPE type;
+  int dimension;
+
+  /*! The values, in the order they were written in the keyframe. */
+  void *values;
+};
+
+/**
+ * @brief The particles of a given type written in the last keyframe.
+ */
+struct keyframe_type {
+
+  /*! Was this type part of the last keyframe? */
+  int valid;
+
+  /*! Number of particles in the keyframe. */
+  size_t N;
+
+  /*! IDs of the particles in the keyframe, sorted. */
+  long long *ids;
+
+  /*! Position in the keyframe of each of the sorted IDs. */
+  long long *order;
+
+  /*! The fields stored. */
+  struct keyframe_field *fields;
+  int nr_fields;
+  int size_fields;
+
+  /*! For the snapshot being written: position in the keyframe of each
+   * particle, -1 if it was not there. */
+  long long *match;
+  size_t N_current;
+
+  /*! Has the match been written to the snapshot being written? */
+  int match_written;
+};
+
+/**
+ * @brief State of the keyframe-plus-delta snapshot series.
+ *
+ * Every interval-th snapshot is a full keyframe of which the fields written
+ * with an absolute error bound (AbsErr schemes) are kept in memory. In
+ * between, these fields are written as integer multiples of their rounding
+ * step relative to the keyframe, which compress to a fraction of the size of
+ * the values themselves. Keyframes are per file, so in distributed mode each
+ * rank refers to its own file of the keyframe.
+ */
+struct snapshot_keyframe {
+
+  /*! Number of snapshots between keyframes (0 for no deltas at all). */
+  int interval;
+
+  /*! Number of snapshots written since the last keyframe. */
+  int count;
+
+  /*! Is the snapshot being written a keyframe? */
+  int is_keyframe;
+
+  /*! File name of the last keyframe. */
+  char keyframe_name[FILENAME_BUFFER_SIZE];
+
+  /*! The keyframe data of each particle type. */
+  struct keyframe_type types[swift_type_count];
+};
+
+/**
+ * @brief Zigzag-encode a signed number of rounding steps.
+ *
+ * n >= 0 is stored as 2n and n < 0 as -2n - 1, so that small changes of
+ * either sign only use the low bytes.
+ *
+ * @param n The number of steps.
+ */
+__attribute__((always_inline)) INLINE static unsigned long long
+snapshot_keyframe_zigzag_encode(const long long n) {
+  return (n >= 0) ? 2ULL * n : 2ULL * (-(n + 1)) + 1ULL;
+}
+
+/**
+ * @brief Recover a signed number of rounding steps from its zigzag encoding
+ * (see tools/reconstruct_keyframe_snapshot.py).
+ *
+ * @param z The encoded number of steps.
+ */
+__attribute__((always_inline)) INLINE static long long
+snapshot_keyframe_zigzag_decode(const unsigned long long z) {
+  const long long half = (long long)(z >> 1);
+  return (z & 1ULL) ? -half - 1 : half;
+}
+
+void snapshot_keyframe_init(struct snapshot_keyframe *sk, const int interval);
+void snapshot_keyframe_clean(struct snapshot_keyframe *sk);
+void snapshot_keyframe_start(struct snapshot_keyframe *sk,
+                             const char *file_name);
+void snapshot_keyframe_start_type(struct snapshot_keyframe *sk,
+                                  const struct engine *e, const int ptype,
+                                  const struct io_props *list,
+                                  const int num_fields, const size_t N);
+int snapshot_keyframe_field_is_delta(
+    const struct snapshot_keyframe *sk, const int ptype, const char *name,
+    const enum lossy_compression_schemes comp);
+void snapshot_keyframe_store_field(struct snapshot_keyframe *sk,
+                                   const int ptype,
+                                   const struct io_props *props,
+                                   const size_t N,
+                                   const enum lossy_compression_schemes comp,
+                                   const void *values);
+
+#ifdef HAVE_HDF5
+void snapshot_keyframe_write_header(const struct snapshot_keyframe *sk,
+                                    hid_t h_grp);
+void snapshot_keyframe_write_delta(struct snapshot_keyframe *sk,
+                                   const struct engine *e, hid_t grp,
+                                   const int ptype,
+                                   const struct io_props *props,
+                                   const size_t N,
+                                   const enum lossy_compression_schemes comp,
+                                   const struct unit_system *internal_units,
+                                   const struct unit_system *snapshot_units);
+#endif
+
+#endif /* SWIFT_SNAPSHOT_KEYFRAME_H */
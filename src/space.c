@@ -129,6 +129,16 @@ struct qstack {
 void space_free_foreign_parts(struct space *s, const int clear_cell_pointers) {
 
 #ifdef WITH_MPI
+  if (s->e->sched.mpi_node_shared_foreign) {
+
+    /* Collective over the ranks of this node. */
+    mpi_node_window_free("parts_foreign", &s->parts_foreign_window);
+    mpi_node_window_free("gparts_foreign", &s->gparts_foreign_window);
+    s->parts_foreign = NULL;
+    s->size_parts_foreign = 0;
+    s->gparts_foreign = NULL;
+    s->size_gparts_foreign = 0;
+  }
   if (s->parts_foreign != NULL) {
     swift_free("parts_foreign", s->parts_foreign);
     s->size_parts_foreign = 0;
@@ -2375,10 +2385,7 @@ void space_clean(struct space *s) {
   swift_free("bparts", s->bparts);
   swift_free("sinks", s->sinks);
 #ifdef WITH_MPI
-  swift_free("parts_foreign", s->parts_foreign);
-  swift_free("sparts_foreign", s->sparts_foreign);
-  swift_free("gparts_foreign", s->gparts_foreign);
-  swift_free("bparts_foreign", s->bparts_foreign);
+  space_free_foreign_parts(s, /*clear_cell_pointers=*/0);
 #endif
   free(s->cells_sub);
   free(s->multipoles_sub);
@@ -2450,27 +2457,28 @@ void space_struct_dump(struct space *s, FILE *stream) {
                        "engine_foreign_alloc_margin",
                        "engine_foreign_alloc_margin");
 
-  /* More things to write. */
+  /* More things to write. These are aligned in the file so that they can be
+   * memory mapped when restarting. */
   if (s->nr_parts > 0) {
-    restart_write_blocks(s->parts, s->nr_parts, sizeof(struct part), stream,
-                         "parts", "parts");
-    restart_write_blocks(s->xparts, s->nr_parts, sizeof(struct xpart), stream,
-                         "xparts", "xparts");
+    restart_write_aligned_blocks(s->parts, sizeof(struct part), s->nr_parts,
+                                 stream, "parts", "parts");
+    restart_write_aligned_blocks(s->xparts, sizeof(struct xpart), s->nr_parts,
+                                 stream, "xparts", "xparts");
   }
   if (s->nr_gparts > 0)
-    restart_write_blocks(s->gparts, s->nr_gparts, sizeof(struct gpart), stream,
-                         "gparts", "gparts");
+    restart_write_aligned_blocks(s->gparts, sizeof(struct gpart), s->nr_gparts,
+                                 stream, "gparts", "gparts");
 
   if (s->nr_sinks > 0)
-    restart_write_blocks(s->sinks, s->nr_sinks, sizeof(struct sink), stream,
-                         "sinks", "sinks");
+    restart_write_aligned_blocks(s->sinks, sizeof(struct sink), s->nr_sinks,
+                                 stream, "sinks", "sinks");
 
   if (s->nr_sparts > 0)
-    restart_write_blocks(s->sparts, s->nr_sparts, sizeof(struct spart), stream,
-                         "sparts", "sparts");
+    restart_write_aligned_blocks(s->sparts, sizeof(struct spart), s->nr_sparts,
+                                 stream, "sparts", "sparts");
   if (s->nr_bparts > 0)
-    restart_write_blocks(s->bparts, s->nr_bparts, sizeof(struct bpart), stream,
-                         "bparts", "bparts");
+    restart_write_aligned_blocks(s->bparts, sizeof(struct bpart), s->nr_bparts,
+                                 stream, "bparts", "bparts");
 }
 
 /**
@@ -2548,65 +2556,44 @@ void space_struct_restore(struct space *s, FILE *stream) {
   s->size_sparts_foreign = 0;
   s->bparts_foreign = NULL;
   s->size_bparts_foreign = 0;
+  bzero(&s->parts_foreign_window, sizeof(struct mpi_node_window));
+  bzero(&s->gparts_foreign_window, sizeof(struct mpi_node_window));
 #endif
 
-  /* More things to read. */
+  /* More things to read. These may be memory mapped from the file, in which
+   * case only the space for the extra particles is allocated now. */
   s->parts = NULL;
   s->xparts = NULL;
   if (s->nr_parts > 0) {
-
-    /* Need the memory for these. */
-    if (swift_memalign("parts", (void **)&s->parts, part_align,
-                       s->size_parts * sizeof(struct part)) != 0)
-      error("Failed to allocate restore part array.");
-
-    if (swift_memalign("xparts", (void **)&s->xparts, xpart_align,
-                       s->size_parts * sizeof(struct xpart)) != 0)
-      error("Failed to allocate restore xpart array.");
-
-    restart_read_blocks(s->parts, s->nr_parts, sizeof(struct part), stream,
-                        NULL, "parts");
-    restart_read_blocks(s->xparts, s->nr_parts, sizeof(struct xpart), stream,
-                        NULL, "xparts");
+    restart_read_aligned_blocks("parts", (void **)&s->parts, part_align,
+                                sizeof(struct part), s->nr_parts,
+                                s->size_parts, stream, "parts");
+    restart_read_aligned_blocks("xparts", (void **)&s->xparts, xpart_align,
+                                sizeof(struct xpart), s->nr_parts,
+                                s->size_parts, stream, "xparts");
   }
   s->gparts = NULL;
-  if (s->nr_gparts > 0) {
-    if (swift_memalign("gparts", (void **)&s->gparts, gpart_align,
-                       s->size_gparts * sizeof(struct gpart)) != 0)
-      error("Failed to allocate restore gpart array.");
-
-    restart_read_blocks(s->gparts, s->nr_gparts, sizeof(struct gpart), stream,
-                        NULL, "gparts");
-  }
+  if (s->nr_gparts > 0)
+    restart_read_aligned_blocks("gparts", (void **)&s->gparts, gpart_align,
+                                sizeof(struct gpart), s->nr_gparts,
+                                s->size_gparts, stream, "gparts");
 
   s->sinks = NULL;
-  if (s->nr_sinks > 0) {
-    if (swift_memalign("sinks", (void **)&s->sinks, sink_align,
-                       s->size_sinks * sizeof(struct sink)) != 0)
-      error("Failed to allocate restore sink array.");
-
-    restart_read_blocks(s->sinks, s->nr_sinks, sizeof(struct sink), stream,
-                        NULL, "sinks");
-  }
+  if (s->nr_sinks > 0)
+    restart_read_aligned_blocks("sinks", (void **)&s->sinks, sink_align,
+                                sizeof(struct sink), s->nr_sinks,
+                                s->size_sinks, stream, "sinks");
 
   s->sparts = NULL;
-  if (s->nr_sparts > 0) {
-    if (swift_memalign("sparts", (void **)&s->sparts, spart_align,
-                       s->size_sparts * sizeof(struct spart)) != 0)
-      error("Failed to allocate restore spart array.");
-
-    restart_read_blocks(s->sparts, s->nr_sparts, sizeof(struct spart), stream,
-                        NULL, "sparts");
-  }
+  if (s->nr_sparts > 0)
+    restart_read_aligned_blocks("sparts", (void **)&s->sparts, spart_align,
+                                sizeof(struct spart), s->nr_sparts,
+                                s->size_sparts, stream, "sparts");
   s->bparts = NULL;
-  if (s->nr_bparts > 0) {
-    if (swift_memalign("bparts", (void **)&s->bparts, bpart_align,
-                       s->size_bparts * sizeof(struct bpart)) != 0)
-      error("Failed to allocate restore bpart array.");
-
-    restart_read_blocks(s->bparts, s->nr_bparts, sizeof(struct bpart), stream,
-                        NULL, "bparts");
-  }
+  if (s->nr_bparts > 0)
+    restart_read_aligned_blocks("bparts", (void **)&s->bparts, bpart_align,
+                                sizeof(struct bpart), s->nr_bparts,
+                                s->size_bparts, stream, "bparts");
 
   /* Need to reconnect the gravity parts to their hydro, star and BH particles.
    * Note that we can't use the threadpool here as we have not restored it yet.
@@ -32,6 +32,7 @@
 /* Includes. */
 #include "hydro_space.h"
 #include "lock.h"
+#include "mpi_node.h"
 #include "parser.h"
 #include "part.h"
 #include "space_unique_id.h"
@@ -347,6 +348,11 @@ struct space {
   struct bpart *bparts_foreign;
   size_t nr_bparts_foreign, size_bparts_foreign;
 
+  /*! Node-shared windows holding the foreign part and g-part buffers when
+   * node-mates write their particles directly into them. */
+  struct mpi_node_window parts_foreign_window;
+  struct mpi_node_window gparts_foreign_window;
+
 #endif
 };
 
@@ -0,0 +1,507 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2024 The SWIFT team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/**
+ *  @file stream_output.c
+ *  @brief Stream of particle outputs to a POSIX shared-memory ring buffer.
+ *
+ *  The fields of an output selection are converted to the snapshot units and
+ *  written directly into a slot of the segment, where a local consumer process
+ *  can read them without going through the file system (see
+ *  tools/stream_output_consumer.py). The engine never waits for the consumer:
+ *  outputs for which no slot is free are dropped and counted.
+ */
+
+/* Config parameters. */
+#include <config.h>
+
+/* Standard headers. */
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* This object's header. */
+#include "stream_output.h"
+
+/* Local headers. */
+#include "engine.h"
+#include "error.h"
+#include "io_properties.h"
+#include "memuse.h"
+#include "output_options.h"
+#include "parser.h"
+#include "units.h"
+
+#if defined(HAVE_HDF5) && defined(HAVE_SHM_OPEN)
+#define STREAM_OUTPUT_AVAILABLE
+#endif
+
+/**
+ * @brief Round a size up to the alignment of the segment.
+ */
+#define stream_output_align(size)                                       \
+  ((((size) + stream_output_alignment - 1) / stream_output_alignment) * \
+   stream_output_alignment)
+
+/**
+ * @brief Initialise the stream and create its shared-memory segment.
+ *
+ * Any segment of the same name left by a previous run is removed first, so
+ * consumers have to attach after the simulation has started (or restarted).
+ *
+ * @param so The #stream_output.
+ * @param params The parsed parameter file.
+ * @param nodeID The MPI rank of this node.
+ * @param nr_nodes The number of MPI ranks.
+ * @param verbose Are we talkative?
+ */
+void stream_output_init(struct stream_output *so, struct swift_params *params,
+                        const int nodeID, const int nr_nodes,
+                        const int verbose) {
+
+  so->enabled = parser_get_opt_param_int(params, "StreamOutput:enable", 0);
+  so->header = NULL;
+  so->size = 0;
+  so->published = 0;
+  so->dropped = 0;
+
+  if (!so->enabled) return;
+
+#ifdef STREAM_OUTPUT_AVAILABLE
+
+  /* One segment per rank */
+  char basename[PARSER_MAX_LINE_SIZE];
+  parser_get_opt_param_string(params, "StreamOutput:basename", basename,
+                              "swift_stream");
+  if (strlen(basename) > FILENAME_BUFFER_SIZE - 16)
+    error("StreamOutput:basename is too long.");
+  if (nr_nodes > 1)
+    sprintf(so->name, "/%s_%04d", basename, nodeID);
+  else
+    sprintf(so->name, "/%s", basename);
+
+  parser_get_opt_param_string(params, "StreamOutput:select_output",
+                              so->select_output,
+                              select_output_header_default_name);
+
+  const int num_slots =
+      parser_get_opt_param_int(params, "StreamOutput:num_slots", 4);
+  const double slot_size_MB =
+      parser_get_opt_param_double(params, "StreamOutput:slot_size_MB", 256.);
+  if (num_slots < 1) error("StreamOutput:num_slots must be at least 1.");
+
+  const size_t slot_size =
+      stream_output_align((size_t)(slot_size_MB * 1024. * 1024.));
+  if (slot_size <= stream_output_align(sizeof(struct stream_output_slot)))
+    error("StreamOutput:slot_size_MB is too small.");
+
+  const size_t slots_offset =
+      stream_output_align(sizeof(struct stream_output_header));
+  so->size = slots_offset + num_slots * slot_size;
+
+  /* Create the segment. Pages are only allocated once written to. */
+  shm_unlink(so->name);
+  const int fd = shm_open(so->name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0)
+    error("Failed to create the shared-memory object '%s' (%s).", so->name,
+          strerror(errno));
+  if (ftruncate(fd, so->size) != 0)
+    error("Failed to resize the shared-memory object '%s' (%s).", so->name,
+          strerror(errno));
+
+  void *segment =
+      mmap(NULL, so->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (segment == MAP_FAILED)
+    error("Failed to map the shared-memory object '%s' (%s).", so->name,
+          strerror(errno));
+  close(fd);
+
+  /* Write the header */
+  struct stream_output_header *header = (struct stream_output_header *)segment;
+  memcpy(header->magic, stream_output_magic, sizeof(header->magic));
+  header->version = stream_output_version;
+  header->num_slots = num_slots;
+  header->slot_size = slot_size;
+  header->slots_offset = slots_offset;
+  header->read_index = 0;
+  header->dropped = 0;
+  header->rank = nodeID;
+  header->nr_ranks = nr_nodes;
+  __atomic_store_n(&header->write_index, 0, __ATOMIC_RELEASE);
+  so->header = header;
+
+  if (verbose)
+    message("Streaming outputs to '%s' (%d slots of %.1f MB).", so->name,
+            num_slots, slot_size / (1024. * 1024.));
+
+#else
+  error(
+      "Streaming outputs to shared memory requires HDF5 and shm_open(), "
+      "which are not available.");
+#endif
+}
+
+#ifdef STREAM_OUTPUT_AVAILABLE
+
+/**
+ * @brief Kind of the values of a given type, as in numpy ('i', 'u' or 'f').
+ *
+ * @param type The #IO_DATA_TYPE.
+ */
+static char stream_output_kind(const enum IO_DATA_TYPE type) {
+
+  switch (type) {
+    case FLOAT:
+    case DOUBLE:
+      return 'f';
+    case INT:
+    case LONG:
+    case LONGLONG:
+    case CHAR:
+      return 'i';
+    case UINT8:
+    case UINT:
+    case UINT64:
+    case ULONG:
+    case ULONGLONG:
+    case SIZE_T:
+      return 'u';
+    default:
+      error("Unknown type");
+      return 0;
+  }
+}
+
+/**
+ * @brief Record that an output could not be published.
+ *
+ * @param so The #stream_output.
+ * @param reason Why it was dropped.
+ */
+static void stream_output_drop(struct stream_output *so, const char *reason) {
+
+  so->dropped++;
+  __atomic_store_n(&so->header->dropped, so->dropped, __ATOMIC_RELEASE);
+  message("WARNING: Dropped stream output %lld (%s), %lld dropped so far.",
+          so->published + so->dropped - 1, reason, so->dropped);
+}
+
+#endif /* STREAM_OUTPUT_AVAILABLE */
+
+/**
+ * @brief Publish the particles of this rank in the next slot of the stream.
+ *
+ * The particles must have been drifted to the current time. Returns
+ * immediately if no slot is free.
+ *
+ * @param so The #stream_output.
+ * @param e The #engine.
+ *
+ * @return 1 if the output was published, 0 if it was dropped.
+ */
+int stream_output_publish(struct stream_output *so, const struct engine *e) {
+
+#ifdef STREAM_OUTPUT_AVAILABLE
+
+  const ticks tic = getticks();
+  struct stream_output_header *header = so->header;
+  const struct space *s = e->s;
+  const struct output_options *output_options = e->output_options;
+  const int with_cosmology = e->policy & engine_policy_cosmology;
+  const int with_cooling = e->policy & engine_policy_cooling;
+  const int with_temperature = e->policy & engine_policy_temperature;
+  const int with_fof = e->policy & engine_policy_fof;
+  const int with_rt = e->policy & engine_policy_rt;
+
+  /* Is the consumer keeping up? */
+  const uint64_t write_index = header->write_index;
+  const uint64_t read_index =
+      __atomic_load_n(&header->read_index, __ATOMIC_ACQUIRE);
+  if (write_index - read_index >= header->num_slots) {
+    stream_output_drop(so, "no free slot");
+    return 0;
+  }
+
+  /* Fill the next slot */
+  char *slot_start = (char *)header + header->slots_offset +
+                     (write_index % header->num_slots) * header->slot_size;
+  struct stream_output_slot *slot = (struct stream_output_slot *)slot_start;
+  slot->output_index = write_index;
+  slot->step = e->step;
+  slot->time = e->time;
+  slot->scale_factor = with_cosmology ? e->cosmology->a : 1.;
+
+  /* Number of particles of each type */
+  const size_t Ngas = s->nr_parts;
+  const size_t Ntot = s->nr_gparts;
+  const size_t Nsinks = s->nr_sinks;
+  const size_t Nstars = s->nr_sparts;
+  const size_t Nblackholes = s->nr_bparts;
+  const size_t N_written[swift_type_count] = {
+      Ngas - s->nr_inhibited_parts - s->nr_extra_parts,
+      io_count_dark_matter_to_write(s, /*subsample=*/0, 1.f, /*snap_num=*/0),
+      s->with_DM_background ? io_count_background_dark_matter_to_write(
+                                  s, /*subsample=*/0, 1.f, /*snap_num=*/0)
+                            : 0,
+      Nsinks - s->nr_inhibited_sinks - s->nr_extra_sinks,
+      Nstars - s->nr_inhibited_sparts - s->nr_extra_sparts,
+      Nblackholes - s->nr_inhibited_bparts - s->nr_extra_bparts,
+      s->with_neutrinos ? io_count_neutrinos_to_write(s, /*subsample=*/0, 1.f,
+                                                      /*snap_num=*/0)
+                        : 0};
+  const int to_write[swift_type_count] = {
+      (e->policy & engine_policy_hydro) ? 1 : 0,
+      s->with_DM,
+      s->with_DM_background,
+      (e->policy & engine_policy_sinks) ? 1 : 0,
+      (e->policy & engine_policy_stars) ? 1 : 0,
+      (e->policy & engine_policy_black_holes) ? 1 : 0,
+      s->with_neutrinos};
+
+  size_t offset = stream_output_align(sizeof(struct stream_output_slot));
+  int nr_fields = 0;
+  const char *full = NULL;
+
+  for (int ptype = 0; ptype < swift_type_count && full == NULL; ptype++) {
+
+    slot->count[ptype] = 0;
+    if (!to_write[ptype] || output_options_get_num_fields_to_write(
+                                output_options, so->select_output, ptype) == 0)
+      continue;
+
+    int num_fields = 0;
+    struct io_props list[100];
+    bzero(list, 100 * sizeof(struct io_props));
+    const size_t N = N_written[ptype];
+
+    struct part *parts_written = NULL;
+    struct xpart *xparts_written = NULL;
+    struct gpart *gparts_written = NULL;
+    struct sink *sinks_written = NULL;
+    struct spart *sparts_written = NULL;
+    struct bpart *bparts_written = NULL;
+
+    /* Select the fields, collecting the particles if some are inhibited */
+    switch (ptype) {
+
+      case swift_type_gas:
+        if (N == Ngas) {
+          io_select_hydro_fields(s->parts, s->xparts, with_cosmology,
+                                 with_cooling, with_temperature, with_fof,
+                                 /*with_stf=*/0, with_rt, e, &num_fields, list);
+        } else {
+          if (swift_memalign("parts_written", (void **)&parts_written,
+                             part_align, N * sizeof(struct part)) != 0 ||
+              swift_memalign("xparts_written", (void **)&xparts_written,
+                             xpart_align, N * sizeof(struct xpart)) != 0)
+            error("Error while allocating temporary memory for parts");
+          io_collect_parts_to_write(s->parts, s->xparts, parts_written,
+                                    xparts_written, /*subsample=*/0, 1.f,
+                                    /*snap_num=*/0, Ngas, N);
+          io_select_hydro_fields(parts_written, xparts_written, with_cosmology,
+                                 with_cooling, with_temperature, with_fof,
+                                 /*with_stf=*/0, with_rt, e, &num_fields, list);
+        }
+        break;
+
+      case swift_type_dark_matter:
+      case swift_type_dark_matter_background:
+      case swift_type_neutrino:
+        if (ptype == swift_type_dark_matter && N == Ntot) {
+          io_select_dm_fields(s->gparts, NULL, with_fof, /*with_stf=*/0, e,
+                              &num_fields, list);
+          break;
+        }
+        if (swift_memalign("gparts_written", (void **)&gparts_written,
+                           gpart_align, N * sizeof(struct gpart)) != 0)
+          error("Error while allocating temporary memory for gparts");
+        if (ptype == swift_type_dark_matter)
+          io_collect_gparts_to_write(s->gparts, NULL, gparts_written, NULL,
+                                     /*subsample=*/0, 1.f, /*snap_num=*/0,
+                                     Ntot, N, /*with_stf=*/0);
+        else if (ptype == swift_type_dark_matter_background)
+          io_collect_gparts_background_to_write(
+              s->gparts, NULL, gparts_written, NULL, /*subsample=*/0, 1.f,
+              /*snap_num=*/0, Ntot, N, /*with_stf=*/0);
+        else
+          io_collect_gparts_neutrino_to_write(
+              s->gparts, NULL, gparts_written, NULL, /*subsample=*/0, 1.f,
+              /*snap_num=*/0, Ntot, N, /*with_stf=*/0);
+        if (ptype == swift_type_neutrino)
+          io_select_neutrino_fields(gparts_written, NULL, with_fof,
+                                    /*with_stf=*/0, e, &num_fields, list);
+        else
+          io_select_dm_fields(gparts_written, NULL, with_fof, /*with_stf=*/0,
+                              e, &num_fields, list);
+        break;
+
+      case swift_type_sink:
+        if (N == Nsinks) {
+          io_select_sink_fields(s->sinks, with_cosmology, with_fof,
+                                /*with_stf=*/0, e, &num_fields, list);
+        } else {
+          if (swift_memalign("sinks_written", (void **)&sinks_written,
+                             sink_align, N * sizeof(struct sink)) != 0)
+            error("Error while allocating temporary memory for sinks");
+          io_collect_sinks_to_write(s->sinks, sinks_written, /*subsample=*/0,
+                                    1.f, /*snap_num=*/0, Nsinks, N);
+          io_select_sink_fields(sinks_written, with_cosmology, with_fof,
+                                /*with_stf=*/0, e, &num_fields, list);
+        }
+        break;
+
+      case swift_type_stars:
+        if (N == Nstars) {
+          io_select_star_fields(s->sparts, with_cosmology, with_fof,
+                                /*with_stf=*/0, with_rt, e, &num_fields, list);
+        } else {
+          if (swift_memalign("sparts_written", (void **)&sparts_written,
+                             spart_align, N * sizeof(struct spart)) != 0)
+            error("Error while allocating temporary memory for sparts");
+          io_collect_sparts_to_write(s->sparts, sparts_written,
+                                     /*subsample=*/0, 1.f, /*snap_num=*/0,
+                                     Nstars, N);
+          io_select_star_fields(sparts_written, with_cosmology, with_fof,
+                                /*with_stf=*/0, with_rt, e, &num_fields, list);
+        }
+        break;
+
+      case swift_type_black_hole:
+        if (N == Nblackholes) {
+          io_select_bh_fields(s->bparts, with_cosmology, with_fof,
+                              /*with_stf=*/0, e, &num_fields, list);
+        } else {
+          if (swift_memalign("bparts_written", (void **)&bparts_written,
+                             bpart_align, N * sizeof(struct bpart)) != 0)
+            error("Error while allocating temporary memory for bparts");
+          io_collect_bparts_to_write(s->bparts, bparts_written,
+                                     /*subsample=*/0, 1.f, /*snap_num=*/0,
+                                     Nblackholes, N);
+          io_select_bh_fields(bparts_written, with_cosmology, with_fof,
+                              /*with_stf=*/0, e, &num_fields, list);
+        }
+        break;
+
+      default:
+        error("Particle Type %d not yet supported. Aborting", ptype);
+    }
+
+    slot->count[ptype] = N;
+
+    /* Did the user specify a non-standard default for this type? */
+    const enum lossy_compression_schemes compression_level_current_default =
+        output_options_get_ptype_default_compression(
+            output_options->select_output, so->select_output,
+            (enum part_type)ptype, e->verbose);
+
+    /* Copy everything that is not cancelled straight into the slot */
+    for (int i = 0; i < num_fields; ++i) {
+
+      const enum lossy_compression_schemes compression_level =
+          output_options_get_field_compression(
+              output_options, so->select_output, list[i].name,
+              (enum part_type)ptype, compression_level_current_default,
+              e->verbose);
+      if (compression_level == compression_do_not_write) continue;
+
+      const size_t type_size = io_sizeof_type(list[i].type);
+      const size_t size = N * type_size * list[i].dimension;
+      if (nr_fields == stream_output_max_fields) {
+        full = "too many fields";
+        break;
+      }
+      if (offset + size > header->slot_size) {
+        full = "slot too small";
+        break;
+      }
+
+      io_copy_temp_buffer(slot_start + offset, e, list[i], N,
+                          e->internal_units, e->snapshot_units);
+
+      struct stream_output_field *field = &slot->fields[nr_fields];
+      bzero(field, sizeof(struct stream_output_field));
+      strcpy(field->name, list[i].name);
+      field->part_type = ptype;
+      field->kind = stream_output_kind(list[i].type);
+      field->type_size = type_size;
+      field->dimension = list[i].dimension;
+      field->count = N;
+      field->offset = offset;
+      field->cgs_factor =
+          units_cgs_conversion_factor(e->snapshot_units, list[i].units);
+      field->a_exponent = list[i].scale_factor_exponent;
+
+      offset = stream_output_align(offset + size);
+      nr_fields++;
+    }
+
+    /* Free temporary arrays */
+    if (parts_written) swift_free("parts_written", parts_written);
+    if (xparts_written) swift_free("xparts_written", xparts_written);
+    if (gparts_written) swift_free("gparts_written", gparts_written);
+    if (sinks_written) swift_free("sinks_written", sinks_written);
+    if (sparts_written) swift_free("sparts_written", sparts_written);
+    if (bparts_written) swift_free("bparts_written", bparts_written);
+  }
+
+  if (full != NULL) {
+    stream_output_drop(so, full);
+    return 0;
+  }
+
+  /* Hand the slot over to the consumer */
+  slot->size = offset;
+  slot->nr_fields = nr_fields;
+  __atomic_store_n(&header->write_index, write_index + 1, __ATOMIC_RELEASE);
+  so->published++;
+
+  if (e->verbose)
+    message("Published stream output %lld (%.1f MB) took %.3f %s.",
+            so->published + so->dropped - 1, offset / (1024. * 1024.),
+            clocks_from_ticks(getticks() - tic), clocks_getunit());
+
+  return 1;
+
+#else
+  error("Streaming outputs to shared memory is not available.");
+  return 0;
+#endif
+}
+
+/**
+ * @brief Unmap and remove the shared-memory segment.
+ *
+ * Consumers still attached keep their mapping until they detach.
+ *
+ * @param so The #stream_output.
+ */
+void stream_output_clean(struct stream_output *so) {
+
+  if (!so->enabled || so->header == NULL) return;
+
+#ifdef STREAM_OUTPUT_AVAILABLE
+  munmap(so->header, so->size);
+  shm_unlink(so->name);
+#endif
+  so->header = NULL;
+  so->size = 0;
+}
@@ -0,0 +1,177 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2024 The SWIFT team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+#ifndef SWIFT_STREAM_OUTPUT_H
+#define SWIFT_STREAM_OUTPUT_H
+
+/* Config parameters. */
+#include <config.h>
+
+/* Standard headers. */
+#include <stddef.h>
+#include <stdint.h>
+
+/* Local headers. */
+#include "common_io.h"
+#include "part_type.h"
+
+/* Pre-declarations */
+struct engine;
+struct swift_params;
+
+/*! Magic string at the start of the shared-memory segment. */
+#define stream_output_magic "SWIFTSHM"
+
+/*! Version of the layout described below. */
+#define stream_output_version 1
+
+/*! Maximal number of fields in one output. */
+#define stream_output_max_fields 256
+
+/*! Alignment of the slots and of the arrays in the segment. */
+#define stream_output_alignment 4096
+
+/**
+ * @brief Header at the start of the shared-memory segment.
+ *
+ * The segment holds num_slots slots of slot_size bytes each, the first one
+ * starting at slots_offset. Output number n is written to the slot n modulo
+ * num_slots and published by setting write_index to n + 1. The consumer
+ * signals that it is done with output n by setting read_index to n + 1, after
+ * which the slot can be re-used. An output for which no slot is free is
+ * dropped (and counted) rather than waited for. Both indices are updated with
+ * release semantics and must be read with acquire semantics.
+ */
+struct stream_output_header {
+
+  /*! The string stream_output_magic (not NULL-terminated). */
+  char magic[8];
+
+  /*! Version of the layout. */
+  uint32_t version;
+
+  /*! Number of slots. */
+  uint32_t num_slots;
+
+  /*! Size of a slot and offset of the first slot in bytes. */
+  uint64_t slot_size;
+  uint64_t slots_offset;
+
+  /*! Number of outputs published (written by SWIFT only). */
+  uint64_t write_index;
+
+  /*! Number of outputs released (written by the consumer only). */
+  uint64_t read_index;
+
+  /*! Number of outputs dropped as no slot was free or large enough. */
+  uint64_t dropped;
+
+  /*! Rank writing to this segment and total number of ranks. */
+  int32_t rank;
+  int32_t nr_ranks;
+};
+
+/**
+ * @brief Description of one array of an output.
+ */
+struct stream_output_field {
+
+  /*! Name of the field, as in the snapshots. */
+  char name[FIELD_BUFFER_SIZE];
+
+  /*! Particle type. */
+  int32_t part_type;
+
+  /*! Kind ('i', 'u' or 'f') and size in bytes of one component. */
+  char kind;
+  char padding[3];
+  int32_t type_size;
+
+  /*! Number of components per particle. */
+  int32_t dimension;
+
+  /*! Number of particles. */
+  uint64_t count;
+
+  /*! Offset of the array from the start of the slot in bytes. */
+  uint64_t offset;
+
+  /*! Conversion factor to CGS and scale-factor exponent to apply to get
+   * physical values (values are written in the snapshot units). */
+  double cgs_factor;
+  double a_exponent;
+};
+
+/**
+ * @brief Header at the start of each slot, followed by nr_fields
+ * #stream_output_field and then by the arrays.
+ */
+struct stream_output_slot {
+
+  /*! Number of this output. */
+  uint64_t output_index;
+
+  /*! Step, time and scale-factor of the output. */
+  int64_t step;
+  double time;
+  double scale_factor;
+
+  /*! Number of bytes used in the slot. */
+  uint64_t size;
+
+  /*! Number of particles of each type. */
+  uint64_t count[swift_type_count];
+
+  /*! Number of arrays. */
+  int32_t nr_fields;
+  int32_t padding;
+
+  /*! The arrays. */
+  struct stream_output_field fields[stream_output_max_fields];
+};
+
+/**
+ * @brief State of the stream of outputs to shared memory.
+ */
+struct stream_output {
+
+  /*! Are we streaming outputs? */
+  int enabled;
+
+  /*! Name of the shared-memory object. */
+  char name[FILENAME_BUFFER_SIZE];
+
+  /*! Output selection (section of the SelectOutput file) to stream. */
+  char select_output[FIELD_BUFFER_SIZE];
+
+  /*! The mapped segment and its size in bytes. */
+  struct stream_output_header *header;
+  size_t size;
+
+  /*! Number of outputs published and dropped by this rank. */
+  long long published;
+  long long dropped;
+};
+
+void stream_output_init(struct stream_output *so, struct swift_params *params,
+                        const int nodeID, const int nr_nodes,
+                        const int verbose);
+int stream_output_publish(struct stream_output *so, const struct engine *e);
+void stream_output_clean(struct stream_output *so);
+
+#endif /* SWIFT_STREAM_OUTPUT_H */
@@ -176,6 +176,10 @@ const char *task_category_names[task_category_count] = {
 #ifdef WITH_MPI
 /* MPI communicators for the subtypes. */
 MPI_Comm subtaskMPI_comms[task_subtype_count];
+
+/* MPI communicators for the node-shared ready signals of the subtypes. */
+MPI_Comm subtaskMPI_node_comms[task_subtype_count];
+static int task_with_node_comms = 0;
 #endif
 
 /**
@@ -1299,11 +1303,20 @@ void task_create_name_files(const char *file_prefix) {
 #ifdef WITH_MPI
 /**
  * @brief Create global communicators for each of the subtasks.
+ *
+ * @param with_node_shared Also create the communicators used to exchange
+ * the ready signals of the node-shared communications.
  */
-void task_create_mpi_comms(void) {
+void task_create_mpi_comms(const int with_node_shared) {
   for (int i = 0; i < task_subtype_count; i++) {
     MPI_Comm_dup(MPI_COMM_WORLD, &subtaskMPI_comms[i]);
   }
+  if (with_node_shared) {
+    for (int i = 0; i < task_subtype_count; i++) {
+      MPI_Comm_dup(MPI_COMM_WORLD, &subtaskMPI_node_comms[i]);
+    }
+  }
+  task_with_node_comms = with_node_shared;
 }
 /**
  * @brief Create global communicators for each of the subtasks.
@@ -1312,6 +1325,12 @@ void task_free_mpi_comms(void) {
   for (int i = 0; i < task_subtype_count; i++) {
     MPI_Comm_free(&subtaskMPI_comms[i]);
   }
+  if (task_with_node_comms) {
+    for (int i = 0; i < task_subtype_count; i++) {
+      MPI_Comm_free(&subtaskMPI_node_comms[i]);
+    }
+  }
+  task_with_node_comms = 0;
 }
 #endif
 
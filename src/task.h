@@ -223,6 +223,12 @@ extern const char *task_category_names[];
  */
 #ifdef WITH_MPI
 extern MPI_Comm subtaskMPI_comms[task_subtype_count];
+
+/**
+ *  @brief The MPI communicators used by node-mates to signal that they are
+ *  ready to receive data through the node-shared foreign buffers.
+ */
+extern MPI_Comm subtaskMPI_node_comms[task_subtype_count];
 #endif
 
 /**
@@ -247,6 +253,10 @@ struct task {
   /*! MPI request corresponding to this task */
   MPI_Request req;
 
+  /*! Offset of the receiving cell's particles in the node-mate's shared
+   * foreign buffer (send tasks only, -1 if not applicable) */
+  long long node_offset;
+
 #endif
 
   /*! Rank of a task in the order */
@@ -310,7 +320,7 @@ void task_get_group_name(int type, int subtype, char *cluster);
 enum task_categories task_get_category(const struct task *t);
 
 #ifdef WITH_MPI
-void task_create_mpi_comms(void);
+void task_create_mpi_comms(const int with_node_shared);
 void task_free_mpi_comms(void);
 #endif
 #endif /* SWIFT_TASK_H */
@@ -105,6 +105,7 @@ const char* timers_names[timer_count] = {
     "dopair_subset",
     "dopair_subset_naive",
     "dosub_subset",
+    "dosubset_ngb_lists",
     "do_ghost",
     "do_extra_ghost",
     "do_stars_ghost",
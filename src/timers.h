@@ -105,6 +105,7 @@ enum {
   timer_dopair_subset,
   timer_dopair_subset_naive,
   timer_dosub_subset,
+  timer_dosubset_ngb_lists,
   timer_do_ghost,
   timer_do_extra_ghost,
   timer_do_stars_ghost,
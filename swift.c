@@ -973,8 +973,10 @@ int main(int argc, char *argv[]) {
     restart_locate_free(1, restart_files);
 #endif
 
-    /* Now read it. */
-    restart_read(&e, restart_file);
+    /* Now read it, possibly mapping the particles rather than reading them. */
+    const int restart_memory_map =
+        parser_get_opt_param_int(params, "Restarts:memory_map", 0);
+    restart_read(&e, restart_file, restart_memory_map);
 
 #ifdef WITH_MPI
     integertime_t min_ti_current = e.ti_current;
@@ -1240,7 +1242,8 @@ int main(int argc, char *argv[]) {
                      with_gravity, with_sinks, with_stars, with_black_holes,
                      with_cosmology, cleanup_h, cleanup_sqrt_a, cosmo.h,
                      cosmo.a, myrank, nr_nodes, MPI_COMM_WORLD, MPI_INFO_NULL,
-                     nr_threads, dry_run, remap_ids, &ics_metadata);
+                     nr_threads, dry_run, remap_ids, &ics_metadata,
+                     &initial_partition);
 #else
     read_ic_serial(ICfileName, &us, dim, &parts, &gparts, &sinks, &sparts,
                    &bparts, &Ngas, &Ngpart, &Ngpart_background, &Nnupart,
@@ -1248,7 +1251,7 @@ int main(int argc, char *argv[]) {
                    with_gravity, with_sinks, with_stars, with_black_holes,
                    with_cosmology, cleanup_h, cleanup_sqrt_a, cosmo.h, cosmo.a,
                    myrank, nr_nodes, MPI_COMM_WORLD, MPI_INFO_NULL, nr_threads,
-                   dry_run, remap_ids, &ics_metadata);
+                   dry_run, remap_ids, &ics_metadata, &initial_partition);
 #endif
 #else
     read_ic_single(ICfileName, &us, dim, &parts, &gparts, &sinks, &sparts,
@@ -1892,6 +1895,9 @@ int main(int argc, char *argv[]) {
 #endif
   }
 
+  /* Wait for the last snapshot to be on disk. */
+  engine_snapshot_async_complete(&e);
+
   /* Remove the stop file if used. Do this anyway, we could have missed the
    * stop file if normal exit happened first. */
   if (myrank == 0) force_stop = restart_stop_now(restart_dir, 1);
@@ -367,6 +367,145 @@ void runner_doself_subset_branch_density(struct runner *r,
                                          struct cell *restrict ci,
                                          struct part *restrict parts,
                                          int *restrict ind, int count);
+void runner_dosubset_ngb_lists_density(struct runner *r,
+                                       struct part *restrict parts,
+                                       const int *restrict ind,
+                                       const size_t *restrict first,
+                                       const int *restrict num, int count);
+
+#if defined(TEST_DOSELF_SUBSET) && defined(TEST_DOPAIR_SUBSET)
+
+/**
+ * @brief Run the subset density loops of the main cell with all the cells.
+ */
+void subset_density(struct runner *r, struct cell **cells,
+                    struct cell *main_cell, int *pid, int count) {
+  for (int j = 0; j < 27; ++j)
+    if (cells[j] != main_cell)
+      DOPAIR1_SUBSET(r, main_cell, main_cell->hydro.parts, pid, count,
+                     cells[j]);
+  DOSELF1_SUBSET(r, main_cell, main_cell->hydro.parts, pid, count);
+}
+
+/**
+ * @brief Check that the densities obtained from neighbour lists, as done in
+ * the ghost with SPH:use_ghost_neighbour_lists, are the ones of the subset
+ * loops.
+ *
+ * The lists are recorded for a smoothing length ghost_ngb_lists_h_factor
+ * times larger than the true one and replayed at the true one. The
+ * smoothing lengths then grow, one of them beyond its list, which must be
+ * rebuilt. The densities and neighbour numbers must agree to a relative
+ * 1e-5 (they are identical unless the subset loops are vectorised).
+ */
+void check_ngb_lists(struct runner *r, struct cell **cells,
+                     struct cell *main_cell, const struct cosmology *cosmo) {
+
+  struct part *parts = main_cell->hydro.parts;
+  const int count = main_cell->hydro.count;
+  struct part *ref = (struct part *)malloc(count * sizeof(struct part));
+  int *pid = (int *)malloc(count * sizeof(int));
+  int *cid = (int *)malloc(count * sizeof(int));
+  int *cpid = (int *)malloc(count * sizeof(int));
+  int *num = (int *)malloc(count * sizeof(int));
+  size_t *first = (size_t *)malloc(count * sizeof(size_t));
+  float *h_list = (float *)malloc(count * sizeof(float));
+  float *h_save = (float *)malloc(count * sizeof(float));
+  float *h_orig = (float *)malloc(count * sizeof(float));
+  if (ref == NULL || pid == NULL || cid == NULL || cpid == NULL ||
+      num == NULL || first == NULL || h_list == NULL || h_save == NULL ||
+      h_orig == NULL)
+    error("Can't allocate memory for the neighbour lists check.");
+
+  for (int k = 0; k < count; k++) {
+    pid[k] = k;
+    h_list[k] = -1.f;
+    h_orig[k] = parts[k].h;
+  }
+  ghost_ngb_lists_reset(&r->ghost_ngbs);
+
+  for (int round = 0; round < 2; round++) {
+
+    /* Grow two smoothing lengths: one within its list, one beyond it */
+    if (round == 1) {
+      parts[0].h *= 1.1f;
+      parts[1].h *= 1.5f;
+    }
+
+    /* The reference: the subset loops at the true smoothing lengths */
+    zero_particle_fields(main_cell);
+    subset_density(r, cells, main_cell, pid, count);
+    end_calculation(main_cell, cosmo);
+    memcpy(ref, parts, count * sizeof(struct part));
+
+    /* The stale list of the particle that outgrew it misses neighbours */
+    if (round == 1) {
+      zero_particle_fields(main_cell);
+      runner_dosubset_ngb_lists_density(r, parts, &pid[1], &first[1], &num[1],
+                                        1);
+      end_calculation(main_cell, cosmo);
+      if (!(parts[1].density.wcount < 0.99f * ref[1].density.wcount))
+        error("Stale neighbour list gave %e neighbours instead of %e.",
+              parts[1].density.wcount, ref[1].density.wcount);
+    }
+
+    /* Record new lists for the particles that have none or outgrew theirs,
+     * as runner_do_ghost_density_ngb_lists() does */
+    int count_collect = 0;
+    for (int k = 0; k < count; k++) {
+      if (parts[k].h > h_list[k]) {
+        cid[count_collect] = k;
+        cpid[count_collect] = k;
+        h_save[count_collect] = parts[k].h;
+        h_list[k] = ghost_ngb_lists_h_factor * parts[k].h;
+        parts[k].h = h_list[k];
+        ++count_collect;
+      }
+    }
+    if (round == 0 && count_collect != count)
+      error("Only %d particles of %d got a list.", count_collect, count);
+    if (round == 1 && (count_collect != 1 || cpid[0] != 1))
+      error("%d lists rebuilt instead of the outgrown one.", count_collect);
+
+    ghost_ngb_lists_start(&r->ghost_ngbs);
+    subset_density(r, cells, main_cell, cpid, count_collect);
+    ghost_ngb_lists_end(&r->ghost_ngbs, cid, count_collect, first, num);
+    for (int j = 0; j < count_collect; j++) parts[cpid[j]].h = h_save[j];
+
+    /* Replay all the lists at the true smoothing lengths */
+    zero_particle_fields(main_cell);
+    runner_dosubset_ngb_lists_density(r, parts, pid, first, num, count);
+    end_calculation(main_cell, cosmo);
+
+    for (int k = 0; k < count; k++) {
+      const float rho = hydro_get_comoving_density(&parts[k]);
+      const float rho_ref = hydro_get_comoving_density(&ref[k]);
+      const float wcount = parts[k].density.wcount;
+      const float wcount_ref = ref[k].density.wcount;
+      if (fabsf(rho - rho_ref) > 1e-5f * fabsf(rho_ref) ||
+          fabsf(wcount - wcount_ref) > 1e-5f * fabsf(wcount_ref))
+        error(
+            "Particle %lld: rho=%e wcount=%e from its list, rho=%e wcount=%e "
+            "from the subset loops (round %d).",
+            parts[k].id, rho, wcount, rho_ref, wcount_ref, round);
+    }
+  }
+  message("Neighbour lists of the ghost agree with the subset loops.");
+
+  for (int k = 0; k < count; k++) parts[k].h = h_orig[k];
+  ghost_ngb_lists_clean(&r->ghost_ngbs);
+  free(ref);
+  free(pid);
+  free(cid);
+  free(cpid);
+  free(num);
+  free(first);
+  free(h_list);
+  free(h_save);
+  free(h_orig);
+}
+
+#endif
 
 /* And go... */
 int main(int argc, char *argv[]) {
@@ -496,6 +635,7 @@ int main(int argc, char *argv[]) {
   engine.cosmology = &cosmo;
 
   struct runner runner;
+  bzero(&runner, sizeof(struct runner));
   runner.e = &engine;
 
   struct lightcone_array_props lightcone_array_properties;
@@ -622,6 +762,11 @@ int main(int argc, char *argv[]) {
   message("SWIFT calculation took:       %.3f %s.",
           clocks_from_ticks(time / runs), clocks_getunit());
 
+#if defined(TEST_DOSELF_SUBSET) && defined(TEST_DOPAIR_SUBSET)
+  /* Check the neighbour lists of the ghost against the subset loops */
+  check_ngb_lists(&runner, cells, main_cell, &cosmo);
+#endif
+
   /* Now perform a brute-force version for accuracy tests */
 
   /* Zero the fields */
@@ -258,8 +258,55 @@ void test_log_timestamps(struct csds_writer *log) {
   }
 }
 
+void test_field_cadences(void) {
+
+  /* Three fields written every 1, 3 and 4 records. */
+  const int n_fields = 3;
+  const int cadences[3] = {1, 3, 4};
+  struct csds_field fields[3];
+  bzero(fields, sizeof(fields));
+  for (int i = 0; i < n_fields; i++) {
+    fields[i].mask = 1u << i;
+    fields[i].size = 4 * (i + 1);
+    fields[i].cadence = cadences[i];
+  }
+
+  /* Log a particle 16 times, with all the fields in the 7th record. */
+  const int n_records = 16;
+  const int full_record = 6;
+  const unsigned int expected_masks[16] = {7, 1, 1, 3, 5, 1, 7, 7,
+                                           1, 1, 3, 5, 1, 3, 1, 5};
+
+  struct csds_part_data data;
+  csds_part_data_init(&data);
+
+  for (int r = 0; r < n_records; r++) {
+    const int log_all_fields = (r == full_record);
+
+    size_t size = 0;
+    unsigned int mask = 0;
+    csds_compute_size_and_mask(fields, n_fields, log_all_fields,
+                               data.records_since_full_output, &size, &mask);
+    csds_record_written(&data, log_all_fields);
+
+    size_t expected_size = 0;
+    for (int i = 0; i < n_fields; i++)
+      if (expected_masks[r] & fields[i].mask) expected_size += fields[i].size;
+
+    printf("Record %2d has mask %#04x and size %zu.\n", r, mask, size);
+    if (mask != expected_masks[r] || size != expected_size) {
+      printf("FAIL: wrong fields in record %d (expected mask %#04x).\n", r,
+             expected_masks[r]);
+      abort();
+    }
+  }
+}
+
 int main(int argc, char *argv[]) {
 
+  /* Test the fields written in successive records. */
+  test_field_cadences();
+
   /* Prepare a csds. */
   struct csds_writer log;
   struct swift_params params;
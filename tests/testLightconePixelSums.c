@@ -0,0 +1,335 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2024 The SWIFT team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/* Config parameters. */
+#include <config.h>
+
+/* System includes. */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* HEALPix C API */
+#ifdef HAVE_CHEALPIX
+#include <chealpix.h>
+#endif
+
+/* Local headers. */
+#include "swift.h"
+
+/* Resolution of the maps. */
+#define NSIDE 32
+#define NPIX (12 * NSIDE * NSIDE)
+
+/* Number of maps in the shell. */
+#define NUM_MAPS 3
+
+/* Number of updates per round. */
+#define NUM_UPDATES 20000
+
+/*! What to expect from the table of per-pixel sums in a test. */
+enum expect {
+  expect_all_summed = 0,
+  expect_table_full,
+  expect_chain_full,
+  expect_all_buffered,
+};
+
+/*! A map update of a particle which only affects a single pixel. */
+struct pixel_update {
+  pixel_index_t pixel;
+  int type;
+  double value[NUM_MAPS];
+};
+
+/*! Data for the accumulation mapper. */
+struct accumulate_data {
+  struct lightcone_shell *shell;
+  const struct lightcone_particle_type *part_type;
+  size_t nr_buffered;
+};
+
+/**
+ * @brief Sum updates in the table of a shell, or buffer them if they do not
+ * fit, as done by lightcone_buffer_map_update().
+ */
+void accumulate_mapper(void *map_data, int num_elements, void *extra_data) {
+
+  const struct pixel_update *update = (const struct pixel_update *)map_data;
+  struct accumulate_data *data = (struct accumulate_data *)extra_data;
+  struct lightcone_shell *shell = data->shell;
+
+  for (int k = 0; k < num_elements; k++) {
+    const struct pixel_update *u = &update[k];
+    const struct lightcone_particle_type *pt = &data->part_type[u->type];
+    if (lightcone_shell_accumulate_pixel(shell, u->pixel, pt, u->value))
+      continue;
+
+#ifdef HAVE_CHEALPIX
+    /* Buffer the update of a particle at the centre of the pixel */
+    union lightcone_map_buffer_entry entry[3 + NUM_MAPS];
+    double theta, phi;
+    pix2ang_ring64(NSIDE, u->pixel, &theta, &phi);
+    entry[0].i = angle_to_int(theta);
+    entry[1].i = angle_to_int(phi);
+    entry[2].f = 0.f;
+    for (int i = 0; i < pt->nr_maps; i++) entry[3 + i].f = u->value[i];
+    particle_buffer_append(&shell->buffer[u->type], entry);
+#else
+    /* Without HEALPix the buffered updates cannot be applied: add the values
+     * as healpix_smoothing_mapper() does for a single pixel */
+    for (int i = 0; i < pt->nr_maps; i++)
+      atomic_add_d(&shell->map[pt->map_index[i]].data[u->pixel], u->value[i]);
+#endif
+    atomic_inc(&data->nr_buffered);
+  }
+}
+
+/**
+ * @brief Set up a current shell covering the whole sky on a single rank.
+ */
+void init_shell(struct lightcone_shell *shell,
+                const struct lightcone_particle_type *part_type,
+                const size_t max_pixels) {
+
+  bzero(shell, sizeof(struct lightcone_shell));
+  shell->state = shell_current;
+  shell->nr_maps = NUM_MAPS;
+  shell->nside = NSIDE;
+  shell->total_nr_pix = NPIX;
+  shell->local_nr_pix = NPIX;
+  shell->local_pix_offset = 0;
+  shell->pix_per_rank = NPIX;
+
+  struct lightcone_map_type map_type;
+  bzero(&map_type, sizeof(struct lightcone_map_type));
+  map_type.buffer_scale_factor = 1.;
+  shell->map =
+      (struct lightcone_map *)malloc(NUM_MAPS * sizeof(struct lightcone_map));
+  if (shell->map == NULL) error("Unable to allocate the maps.");
+  for (int i = 0; i < NUM_MAPS; i++) {
+    lightcone_map_init(&shell->map[i], NSIDE, NPIX, NPIX, NPIX, 0, 0., 1.,
+                       map_type);
+    lightcone_map_allocate_pixels(&shell->map[i], /*zero_pixels=*/1);
+  }
+
+  for (int ptype = 0; ptype < swift_type_count; ptype++)
+    particle_buffer_init(&shell->buffer[ptype],
+                         part_type[ptype].buffer_element_size, 1000,
+                         "test_map_updates");
+
+  lightcone_shell_init_pixel_sums(shell, max_pixels);
+  lightcone_shell_allocate_pixel_sums(shell);
+}
+
+/**
+ * @brief Free a shell set up by init_shell().
+ */
+void clean_shell(struct lightcone_shell *shell) {
+
+  lightcone_shell_free_pixel_sums(shell);
+  for (int ptype = 0; ptype < swift_type_count; ptype++)
+    particle_buffer_free(&shell->buffer[ptype]);
+  for (int i = 0; i < NUM_MAPS; i++) lightcone_map_free_pixels(&shell->map[i]);
+  free(shell->map);
+}
+
+/**
+ * @brief Apply random updates of some pixels to a shell and check that the
+ * maps are the sums of the updates.
+ *
+ * The updates are summed per pixel as far as the table allows and buffered
+ * otherwise, then flushed. This is done twice to check that the flush
+ * leaves an empty table which can be used again.
+ *
+ * @param tp The #threadpool.
+ * @param part_type The #lightcone_particle_type of each particle type.
+ * @param max_pixels The maximum number of pixels to sum (0 to buffer all the
+ * updates as before the table was introduced).
+ * @param pixels The pixels to update.
+ * @param nr_pixels The number of pixels.
+ * @param expect What the table should do with the updates.
+ */
+void test_updates(struct threadpool *tp,
+                  const struct lightcone_particle_type *part_type,
+                  const size_t max_pixels, const pixel_index_t *pixels,
+                  const int nr_pixels, const enum expect expect) {
+
+  struct lightcone_shell shell;
+  init_shell(&shell, part_type, max_pixels);
+
+  /* The part types to flush: those with buffered updates */
+  struct lightcone_particle_type flush_part_type[swift_type_count];
+  memcpy(flush_part_type, part_type, sizeof(flush_part_type));
+#ifndef HAVE_CHEALPIX
+  for (int ptype = 0; ptype < swift_type_count; ptype++)
+    flush_part_type[ptype].nr_maps = 0;
+#endif
+
+  struct pixel_update *updates =
+      (struct pixel_update *)malloc(NUM_UPDATES * sizeof(struct pixel_update));
+  double *sum = (double *)calloc(NUM_MAPS * NPIX, sizeof(double));
+  double *abs_sum = (double *)calloc(NUM_MAPS * NPIX, sizeof(double));
+  if (updates == NULL || sum == NULL || abs_sum == NULL)
+    error("Unable to allocate the updates.");
+
+  for (int round = 0; round < 2; round++) {
+
+    /* Random updates of the pixels by both particle types, and their sums */
+    for (int k = 0; k < NUM_UPDATES; k++) {
+      struct pixel_update *u = &updates[k];
+      u->pixel = pixels[rand() % nr_pixels];
+      u->type = (rand() % 2) ? swift_type_gas : swift_type_dark_matter;
+      const struct lightcone_particle_type *pt = &part_type[u->type];
+      for (int i = 0; i < pt->nr_maps; i++) {
+        u->value[i] = (float)random_uniform(-1., 1.);
+        const int map_nr = pt->map_index[i];
+        sum[map_nr * NPIX + u->pixel] += u->value[i];
+        abs_sum[map_nr * NPIX + u->pixel] += fabs(u->value[i]);
+      }
+    }
+
+    struct accumulate_data data = {&shell, part_type, 0};
+    threadpool_map(tp, accumulate_mapper, updates, NUM_UPDATES,
+                   sizeof(struct pixel_update), threadpool_auto_chunk_size,
+                   &data);
+
+    /* Did the table take the expected updates? */
+    const struct lightcone_pixel_sums *sums = &shell.sums;
+    switch (expect) {
+      case expect_all_summed:
+        if (data.nr_buffered != 0)
+          error("%zu updates were buffered with %d pixels.", data.nr_buffered,
+                nr_pixels);
+        break;
+      case expect_table_full:
+        /* Threads claiming the last slots at the same time may overshoot */
+        if (data.nr_buffered == 0 || sums->count < sums->max_count ||
+            sums->count >= sums->max_count + tp->num_threads)
+          error("Table filled to %zu of %zu pixels (%zu updates buffered).",
+                sums->count, sums->max_count, data.nr_buffered);
+        break;
+      case expect_chain_full:
+        if (data.nr_buffered == 0 || sums->count >= sums->max_count)
+          error("Long collision chain not buffered (%zu/%zu pixels).",
+                sums->count, sums->max_count);
+        break;
+      case expect_all_buffered:
+        if (data.nr_buffered != NUM_UPDATES || sums->pixel != NULL)
+          error("Updates were summed without a table.");
+        break;
+    }
+
+    lightcone_shell_flush_map_updates(&shell, tp, flush_part_type,
+                                      /*max_map_update_send_size_mb=*/1000.,
+                                      /*kernel_table=*/NULL, /*verbose=*/0);
+
+    /* The flush must leave an empty table */
+    if (sums->count != 0) error("Table not empty after a flush.");
+    for (size_t slot = 0; sums->pixel != NULL && slot < sums->size; slot++) {
+      if (sums->pixel[slot] != -1) error("Slot %zu still in use.", slot);
+      for (int i = 0; i < NUM_MAPS; i++)
+        if (sums->value[slot * NUM_MAPS + i] != 0.)
+          error("Value of slot %zu not reset.", slot);
+    }
+    for (int ptype = 0; ptype < swift_type_count; ptype++)
+      if (particle_buffer_num_elements(&shell.buffer[ptype]) != 0)
+        error("Buffer of type %d not empty after a flush.", ptype);
+
+    /* The maps must be the sums of all the updates so far */
+    for (int i = 0; i < NUM_MAPS; i++) {
+      for (int pix = 0; pix < NPIX; pix++) {
+        const double expected = sum[i * NPIX + pix];
+        const double tolerance = 1e-10 * abs_sum[i * NPIX + pix];
+        if (fabs(shell.map[i].data[pix] - expected) > tolerance)
+          error("Pixel %d of map %d is %.17e instead of %.17e (round %d).",
+                pix, i, shell.map[i].data[pix], expected, round);
+      }
+    }
+  }
+
+  free(updates);
+  free(sum);
+  free(abs_sum);
+  clean_shell(&shell);
+}
+
+int main(int argc, char *argv[]) {
+
+  /* Initialize CPU frequency, this also starts time. */
+  unsigned long long cpufreq = 0;
+  clocks_set_cpufreq(cpufreq);
+
+  /* Get some randomness going */
+  const int seed = time(NULL);
+  message("Seed = %d", seed);
+  srand(seed);
+
+  struct threadpool tp;
+  threadpool_init(&tp, 4);
+
+  /* Gas contributes to the first two maps and dark matter to the last one,
+   * which exercises the mapping from the values to the maps */
+  int gas_maps[2] = {0, 1};
+  int dm_maps[1] = {2};
+  struct lightcone_particle_type part_type[swift_type_count];
+  bzero(part_type, sizeof(part_type));
+  part_type[swift_type_gas].nr_maps = 2;
+  part_type[swift_type_gas].map_index = gas_maps;
+  part_type[swift_type_dark_matter].nr_maps = 1;
+  part_type[swift_type_dark_matter].map_index = dm_maps;
+  for (int ptype = 0; ptype < swift_type_count; ptype++) {
+    part_type[ptype].nr_unsmoothed_maps = part_type[ptype].nr_maps;
+    part_type[ptype].buffer_element_size =
+        (3 + part_type[ptype].nr_maps) *
+        sizeof(union lightcone_map_buffer_entry);
+  }
+
+  pixel_index_t *pixels =
+      (pixel_index_t *)malloc(NPIX * sizeof(pixel_index_t));
+  if (pixels == NULL) error("Unable to allocate the pixels.");
+
+  /* Few pixels, many updates each: everything is summed */
+  message("Testing a few pixels...");
+  for (int k = 0; k < 50; k++) pixels[k] = rand() % NPIX;
+  test_updates(&tp, part_type, 64, pixels, 50, expect_all_summed);
+
+  /* The same updates without a table: the old buffered path */
+  message("Testing the buffered updates...");
+  test_updates(&tp, part_type, 0, pixels, 50, expect_all_buffered);
+
+  /* All the pixels: the table fills up and the rest is buffered */
+  message("Testing a full table...");
+  for (int k = 0; k < NPIX; k++) pixels[k] = k;
+  test_updates(&tp, part_type, 64, pixels, NPIX, expect_table_full);
+
+  /* Pixels which all hash to the same slot of a table of 128 slots */
+  message("Testing collisions...");
+  const pixel_index_t first = rand() % 128;
+  for (int k = 0; k < 40; k++) pixels[k] = first + 128 * k;
+  test_updates(&tp, part_type, 64, pixels, 20, expect_all_summed);
+  test_updates(&tp, part_type, 64, pixels, 40, expect_chain_full);
+
+  free(pixels);
+  threadpool_clean(&tp);
+
+  message("All good.");
+  return 0;
+}
@@ -0,0 +1,202 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2024 The SWIFT team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/* Config parameters. */
+#include <config.h>
+
+/* System includes. */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Local headers. */
+#include "swift.h"
+
+/* Number of top-level cells per dimension in the unit box. */
+#define CDIM 4
+
+/* Number of levels below the top-level cell of the drifted leaf. */
+#define DEPTH 3
+
+/* Number of drifts to simulate. */
+#define NUM_DRIFTS 500
+
+/* Number of particles per drift. */
+#define NUM_PARTS 200
+
+/* Largest number of crossings of a particle. */
+#define MAX_CROSSINGS 64
+
+/**
+ * @brief Find the replications in which a particle crosses the lightcone, as
+ * lightcone_check_particle_crosses() does.
+ *
+ * @param list The replications to check.
+ * @param x The position of the particle relative to the observer at the
+ * start of the drift.
+ * @param dx The displacement of the particle during the drift.
+ * @param dist_2_start Comoving distance squared to the lightcone at the
+ * start of the drift.
+ * @param dist_2_end Comoving distance squared to the lightcone at the end of
+ * the drift.
+ * @param crossed (return) The index in list of the replications crossed.
+ * @return The number of replications crossed.
+ */
+int find_crossings(const struct replication_list *list, const double x[3],
+                   const double dx[3], const double dist_2_start,
+                   const double dist_2_end, int *crossed) {
+
+  const double boundary = dist_2_start - dist_2_end;
+  int count = 0;
+  for (int i = 0; i < list->nrep; i++) {
+    const struct replication *rep = list->replication + i;
+    if (rep->rmin2 > dist_2_start) break;
+    if (rep->rmax2 + boundary < dist_2_end) continue;
+
+    double r2_start = 0., r2_end = 0.;
+    for (int j = 0; j < 3; j++) {
+      const double x_start = x[j] + rep->coord[j];
+      r2_start += x_start * x_start;
+      r2_end += (x_start + dx[j]) * (x_start + dx[j]);
+    }
+    if (r2_start > dist_2_start || r2_end < dist_2_end) continue;
+
+    if (count == MAX_CROSSINGS) error("Too many crossings.");
+    crossed[count++] = i;
+  }
+  return count;
+}
+
+int main(int argc, char *argv[]) {
+
+  /* Initialize CPU frequency, this also starts time. */
+  unsigned long long cpufreq = 0;
+  clocks_set_cpufreq(cpufreq);
+
+  /* Get some randomness going */
+  const int seed = time(NULL);
+  message("Seed = %d", seed);
+  srand(seed);
+
+  const double boxsize = 1.;
+  const double top_width = boxsize / CDIM;
+  const double leaf_width = top_width / (1 << DEPTH);
+
+  struct cell *top = (struct cell *)calloc(1, sizeof(struct cell));
+  struct cell *leaf = (struct cell *)calloc(1, sizeof(struct cell));
+  if (top == NULL || leaf == NULL) error("Unable to allocate the cells.");
+
+  long long nr_crossings = 0, nr_crossings_outside = 0;
+  long long nrep_step = 0, nrep_drift = 0;
+
+  for (int n = 0; n < NUM_DRIFTS; n++) {
+
+    /* A leaf somewhere in a top-level cell */
+    for (int j = 0; j < 3; j++) {
+      top->loc[j] = top_width * (rand() % CDIM);
+      top->width[j] = top_width;
+      leaf->loc[j] = top->loc[j] + leaf_width * (rand() % (1 << DEPTH));
+      leaf->width[j] = leaf_width;
+    }
+    top->top = top;
+    leaf->top = top;
+
+    /* The lightcone surface sweeps a thin shell during the drift of the leaf,
+     * inside the thicker one of the whole step */
+    double observer[3];
+    for (int j = 0; j < 3; j++) observer[j] = random_uniform(0., boxsize);
+    const double step_start = random_uniform(0.2, 3.);
+    const double step_end = step_start * random_uniform(0.9, 0.99);
+    const double dist_start = random_uniform(step_end, step_start);
+    const double dist_end = random_uniform(step_end, dist_start);
+    const double dist_2_start = dist_start * dist_start;
+    const double dist_2_end = dist_end * dist_end;
+
+    /* The lists of lightcone_prepare_for_step() and of the top of the drift
+     * recursion, then the one culled for the drift of the leaf */
+    struct replication_list step, cell_list, drift_list;
+    const double boundary = step_start - step_end;
+    replication_list_init(&step, boxsize, top_width, observer,
+                          max(step_end - boundary, 0.), step_start);
+    replication_list_subset_for_cell(&step, top, observer, &cell_list);
+    replication_list_subset_for_drift(&cell_list, leaf, observer,
+                                      dist_2_start, dist_2_end, &drift_list);
+    if (drift_list.nrep > cell_list.nrep)
+      error("Culled list is longer than the input one.");
+    nrep_step += cell_list.nrep;
+    nrep_drift += drift_list.nrep;
+
+    for (int k = 0; k < NUM_PARTS; k++) {
+
+      /* Anywhere the particles of the top-level cell can have wandered to,
+       * moving at most at the speed of light */
+      double x[3], dx[3];
+      int outside = 0;
+      for (int j = 0; j < 3; j++) {
+        const double pos = top->loc[j] + top_width * random_uniform(-0.5, 1.5);
+        if (pos < leaf->loc[j] || pos >= leaf->loc[j] + leaf_width)
+          outside = 1;
+        x[j] = pos - observer[j];
+      }
+      double norm = 0.;
+      for (int j = 0; j < 3; j++) {
+        dx[j] = random_uniform(-1., 1.);
+        norm += dx[j] * dx[j];
+      }
+      const double speed = (dist_start - dist_end) * random_uniform(0., 1.);
+      for (int j = 0; j < 3; j++) dx[j] *= speed / sqrt(norm);
+
+      /* Same replications crossed with and without the cull */
+      int crossed[MAX_CROSSINGS], crossed_drift[MAX_CROSSINGS];
+      const int count = find_crossings(&cell_list, x, dx, dist_2_start,
+                                       dist_2_end, crossed);
+      const int count_drift = find_crossings(&drift_list, x, dx, dist_2_start,
+                                             dist_2_end, crossed_drift);
+      if (count != count_drift)
+        error("Particle crosses %d replications, %d in the culled list.",
+              count, count_drift);
+      for (int i = 0; i < count; i++)
+        if (memcmp(cell_list.replication[crossed[i]].coord,
+                   drift_list.replication[crossed_drift[i]].coord,
+                   3 * sizeof(double)) != 0)
+          error("Particle crosses different replications with the cull.");
+
+      nr_crossings += count;
+      if (outside) nr_crossings_outside += count;
+    }
+
+    replication_list_clean(&drift_list);
+    replication_list_clean(&cell_list);
+    replication_list_clean(&step);
+  }
+
+  message("%lld crossings, %lld of them outside the leaf.", nr_crossings,
+          nr_crossings_outside);
+  message("Replications checked per drift: %.1f culled, %.1f before.",
+          (double)nrep_drift / NUM_DRIFTS, (double)nrep_step / NUM_DRIFTS);
+  if (nr_crossings_outside == 0)
+    error("No crossing outside the leaf, the test is not conclusive.");
+
+  free(top);
+  free(leaf);
+
+  message("All good.");
+  return 0;
+}
@@ -0,0 +1,168 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2024 The SWIFT team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/* Config parameters. */
+#include <config.h>
+
+/* System includes. */
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Local headers. */
+#include "swift.h"
+
+/* Number of random values to round. */
+#define NUM_RANDOM 100000
+
+/* Number of special values at the start of the arrays. */
+#define NUM_SPECIAL 20
+
+/**
+ * @brief Fill an array with special and random values of both signs.
+ *
+ * @param v The array of NUM_SPECIAL + NUM_RANDOM values.
+ * @param is_double Are the values double precision?
+ */
+void fill_values(double *v, const int is_double) {
+
+  const double largest = is_double ? DBL_MAX : FLT_MAX;
+  const double smallest = is_double ? DBL_MIN : FLT_MIN;
+  const double special[NUM_SPECIAL / 2] = {
+      0.,       1.,          0.1,           0.5,           1e-7,
+      smallest, 2. * smallest, largest / 3., largest * 0.999, largest};
+
+  for (int i = 0; i < NUM_SPECIAL / 2; i++) {
+    v[2 * i] = special[i];
+    v[2 * i + 1] = -special[i];
+  }
+
+  /* Values over the whole range of magnitudes */
+  const double max_exp = is_double ? 300. : 37.;
+  for (int i = 0; i < NUM_RANDOM; i++) {
+    const double x = pow(10., random_uniform(-max_exp, max_exp));
+    v[NUM_SPECIAL + i] = (i % 2) ? -x : x;
+  }
+}
+
+/**
+ * @brief Round values with an error-bounded scheme and check the bound.
+ *
+ * @param tp The #threadpool.
+ * @param comp The error-bounded #lossy_compression_schemes.
+ * @param type FLOAT or DOUBLE.
+ */
+void test_scheme(struct threadpool *tp,
+                 const enum lossy_compression_schemes comp,
+                 const enum IO_DATA_TYPE type) {
+
+  const int is_double = (type == DOUBLE);
+  const int count = NUM_SPECIAL + NUM_RANDOM;
+  const int relative = (comp >= compression_write_rel_err_2);
+  const int n = relative ? comp - compression_write_rel_err_2 + 2
+                         : comp - compression_write_abs_err_1 + 1;
+  const double tolerance = pow(10., -n);
+
+  double *exact = (double *)malloc(count * sizeof(double));
+  void *buffer = malloc(count * io_sizeof_type(type));
+  if (exact == NULL || buffer == NULL) error("Unable to allocate values.");
+
+  fill_values(exact, is_double);
+  for (int i = 0; i < count; i++) {
+    if (is_double)
+      ((double *)buffer)[i] = exact[i];
+    else {
+      ((float *)buffer)[i] = exact[i];
+      exact[i] = ((float *)buffer)[i];
+    }
+  }
+
+  io_quantise_buffer(tp, buffer, count, type, comp, "test");
+
+  for (int i = 0; i < count; i++) {
+    const double x = exact[i];
+    const double r = is_double ? ((double *)buffer)[i] : ((float *)buffer)[i];
+
+    /* Zero and the sign must be kept */
+    if ((x == 0. && r != 0.) || (x > 0. && r < 0.) || (x < 0. && r > 0.))
+      error("Value %.17e was rounded to %.17e (%s).", x, r,
+            lossy_compression_schemes_names[comp]);
+
+    /* The error bound itself (the differences are exact or much smaller) */
+    const double err = fabs(r - x);
+    const double bound = relative ? tolerance * fabs(x) : tolerance;
+    if (err > bound)
+      error(
+          "Value %.17e was rounded to %.17e, error %e above the bound %e "
+          "(%s).",
+          x, r, err, bound, lossy_compression_schemes_names[comp]);
+  }
+
+  /* Inf and NaN are left alone (compare the bits as the code is compiled
+   * with -ffast-math) */
+  if (is_double) {
+    const double special[3] = {INFINITY, -INFINITY, NAN};
+    double rounded[3];
+    memcpy(rounded, special, sizeof(special));
+    io_quantise_buffer(tp, rounded, 3, type, comp, "special");
+    if (memcmp(rounded, special, sizeof(special)) != 0)
+      error("Inf or NaN were changed (%s).",
+            lossy_compression_schemes_names[comp]);
+  } else {
+    const float special[3] = {INFINITY, -INFINITY, NAN};
+    float rounded[3];
+    memcpy(rounded, special, sizeof(special));
+    io_quantise_buffer(tp, rounded, 3, type, comp, "special");
+    if (memcmp(rounded, special, sizeof(special)) != 0)
+      error("Inf or NaN were changed (%s).",
+            lossy_compression_schemes_names[comp]);
+  }
+
+  free(exact);
+  free(buffer);
+}
+
+int main(int argc, char *argv[]) {
+
+  /* Initialize CPU frequency, this also starts time. */
+  unsigned long long cpufreq = 0;
+  clocks_set_cpufreq(cpufreq);
+
+  /* Get some randomness going */
+  const int seed = time(NULL);
+  message("Seed = %d", seed);
+  srand(seed);
+
+  struct threadpool tp;
+  threadpool_init(&tp, 2);
+
+  for (int comp = compression_write_abs_err_1;
+       comp <= compression_write_rel_err_6; comp++) {
+    message("Testing %s...", lossy_compression_schemes_names[comp]);
+    test_scheme(&tp, (enum lossy_compression_schemes)comp, FLOAT);
+    test_scheme(&tp, (enum lossy_compression_schemes)comp, DOUBLE);
+  }
+
+  threadpool_clean(&tp);
+
+  message("All good.");
+  return 0;
+}
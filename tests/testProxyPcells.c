@@ -0,0 +1,255 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2024 The SWIFT team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/* Config parameters. */
+#include <config.h>
+
+/* System includes. */
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Local headers. */
+#include "proxy.h"
+#include "swift.h"
+
+/* Number of trees in the buffers. */
+#define NUM_TREES 50
+
+/* Largest number of #pcell in a tree. */
+#define MAX_TREE_SIZE 200
+
+/* Number of exchanges to simulate. */
+#define NUM_EXCHANGES 20
+
+/*! The different ways a tree can change between two exchanges. */
+enum tree_change {
+  tree_change_none = 0,
+  tree_change_few,
+  tree_change_all,
+  tree_change_progeny,
+  tree_change_size,
+  tree_change_count,
+};
+
+/* Kind of record the encoding should choose for each change (0: full
+ * tree, 1: patch). */
+static const int expected_record[tree_change_count] = {1, 1, 0, 0, 0};
+
+/**
+ * @brief Fill some #pcell with random bytes, padding included.
+ */
+void random_pcells(struct pcell *pcells, const int count) {
+  unsigned char *bytes = (unsigned char *)pcells;
+  for (size_t k = 0; k < count * sizeof(struct pcell); k++)
+    bytes[k] = rand() & 0xff;
+}
+
+/**
+ * @brief Change one random byte of a #pcell, keeping its progeny.
+ */
+void change_pcell(struct pcell *pc) {
+  const size_t start = offsetof(struct pcell, progeny);
+  const size_t end = start + sizeof(pc->progeny);
+  size_t k;
+  do {
+    k = rand() % sizeof(struct pcell);
+  } while (k >= start && k < end);
+  ((unsigned char *)pc)[k] ^= 1 + rand() % 255;
+}
+
+/**
+ * @brief Make a new version of a tree.
+ *
+ * @param prev The previous tree.
+ * @param prev_size The number of #pcell in prev.
+ * @param cur The new tree.
+ * @param change The #tree_change to apply.
+ * @return The number of #pcell in cur.
+ */
+int change_tree(const struct pcell *prev, const int prev_size,
+                struct pcell *cur, const enum tree_change change) {
+
+  if (change == tree_change_size) {
+    const int size = (prev_size == MAX_TREE_SIZE)
+                         ? prev_size - 1
+                         : prev_size + 1 + rand() % (MAX_TREE_SIZE - prev_size);
+    random_pcells(cur, size);
+    memcpy(cur, prev, (size < prev_size ? size : prev_size) *
+                          sizeof(struct pcell));
+    return size;
+  }
+
+  memcpy(cur, prev, prev_size * sizeof(struct pcell));
+  switch (change) {
+    case tree_change_few:
+      for (int k = 0; k < 1 + prev_size / 10; k++)
+        change_pcell(&cur[rand() % prev_size]);
+      break;
+    case tree_change_all:
+      for (int i = 0; i < prev_size; i++) {
+        unsigned char *bytes = (unsigned char *)&cur[i];
+        for (size_t k = 0; k < sizeof(struct pcell); k++) bytes[k] ^= 0xff;
+        memcpy(cur[i].progeny, prev[i].progeny, sizeof(cur[i].progeny));
+      }
+      break;
+    case tree_change_progeny:
+      cur[rand() % prev_size].progeny[rand() % 8] ^= 1 + rand() % 255;
+      break;
+    default:
+      break;
+  }
+  return prev_size;
+}
+
+int main(int argc, char *argv[]) {
+
+  /* Initialize CPU frequency, this also starts time. */
+  unsigned long long cpufreq = 0;
+  clocks_set_cpufreq(cpufreq);
+
+  /* Get some randomness going */
+  const int seed = time(NULL);
+  message("Seed = %d", seed);
+  srand(seed);
+
+  /* The trees on the sending side and those rebuilt on the receiving side,
+   * one after the other as in the proxies */
+  const size_t max_pcells = NUM_TREES * MAX_TREE_SIZE;
+  struct pcell *sent =
+      (struct pcell *)malloc(max_pcells * sizeof(struct pcell));
+  struct pcell *cur =
+      (struct pcell *)malloc(max_pcells * sizeof(struct pcell));
+  struct pcell *received =
+      (struct pcell *)malloc(max_pcells * sizeof(struct pcell));
+  struct pcell *rebuilt =
+      (struct pcell *)malloc(max_pcells * sizeof(struct pcell));
+  int sent_offset[NUM_TREES + 1], cur_offset[NUM_TREES + 1];
+  int received_offset[NUM_TREES + 1], rebuilt_offset[NUM_TREES + 1];
+  char *buffer = (char *)malloc(NUM_TREES * 2 * sizeof(int) +
+                                max_pcells * sizeof(struct pcell));
+  if (sent == NULL || cur == NULL || received == NULL || rebuilt == NULL ||
+      buffer == NULL)
+    error("Unable to allocate the trees.");
+
+  int counts[tree_change_count][2] = {{0}};
+
+  for (int n = 0; n < NUM_EXCHANGES; n++) {
+
+    /* The new trees: random at the first exchange, changed afterwards */
+    enum tree_change changes[NUM_TREES];
+    cur_offset[0] = 0;
+    for (int j = 0; j < NUM_TREES; j++) {
+      int size;
+      if (n == 0) {
+        size = 1 + rand() % MAX_TREE_SIZE;
+        random_pcells(&cur[cur_offset[j]], size);
+      } else {
+        changes[j] = (enum tree_change)(j % tree_change_count);
+        size = change_tree(&sent[sent_offset[j]],
+                           sent_offset[j + 1] - sent_offset[j],
+                           &cur[cur_offset[j]], changes[j]);
+      }
+      cur_offset[j + 1] = cur_offset[j] + size;
+    }
+
+    /* Encode them as in proxy_cells_exchange_first() */
+    size_t bytes = 0;
+    for (int j = 0; j < NUM_TREES; j++) {
+      const int prev_size = n ? sent_offset[j + 1] - sent_offset[j] : 0;
+      const size_t record = proxy_pcell_encode(
+          n ? &sent[sent_offset[j]] : NULL, prev_size, &cur[cur_offset[j]],
+          cur_offset[j + 1] - cur_offset[j], buffer + bytes);
+
+      int header[2];
+      memcpy(header, buffer + bytes, sizeof(header));
+      const int size = cur_offset[j + 1] - cur_offset[j];
+      const size_t full_bytes = 2 * sizeof(int) + size * sizeof(struct pcell);
+      if (record > full_bytes)
+        error("Record of tree %d is larger than the full tree.", j);
+      if (n == 0 && header[0] != 0)
+        error("Tree %d was not sent in full at the first exchange.", j);
+      if (n > 0) {
+        if (header[0] != expected_record[changes[j]])
+          error("Wrong kind of record for tree %d (change %d).", j,
+                changes[j]);
+        if (changes[j] == tree_change_none && record != 2 * sizeof(int))
+          error("Unchanged tree %d was not sent as an empty patch.", j);
+        counts[changes[j]][header[0]]++;
+      }
+      bytes += record;
+    }
+
+    /* Get the sizes then rebuild as in proxy_cells_decode() */
+    size_t bytes_in = 0;
+    rebuilt_offset[0] = 0;
+    for (int j = 0; j < NUM_TREES; j++) {
+      const int prev_size = n ? received_offset[j + 1] - received_offset[j] : 0;
+      int size = 0;
+      bytes_in += proxy_pcell_decode(buffer + bytes_in,
+                                     n ? &received[received_offset[j]] : NULL,
+                                     prev_size, /*cur=*/NULL, &size);
+      rebuilt_offset[j + 1] = rebuilt_offset[j] + size;
+    }
+    if (bytes_in != bytes)
+      error("Read %zu bytes of the %zu written.", bytes_in, bytes);
+
+    bytes_in = 0;
+    for (int j = 0; j < NUM_TREES; j++) {
+      const int prev_size = n ? received_offset[j + 1] - received_offset[j] : 0;
+      int size = 0;
+      bytes_in += proxy_pcell_decode(
+          buffer + bytes_in, n ? &received[received_offset[j]] : NULL,
+          prev_size, &rebuilt[rebuilt_offset[j]], &size);
+    }
+    if (bytes_in != bytes)
+      error("Read %zu bytes of the %zu written.", bytes_in, bytes);
+
+    /* The rebuilt trees must be exactly the ones of a full exchange */
+    for (int j = 0; j < NUM_TREES; j++) {
+      const int size = cur_offset[j + 1] - cur_offset[j];
+      if (rebuilt_offset[j + 1] - rebuilt_offset[j] != size)
+        error("Tree %d rebuilt with %d cells instead of %d.", j,
+              rebuilt_offset[j + 1] - rebuilt_offset[j], size);
+      if (memcmp(&rebuilt[rebuilt_offset[j]], &cur[cur_offset[j]],
+                 size * sizeof(struct pcell)) != 0)
+        error("Tree %d differs from the one sent (exchange %d).", j, n);
+    }
+
+    /* Both sides keep the trees for the next exchange */
+    memcpy(sent, cur, cur_offset[NUM_TREES] * sizeof(struct pcell));
+    memcpy(sent_offset, cur_offset, sizeof(cur_offset));
+    memcpy(received, rebuilt, rebuilt_offset[NUM_TREES] * sizeof(struct pcell));
+    memcpy(received_offset, rebuilt_offset, sizeof(rebuilt_offset));
+  }
+
+  for (int c = 0; c < tree_change_count; c++)
+    message("Change %d: %d full trees and %d patches.", c, counts[c][0],
+            counts[c][1]);
+
+  free(sent);
+  free(cur);
+  free(received);
+  free(rebuilt);
+  free(buffer);
+
+  message("All good.");
+  return 0;
+}
@@ -0,0 +1,181 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2024 The SWIFT team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/* Config parameters. */
+#include <config.h>
+
+/* System includes. */
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Local headers. */
+#include "swift.h"
+
+/* Number of values in the random round trips. */
+#define NUM_VALUES 100000
+
+/**
+ * @brief Check that a number of steps survives the zigzag encoding.
+ */
+void check_zigzag(const long long n) {
+
+  const unsigned long long z = snapshot_keyframe_zigzag_encode(n);
+  const long long n_back = snapshot_keyframe_zigzag_decode(z);
+  if (n_back != n) error("Zigzag round trip of %lld gave %lld.", n, n_back);
+
+  /* Small changes of either sign must give small codes */
+  const unsigned long long abs_n =
+      (n < 0) ? (unsigned long long)(-(n + 1)) + 1ULL : (unsigned long long)n;
+  if (z / 2 > abs_n || abs_n - z / 2 > 1)
+    error("Zigzag code of %lld is %llu.", n, z);
+}
+
+/**
+ * @brief Test the zigzag encoding of the number of steps.
+ */
+void test_zigzag(void) {
+
+  /* The first codes alternate between the signs */
+  const long long expected[7] = {0, -1, 1, -2, 2, -3, 3};
+  for (int i = 0; i < 7; i++) {
+    if (snapshot_keyframe_zigzag_encode(expected[i]) != (unsigned long long)i)
+      error("Zigzag code of %lld is not %d.", expected[i], i);
+    if (snapshot_keyframe_zigzag_decode(i) != expected[i])
+      error("Zigzag decoding of %d is not %lld.", i, expected[i]);
+  }
+
+  /* Small values, the largest deltas we write and the limits of the type */
+  for (long long n = -100000; n <= 100000; n++) check_zigzag(n);
+  const long long max_steps = 1LL << 53;
+  check_zigzag(max_steps);
+  check_zigzag(-max_steps);
+  check_zigzag(LLONG_MAX);
+  check_zigzag(LLONG_MIN);
+
+  for (int i = 0; i < NUM_VALUES; i++) {
+    const long long n = (long long)(random_uniform(-1., 1.) * max_steps);
+    check_zigzag(n);
+  }
+}
+
+/**
+ * @brief Test that values rounded with an absolute error bound are exactly
+ * recovered from their keyframe value and their encoded delta, the way
+ * they are written by snapshot_keyframe_write_delta() and read by
+ * tools/reconstruct_keyframe_snapshot.py.
+ *
+ * @param tp The #threadpool.
+ * @param comp The AbsErr scheme.
+ * @param type FLOAT or DOUBLE.
+ */
+void test_delta_round_trip(struct threadpool *tp,
+                           const enum lossy_compression_schemes comp,
+                           const enum IO_DATA_TYPE type) {
+
+  const int is_double = (type == DOUBLE);
+  const size_t size = io_sizeof_type(type);
+  const double step = compression_scheme_abs_err_step(comp);
+  const double inv_step = 1. / step;
+
+  void *keyframe = malloc(NUM_VALUES * size);
+  void *values = malloc(NUM_VALUES * size);
+  if (keyframe == NULL || values == NULL) error("Unable to allocate values.");
+
+  /* Values of many magnitudes and signs that moved a little, a lot, not at
+   * all, or that were not in the keyframe (stored relative to zero) */
+  for (int i = 0; i < NUM_VALUES; i++) {
+    const double scale = pow(10., random_uniform(-8., 4.));
+    const double x_key = random_uniform(-1., 1.) * scale;
+    double x = x_key;
+    if (i % 4 == 1) x += random_uniform(-1e-3, 1e-3);
+    if (i % 4 == 2) x = random_uniform(-1., 1.) * 1e4;
+    const double x_key_written = (i % 4 == 3) ? 0. : x_key;
+
+    if (is_double) {
+      ((double *)keyframe)[i] = x_key_written;
+      ((double *)values)[i] = x;
+    } else {
+      ((float *)keyframe)[i] = x_key_written;
+      ((float *)values)[i] = x;
+    }
+  }
+
+  io_quantise_buffer(tp, keyframe, NUM_VALUES, type, comp, "keyframe");
+  io_quantise_buffer(tp, values, NUM_VALUES, type, comp, "values");
+
+  for (int i = 0; i < NUM_VALUES; i++) {
+
+    const double x_key = is_double ? ((double *)keyframe)[i]
+                                   : ((float *)keyframe)[i];
+    const double x =
+        is_double ? ((double *)values)[i] : ((float *)values)[i];
+
+    /* Encode as in snapshot_keyframe_delta_mapper() */
+    const double steps = (x - x_key) * inv_step;
+    if (steps != rint(steps))
+      error("Delta of %e from %e is not a whole number of steps (%s).", x,
+            x_key, lossy_compression_schemes_names[comp]);
+    const unsigned long long z =
+        snapshot_keyframe_zigzag_encode((long long)steps);
+
+    /* Decode as in the reconstruction tool */
+    const double x_back =
+        snapshot_keyframe_zigzag_decode(z) * step + x_key;
+    const int same = is_double ? (x_back == x) : ((float)x_back == (float)x);
+    if (!same)
+      error("Value %.17e recovered as %.17e (%s).", x, x_back,
+            lossy_compression_schemes_names[comp]);
+  }
+
+  free(keyframe);
+  free(values);
+}
+
+int main(int argc, char *argv[]) {
+
+  /* Initialize CPU frequency, this also starts time. */
+  unsigned long long cpufreq = 0;
+  clocks_set_cpufreq(cpufreq);
+
+  /* Get some randomness going */
+  const int seed = time(NULL);
+  message("Seed = %d", seed);
+  srand(seed);
+
+  message("Testing the zigzag encoding...");
+  test_zigzag();
+
+  struct threadpool tp;
+  threadpool_init(&tp, 2);
+
+  message("Testing the round trip of the deltas...");
+  for (int comp = compression_write_abs_err_1;
+       comp <= compression_write_abs_err_6; comp++) {
+    test_delta_round_trip(&tp, (enum lossy_compression_schemes)comp, FLOAT);
+    test_delta_round_trip(&tp, (enum lossy_compression_schemes)comp, DOUBLE);
+  }
+
+  threadpool_clean(&tp);
+
+  message("All good.");
+  return 0;
+}
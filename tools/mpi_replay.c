@@ -0,0 +1,951 @@
+/*******************************************************************************
+ * This file is part of SWIFT.
+ * Copyright (c) 2024 The SWIFT team
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/**
+ *  @file mpi_replay.c
+ *  @brief Offline replay of the tasks and MPI messages of a step, to predict
+ *  the step time on a different interconnect, thread or rank count.
+ *
+ *  The inputs are the task dump of a step (thread_info_MPI-stepN.dat, from
+ *  --task-dumps with --enable-task-debugging), the MPI reports of all the
+ *  ranks for the same step (mpiuse_report-rankR-stepN.dat, from
+ *  --enable-mpiuse-reports) and, optionally, the dependency graph of the
+ *  run (dependency_graph_N.csv).
+ *
+ *  The dumps do not record which task instance unlocks which, so the
+ *  dependencies are reconstructed from the measured timeline: a task can only
+ *  start once all the tasks that had completed before it started in the
+ *  measured run have completed in the replay. When the dependency graph is
+ *  given, this is restricted to the task types that can reach the task's type
+ *  in that graph, which lets tasks of unrelated types use extra threads.
+ *  Sends leave when the tasks that preceded their activation are done, and
+ *  recv tasks wait for their message to arrive through a latency/bandwidth
+ *  model of the network, optionally serialising the sends of each rank.
+ *
+ *  A different rank count is modelled to first order: the work per rank
+ *  scales as the inverse of the number of ranks and the message sizes as the
+ *  surface of the domains, i.e. to the power 2/3. The number of messages is
+ *  kept the same.
+ */
+
+/* Config parameters. */
+#include <config.h>
+
+/* Standard includes. */
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Local headers. */
+#include "argparse.h"
+#include "swift.h"
+
+/*! Number of distinct (type, subtype) pairs. */
+#define replay_nr_full_types (task_type_count * task_subtype_count)
+
+/*! Maximum length of a line in the input files. */
+#define replay_line_length 1024
+
+/**
+ * @brief A task as measured and as replayed.
+ */
+struct replay_task {
+
+  /*! Type and subtype combined as type * task_subtype_count + subtype. */
+  int full_type;
+
+  /*! Measured start and end times, in seconds since the start of the step. */
+  double start, end;
+
+  /*! Replayed end time. */
+  double rend;
+
+  /*! Index of the message this (recv) task waits for, -1 if none. */
+  int msg;
+
+  /*! Has this task been replayed yet? */
+  int done;
+};
+
+/**
+ * @brief An MPI message matched between the sending and receiving rank.
+ */
+struct replay_msg {
+
+  /*! Sending and receiving ranks. */
+  int from, to;
+
+  /*! Subtype and tag of the exchange. */
+  int subtype, tag;
+
+  /*! Size in bytes. */
+  long long size;
+
+  /*! Measured activation of the send, sender's clock. */
+  double depart;
+
+  /*! Measured completion of the recv, receiver's clock. */
+  double complete;
+
+  /*! Replayed arrival time and resolution flag. */
+  double rarrive;
+  int resolved;
+};
+
+/**
+ * @brief The state of one rank during the replay.
+ */
+struct replay_rank {
+
+  /*! The tasks of this rank, sorted by measured start time. */
+  struct replay_task *tasks;
+  int nr_tasks, size_tasks;
+
+  /*! Indices of the tasks sorted by measured end time. */
+  int *by_end;
+
+  /*! Outgoing messages sorted by measured departure. */
+  int *out;
+  int nr_out;
+
+  /*! Measured step start and end (ticks), and CPU frequency. */
+  long long tic_step, toc_step;
+  double cpufreq;
+
+  /*! Number of threads used in the measured run. */
+  int nr_threads;
+
+  /*! Measured start of the first task and time between the end of the last
+   * task and the end of the step (s). Neither is replayed. */
+  double first_start, tail;
+
+  /*! Replay progress: next task by start, next task by end, next message. */
+  int next, end_ptr, out_ptr;
+
+  /*! Latest replayed end time of the completed tasks, per type and overall. */
+  double *typemax;
+  double allmax;
+
+  /*! Time at which the network interface is free again. */
+  double nic_free;
+
+  /*! Free time of each thread (a binary min-heap). */
+  double *threads;
+  int nr_heap;
+
+  /*! Replayed end of the step and time spent waiting for messages. */
+  double step_end;
+  double comm_wait;
+};
+
+/**
+ * @brief The replay model parameters.
+ */
+struct replay_model {
+
+  /*! Network latency (s) and bandwidth (bytes/s). */
+  double latency, bandwidth;
+
+  /*! Serialise the sends of each rank? */
+  int serial_injection;
+
+  /*! Threads per rank in the replay, 0 to keep the measured count. */
+  int nr_threads;
+
+  /*! Scaling of the task durations and message sizes. */
+  double compute_scale, size_scale;
+};
+
+/* The dependency graph: for each full type, the list of the full types that
+ * can reach it. NULL if no graph was given. */
+static int **replay_preds = NULL;
+static int *replay_nr_preds = NULL;
+
+/**
+ * @brief Look up the full type index from its name, -1 if not found.
+ */
+static int replay_full_type_from_name(const char *name) {
+
+  char buff[200];
+  for (int type = 0; type < task_type_count; type++) {
+    for (int subtype = 0; subtype < task_subtype_count; subtype++) {
+      task_get_full_name(type, subtype, buff);
+      if (strcmp(buff, name) == 0) return type * task_subtype_count + subtype;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Read a dependency graph and compute which types can reach which.
+ *
+ * @param filename The dependency_graph_N.csv file.
+ */
+static void replay_read_dependencies(const char *filename) {
+
+  FILE *file = fopen(filename, "r");
+  if (file == NULL) error("Could not open file '%s'.", filename);
+
+  /* Compact index of the types that appear in the graph. */
+  int *compact = (int *)malloc(replay_nr_full_types * sizeof(int));
+  int *full = (int *)malloc(replay_nr_full_types * sizeof(int));
+  for (int k = 0; k < replay_nr_full_types; k++) compact[k] = -1;
+  int nr_types = 0;
+
+  int size_edges = 256, nr_edges = 0;
+  int *edges = (int *)malloc(2 * size_edges * sizeof(int));
+
+  char line[replay_line_length];
+  while (fgets(line, replay_line_length, file) != NULL) {
+    if (line[0] == '#' || strncmp(line, "task_in", 7) == 0) continue;
+
+    char *in = strtok(line, ",");
+    char *out = strtok(NULL, ",");
+    if (in == NULL || out == NULL) continue;
+
+    const int ends[2] = {replay_full_type_from_name(in),
+                         replay_full_type_from_name(out)};
+    if (ends[0] < 0 || ends[1] < 0) {
+      message("Ignoring unknown dependency %s -> %s.", in, out);
+      continue;
+    }
+    for (int k = 0; k < 2; k++) {
+      if (compact[ends[k]] < 0) {
+        compact[ends[k]] = nr_types;
+        full[nr_types++] = ends[k];
+      }
+    }
+    if (nr_edges == size_edges) {
+      size_edges *= 2;
+      edges = (int *)realloc(edges, 2 * size_edges * sizeof(int));
+    }
+    edges[2 * nr_edges] = compact[ends[0]];
+    edges[2 * nr_edges + 1] = compact[ends[1]];
+    nr_edges++;
+  }
+  fclose(file);
+
+  /* Transitive closure (Warshall) of the reachability matrix. */
+  char *reach = (char *)calloc(nr_types * nr_types, sizeof(char));
+  for (int e = 0; e < nr_edges; e++)
+    reach[edges[2 * e] * nr_types + edges[2 * e + 1]] = 1;
+  for (int k = 0; k < nr_types; k++)
+    for (int i = 0; i < nr_types; i++)
+      if (reach[i * nr_types + k])
+        for (int j = 0; j < nr_types; j++)
+          if (reach[k * nr_types + j]) reach[i * nr_types + j] = 1;
+
+  /* Invert into lists of predecessors. Types that are not in the graph have
+   * no predecessors. */
+  replay_preds = (int **)calloc(replay_nr_full_types, sizeof(int *));
+  replay_nr_preds = (int *)calloc(replay_nr_full_types, sizeof(int));
+  for (int j = 0; j < nr_types; j++) {
+    int count = 0;
+    for (int i = 0; i < nr_types; i++) count += reach[i * nr_types + j];
+    replay_preds[full[j]] = (int *)malloc(count * sizeof(int));
+    for (int i = 0; i < nr_types; i++)
+      if (reach[i * nr_types + j])
+        replay_preds[full[j]][replay_nr_preds[full[j]]++] = full[i];
+  }
+
+  message("Read %d dependencies between %d task types.", nr_edges, nr_types);
+
+  free(reach);
+  free(edges);
+  free(full);
+  free(compact);
+}
+
+/**
+ * @brief Read the task dump of a step.
+ *
+ * @param filename The thread_info_MPI-stepN.dat file.
+ * @param nr_ranks (return) The number of ranks found.
+ * @return The array of #replay_rank.
+ */
+static struct replay_rank *replay_read_tasks(const char *filename,
+                                             int *nr_ranks) {
+
+  FILE *file = fopen(filename, "r");
+  if (file == NULL) error("Could not open file '%s'.", filename);
+
+  int size_ranks = 16;
+  struct replay_rank *ranks =
+      (struct replay_rank *)calloc(size_ranks, sizeof(struct replay_rank));
+  *nr_ranks = 0;
+
+  char line[replay_line_length];
+  while (fgets(line, replay_line_length, file) != NULL) {
+    if (line[0] == '#') continue;
+
+    int rank, rid, type, subtype, cj_null, offset;
+    if (sscanf(line, "%d %d %d %d %d%n", &rank, &rid, &type, &subtype,
+               &cj_null, &offset) != 5)
+      continue;
+
+    /* The header line of each rank has no type and ends with the CPU
+     * frequency, which does not fit in an int. The task lines end with the
+     * sub-cell ID. */
+    long long tic, toc, c1, c2, c3, c4, flags, cpufreq = 0;
+    int sid = -1;
+    if (type == task_type_none) {
+      if (sscanf(line + offset, "%lld %lld %lld %lld %lld %lld %lld %lld",
+                 &tic, &toc, &c1, &c2, &c3, &c4, &flags, &cpufreq) != 8)
+        continue;
+    } else {
+      if (sscanf(line + offset, "%lld %lld %lld %lld %lld %lld %lld %d", &tic,
+                 &toc, &c1, &c2, &c3, &c4, &flags, &sid) != 8)
+        continue;
+    }
+
+    while (rank >= size_ranks) {
+      ranks = (struct replay_rank *)realloc(
+          ranks, 2 * size_ranks * sizeof(struct replay_rank));
+      bzero(&ranks[size_ranks], size_ranks * sizeof(struct replay_rank));
+      size_ranks *= 2;
+    }
+    if (rank >= *nr_ranks) *nr_ranks = rank + 1;
+    struct replay_rank *r = &ranks[rank];
+
+    if (type == task_type_none) {
+      r->tic_step = tic;
+      r->toc_step = toc;
+      r->cpufreq = (double)cpufreq;
+      continue;
+    }
+
+    if (r->nr_tasks == r->size_tasks) {
+      r->size_tasks = r->size_tasks ? 2 * r->size_tasks : 1024;
+      r->tasks = (struct replay_task *)realloc(
+          r->tasks, r->size_tasks * sizeof(struct replay_task));
+    }
+    struct replay_task *t = &r->tasks[r->nr_tasks++];
+    t->full_type = type * task_subtype_count + subtype;
+    t->start = (double)tic;
+    t->end = (double)toc;
+    t->msg = -1;
+    t->done = 0;
+    if (rid + 1 > r->nr_threads) r->nr_threads = rid + 1;
+  }
+  fclose(file);
+
+  /* Convert to seconds since the start of the step. */
+  for (int k = 0; k < *nr_ranks; k++) {
+    struct replay_rank *r = &ranks[k];
+    if (r->cpufreq <= 0.) error("No header found for rank %d.", k);
+    for (int i = 0; i < r->nr_tasks; i++) {
+      r->tasks[i].start = (r->tasks[i].start - r->tic_step) / r->cpufreq;
+      r->tasks[i].end = (r->tasks[i].end - r->tic_step) / r->cpufreq;
+    }
+  }
+
+  return ranks;
+}
+
+/* Sorting helpers. */
+static struct replay_task *replay_sort_tasks;
+static struct replay_msg *replay_sort_msgs;
+
+static int replay_cmp_start(const void *a, const void *b) {
+  const struct replay_task *ta = (const struct replay_task *)a;
+  const struct replay_task *tb = (const struct replay_task *)b;
+  return (ta->start > tb->start) - (ta->start < tb->start);
+}
+
+static int replay_cmp_end(const void *a, const void *b) {
+  const double ea = replay_sort_tasks[*(const int *)a].end;
+  const double eb = replay_sort_tasks[*(const int *)b].end;
+  return (ea > eb) - (ea < eb);
+}
+
+static int replay_cmp_depart(const void *a, const void *b) {
+  const double da = replay_sort_msgs[*(const int *)a].depart;
+  const double db = replay_sort_msgs[*(const int *)b].depart;
+  return (da > db) - (da < db);
+}
+
+/**
+ * @brief An MPI report record before matching.
+ */
+struct replay_record {
+  int from, to, subtype, tag;
+  long long size;
+  double time;
+};
+
+static int replay_cmp_record(const void *a, const void *b) {
+  const struct replay_record *ra = (const struct replay_record *)a;
+  const struct replay_record *rb = (const struct replay_record *)b;
+  if (ra->from != rb->from) return ra->from - rb->from;
+  if (ra->to != rb->to) return ra->to - rb->to;
+  if (ra->subtype != rb->subtype) return ra->subtype - rb->subtype;
+  if (ra->tag != rb->tag) return ra->tag - rb->tag;
+  if (ra->size != rb->size) return (ra->size > rb->size) ? 1 : -1;
+  return (ra->time > rb->time) - (ra->time < rb->time);
+}
+
+/**
+ * @brief Read the MPI reports and match the sends with the recvs.
+ *
+ * As in match_mpireports.py, sends are matched when they are activated and
+ * recvs when they complete.
+ *
+ * @param files The mpiuse_report-rankR-stepN.dat files.
+ * @param nr_files The number of files.
+ * @param ranks The #replay_rank array (for the CPU frequencies).
+ * @param nr_ranks The number of ranks.
+ * @param nr_msgs (return) The number of matched messages.
+ * @return The array of #replay_msg.
+ */
+static struct replay_msg *replay_read_messages(const char **files,
+                                               int nr_files,
+                                               const struct replay_rank *ranks,
+                                               int nr_ranks, int *nr_msgs) {
+
+  int size_sends = 1024, nr_sends = 0, size_recvs = 1024, nr_recvs = 0;
+  struct replay_record *sends = (struct replay_record *)malloc(
+      size_sends * sizeof(struct replay_record));
+  struct replay_record *recvs = (struct replay_record *)malloc(
+      size_recvs * sizeof(struct replay_record));
+
+  for (int f = 0; f < nr_files; f++) {
+    FILE *file = fopen(files[f], "r");
+    if (file == NULL) error("Could not open file '%s'.", files[f]);
+
+    char line[replay_line_length];
+    while (fgets(line, replay_line_length, file) != NULL) {
+      if (line[0] == '#') continue;
+
+      long long stic, etic, dtic, size, sum;
+      int step, rank, otherrank, itype, isubtype, activation, tag;
+      char type[64], subtype[64];
+      if (sscanf(line, "%lld %lld %lld %d %d %d %63s %d %63s %d %d %d %lld %lld",
+                 &stic, &etic, &dtic, &step, &rank, &otherrank, type, &itype,
+                 subtype, &isubtype, &activation, &tag, &size, &sum) != 14)
+        continue;
+      if (rank >= nr_ranks || otherrank >= nr_ranks)
+        error("Rank %d/%d not present in the task dump.", rank, otherrank);
+
+      struct replay_record rec;
+      rec.subtype = isubtype;
+      rec.tag = tag;
+      rec.size = llabs(size);
+      rec.time = (double)stic / ranks[rank].cpufreq;
+
+      if (activation == 1 && itype == task_type_send) {
+        rec.from = rank;
+        rec.to = otherrank;
+        if (nr_sends == size_sends) {
+          size_sends *= 2;
+          sends = (struct replay_record *)realloc(
+              sends, size_sends * sizeof(struct replay_record));
+        }
+        sends[nr_sends++] = rec;
+      } else if (activation == 0 && itype == task_type_recv) {
+        rec.from = otherrank;
+        rec.to = rank;
+        if (nr_recvs == size_recvs) {
+          size_recvs *= 2;
+          recvs = (struct replay_record *)realloc(
+              recvs, size_recvs * sizeof(struct replay_record));
+        }
+        recvs[nr_recvs++] = rec;
+      }
+    }
+    fclose(file);
+  }
+
+  /* Match by key, pairing in time order for repeated keys. */
+  qsort(sends, nr_sends, sizeof(struct replay_record), replay_cmp_record);
+  qsort(recvs, nr_recvs, sizeof(struct replay_record), replay_cmp_record);
+
+  struct replay_msg *msgs =
+      (struct replay_msg *)malloc(nr_sends * sizeof(struct replay_msg));
+  int count = 0, unmatched = 0;
+  for (int i = 0, j = 0; i < nr_sends;) {
+    const struct replay_record *s = &sends[i];
+    while (j < nr_recvs && (recvs[j].from < s->from ||
+                            (recvs[j].from == s->from &&
+                             (recvs[j].to < s->to ||
+                              (recvs[j].to == s->to &&
+                               (recvs[j].subtype < s->subtype ||
+                                (recvs[j].subtype == s->subtype &&
+                                 (recvs[j].tag < s->tag ||
+                                  (recvs[j].tag == s->tag &&
+                                   recvs[j].size < s->size)))))))))
+      j++;
+    if (j < nr_recvs && recvs[j].from == s->from && recvs[j].to == s->to &&
+        recvs[j].subtype == s->subtype && recvs[j].tag == s->tag &&
+        recvs[j].size == s->size) {
+      struct replay_msg *m = &msgs[count++];
+      m->from = s->from;
+      m->to = s->to;
+      m->subtype = s->subtype;
+      m->tag = s->tag;
+      m->size = s->size;
+      m->depart = s->time;
+      m->complete = recvs[j].time;
+      m->resolved = 0;
+      m->rarrive = 0.;
+      i++;
+      j++;
+    } else {
+      unmatched++;
+      i++;
+    }
+  }
+  if (unmatched > 0) message("%d sends could not be matched.", unmatched);
+
+  free(sends);
+  free(recvs);
+  *nr_msgs = count;
+  return msgs;
+}
+
+/**
+ * @brief Attach each incoming message to the recv task that processed it.
+ *
+ * The recv task of a given subtype that ran first after the message
+ * completed is assumed to be the one that processed it.
+ */
+static void replay_attach_messages(struct replay_rank *ranks, int nr_ranks,
+                                   struct replay_msg *msgs, int nr_msgs) {
+
+  /* Messages sorted by completion, per receiving rank. */
+  int *order = (int *)malloc(nr_msgs * sizeof(int));
+  for (int k = 0; k < nr_msgs; k++) order[k] = k;
+  replay_sort_msgs = msgs;
+
+  for (int r = 0; r < nr_ranks; r++) {
+    struct replay_rank *rank = &ranks[r];
+
+    for (int subtype = 0; subtype < task_subtype_count; subtype++) {
+      const int full_type = task_type_recv * task_subtype_count + subtype;
+
+      /* Gather the messages of this subtype and sort them by completion. */
+      int count = 0;
+      for (int k = 0; k < nr_msgs; k++)
+        if (msgs[k].to == r && msgs[k].subtype == subtype) order[count++] = k;
+      for (int a = 1; a < count; a++) {
+        const int key = order[a];
+        int b = a - 1;
+        while (b >= 0 && msgs[order[b]].complete > msgs[key].complete) {
+          order[b + 1] = order[b];
+          b--;
+        }
+        order[b + 1] = key;
+      }
+
+      /* Walk the recv tasks, which are already in start order. */
+      int m = 0;
+      for (int i = 0; i < rank->nr_tasks && m < count; i++) {
+        struct replay_task *t = &rank->tasks[i];
+        if (t->full_type != full_type) continue;
+        if (msgs[order[m]].complete <= t->start) t->msg = order[m++];
+      }
+    }
+  }
+  free(order);
+}
+
+/* Binary heap of thread free times. */
+static void replay_heap_push(struct replay_rank *r, double v) {
+  int i = r->nr_heap++;
+  while (i > 0 && r->threads[(i - 1) / 2] > v) {
+    r->threads[i] = r->threads[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  r->threads[i] = v;
+}
+
+static double replay_heap_pop(struct replay_rank *r) {
+  const double top = r->threads[0];
+  const double last = r->threads[--r->nr_heap];
+  int i = 0;
+  while (2 * i + 1 < r->nr_heap) {
+    int c = 2 * i + 1;
+    if (c + 1 < r->nr_heap && r->threads[c + 1] < r->threads[c]) c++;
+    if (r->threads[c] >= last) break;
+    r->threads[i] = r->threads[c];
+    i = c;
+  }
+  r->threads[i] = last;
+  return top;
+}
+
+/**
+ * @brief Reset the replay state of all the ranks.
+ */
+static void replay_reset(struct replay_rank *ranks, int nr_ranks,
+                         struct replay_msg *msgs, int nr_msgs,
+                         const struct replay_model *model) {
+
+  for (int r = 0; r < nr_ranks; r++) {
+    struct replay_rank *rank = &ranks[r];
+    rank->next = 0;
+    rank->end_ptr = 0;
+    rank->out_ptr = 0;
+    rank->allmax = 0.;
+    rank->nic_free = 0.;
+    rank->step_end = rank->first_start;
+    rank->comm_wait = 0.;
+    for (int k = 0; k < replay_nr_full_types; k++) rank->typemax[k] = 0.;
+    for (int i = 0; i < rank->nr_tasks; i++) rank->tasks[i].done = 0;
+
+    const int nr_threads =
+        model->nr_threads > 0 ? model->nr_threads : rank->nr_threads;
+    rank->nr_heap = 0;
+    rank->threads = (double *)realloc(rank->threads,
+                                      max(nr_threads, 1) * sizeof(double));
+    for (int k = 0; k < max(nr_threads, 1); k++)
+      replay_heap_push(rank, rank->first_start);
+  }
+  for (int k = 0; k < nr_msgs; k++) msgs[k].resolved = 0;
+}
+
+/**
+ * @brief Move the completed-tasks front of a rank up to a measured time.
+ *
+ * Only tasks that have already been replayed are taken into account.
+ */
+static void replay_advance_front(struct replay_rank *r, double time) {
+
+  while (r->end_ptr < r->nr_tasks) {
+    const struct replay_task *t = &r->tasks[r->by_end[r->end_ptr]];
+    if (t->end > time || !t->done) break;
+    if (t->rend > r->typemax[t->full_type])
+      r->typemax[t->full_type] = t->rend;
+    if (t->rend > r->allmax) r->allmax = t->rend;
+    r->end_ptr++;
+  }
+}
+
+/**
+ * @brief The earliest replayed time at which a task of a given type can start
+ * given the tasks completed so far.
+ */
+static double replay_ready_time(const struct replay_rank *r, int full_type) {
+
+  if (replay_preds == NULL) return r->allmax;
+
+  double ready = 0.;
+  for (int k = 0; k < replay_nr_preds[full_type]; k++)
+    ready = max(ready, r->typemax[replay_preds[full_type][k]]);
+  return ready;
+}
+
+/**
+ * @brief Send a message through the network model.
+ */
+static void replay_send(struct replay_rank *r, struct replay_msg *m,
+                        const struct replay_model *model) {
+
+  replay_advance_front(r, m->depart);
+  const double depart = replay_ready_time(
+      r, task_type_send * task_subtype_count + m->subtype);
+
+  const double transfer =
+      (double)m->size * model->size_scale / model->bandwidth;
+  double start = depart;
+  if (model->serial_injection) {
+    start = max(depart, r->nic_free);
+    r->nic_free = start + transfer;
+  }
+  m->rarrive = start + model->latency + transfer;
+  m->resolved = 1;
+}
+
+/**
+ * @brief Replay as many tasks of a rank as possible.
+ *
+ * @return The number of tasks replayed.
+ */
+static int replay_progress(struct replay_rank *r, struct replay_msg *msgs,
+                           const struct replay_model *model) {
+
+  int count = 0;
+  while (r->next < r->nr_tasks) {
+    struct replay_task *t = &r->tasks[r->next];
+
+    /* Sends activated before this task started leave first. */
+    while (r->out_ptr < r->nr_out && msgs[r->out[r->out_ptr]].depart <= t->start)
+      replay_send(r, &msgs[r->out[r->out_ptr++]], model);
+
+    /* Recvs need their message to have been sent. */
+    if (t->msg >= 0 && !msgs[t->msg].resolved) break;
+
+    replay_advance_front(r, t->start);
+    double ready = replay_ready_time(r, t->full_type);
+    const double thread_free = replay_heap_pop(r);
+
+    if (t->msg >= 0) {
+      const double arrive = msgs[t->msg].rarrive;
+      if (arrive > max(ready, thread_free))
+        r->comm_wait += arrive - max(ready, thread_free);
+      ready = max(ready, arrive);
+    }
+
+    const double start = max(ready, thread_free);
+    t->rend = start + (t->end - t->start) * model->compute_scale;
+    t->done = 1;
+    replay_heap_push(r, t->rend);
+    if (t->rend > r->step_end) r->step_end = t->rend;
+
+    r->next++;
+    count++;
+  }
+
+  /* All the tasks are done, the remaining sends can leave. */
+  if (r->next == r->nr_tasks)
+    while (r->out_ptr < r->nr_out)
+      replay_send(r, &msgs[r->out[r->out_ptr++]], model);
+
+  return count;
+}
+
+/**
+ * @brief Replay the whole step.
+ *
+ * @return The replayed step time (maximum over the ranks).
+ */
+static double replay_run(struct replay_rank *ranks, int nr_ranks,
+                         struct replay_msg *msgs, int nr_msgs,
+                         const struct replay_model *model, int *nr_forced) {
+
+  replay_reset(ranks, nr_ranks, msgs, nr_msgs, model);
+  *nr_forced = 0;
+
+  while (1) {
+    int progress = 0, remaining = 0;
+    for (int r = 0; r < nr_ranks; r++) {
+      progress += replay_progress(&ranks[r], msgs, model);
+      remaining += ranks[r].nr_tasks - ranks[r].next;
+    }
+    if (remaining == 0) break;
+    if (progress > 0) continue;
+
+    /* No progress. Clock offsets between the ranks can make a send appear to
+     * be activated after the task it unlocks ran. Send the earliest blocking
+     * message from where its sender currently is. */
+    int blocked = -1;
+    for (int r = 0; r < nr_ranks; r++) {
+      const struct replay_rank *rank = &ranks[r];
+      if (rank->next == rank->nr_tasks) continue;
+      const int m = rank->tasks[rank->next].msg;
+      if (m >= 0 && !msgs[m].resolved &&
+          (blocked < 0 || msgs[m].depart < msgs[blocked].depart))
+        blocked = m;
+    }
+    if (blocked < 0) error("Replay is stuck without a blocking message.");
+    replay_send(&ranks[msgs[blocked].from], &msgs[blocked], model);
+    (*nr_forced)++;
+  }
+
+  /* Add back the time spent outside of the tasks. */
+  double step = 0.;
+  for (int r = 0; r < nr_ranks; r++) {
+    ranks[r].step_end += ranks[r].tail;
+    step = max(step, ranks[r].step_end);
+  }
+  return step;
+}
+
+/* Command line. */
+static const char *const replay_usage[] = {
+    "mpi_replay [options] -t thread_info_MPI-stepN.dat "
+    "mpiuse_report-rank*-stepN.dat",
+    NULL,
+};
+
+int main(int argc, char *argv[]) {
+
+  char *tasks_file = NULL;
+  char *deps_file = NULL;
+  float latency_us = 1.f;
+  float bandwidth_gbs = 10.f;
+  int nr_threads = 0;
+  int nr_ranks_target = 0;
+  float compute_scale = 1.f;
+  int parallel_injection = 0;
+
+  struct argparse_option options[] = {
+      OPT_HELP(),
+      OPT_STRING('t', "tasks", &tasks_file,
+                 "Task dump of the step (thread_info_MPI-stepN.dat).", NULL, 0,
+                 0),
+      OPT_STRING('d', "dependencies", &deps_file,
+                 "Dependency graph of the run (dependency_graph_N.csv).", NULL,
+                 0, 0),
+      OPT_FLOAT('l', "latency", &latency_us,
+                "Network latency in microseconds (default 1).", NULL, 0, 0),
+      OPT_FLOAT('b', "bandwidth", &bandwidth_gbs,
+                "Network bandwidth per rank in GB/s (default 10).", NULL, 0,
+                0),
+      OPT_INTEGER('n', "threads", &nr_threads,
+                  "Threads per rank (default: as measured).", NULL, 0, 0),
+      OPT_INTEGER('r', "ranks", &nr_ranks_target,
+                  "Number of ranks to predict for (default: as measured).",
+                  NULL, 0, 0),
+      OPT_FLOAT('c', "compute-scale", &compute_scale,
+                "Extra factor applied to the task durations (default 1).",
+                NULL, 0, 0),
+      OPT_BOOLEAN('p', "parallel-injection", &parallel_injection,
+                  "Let the sends of a rank overlap on the network.", NULL, 0,
+                  0),
+      OPT_END(),
+  };
+  struct argparse argparse;
+  argparse_init(&argparse, options, replay_usage, 0);
+  argparse_describe(&argparse,
+                    "\nReplay the tasks and MPI messages of a step to predict "
+                    "its duration on a different setup.",
+                    "");
+  const int nr_files = argparse_parse(&argparse, argc, (const char **)argv);
+
+  if (tasks_file == NULL || nr_files == 0) {
+    argparse_usage(&argparse);
+    return 1;
+  }
+
+  /* Read everything. */
+  if (deps_file != NULL) replay_read_dependencies(deps_file);
+
+  int nr_ranks = 0;
+  struct replay_rank *ranks = replay_read_tasks(tasks_file, &nr_ranks);
+
+  int nr_msgs = 0;
+  struct replay_msg *msgs = replay_read_messages(
+      (const char **)argv, nr_files, ranks, nr_ranks, &nr_msgs);
+
+  /* Sort the tasks and messages as the replay needs them. */
+  for (int r = 0; r < nr_ranks; r++) {
+    struct replay_rank *rank = &ranks[r];
+    qsort(rank->tasks, rank->nr_tasks, sizeof(struct replay_task),
+          replay_cmp_start);
+    rank->by_end = (int *)malloc(rank->nr_tasks * sizeof(int));
+    for (int i = 0; i < rank->nr_tasks; i++) rank->by_end[i] = i;
+
+    double last_end = 0.;
+    for (int i = 0; i < rank->nr_tasks; i++)
+      last_end = max(last_end, rank->tasks[i].end);
+    rank->first_start = rank->nr_tasks > 0 ? rank->tasks[0].start : 0.;
+    rank->tail =
+        (double)(rank->toc_step - rank->tic_step) / rank->cpufreq - last_end;
+    if (rank->tail < 0.) rank->tail = 0.;
+    replay_sort_tasks = rank->tasks;
+    qsort(rank->by_end, rank->nr_tasks, sizeof(int), replay_cmp_end);
+
+    rank->out = (int *)malloc(nr_msgs * sizeof(int));
+    rank->nr_out = 0;
+    for (int k = 0; k < nr_msgs; k++)
+      if (msgs[k].from == r) rank->out[rank->nr_out++] = k;
+    replay_sort_msgs = msgs;
+    qsort(rank->out, rank->nr_out, sizeof(int), replay_cmp_depart);
+
+    rank->typemax = (double *)malloc(replay_nr_full_types * sizeof(double));
+    rank->threads = NULL;
+  }
+  replay_attach_messages(ranks, nr_ranks, msgs, nr_msgs);
+
+  /* The model. */
+  struct replay_model model;
+  model.latency = latency_us * 1e-6;
+  model.bandwidth = bandwidth_gbs * 1e9;
+  model.serial_injection = !parallel_injection;
+  model.nr_threads = nr_threads;
+  model.compute_scale = compute_scale;
+  model.size_scale = 1.;
+  if (nr_ranks_target > 0) {
+    const double ratio = (double)nr_ranks / (double)nr_ranks_target;
+    model.compute_scale *= ratio;
+    model.size_scale = pow(ratio, 2. / 3.);
+  }
+
+  /* Replay with the model and with an infinitely fast network to separate
+   * the cost of the communications. */
+  int nr_forced = 0, nr_forced_ideal = 0;
+  struct replay_model ideal = model;
+  ideal.latency = 0.;
+  ideal.bandwidth = DBL_MAX;
+  const double step_ideal =
+      replay_run(ranks, nr_ranks, msgs, nr_msgs, &ideal, &nr_forced_ideal);
+  double *ideal_ends = (double *)malloc(nr_ranks * sizeof(double));
+  for (int r = 0; r < nr_ranks; r++) ideal_ends[r] = ranks[r].step_end;
+
+  const double step =
+      replay_run(ranks, nr_ranks, msgs, nr_msgs, &model, &nr_forced);
+
+  /* Report. */
+  long long total_tasks = 0, total_bytes = 0;
+  double measured = 0.;
+  for (int r = 0; r < nr_ranks; r++) total_tasks += ranks[r].nr_tasks;
+  for (int k = 0; k < nr_msgs; k++) total_bytes += msgs[k].size;
+
+  printf("# Ranks: %d, tasks: %lld, messages: %d (%.3f MB)\n", nr_ranks,
+         total_tasks, nr_msgs, total_bytes / (1024. * 1024.));
+  printf("# Model: latency %.3f us, bandwidth %.3f GB/s, %s injection, "
+         "%s threads, compute scale %.3f, size scale %.3f\n",
+         model.latency * 1e6, model.bandwidth / 1e9,
+         model.serial_injection ? "serial" : "parallel",
+         nr_threads > 0 ? "fixed" : "measured", model.compute_scale,
+         model.size_scale);
+  printf("# rank  threads  measured[ms]  ideal-network[ms]  predicted[ms]  "
+         "comm-wait[ms]\n");
+  for (int r = 0; r < nr_ranks; r++) {
+    const struct replay_rank *rank = &ranks[r];
+    const double rank_measured =
+        (double)(rank->toc_step - rank->tic_step) / rank->cpufreq;
+    measured = max(measured, rank_measured);
+    printf("%6d  %7d  %12.3f  %17.3f  %13.3f  %13.3f\n", r,
+           nr_threads > 0 ? nr_threads : rank->nr_threads,
+           rank_measured * 1e3, ideal_ends[r] * 1e3, rank->step_end * 1e3,
+           rank->comm_wait * 1e3);
+  }
+  printf("# Measured step time:       %.3f ms\n", measured * 1e3);
+  printf("# Ideal network step time:  %.3f ms\n", step_ideal * 1e3);
+  printf("# Predicted step time:      %.3f ms\n", step * 1e3);
+  printf("# Communication bound:      %.1f%%\n",
+         step > 0. ? 100. * (step - step_ideal) / step : 0.);
+  if (nr_ranks_target > 0)
+    printf("# Predicted for %d ranks (first-order scaling from %d).\n",
+           nr_ranks_target, nr_ranks);
+  if (nr_forced > 0 || nr_forced_ideal > 0)
+    message("%d messages were sent out of order because of clock offsets.",
+            max(nr_forced, nr_forced_ideal));
+
+  /* Clean up. */
+  for (int r = 0; r < nr_ranks; r++) {
+    free(ranks[r].tasks);
+    free(ranks[r].by_end);
+    free(ranks[r].out);
+    free(ranks[r].typemax);
+    free(ranks[r].threads);
+  }
+  free(ranks);
+  free(msgs);
+  free(ideal_ends);
+  if (replay_preds != NULL) {
+    for (int k = 0; k < replay_nr_full_types; k++) free(replay_preds[k]);
+    free(replay_preds);
+    free(replay_nr_preds);
+  }
+  return 0;
+}
@@ -0,0 +1,152 @@
+#!/usr/bin/env python
+"""
+Usage:
+    reconstruct_keyframe_snapshot.py delta_file.hdf5 full_file.hdf5 [gzip_level]
+
+Rebuilds a full snapshot from a snapshot written between two keyframes
+(see the Snapshots:keyframe_interval parameter) and its keyframe.
+
+The fields stored in the group PartTypeN/KeyframeDeltas of the delta file
+are integer multiples of their rounding step relative to the keyframe,
+zigzag-encoded (n >= 0 is stored as 2n and n < 0 as -2n - 1). The
+KeyframeIndex dataset gives the position of each particle in the keyframe
+file (-1 if the particle was not in the keyframe, in which case the delta
+is relative to 0). The reconstructed values are identical to the ones a
+full snapshot would have contained.
+
+The keyframe file is looked for as written in the header of the delta file
+and then relative to the directory of the delta file and to its parent. The
+gzip_level (default 4) is used for the reconstructed fields.
+
+This file is part of SWIFT.
+Copyright (C) 2024 The SWIFT team
+
+All Rights Reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+"""
+
+import os
+import shutil
+import sys
+import h5py as h5
+import numpy as np
+
+if len(sys.argv) < 3:
+    print(__doc__)
+    sys.exit(1)
+
+delta_file_name = sys.argv[1]
+full_file_name = sys.argv[2]
+gzip_level = 4
+if len(sys.argv) > 3:
+    gzip_level = int(sys.argv[3])
+
+
+def find_keyframe(name, delta_file_name):
+    """
+    Locate the keyframe file of a delta file.
+    """
+    delta_dir = os.path.dirname(os.path.abspath(delta_file_name))
+    candidates = [
+        name,
+        os.path.join(delta_dir, os.path.basename(name)),
+        os.path.join(os.path.dirname(delta_dir), name),
+    ]
+    for candidate in candidates:
+        if os.path.exists(candidate):
+            return candidate
+    raise IOError("Could not find the keyframe file '%s'" % name)
+
+
+# Start from a copy of the delta file
+shutil.copyfile(delta_file_name, full_file_name)
+full_file = h5.File(full_file_name, "r+")
+header = full_file["/Header"]
+
+if "IsKeyframe" not in header.attrs:
+    raise ValueError("'%s' is not part of a keyframe series" % delta_file_name)
+if header.attrs["IsKeyframe"]:
+    print("'%s' is a keyframe already, it was simply copied." % delta_file_name)
+    sys.exit(0)
+
+keyframe_name = header.attrs["Keyframe"]
+if isinstance(keyframe_name, bytes):
+    keyframe_name = keyframe_name.decode()
+keyframe_name = find_keyframe(keyframe_name, delta_file_name)
+print("Reading the keyframe from", keyframe_name)
+keyframe_file = h5.File(keyframe_name, "r")
+scale_factor = header.attrs["Scale-factor"][0]
+
+for group_name in full_file:
+    if not group_name.startswith("PartType"):
+        continue
+    group = full_file[group_name]
+    if "KeyframeDeltas" not in group:
+        continue
+    deltas = group["KeyframeDeltas"]
+    index = deltas["KeyframeIndex"][:]
+    in_keyframe = index >= 0
+
+    for field_name in deltas:
+        if field_name == "KeyframeIndex":
+            continue
+        print("Reconstructing", group_name + "/" + field_name)
+
+        key_data = keyframe_file[group_name + "/" + field_name]
+        delta = deltas[field_name]
+        step = delta.attrs["Step"][0]
+
+        # Undo the zigzag encoding. The sums are exact in double precision.
+        zigzag = delta[:].astype(np.uint64)
+        steps = (zigzag >> np.uint64(1)).astype(np.int64)
+        negative = (zigzag & np.uint64(1)) == 1
+        steps[negative] = -steps[negative] - 1
+        values = steps.astype(np.float64) * step
+        if np.any(in_keyframe):
+            values[in_keyframe] += key_data[:][index[in_keyframe]]
+        values = values.astype(key_data.dtype)
+
+        chunks = None
+        if values.shape[0] > 0:
+            chunks = (min(values.shape[0], 1 << 20),) + values.shape[1:]
+        if gzip_level > 0 and chunks is not None:
+            dset = group.create_dataset(
+                field_name,
+                data=values,
+                chunks=chunks,
+                shuffle=True,
+                compression="gzip",
+                compression_opts=gzip_level,
+            )
+        else:
+            dset = group.create_dataset(field_name, data=values, chunks=chunks)
+
+        # Same meta-data as in the keyframe, at the time of the delta file
+        for attr in key_data.attrs:
+            dset.attrs[attr] = key_data.attrs[attr]
+        a_exp = key_data.attrs["a-scale exponent"][0]
+        cgs = key_data.attrs[
+            "Conversion factor to CGS (not including cosmological corrections)"
+        ][0]
+        dset.attrs[
+            "Conversion factor to physical CGS (including cosmological corrections)"
+        ] = [cgs * scale_factor ** a_exp]
+
+    del group["KeyframeDeltas"]
+
+header.attrs["IsKeyframe"] = 1
+header.attrs["Keyframe"] = full_file_name
+full_file.close()
+keyframe_file.close()
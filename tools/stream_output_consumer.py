@@ -0,0 +1,161 @@
+#!/usr/bin/env python
+"""
+Usage:
+    stream_output_consumer.py name [number_of_outputs]
+
+Attaches to the shared-memory segment a SWIFT run writes its stream outputs
+to (see the StreamOutput section of the parameter file) and prints a summary
+of each output as it arrives. The name is the StreamOutput:basename of the
+run, followed by _XXXX (the rank) when running with MPI.
+
+The read_output() function returns the arrays of an output as a dictionary
+and can be used as a starting point for in-situ analysis. The arrays are
+views of the shared memory: they must be copied if they are needed after the
+slot has been released.
+
+This file is part of SWIFT.
+Copyright (C) 2024 The SWIFT team
+
+All Rights Reserved.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published
+by the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+"""
+
+import mmap
+import os
+import sys
+import time
+import numpy as np
+
+# Layout of src/stream_output.h (version 1)
+header_dtype = np.dtype(
+    [
+        ("magic", "S8"),
+        ("version", "<u4"),
+        ("num_slots", "<u4"),
+        ("slot_size", "<u8"),
+        ("slots_offset", "<u8"),
+        ("write_index", "<u8"),
+        ("read_index", "<u8"),
+        ("dropped", "<u8"),
+        ("rank", "<i4"),
+        ("nr_ranks", "<i4"),
+    ]
+)
+field_dtype = np.dtype(
+    [
+        ("name", "S64"),
+        ("part_type", "<i4"),
+        ("kind", "S1"),
+        ("padding", "S3"),
+        ("type_size", "<i4"),
+        ("dimension", "<i4"),
+        ("count", "<u8"),
+        ("offset", "<u8"),
+        ("cgs_factor", "<f8"),
+        ("a_exponent", "<f8"),
+    ]
+)
+slot_dtype = np.dtype(
+    [
+        ("output_index", "<u8"),
+        ("step", "<i8"),
+        ("time", "<f8"),
+        ("scale_factor", "<f8"),
+        ("size", "<u8"),
+        ("count", "<u8", 7),
+        ("nr_fields", "<i4"),
+        ("padding", "<i4"),
+    ]
+)
+
+
+def attach(name):
+    """
+    Map the segment of the given name and check its header.
+    """
+    name = name.lstrip("/")
+    fd = os.open(os.path.join("/dev/shm", name), os.O_RDWR)
+    buf = mmap.mmap(fd, 0)
+    os.close(fd)
+    header = np.frombuffer(buf, dtype=header_dtype, count=1)
+    if header["magic"][0] != b"SWIFTSHM" or header["version"][0] != 1:
+        raise ValueError("'%s' is not a SWIFT stream (version 1)" % name)
+    return buf, header
+
+
+def read_output(buf, header, index):
+    """
+    Return the meta-data and the arrays (as views) of the given output.
+    """
+    h = header[0]
+    start = int(h["slots_offset"] + (index % h["num_slots"]) * h["slot_size"])
+    slot = np.frombuffer(buf, dtype=slot_dtype, count=1, offset=start)[0]
+    fields = np.frombuffer(
+        buf,
+        dtype=field_dtype,
+        count=int(slot["nr_fields"]),
+        offset=start + slot_dtype.itemsize,
+    )
+    arrays = {}
+    for f in fields:
+        dtype = np.dtype("<%s%d" % (f["kind"].decode(), f["type_size"]))
+        count = int(f["count"]) * int(f["dimension"])
+        data = np.frombuffer(
+            buf, dtype=dtype, count=count, offset=start + int(f["offset"])
+        )
+        if f["dimension"] > 1:
+            data = data.reshape((int(f["count"]), int(f["dimension"])))
+        arrays["PartType%d/%s" % (f["part_type"], f["name"].decode())] = data
+    return slot, arrays
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    number_of_outputs = int(sys.argv[2]) if len(sys.argv) > 2 else -1
+
+    # Wait for the run to create the segment
+    segment = os.path.join("/dev/shm", sys.argv[1].lstrip("/"))
+    while not os.path.exists(segment):
+        time.sleep(0.1)
+    buf, header = attach(sys.argv[1])
+    done = 0
+    while number_of_outputs < 0 or done < number_of_outputs:
+
+        # Wait for the next output
+        read_index = int(header["read_index"][0])
+        if int(header["write_index"][0]) <= read_index:
+            time.sleep(0.01)
+            continue
+
+        slot, arrays = read_output(buf, header, read_index)
+        print(
+            "Output %d: step %d, t=%e, a=%e, %d dropped so far"
+            % (
+                slot["output_index"],
+                slot["step"],
+                slot["time"],
+                slot["scale_factor"],
+                header["dropped"][0],
+            )
+        )
+        for name, data in arrays.items():
+            print("  %-40s %-10s %s" % (name, data.dtype, data.shape))
+
+        # Release the slot
+        del slot, arrays
+        header["read_index"] = read_index + 1
+        done += 1